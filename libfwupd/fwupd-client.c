@@ -4,16 +4,22 @@
  * SPDX-License-Identifier: LGPL-2.1+
  */
 
+/* for memfd_create() */
+#define _GNU_SOURCE
+
 #include "config.h"
 
 #include <glib-object.h>
 #include <gio/gio.h>
 #include <gio/gunixfdlist.h>
 
+#include <errno.h>
 #include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include "fwupd-client.h"
 #include "fwupd-common.h"
@@ -355,6 +361,12 @@ fwupd_client_fixup_dbus_error (GError *error)
 				    G_DBUS_ERROR_SERVICE_UNKNOWN)) {
 		error->domain = FWUPD_ERROR;
 		error->code = FWUPD_ERROR_NOT_SUPPORTED;
+	} else if (g_error_matches (error,
+				    G_DBUS_ERROR,
+				    G_DBUS_ERROR_UNKNOWN_METHOD)) {
+		/* the daemon is older than the library */
+		error->domain = FWUPD_ERROR;
+		error->code = FWUPD_ERROR_NOT_SUPPORTED;
 	} else if (g_error_matches (error,
 				    G_IO_ERROR,
 				    G_IO_ERROR_DBUS_ERROR)) {
@@ -451,6 +463,93 @@ fwupd_client_get_history (FwupdClient *client, GCancellable *cancellable, GError
 	return fwupd_client_parse_devices_from_variant (val);
 }
 
+/**
+ * fwupd_client_get_history_filtered:
+ * @client: A #FwupdClient
+ * @device_id: (nullable): the device ID, or %NULL for all devices
+ * @update_state: a #FwupdUpdateState, or %FWUPD_UPDATE_STATE_UNKNOWN for any
+ * @modified_min: the earliest modification time in seconds, or 0
+ * @modified_max: the latest modification time in seconds, or 0
+ * @offset: the number of matching entries to skip
+ * @limit: the maximum number of entries to return, or 0 for no limit
+ * @cancellable: the #GCancellable, or %NULL
+ * @error: the #GError, or %NULL
+ *
+ * Gets a page of the history, oldest first. An error of
+ * %FWUPD_ERROR_NOTHING_TO_DO is returned when no entries match, and
+ * %FWUPD_ERROR_NOT_SUPPORTED if the daemon is too old to filter the history,
+ * in which case fwupd_client_get_history() can be used instead.
+ *
+ * Returns: (element-type FwupdDevice) (transfer container): results
+ *
+ * Since: 1.2.5
+ **/
+GPtrArray *
+fwupd_client_get_history_filtered (FwupdClient *client,
+				   const gchar *device_id,
+				   FwupdUpdateState update_state,
+				   guint64 modified_min,
+				   guint64 modified_max,
+				   guint offset,
+				   guint limit,
+				   GCancellable *cancellable,
+				   GError **error)
+{
+	FwupdClientPrivate *priv = GET_PRIVATE (client);
+	GVariantBuilder builder;
+	g_autoptr(GVariant) val = NULL;
+
+	g_return_val_if_fail (FWUPD_IS_CLIENT (client), NULL);
+	g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+	/* connect */
+	if (!fwupd_client_connect (client, cancellable, error))
+		return NULL;
+
+	/* set filters */
+	g_variant_builder_init (&builder, G_VARIANT_TYPE_ARRAY);
+	if (device_id != NULL) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "device-id", g_variant_new_string (device_id));
+	}
+	if (update_state != FWUPD_UPDATE_STATE_UNKNOWN) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "update-state", g_variant_new_uint32 (update_state));
+	}
+	if (modified_min > 0) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "modified-min", g_variant_new_uint64 (modified_min));
+	}
+	if (modified_max > 0) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "modified-max", g_variant_new_uint64 (modified_max));
+	}
+	if (offset > 0) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "offset", g_variant_new_uint32 (offset));
+	}
+	if (limit > 0) {
+		g_variant_builder_add (&builder, "{sv}",
+				       "limit", g_variant_new_uint32 (limit));
+	}
+
+	/* call into daemon */
+	val = g_dbus_proxy_call_sync (priv->proxy,
+				      "GetHistoryFiltered",
+				      g_variant_new ("(a{sv})", &builder),
+				      G_DBUS_CALL_FLAGS_NONE,
+				      -1,
+				      cancellable,
+				      error);
+	if (val == NULL) {
+		if (error != NULL)
+			fwupd_client_fixup_dbus_error (*error);
+		return NULL;
+	}
+	return fwupd_client_parse_devices_from_variant (val);
+}
+
 /**
  * fwupd_client_get_device_by_id:
  * @client: A #FwupdClient
@@ -902,6 +1001,50 @@ fwupd_client_send_message_cb (GObject *source_object, GAsyncResult *res, gpointe
 	g_main_loop_quit (helper->loop);
 }
 
+/* copy the archive into a sealed memfd so that the daemon can map it rather
+ * than reading the whole file into memory -- returns -1 if not possible */
+static gint
+fwupd_client_open_memfd (gint fd_src)
+{
+#ifdef HAVE_MEMFD_SEALS
+	gint fd;
+	guint8 buf[32 * 1024];
+
+	fd = memfd_create ("fwupd-archive", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0)
+		return -1;
+	for (;;) {
+		gssize rc = read (fd_src, buf, sizeof(buf));
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc < 0)
+			goto out;
+		if (rc == 0)
+			break;
+		for (gssize off = 0; off < rc;) {
+			gssize wr = write (fd, buf + off, rc - off);
+			if (wr < 0 && errno == EINTR)
+				continue;
+			if (wr < 0)
+				goto out;
+			off += wr;
+		}
+	}
+
+	/* the daemon only maps the memfd if it can no longer be modified */
+	if (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) < 0)
+		goto out;
+	if (lseek (fd, 0, SEEK_SET) < 0)
+		goto out;
+	return fd;
+out:
+	close (fd);
+	return -1;
+#else
+	return -1;
+#endif
+}
+
 /**
  * fwupd_client_install:
  * @client: A #FwupdClient
@@ -930,6 +1073,7 @@ fwupd_client_install (FwupdClient *client,
 	GVariantBuilder builder;
 	gint retval;
 	gint fd;
+	gint fd_memfd;
 	g_autoptr(FwupdClientHelper) helper = NULL;
 	g_autoptr(GDBusMessage) request = NULL;
 	g_autoptr(GUnixFDList) fd_list = NULL;
@@ -982,6 +1126,21 @@ fwupd_client_install (FwupdClient *client,
 		return FALSE;
 	}
 
+	/* prefer a sealed copy the daemon does not have to read */
+	fd_memfd = fwupd_client_open_memfd (fd);
+	if (fd_memfd >= 0) {
+		close (fd);
+		fd = fd_memfd;
+	} else if (lseek (fd, 0, SEEK_SET) < 0) {
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INVALID_FILE,
+			     "failed to rewind %s",
+			     filename);
+		close (fd);
+		return FALSE;
+	}
+
 	/* set out of band file descriptor */
 	fd_list = g_unix_fd_list_new ();
 	retval = g_unix_fd_list_append (fd_list, fd, NULL);
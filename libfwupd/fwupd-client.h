@@ -51,6 +51,15 @@ GPtrArray	*fwupd_client_get_devices		(FwupdClient	*client,
 GPtrArray	*fwupd_client_get_history		(FwupdClient	*client,
 							 GCancellable	*cancellable,
 							 GError		**error);
+GPtrArray	*fwupd_client_get_history_filtered	(FwupdClient	*client,
+							 const gchar	*device_id,
+							 FwupdUpdateState update_state,
+							 guint64	 modified_min,
+							 guint64	 modified_max,
+							 guint		 offset,
+							 guint		 limit,
+							 GCancellable	*cancellable,
+							 GError		**error);
 GPtrArray	*fwupd_client_get_releases		(FwupdClient	*client,
 							 const gchar	*device_id,
 							 GCancellable	*cancellable,
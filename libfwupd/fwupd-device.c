@@ -27,6 +27,8 @@
 
 static void fwupd_device_finalize	 (GObject *object);
 
+typedef guint8 FwupdDeviceGuid[16];
+
 typedef struct {
 	gchar				*id;
 	gchar				*parent_id;
@@ -34,6 +36,9 @@ typedef struct {
 	guint64				 modified;
 	guint64				 flags;
 	GPtrArray			*guids;
+	FwupdDeviceGuid			*guids_set;	/* open addressed */
+	guint				 guids_set_sz;
+	guint				 guids_set_len;
 	GPtrArray			*icons;
 	gchar				*name;
 	gchar				*serial;
@@ -296,6 +301,97 @@ fwupd_device_get_guids (FwupdDevice *device)
 	return priv->guids;
 }
 
+/* the binary form is private and only used as a key for the set, so the bytes
+ * are kept in string order rather than the mixed-endian RFC 4122 layout */
+static const FwupdDeviceGuid fwupd_guid_null = { 0x0 };
+
+/* only the canonical lowercase form is accepted so that matching stays case
+ * sensitive, and the null GUID is used for empty slots so is also rejected;
+ * anything else is compared as a string */
+static gboolean
+fwupd_device_guid_parse (const gchar *guidstr, FwupdDeviceGuid *guid)
+{
+	guint8 tmp = 0x0;
+	guint j = 0;
+
+	if (guidstr == NULL || strlen (guidstr) != 36)
+		return FALSE;
+	for (guint i = 0; i < 36; i++) {
+		gint val;
+		if (i == 8 || i == 13 || i == 18 || i == 23) {
+			if (guidstr[i] != '-')
+				return FALSE;
+			continue;
+		}
+		if (g_ascii_isupper (guidstr[i]))
+			return FALSE;
+		val = g_ascii_xdigit_value (guidstr[i]);
+		if (val < 0)
+			return FALSE;
+		(*guid)[j / 2] = (j % 2 == 0) ? (guint8) (val << 4) : (*guid)[j / 2] | (guint8) val;
+		tmp |= (guint8) val;
+		j++;
+	}
+	return tmp != 0x0;
+}
+
+static guint
+fwupd_device_guid_hash (const FwupdDeviceGuid *guid)
+{
+	/* most GUIDs are generated from a hash, so the bytes are random */
+	return ((guint) (*guid)[0] << 24) | ((guint) (*guid)[1] << 16) |
+	       ((guint) (*guid)[2] << 8) | (guint) (*guid)[3];
+}
+
+/* returns the slot for the GUID, or the empty slot where it would go */
+static FwupdDeviceGuid *
+fwupd_device_guids_set_find (FwupdDeviceGuid *set, guint set_sz, const FwupdDeviceGuid *guid)
+{
+	guint mask = set_sz - 1;
+	for (guint i = fwupd_device_guid_hash (guid) & mask; ; i = (i + 1) & mask) {
+		if (memcmp (set[i], *guid, sizeof(FwupdDeviceGuid)) == 0 ||
+		    memcmp (set[i], fwupd_guid_null, sizeof(FwupdDeviceGuid)) == 0)
+			return &set[i];
+	}
+}
+
+static void
+fwupd_device_guids_set_add (FwupdDevicePrivate *priv, const FwupdDeviceGuid *guid)
+{
+	FwupdDeviceGuid *slot;
+
+	/* keep the load factor under one half so lookups stay short */
+	if ((priv->guids_set_len + 1) * 2 > priv->guids_set_sz) {
+		guint set_sz = MAX (priv->guids_set_sz * 2, 8);
+		FwupdDeviceGuid *set = g_new0 (FwupdDeviceGuid, set_sz);
+		for (guint i = 0; i < priv->guids_set_sz; i++) {
+			if (memcmp (priv->guids_set[i], fwupd_guid_null, sizeof(FwupdDeviceGuid)) == 0)
+				continue;
+			slot = fwupd_device_guids_set_find (set, set_sz,
+							    (const FwupdDeviceGuid *) &priv->guids_set[i]);
+			memcpy (*slot, priv->guids_set[i], sizeof(FwupdDeviceGuid));
+		}
+		g_free (priv->guids_set);
+		priv->guids_set = set;
+		priv->guids_set_sz = set_sz;
+	}
+	slot = fwupd_device_guids_set_find (priv->guids_set, priv->guids_set_sz, guid);
+	if (memcmp (*slot, fwupd_guid_null, sizeof(FwupdDeviceGuid)) != 0)
+		return;
+	memcpy (*slot, *guid, sizeof(FwupdDeviceGuid));
+	priv->guids_set_len++;
+}
+
+static gboolean
+fwupd_device_guids_set_contains (FwupdDevicePrivate *priv, const FwupdDeviceGuid *guid)
+{
+	FwupdDeviceGuid *slot;
+	if (priv->guids_set_len == 0)
+		return FALSE;
+	slot = fwupd_device_guids_set_find (priv->guids_set, priv->guids_set_sz, guid);
+	return memcmp (*slot, fwupd_guid_null, sizeof(FwupdDeviceGuid)) != 0;
+}
+
 /**
  * fwupd_device_has_guid:
  * @device: A #FwupdDevice
@@ -311,9 +407,15 @@ gboolean
 fwupd_device_has_guid (FwupdDevice *device, const gchar *guid)
 {
 	FwupdDevicePrivate *priv = GET_PRIVATE (device);
+	FwupdDeviceGuid guid_raw;
 
 	g_return_val_if_fail (FWUPD_IS_DEVICE (device), FALSE);
 
+	/* valid GUIDs are always in the set */
+	if (fwupd_device_guid_parse (guid, &guid_raw))
+		return fwupd_device_guids_set_contains (priv, &guid_raw);
+
+	/* anything else has to be compared as a string */
 	for (guint i = 0; i < priv->guids->len; i++) {
 		const gchar *guid_tmp = g_ptr_array_index (priv->guids, i);
 		if (g_strcmp0 (guid, guid_tmp) == 0)
@@ -335,9 +437,15 @@ void
 fwupd_device_add_guid (FwupdDevice *device, const gchar *guid)
 {
 	FwupdDevicePrivate *priv = GET_PRIVATE (device);
+	FwupdDeviceGuid guid_raw;
 	g_return_if_fail (FWUPD_IS_DEVICE (device));
-	if (fwupd_device_has_guid (device, guid))
+	if (fwupd_device_guid_parse (guid, &guid_raw)) {
+		if (fwupd_device_guids_set_contains (priv, &guid_raw))
+			return;
+		fwupd_device_guids_set_add (priv, &guid_raw);
+	} else if (fwupd_device_has_guid (device, guid)) {
 		return;
+	}
 	g_ptr_array_add (priv->guids, g_strdup (guid));
 }
 
@@ -1594,6 +1702,7 @@ fwupd_device_finalize (GObject *object)
 	g_free (priv->version_lowest);
 	g_free (priv->version_bootloader);
 	g_ptr_array_unref (priv->guids);
+	g_free (priv->guids_set);
 	g_ptr_array_unref (priv->icons);
 	g_ptr_array_unref (priv->checksums);
 	g_ptr_array_unref (priv->releases);
@@ -242,6 +242,10 @@ fwupd_device_func (void)
 	g_assert (fwupd_device_has_guid (dev, "2082b5e0-7a64-478a-b1b2-e3404fab6dad"));
 	g_assert (fwupd_device_has_guid (dev, "00000000-0000-0000-0000-000000000000"));
 	g_assert (!fwupd_device_has_guid (dev, "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx"));
+	g_assert (!fwupd_device_has_guid (dev, "1082b5e0-7a64-478a-b1b2-e3404fab6dad"));
+
+	/* matching is case sensitive */
+	g_assert (!fwupd_device_has_guid (dev, "2082B5E0-7A64-478A-B1B2-E3404FAB6DAD"));
 
 	ret = fu_test_compare_lines (str,
 		"ColorHug2\n"
@@ -330,13 +330,13 @@ static gboolean
 fu_colorhug_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 {
 	FuColorhugDevice *self = FU_COLORHUG_DEVICE (device);
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* build packets */
-	chunks = fu_chunk_array_new_from_bytes (fw,
-						self->start_addr,
-						0x00,	/* page_sz */
-						CH_FLASH_TRANSFER_BLOCK_SIZE);
+	chunks = fu_chunk_array_new_flat_from_bytes (fw,
+						     self->start_addr,
+						     0x00,	/* page_sz */
+						     CH_FLASH_TRANSFER_BLOCK_SIZE);
 
 	/* don't auto-boot firmware */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
@@ -349,7 +349,7 @@ fu_colorhug_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 
 	/* write each block */
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		guint8 buf[CH_FLASH_TRANSFER_BLOCK_SIZE+4];
 		g_autoptr(GError) error_local = NULL;
 
@@ -377,7 +377,7 @@ fu_colorhug_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 	/* verify each block */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_VERIFY);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		guint8 buf[3];
 		guint8 buf_out[CH_FLASH_TRANSFER_BLOCK_SIZE+1];
 		g_autoptr(GError) error_local = NULL;
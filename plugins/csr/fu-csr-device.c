@@ -473,18 +473,18 @@ fu_csr_device_download (FuDevice *device, GBytes *blob, GError **error)
 	FuCsrDevice *self = FU_CSR_DEVICE (device);
 	guint16 idx;
 	g_autoptr(GBytes) blob_empty = NULL;
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* notify UI */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
 
 	/* create chunks */
-	chunks = fu_chunk_array_new_from_bytes (blob, 0x0, 0x0,
-						FU_CSR_PACKET_DATA_SIZE - FU_CSR_COMMAND_HEADER_SIZE);
+	chunks = fu_chunk_array_new_flat_from_bytes (blob, 0x0, 0x0,
+						     FU_CSR_PACKET_DATA_SIZE - FU_CSR_COMMAND_HEADER_SIZE);
 
 	/* send to hardware */
 	for (idx = 0; idx < chunks->len; idx++) {
-		FuChunk *chk = g_ptr_array_index (chunks, idx);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, idx);
 		g_autoptr(GBytes) blob_tmp = g_bytes_new_static (chk->data, chk->data_sz);
 
 		/* send packet */
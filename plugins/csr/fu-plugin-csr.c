@@ -37,10 +37,7 @@ fu_plugin_verify (FuPlugin *plugin, FuDevice *device,
 {
 	g_autoptr(GBytes) blob_fw = NULL;
 	g_autoptr(FuDeviceLocker) locker = NULL;
-	GChecksumType checksum_types[] = {
-		G_CHECKSUM_SHA1,
-		G_CHECKSUM_SHA256,
-		0 };
+	g_autoptr(GPtrArray) checksums = NULL;
 
 	/* get data */
 	locker = fu_device_locker_new (device, error);
@@ -49,11 +46,10 @@ fu_plugin_verify (FuPlugin *plugin, FuDevice *device,
 	blob_fw = fu_device_read_firmware (device, error);
 	if (blob_fw == NULL)
 		return FALSE;
-	for (guint i = 0; checksum_types[i] != 0; i++) {
-		g_autofree gchar *hash = NULL;
-		hash = g_compute_checksum_for_bytes (checksum_types[i], blob_fw);
-		fu_device_add_checksum (device, hash);
-	}
+	checksums = fu_common_get_checksums (blob_fw, FU_CHECKSUM_FLAG_SHA1 |
+							FU_CHECKSUM_FLAG_SHA256);
+	for (guint i = 0; i < checksums->len; i++)
+		fu_device_add_checksum (device, g_ptr_array_index (checksums, i));
 	return TRUE;
 }
 
@@ -17,6 +17,8 @@
 
 #include "dfu-common.h"
 
+#include "fwupd-error.h"
+
 /**
  * dfu_state_to_string:
  * @state: a #DfuState, e.g. %DFU_STATE_DFU_MANIFEST
@@ -326,3 +328,59 @@ dfu_utils_buffer_parse_uint32 (const gchar *data)
 	buffer[8] = '\0';
 	return (guint32) g_ascii_strtoull (buffer, NULL, 16);
 }
+
+/* valid digits have 0x10 set, so that the default of zero is invalid */
+static const guint8 dfu_utils_hex_table[256] = {
+	['0'] = 0x10, ['1'] = 0x11, ['2'] = 0x12, ['3'] = 0x13,
+	['4'] = 0x14, ['5'] = 0x15, ['6'] = 0x16, ['7'] = 0x17,
+	['8'] = 0x18, ['9'] = 0x19, ['a'] = 0x1a, ['b'] = 0x1b,
+	['c'] = 0x1c, ['d'] = 0x1d, ['e'] = 0x1e, ['f'] = 0x1f,
+	['A'] = 0x1a, ['B'] = 0x1b, ['C'] = 0x1c, ['D'] = 0x1d,
+	['E'] = 0x1e, ['F'] = 0x1f
+};
+
+/**
+ * dfu_utils_buffer_decode_hex:
+ * @data: a string
+ * @buf: the output buffer
+ * @bufsz: the number of bytes to decode
+ * @checksum: (nullable): a running 8-bit checksum, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Decodes pairs of base 16 digits from a string into a buffer, adding each
+ * byte to @checksum as it goes.
+ *
+ * The string MUST be at least @bufsz * 2 bytes long as this function cannot
+ * check the length of @data. Checking the size must be done in the caller.
+ *
+ * Return value: %TRUE for success, %FALSE if there was an invalid digit
+ **/
+gboolean
+dfu_utils_buffer_decode_hex (const gchar *data,
+			     guint8 *buf,
+			     gsize bufsz,
+			     guint8 *checksum,
+			     GError **error)
+{
+	const guint8 *tmp = (const guint8 *) data;
+	guint8 csum = 0;
+
+	for (gsize i = 0; i < bufsz; i++) {
+		guint8 hi = dfu_utils_hex_table[tmp[i * 2]];
+		guint8 lo = dfu_utils_hex_table[tmp[(i * 2) + 1]];
+		if ((hi & lo & 0x10) == 0) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "invalid hex digits '%c%c'",
+				     g_ascii_isprint (tmp[i * 2]) ? tmp[i * 2] : '?',
+				     g_ascii_isprint (tmp[(i * 2) + 1]) ? tmp[(i * 2) + 1] : '?');
+			return FALSE;
+		}
+		buf[i] = (guint8) (((hi & 0x0f) << 4) | (lo & 0x0f));
+		csum += buf[i];
+	}
+	if (checksum != NULL)
+		*checksum += csum;
+	return TRUE;
+}
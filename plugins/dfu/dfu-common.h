@@ -165,6 +165,11 @@ guint8		 dfu_utils_buffer_parse_uint8		(const gchar	*data);
 guint16		 dfu_utils_buffer_parse_uint16		(const gchar	*data);
 guint32		 dfu_utils_buffer_parse_uint24		(const gchar	*data);
 guint32		 dfu_utils_buffer_parse_uint32		(const gchar	*data);
+gboolean	 dfu_utils_buffer_decode_hex		(const gchar	*data,
+							 guint8		*buf,
+							 gsize		 bufsz,
+							 guint8		*checksum,
+							 GError		**error);
 
 G_END_DECLS
 
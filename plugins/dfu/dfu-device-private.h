@@ -17,6 +17,17 @@
 
 G_BEGIN_DECLS
 
+typedef void	 (*DfuDeviceRequestFunc)		(GObject	*backend,
+							 DfuRequest	 request,
+							 guint16	 value,
+							 GBytes		*data,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+typedef GBytes	*(*DfuDeviceRequestFinishFunc)	(GObject	*backend,
+							 GAsyncResult	*res,
+							 GError		**error);
+
 void		 dfu_device_error_fixup			(DfuDevice	*device,
 							 GError		**error);
 guint		 dfu_device_get_download_timeout	(DfuDevice	*device);
@@ -24,6 +35,34 @@ gchar		*dfu_device_get_quirks_as_string	(DfuDevice	*device);
 gchar		*dfu_device_get_attributes_as_string	(DfuDevice	*device);
 gboolean	 dfu_device_ensure_interface		(DfuDevice	*device,
 							 GError		**error);
+gboolean	 dfu_device_parse_status		(DfuDevice	*device,
+							 const guint8	*buf,
+							 gsize		 bufsz,
+							 GError		**error);
+gboolean	 dfu_device_has_request_funcs		(DfuDevice	*device);
+void		 dfu_device_request_async		(DfuDevice	*device,
+							 DfuRequest	 request,
+							 guint16	 value,
+							 GBytes		*data,
+							 GCancellable	*cancellable,
+							 GAsyncReadyCallback callback,
+							 gpointer	 user_data);
+GBytes		*dfu_device_request_finish		(DfuDevice	*device,
+							 GAsyncResult	*res,
+							 GError		**error);
+GBytes		*dfu_device_request_sync		(DfuDevice	*device,
+							 DfuRequest	 request,
+							 guint16	 value,
+							 GBytes		*data,
+							 GError		**error);
+
+/* export this just for the self tests */
+void		 dfu_device_set_request_funcs		(DfuDevice	*device,
+							 GObject	*backend,
+							 DfuDeviceRequestFunc request,
+							 DfuDeviceRequestFinishFunc request_finish);
+void		 dfu_device_add_attribute		(DfuDevice	*device,
+							 DfuDeviceAttributes attribute);
 
 G_END_DECLS
 
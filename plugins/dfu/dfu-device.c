@@ -43,6 +43,7 @@
  * * `use-atmel-avr`:		Device uses the ATMEL bootloader
  * * `use-protocol-zero`:	Fix up the protocol number
  * * `legacy-protocol`:		Use a legacy protocol version
+ * * `differential-write`:	Only write DfuSe sectors that have changed
  *
  * Default value: `none`
  *
@@ -111,6 +112,9 @@ typedef struct {
 	guint8			 iface_number;
 	guint			 dnload_timeout;
 	guint			 timeout_ms;
+	GObject			*backend;	/* nullable, for the self tests */
+	DfuDeviceRequestFunc	 backend_request;
+	DfuDeviceRequestFinishFunc backend_request_finish;
 } DfuDevicePrivate;
 
 enum {
@@ -558,6 +562,117 @@ dfu_device_has_attribute (DfuDevice *device, DfuDeviceAttributes attribute)
 	return (priv->attributes & attribute) > 0;
 }
 
+/**
+ * dfu_device_add_attribute: (skip)
+ * @device: A #DfuDevice
+ * @attribute: A #DfuDeviceAttributes, e.g. %DFU_DEVICE_ATTRIBUTE_CAN_DOWNLOAD
+ *
+ * Adds an attribute to the device.
+ **/
+void
+dfu_device_add_attribute (DfuDevice *device, DfuDeviceAttributes attribute)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_if_fail (DFU_IS_DEVICE (device));
+	priv->attributes |= attribute;
+}
+
+/**
+ * dfu_device_set_request_funcs: (skip)
+ * @device: A #DfuDevice
+ * @backend: (nullable): the object passed to @request and @request_finish
+ * @request: the function to send a request
+ * @request_finish: the function to get the result of @request
+ *
+ * Sends the DFU class requests to something other than the USB hardware, for
+ * instance a scripted device. This is only useful for the self tests.
+ **/
+void
+dfu_device_set_request_funcs (DfuDevice *device,
+			      GObject *backend,
+			      DfuDeviceRequestFunc request,
+			      DfuDeviceRequestFinishFunc request_finish)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_if_fail (DFU_IS_DEVICE (device));
+	g_return_if_fail (backend == NULL || G_IS_OBJECT (backend));
+	g_set_object (&priv->backend, backend);
+	priv->backend_request = request;
+	priv->backend_request_finish = request_finish;
+}
+
+gboolean
+dfu_device_has_request_funcs (DfuDevice *device)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+	return priv->backend != NULL;
+}
+
+void
+dfu_device_request_async (DfuDevice *device,
+			  DfuRequest request,
+			  guint16 value,
+			  GBytes *data,
+			  GCancellable *cancellable,
+			  GAsyncReadyCallback callback,
+			  gpointer user_data)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_if_fail (priv->backend != NULL);
+	priv->backend_request (priv->backend, request, value, data,
+			       cancellable, callback, user_data);
+}
+
+GBytes *
+dfu_device_request_finish (DfuDevice *device, GAsyncResult *res, GError **error)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+	g_return_val_if_fail (priv->backend != NULL, NULL);
+	return priv->backend_request_finish (priv->backend, res, error);
+}
+
+typedef struct {
+	DfuDevice		*device;
+	GBytes			*data;
+	GError			*error;
+	gboolean		 done;
+} DfuDeviceRequestHelper;
+
+static void
+dfu_device_request_sync_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	DfuDeviceRequestHelper *helper = (DfuDeviceRequestHelper *) user_data;
+	helper->data = dfu_device_request_finish (helper->device, res, &helper->error);
+	helper->done = TRUE;
+}
+
+/* the request may complete before returning, so iterate rather than using
+ * a GMainLoop that might never be quit */
+GBytes *
+dfu_device_request_sync (DfuDevice *device,
+			 DfuRequest request,
+			 guint16 value,
+			 GBytes *data,
+			 GError **error)
+{
+	DfuDeviceRequestHelper helper = {
+		.device		= device,
+	};
+	g_autoptr(GMainContext) context = g_main_context_new ();
+
+	g_main_context_push_thread_default (context);
+	dfu_device_request_async (device, request, value, data, NULL,
+				  dfu_device_request_sync_cb, &helper);
+	while (!helper.done)
+		g_main_context_iteration (context, TRUE);
+	g_main_context_pop_thread_default (context);
+	if (helper.data == NULL) {
+		g_propagate_error (error, helper.error);
+		return NULL;
+	}
+	return helper.data;
+}
+
 /**
  * dfu_device_remove_attribute: (skip)
  * @device: A #DfuDevice
@@ -628,6 +743,10 @@ dfu_device_set_quirks_from_string (DfuDevice *device, const gchar *str)
 			priv->quirks |= DFU_DEVICE_QUIRK_LEGACY_PROTOCOL;
 			continue;
 		}
+		if (g_strcmp0 (split[i], "differential-write") == 0) {
+			priv->quirks |= DFU_DEVICE_QUIRK_DIFFERENTIAL_WRITE;
+			continue;
+		}
 	}
 }
 
@@ -968,6 +1087,62 @@ dfu_device_refresh_and_clear (DfuDevice *device, GError **error)
 	return TRUE;
 }
 
+/**
+ * dfu_device_parse_status:
+ * @device: a #DfuDevice
+ * @buf: the DFU_GETSTATUS response
+ * @bufsz: size of @buf
+ * @error: a #GError, or %NULL
+ *
+ * Updates the cached properties on the DFU device from a GETSTATUS response.
+ * This is used for both synchronous and asynchronous requests.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+dfu_device_parse_status (DfuDevice *device,
+			 const guint8 *buf,
+			 gsize bufsz,
+			 GError **error)
+{
+	DfuDevicePrivate *priv = GET_PRIVATE (device);
+
+	g_return_val_if_fail (DFU_IS_DEVICE (device), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	if (bufsz != 6) {
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INTERNAL,
+			     "cannot get device status, invalid size: %04x",
+			     (guint) bufsz);
+		return FALSE;
+	}
+
+	/* some devices use the wrong state value */
+	if (dfu_device_has_quirk (device, DFU_DEVICE_QUIRK_FORCE_DFU_MODE)) {
+		g_debug ("quirking device into DFU mode");
+		dfu_device_set_state (device, DFU_STATE_DFU_IDLE);
+	} else {
+		dfu_device_set_state (device, buf[4]);
+	}
+
+	/* status or state changed */
+	dfu_device_set_status (device, buf[0]);
+	if (dfu_device_has_quirk (device, DFU_DEVICE_QUIRK_IGNORE_POLLTIMEOUT)) {
+		priv->dnload_timeout = 5;
+	} else {
+		priv->dnload_timeout = buf[1] +
+					(((guint32) buf[2]) << 8) +
+					(((guint32) buf[3]) << 16);
+	}
+	g_debug ("refreshed status=%s and state=%s (dnload=%u)",
+		 dfu_status_to_string (priv->status),
+		 dfu_state_to_string (priv->state),
+		 priv->dnload_timeout);
+	return TRUE;
+}
+
 /**
  * dfu_device_refresh:
  * @device: a #DfuDevice
@@ -989,6 +1164,25 @@ dfu_device_refresh (DfuDevice *device, GError **error)
 	g_return_val_if_fail (DFU_IS_DEVICE (device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* scripted device */
+	if (priv->backend != NULL) {
+		g_autoptr(GBytes) data = NULL;
+		data = dfu_device_request_sync (device, DFU_REQUEST_GETSTATUS,
+						0, NULL, &error_local);
+		if (data == NULL) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "cannot get device state: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		return dfu_device_parse_status (device,
+						g_bytes_get_data (data, NULL),
+						g_bytes_get_size (data),
+						error);
+	}
+
 	/* no backing USB device */
 	if (usb_device == NULL) {
 		g_set_error (error,
@@ -1026,37 +1220,7 @@ dfu_device_refresh (DfuDevice *device, GError **error)
 			     error_local->message);
 		return FALSE;
 	}
-	if (actual_length != 6) {
-		g_set_error (error,
-			     FWUPD_ERROR,
-			     FWUPD_ERROR_INTERNAL,
-			     "cannot get device status, invalid size: %04x",
-			     (guint) actual_length);
-		return FALSE;
-	}
-
-	/* some devices use the wrong state value */
-	if (dfu_device_has_quirk (device, DFU_DEVICE_QUIRK_FORCE_DFU_MODE)) {
-		g_debug ("quirking device into DFU mode");
-		dfu_device_set_state (device, DFU_STATE_DFU_IDLE);
-	} else {
-		dfu_device_set_state (device, buf[4]);
-	}
-
-	/* status or state changed */
-	dfu_device_set_status (device, buf[0]);
-	if (dfu_device_has_quirk (device, DFU_DEVICE_QUIRK_IGNORE_POLLTIMEOUT)) {
-		priv->dnload_timeout = 5;
-	} else {
-		priv->dnload_timeout = buf[1] +
-					(((guint32) buf[2]) << 8) +
-					(((guint32) buf[3]) << 16);
-	}
-	g_debug ("refreshed status=%s and state=%s (dnload=%u)",
-		 dfu_status_to_string (priv->status),
-		 dfu_state_to_string (priv->state),
-		 priv->dnload_timeout);
-	return TRUE;
+	return dfu_device_parse_status (device, buf, actual_length, error);
 }
 
 static guint8
@@ -1262,6 +1426,22 @@ dfu_device_abort (DfuDevice *device, GError **error)
 	g_return_val_if_fail (DFU_IS_DEVICE (device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
+	/* scripted device */
+	if (priv->backend != NULL) {
+		g_autoptr(GBytes) data = NULL;
+		data = dfu_device_request_sync (device, DFU_REQUEST_ABORT,
+						0, NULL, &error_local);
+		if (data == NULL) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "cannot abort device: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		return TRUE;
+	}
+
 	/* no backing USB device */
 	if (usb_device == NULL) {
 		g_set_error (error,
@@ -1914,6 +2094,17 @@ dfu_device_download (DfuDevice *device,
 		/* download onto target */
 		if (flags & DFU_TARGET_TRANSFER_FLAG_VERIFY)
 			flags_local = DFU_TARGET_TRANSFER_FLAG_VERIFY;
+		if (flags & DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL)
+			flags_local |= DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL;
+		if (priv->quirks & DFU_DEVICE_QUIRK_DIFFERENTIAL_WRITE) {
+			if (dfu_device_can_upload (device)) {
+				flags_local |= DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL;
+			} else {
+				g_warning ("ignoring differential-write quirk "
+					   "as %s cannot upload",
+					   dfu_device_get_platform_id (device));
+			}
+		}
 		if (dfu_firmware_get_format (firmware) == DFU_FIRMWARE_FORMAT_RAW)
 			flags_local |= DFU_TARGET_TRANSFER_FLAG_ADDR_HEURISTIC;
 		id1 = g_signal_connect (target_tmp, "percentage-changed",
@@ -2017,6 +2208,8 @@ dfu_device_get_quirks_as_string (DfuDevice *device)
 		g_string_append_printf (str, "use-any-interface|");
 	if (priv->quirks & DFU_DEVICE_QUIRK_LEGACY_PROTOCOL)
 		g_string_append_printf (str, "legacy-protocol|");
+	if (priv->quirks & DFU_DEVICE_QUIRK_DIFFERENTIAL_WRITE)
+		g_string_append_printf (str, "differential-write|");
 
 	/* a well behaved device */
 	if (str->len == 0) {
@@ -2113,6 +2306,8 @@ dfu_device_finalize (GObject *object)
 
 	if (priv->usb_context != NULL)
 		g_object_unref (priv->usb_context);
+	if (priv->backend != NULL)
+		g_object_unref (priv->backend);
 	g_free (priv->chip_id);
 	g_free (priv->jabra_detach);
 	g_ptr_array_unref (priv->targets);
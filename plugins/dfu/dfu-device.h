@@ -37,6 +37,7 @@ G_DECLARE_DERIVABLE_TYPE (DfuDevice, dfu_device, DFU, DEVICE, FuUsbDevice)
  * @DFU_DEVICE_QUIRK_IGNORE_UPLOAD:		Uploading from the device is broken
  * @DFU_DEVICE_QUIRK_ATTACH_EXTRA_RESET:	Device needs resetting twice for attach
  * @DFU_DEVICE_QUIRK_LEGACY_PROTOCOL:		Use a legacy protocol version
+ * @DFU_DEVICE_QUIRK_DIFFERENTIAL_WRITE:	Only write DfuSe sectors that have changed
  *
  * The workarounds for different devices.
  **/
@@ -54,6 +55,7 @@ typedef enum {
 	DFU_DEVICE_QUIRK_IGNORE_UPLOAD		= (1 << 10),
 	DFU_DEVICE_QUIRK_ATTACH_EXTRA_RESET	= (1 << 11),
 	DFU_DEVICE_QUIRK_LEGACY_PROTOCOL	= (1 << 12),
+	DFU_DEVICE_QUIRK_DIFFERENTIAL_WRITE	= (1 << 13),
 	/*< private >*/
 	DFU_DEVICE_QUIRK_LAST
 } DfuDeviceQuirks;
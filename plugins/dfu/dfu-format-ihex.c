@@ -74,17 +74,6 @@ dfu_firmware_ihex_record_type_to_string (guint8 record_type)
 	return NULL;
 }
 
-static gchar **
-_g_strnsplit (const gchar *str, gsize sz,
-	      const gchar *delimiter, gint max_tokens)
-{
-	if (str[sz - 1] != '\0') {
-		g_autofree gchar *str2 = g_strndup (str, sz);
-		return g_strsplit (str2, delimiter, max_tokens);
-	}
-	return g_strsplit (str, delimiter, max_tokens);
-}
-
 /**
  * dfu_firmware_from_ihex: (skip)
  * @firmware: a #DfuFirmware
@@ -103,17 +92,19 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 			GError **error)
 {
 	const gchar *data;
+	const gchar *data_end;
 	gboolean got_eof = FALSE;
+	gboolean verbose = g_getenv ("FWUPD_DFU_VERBOSE") != NULL;
 	gsize sz = 0;
 	guint32 abs_addr = 0x0;
 	guint32 addr_last = 0x0;
 	guint32 base_addr = 0x0;
 	guint32 seg_addr = 0x0;
-	g_auto(GStrv) lines = NULL;
+	guint8 rec[4 + 0xff + 1];
 	g_autoptr(DfuElement) element = NULL;
 	g_autoptr(DfuImage) image = NULL;
+	g_autoptr(GByteArray) buf = NULL;
 	g_autoptr(GBytes) contents = NULL;
-	g_autoptr(GString) buf = g_string_new (NULL);
 	g_autoptr(GString) buf_signature = g_string_new (NULL);
 
 	g_return_val_if_fail (bytes != NULL, FALSE);
@@ -123,34 +114,58 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 	dfu_image_set_name (image, "ihex");
 	element = dfu_element_new ();
 
-	/* parse records */
+	/* each data byte needs at least two chars */
 	data = g_bytes_get_data (bytes, &sz);
-	lines = _g_strnsplit ((const gchar *) data, sz, "\n", -1);
-	for (guint ln = 0; lines[ln] != NULL; ln++) {
-		const gchar *line = lines[ln];
+	buf = g_byte_array_sized_new (sz / 2);
+
+	/* anything after a NUL byte is ignored */
+	data_end = memchr (data, '\0', sz);
+	if (data_end == NULL)
+		data_end = data + sz;
+
+	/* parse records, one line at a time */
+	for (guint ln = 1; data < data_end; ln++) {
+		const gchar *line = data;
+		const gchar *tmp;
 		gsize linesz;
 		guint32 addr;
 		guint8 byte_cnt;
+		guint8 checksum = 0;
 		guint8 record_type;
 		guint line_end;
 
+		/* find the end of the line, and the start of the next */
+		tmp = memchr (line, '\n', data_end - line);
+		if (tmp == NULL) {
+			linesz = data_end - line;
+			data = data_end;
+		} else {
+			linesz = tmp - line;
+			data = tmp + 1;
+		}
+
 		/* ignore comments */
-		if (g_str_has_prefix (line, ";"))
+		if (linesz > 0 && line[0] == ';')
 			continue;
 
 		/* ignore blank lines */
-		g_strdelimit (lines[ln], "\r\x1a", '\0');
-		linesz = strlen (line);
+		for (gsize i = 0; i < linesz; i++) {
+			if (line[i] == '\r' || line[i] == '\x1a') {
+				linesz = i;
+				break;
+			}
+		}
 		if (linesz == 0)
 			continue;
 
 		/* check starting token */
 		if (line[0] != ':') {
+			g_autofree gchar *line_str = g_strndup (line, linesz);
 			g_set_error (error,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
 				     "invalid starting token on line %u: %s",
-				     ln + 1, line);
+				     ln, line_str);
 			return FALSE;
 		}
 
@@ -160,20 +175,27 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
 				     "line %u is incomplete, length %u",
-				     ln + 1, (guint) linesz);
+				     ln, (guint) linesz);
 			return FALSE;
 		}
 
 		/* length, 16-bit address, type */
-		byte_cnt = dfu_utils_buffer_parse_uint8 (line + 1);
-		addr = dfu_utils_buffer_parse_uint16 (line + 3);
-		record_type = dfu_utils_buffer_parse_uint8 (line + 7);
-		g_debug ("%s:", dfu_firmware_ihex_record_type_to_string (record_type));
-		g_debug ("  addr_start:\t0x%04x", addr);
-		g_debug ("  length:\t0x%02x", byte_cnt);
+		if (!dfu_utils_buffer_decode_hex (line + 1, rec, 4, &checksum, error)) {
+			g_prefix_error (error, "line %u: ", ln);
+			return FALSE;
+		}
+		byte_cnt = rec[0];
+		addr = ((guint32) rec[1] << 8) | rec[2];
+		record_type = rec[3];
+		if (verbose) {
+			g_debug ("%s:", dfu_firmware_ihex_record_type_to_string (record_type));
+			g_debug ("  addr_start:\t0x%04x", addr);
+			g_debug ("  length:\t0x%02x", byte_cnt);
+		}
 		addr += seg_addr;
 		addr += abs_addr;
-		g_debug ("  addr:\t0x%08x", addr);
+		if (verbose)
+			g_debug ("  addr:\t0x%08x", addr);
 
 		/* position of checksum */
 		line_end = 9 + byte_cnt * 2;
@@ -182,30 +204,73 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
 				     "line %u malformed, length: %u",
-				     ln + 1, line_end);
+				     ln, line_end);
 			return FALSE;
 		}
 
-		/* verify checksum */
+		/* decode the data and verify the checksum in one pass */
+		if (!dfu_utils_buffer_decode_hex (line + 9, rec + 4, byte_cnt,
+						  &checksum, error)) {
+			g_prefix_error (error, "line %u: ", ln);
+			return FALSE;
+		}
 		if ((flags & DFU_FIRMWARE_PARSE_FLAG_NO_CRC_TEST) == 0) {
-			guint8 checksum = 0;
-			for (guint i = 1; i < line_end + 2; i += 2) {
-				guint8 data_tmp = dfu_utils_buffer_parse_uint8 (line + i);
-				checksum += data_tmp;
+			if (line_end + 2 > (guint) linesz) {
+				g_set_error (error,
+					     FWUPD_ERROR,
+					     FWUPD_ERROR_INVALID_FILE,
+					     "line %u has no checksum",
+					     ln);
+				return FALSE;
+			}
+			if (!dfu_utils_buffer_decode_hex (line + line_end,
+							  rec + 4 + byte_cnt, 1,
+							  &checksum, error)) {
+				g_prefix_error (error, "line %u: ", ln);
+				return FALSE;
 			}
 			if (checksum != 0)  {
 				g_set_error (error,
 					     FWUPD_ERROR,
 					     FWUPD_ERROR_INVALID_FILE,
 					     "line %u has invalid checksum (0x%02x)",
-					     ln + 1, checksum);
+					     ln, checksum);
 				return FALSE;
 			}
 		}
 
+		/* records that contain an address need enough data */
+		if ((record_type == DFU_INHX32_RECORD_TYPE_EXTENDED_LINEAR ||
+		     record_type == DFU_INHX32_RECORD_TYPE_EXTENDED_SEGMENT) &&
+		    byte_cnt < 2) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "line %u has invalid %s record length %u",
+				     ln,
+				     dfu_firmware_ihex_record_type_to_string (record_type),
+				     byte_cnt);
+			return FALSE;
+		}
+		if ((record_type == DFU_INHX32_RECORD_TYPE_START_LINEAR ||
+		     record_type == DFU_INHX32_RECORD_TYPE_START_SEGMENT) &&
+		    byte_cnt < 4) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "line %u has invalid %s record length %u",
+				     ln,
+				     dfu_firmware_ihex_record_type_to_string (record_type),
+				     byte_cnt);
+			return FALSE;
+		}
+
 		/* process different record types */
 		switch (record_type) {
 		case DFU_INHX32_RECORD_TYPE_DATA:
+		{
+			guint32 len_hole;
+
 			/* base address for element */
 			if (base_addr == 0x0)
 				base_addr = addr;
@@ -220,36 +285,38 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 					     (guint) addr_last);
 				return FALSE;
 			}
+			if (byte_cnt == 0)
+				break;
 
-			/* parse bytes from line */
-			g_debug ("writing data 0x%08x", (guint32) addr);
-			for (guint i = 9; i < line_end; i += 2) {
-				/* any holes in the hex record */
-				guint32 len_hole = addr - addr_last;
-				guint8 data_tmp;
-				if (addr_last > 0 && len_hole > 0x100000) {
-					g_set_error (error,
-						     FWUPD_ERROR,
-						     FWUPD_ERROR_INVALID_FILE,
-						     "hole of 0x%x bytes too large to fill",
-						     (guint) len_hole);
-					return FALSE;
-				}
-				if (addr_last > 0x0 && len_hole > 1) {
+			/* any holes in the hex record */
+			len_hole = addr - addr_last;
+			if (addr_last > 0 && len_hole > 0x100000) {
+				g_set_error (error,
+					     FWUPD_ERROR,
+					     FWUPD_ERROR_INVALID_FILE,
+					     "hole of 0x%x bytes too large to fill",
+					     (guint) len_hole);
+				return FALSE;
+			}
+			if (addr_last > 0x0 && len_hole > 1) {
+				guint len_old = buf->len;
+				if (verbose) {
 					g_debug ("filling address 0x%08x to 0x%08x",
 						 addr_last + 1, addr_last + len_hole - 1);
-					for (guint j = 1; j < len_hole; j++) {
-						/* although 0xff might be clearer,
-						 * we can't write 0xffff to pic14 */
-						g_string_append_c (buf, 0x00);
-					}
 				}
-				/* write into buf */
-				data_tmp = dfu_utils_buffer_parse_uint8 (line + i);
-				g_string_append_c (buf, (gchar) data_tmp);
-				addr_last = addr++;
+				/* although 0xff might be clearer,
+				 * we can't write 0xffff to pic14 */
+				g_byte_array_set_size (buf, len_old + len_hole - 1);
+				memset (buf->data + len_old, 0x00, len_hole - 1);
 			}
+
+			/* write into buf */
+			if (verbose)
+				g_debug ("writing data 0x%08x", (guint32) addr);
+			g_byte_array_append (buf, rec + 4, byte_cnt);
+			addr_last = addr + byte_cnt - 1;
 			break;
+		}
 		case DFU_INHX32_RECORD_TYPE_EOF:
 			if (got_eof) {
 				g_set_error_literal (error,
@@ -262,28 +329,29 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 			got_eof = TRUE;
 			break;
 		case DFU_INHX32_RECORD_TYPE_EXTENDED_LINEAR:
-			abs_addr = dfu_utils_buffer_parse_uint16 (line + 9) << 16;
-			g_debug ("  abs_addr:\t0x%02x", abs_addr);
+			abs_addr = (((guint32) rec[4] << 8) | rec[5]) << 16;
+			if (verbose)
+				g_debug ("  abs_addr:\t0x%02x", abs_addr);
 			break;
 		case DFU_INHX32_RECORD_TYPE_START_LINEAR:
-			abs_addr = dfu_utils_buffer_parse_uint32 (line + 9);
-			g_debug ("  abs_addr:\t0x%08x", abs_addr);
+			abs_addr = fu_common_read_uint32 (rec + 4, G_BIG_ENDIAN);
+			if (verbose)
+				g_debug ("  abs_addr:\t0x%08x", abs_addr);
 			break;
 		case DFU_INHX32_RECORD_TYPE_EXTENDED_SEGMENT:
 			/* segment base address, so ~1Mb addressable */
-			seg_addr = dfu_utils_buffer_parse_uint16 (line + 9) * 16;
-			g_debug ("  seg_addr:\t0x%08x", seg_addr);
+			seg_addr = (((guint32) rec[4] << 8) | rec[5]) * 16;
+			if (verbose)
+				g_debug ("  seg_addr:\t0x%08x", seg_addr);
 			break;
 		case DFU_INHX32_RECORD_TYPE_START_SEGMENT:
 			/* initial content of the CS:IP registers */
-			seg_addr = dfu_utils_buffer_parse_uint32 (line + 9);
-			g_debug ("  seg_addr:\t0x%02x", seg_addr);
+			seg_addr = fu_common_read_uint32 (rec + 4, G_BIG_ENDIAN);
+			if (verbose)
+				g_debug ("  seg_addr:\t0x%02x", seg_addr);
 			break;
 		case DFU_INHX32_RECORD_TYPE_SIGNATURE:
-			for (guint i = 9; i < line_end; i += 2) {
-				guint8 tmp_c = dfu_utils_buffer_parse_uint8 (line + i);
-				g_string_append_c (buf_signature, tmp_c);
-			}
+			g_string_append_len (buf_signature, (const gchar *) rec + 4, byte_cnt);
 			break;
 		default:
 			/* vendors sneak in nonstandard sections past the EOF */
@@ -308,7 +376,7 @@ dfu_firmware_from_ihex (DfuFirmware *firmware,
 	}
 
 	/* add single image */
-	contents = g_bytes_new (buf->str, buf->len);
+	contents = g_byte_array_free_to_bytes (g_steal_pointer (&buf));
 	dfu_element_set_contents (element, contents);
 	dfu_element_set_address (element, base_addr);
 	dfu_image_add_element (image, element);
@@ -68,29 +68,34 @@ dfu_image_from_srec (DfuImage *image,
 	const gchar *in_buffer;
 	gboolean got_eof = FALSE;
 	gboolean got_hdr = FALSE;
+	gboolean verbose = g_getenv ("FWUPD_DFU_VERBOSE") != NULL;
 	gsize len_in;
 	guint16 class_data_cnt = 0;
 	guint32 addr32_last = 0;
 	guint32 element_address = 0;
 	guint offset = 0;
+	guint8 rec[1 + 0xff];
 	g_autoptr(DfuElement) element = NULL;
+	g_autoptr(GByteArray) outbuf = NULL;
 	g_autoptr(GBytes) contents = NULL;
 	g_autoptr(GString) modname = g_string_new (NULL);
-	g_autoptr(GString) outbuf = NULL;
 
 	g_return_val_if_fail (bytes != NULL, FALSE);
 
 	/* create element */
 	element = dfu_element_new ();
 
-	/* parse records */
+	/* each data byte needs at least two chars */
 	in_buffer = g_bytes_get_data (bytes, &len_in);
-	outbuf = g_string_new ("");
+	outbuf = g_byte_array_sized_new (len_in / 2);
+
+	/* parse records */
 	while (offset < len_in) {
 		DfuSrecClassType rec_class = DFU_SREC_RECORD_CLASS_UNKNOWN;
-		guint32 rec_addr32;
+		guint32 rec_addr32 = 0;
+		guint8 rec_addrlen;		/* bytes */
 		guint8 rec_count;		/* bytes */
-		guint8 rec_dataoffset;		/* bytes */
+		guint8 rec_csum = 0;
 		guint8 rec_kind;
 
 		/* check starting token */
@@ -115,7 +120,12 @@ dfu_image_from_srec (DfuImage *image,
 
 		/* kind, count, address, (data), checksum, linefeed */
 		rec_kind = in_buffer[offset + 1];
-		rec_count = dfu_utils_buffer_parse_uint8 (in_buffer + offset + 2);
+		if (!dfu_utils_buffer_decode_hex (in_buffer + offset + 2,
+						  rec, 1, &rec_csum, error)) {
+			g_prefix_error (error, "record at 0x%x: ", offset);
+			return FALSE;
+		}
+		rec_count = rec[0];
 
 		/* check we can read out this much data */
 		if (len_in < offset + (rec_count * 2) + 4) {
@@ -127,33 +137,85 @@ dfu_image_from_srec (DfuImage *image,
 			return FALSE;
 		}
 
-		/* checksum check */
-		if ((flags & DFU_FIRMWARE_PARSE_FLAG_NO_CRC_TEST) == 0) {
-			guint8 rec_csum = 0;
-			guint8 rec_csum_expected;
-			for (guint8 i = 0; i < rec_count; i++)
-				rec_csum += dfu_utils_buffer_parse_uint8 (in_buffer + offset + (i * 2) + 2);
-			rec_csum ^= 0xff;
-			rec_csum_expected = dfu_utils_buffer_parse_uint8 (in_buffer + offset + (rec_count * 2) + 2);
-			if (rec_csum != rec_csum_expected) {
-				g_set_error (error,
-					     FWUPD_ERROR,
-					     FWUPD_ERROR_INVALID_FILE,
-					     "checksum incorrect @ 0x%04x, expected %02x, got %02x",
-					     offset, rec_csum_expected, rec_csum);
-				return FALSE;
-			}
+		/* decode the address, data and checksum in one pass */
+		if (!dfu_utils_buffer_decode_hex (in_buffer + offset + 4,
+						  rec + 1, rec_count,
+						  &rec_csum, error)) {
+			g_prefix_error (error, "record at 0x%x: ", offset);
+			return FALSE;
 		}
 
-		/* record kind + record count (in bytes, not chars) */
-		rec_dataoffset = 2;
+		/* the sum including the checksum byte is always 0xff */
+		if ((flags & DFU_FIRMWARE_PARSE_FLAG_NO_CRC_TEST) == 0 &&
+		    rec_csum != 0xff) {
+			guint8 rec_csum_expected = rec[rec_count];
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "checksum incorrect @ 0x%04x, expected %02x, got %02x",
+				     offset, rec_csum_expected,
+				     (guint8) ((rec_csum - rec_csum_expected) ^ 0xff));
+			return FALSE;
+		}
 
-		/* parse record */
+		/* get the record class and address size */
 		switch (rec_kind) {
 		case '0':
 			rec_class = DFU_SREC_RECORD_CLASS_HEADER;
-			rec_dataoffset += 2;
-			rec_addr32 = dfu_utils_buffer_parse_uint16 (in_buffer + offset + 4);
+			rec_addrlen = 2;
+			break;
+		case '1':
+			rec_class = DFU_SREC_RECORD_CLASS_DATA;
+			rec_addrlen = 2;
+			break;
+		case '2':
+			rec_class = DFU_SREC_RECORD_CLASS_DATA;
+			rec_addrlen = 3;
+			break;
+		case '3':
+			rec_class = DFU_SREC_RECORD_CLASS_DATA;
+			rec_addrlen = 4;
+			break;
+		case '9':
+			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
+			rec_addrlen = 2;
+			break;
+		case '8':
+			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
+			rec_addrlen = 3;
+			break;
+		case '7':
+			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
+			rec_addrlen = 4;
+			break;
+		case '5':
+			rec_class = DFU_SREC_RECORD_CLASS_COUNT;
+			rec_addrlen = 2;
+			break;
+		default:
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "invalid srec record type S%c",
+				     rec_kind);
+			return FALSE;
+		}
+
+		/* address and checksum have to fit in the record */
+		if (rec_count < rec_addrlen + 1) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "record S%c too short @ 0x%04x, count %u",
+				     rec_kind, offset, (guint) rec_count);
+			return FALSE;
+		}
+		for (guint8 i = 0; i < rec_addrlen; i++)
+			rec_addr32 = (rec_addr32 << 8) | rec[i + 1];
+
+		/* parse record */
+		switch (rec_class) {
+		case DFU_SREC_RECORD_CLASS_HEADER:
 			if (got_hdr) {
 				g_set_error_literal (error,
 						     FWUPD_ERROR,
@@ -170,49 +232,21 @@ dfu_image_from_srec (DfuImage *image,
 				return FALSE;
 			}
 			/* could be anything, lets assume text */
-			for (guint8 i = rec_dataoffset; i <= rec_count; i++) {
-				guint8 tmp = dfu_utils_buffer_parse_uint8 (in_buffer + offset + (i * 2));
-				if (!g_ascii_isgraph (tmp))
+			for (guint i = rec_addrlen + 1; i < rec_count; i++) {
+				if (!g_ascii_isgraph (rec[i]))
 					break;
-				g_string_append_c (modname, tmp);
+				g_string_append_c (modname, rec[i]);
 			}
 			if (modname->len != 0)
 				dfu_image_set_name (image, modname->str);
 			got_hdr = TRUE;
 			break;
-		case '1':
-			rec_class = DFU_SREC_RECORD_CLASS_DATA;
-			rec_dataoffset += 2;
-			rec_addr32 = dfu_utils_buffer_parse_uint16 (in_buffer + offset + 4);
-			break;
-		case '2':
-			rec_class = DFU_SREC_RECORD_CLASS_DATA;
-			rec_dataoffset += 3;
-			rec_addr32 = dfu_utils_buffer_parse_uint24 (in_buffer + offset + 4);
-			break;
-		case '3':
-			rec_class = DFU_SREC_RECORD_CLASS_DATA;
-			rec_dataoffset += 4;
-			rec_addr32 = dfu_utils_buffer_parse_uint32 (in_buffer + offset + 4);
-			break;
-		case '9':
-			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
-			rec_addr32 = dfu_utils_buffer_parse_uint16 (in_buffer + offset + 4);
+		case DFU_SREC_RECORD_CLASS_TERMINATION:
+			if (verbose)
+				g_debug ("start execution location: 0x%04x", (guint) rec_addr32);
 			got_eof = TRUE;
 			break;
-		case '8':
-			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
-			rec_addr32 = dfu_utils_buffer_parse_uint24 (in_buffer + offset + 4);
-			got_eof = TRUE;
-			break;
-		case '7':
-			rec_class = DFU_SREC_RECORD_CLASS_TERMINATION;
-			rec_addr32 = dfu_utils_buffer_parse_uint32 (in_buffer + offset + 4);
-			got_eof = TRUE;
-			break;
-		case '5':
-			rec_class = DFU_SREC_RECORD_CLASS_COUNT;
-			rec_addr32 = dfu_utils_buffer_parse_uint16 (in_buffer + offset + 4);
+		case DFU_SREC_RECORD_CLASS_COUNT:
 			if (rec_addr32 != class_data_cnt) {
 				g_set_error (error,
 					     FWUPD_ERROR,
@@ -223,21 +257,7 @@ dfu_image_from_srec (DfuImage *image,
 			}
 			got_eof = TRUE;
 			break;
-		default:
-			g_set_error (error,
-				     FWUPD_ERROR,
-				     FWUPD_ERROR_INVALID_FILE,
-				     "invalid srec record type S%c",
-				     rec_kind);
-			return FALSE;
-		}
-
-		/* record EOF */
-		if (rec_class == DFU_SREC_RECORD_CLASS_TERMINATION)
-			g_debug ("start execution location: 0x%04x", (guint) rec_addr32);
-
-		/* read data */
-		if (rec_class == DFU_SREC_RECORD_CLASS_DATA) {
+		case DFU_SREC_RECORD_CLASS_DATA:
 			/* probably invalid data */
 			if (!got_hdr) {
 				g_set_error_literal (error,
@@ -257,18 +277,22 @@ dfu_image_from_srec (DfuImage *image,
 				return FALSE;
 			}
 			if (rec_addr32 < start_addr) {
-				g_debug ("ignoring data at 0x%x as before start address 0x%x",
-					 (guint) rec_addr32, (guint) start_addr);
-			} else {
-				for (guint8 i = rec_dataoffset; i <= rec_count; i++) {
-					guint8 tmp = dfu_utils_buffer_parse_uint8 (in_buffer + offset + (i * 2));
-					g_string_append_c (outbuf, tmp);
+				if (verbose) {
+					g_debug ("ignoring data at 0x%x as before start address 0x%x",
+						 (guint) rec_addr32, (guint) start_addr);
 				}
+			} else {
+				g_byte_array_append (outbuf,
+						     rec + rec_addrlen + 1,
+						     rec_count - rec_addrlen - 1);
 				if (element_address == 0x0)
 					element_address = rec_addr32;
 			}
-			addr32_last = rec_addr32++;
+			addr32_last = rec_addr32;
 			class_data_cnt++;
+			break;
+		default:
+			break;
 		}
 
 		/* ignore any line return */
@@ -290,7 +314,7 @@ dfu_image_from_srec (DfuImage *image,
 	}
 
 	/* add single image */
-	contents = g_bytes_new (outbuf->str, outbuf->len);
+	contents = g_byte_array_free_to_bytes (g_steal_pointer (&outbuf));
 	dfu_element_set_contents (element, contents);
 	dfu_element_set_address (element, element_address);
 	dfu_image_add_element (image, element);
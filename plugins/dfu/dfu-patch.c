@@ -10,10 +10,11 @@
  *
  * This object represents an binary patch that can be applied on a firmware
  * image. The patch itself is made up of chunks of data that have an offset
- * and that can replace the data to upgrade the firmware.
+ * and that can replace the data to upgrade the firmware. Chunks can also copy
+ * data from anywhere in the old image, so code that has been moved by the
+ * linker does not have to be included in the patch.
  *
- * Note: this is one way operation -- the patch can only be used to go forwards
- * and also cannot be used to truncate the existing image.
+ * Note: this is one way operation -- the patch can only be used to go forwards.
  *
  * See also: #DfuImage, #DfuFirmware
  */
@@ -23,11 +24,21 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "fu-common.h"
+
 #include "dfu-common.h"
 #include "dfu-patch.h"
 
 #include "fwupd-error.h"
 
+/* matching blocks in the old image are found using a rolling hash of this size,
+ * which has to be larger than a copy chunk to make the copy worthwhile */
+#define DFU_PATCH_BLOCK_SIZE		32
+#define DFU_PATCH_HASH_PRIME		0x01000193
+
+/* the amount of the new image held in memory when applying to a stream */
+#define DFU_PATCH_APPLY_BLOCK_SIZE	0x8000
+
 static void dfu_patch_finalize			 (GObject *object);
 
 typedef struct __attribute__((packed)) {
@@ -49,8 +60,19 @@ typedef struct {
 	GPtrArray		*chunks;		/* of DfuPatchChunk */
 } DfuPatchPrivate;
 
+typedef enum {
+	DFU_PATCH_CHUNK_FLAG_NONE		= 0,
+	DFU_PATCH_CHUNK_FLAG_COPY		= (1 << 0),	/* data is offset,length in old image */
+	DFU_PATCH_CHUNK_FLAG_SIZE		= (1 << 1),	/* off is the size of the new image */
+	/*< private >*/
+	DFU_PATCH_CHUNK_FLAG_LAST
+} DfuPatchChunkFlags;
+
 typedef struct {
 	guint32			 off;
+	guint32			 flags;			/* DfuPatchChunkFlags */
+	guint32			 src;			/* for DFU_PATCH_CHUNK_FLAG_COPY */
+	guint32			 sz;			/* bytes written to the new image */
 	GBytes			*blob;
 } DfuPatchChunk;
 
@@ -157,7 +179,7 @@ dfu_patch_export (DfuPatch *self, GError **error)
 		/* build chunk header and append data */
 		chunkhdr.off = GUINT32_TO_LE (chunk->off);
 		chunkhdr.sz = GUINT32_TO_LE (sz_tmp);
-		chunkhdr.flags = 0;
+		chunkhdr.flags = GUINT32_TO_LE (chunk->flags);
 		memcpy (data + addr, &chunkhdr, sizeof(DfuPatchChunkHeader));
 		memcpy (data + addr + sizeof(DfuPatchChunkHeader), data_new, sz_tmp);
 
@@ -200,7 +222,7 @@ dfu_patch_import (DfuPatch *self, GBytes *blob, GError **error)
 
 	/* check minimum size */
 	data = g_bytes_get_data (blob, &sz);
-	if (sz < sizeof(DfuPatchFileHeader) + sizeof(DfuPatchChunkHeader) + 1) {
+	if (sz < sizeof(DfuPatchFileHeader) + sizeof(DfuPatchChunkHeader)) {
 		g_set_error_literal (error,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
@@ -224,13 +246,26 @@ dfu_patch_import (DfuPatch *self, GBytes *blob, GError **error)
 	/* look for each chunk */
 	off = sizeof(DfuPatchFileHeader);
 	while (off < (guint32) sz) {
-		DfuPatchChunkHeader *chunkhdr = (DfuPatchChunkHeader *) (data + off);
+		DfuPatchChunkHeader chunkhdr;
 		DfuPatchChunk *chunk;
-		guint32 chunk_sz = GUINT32_FROM_LE (chunkhdr->sz);
-		guint32 chunk_off = GUINT32_FROM_LE (chunkhdr->off);
+		guint32 chunk_flags;
+		guint32 chunk_off;
+		guint32 chunk_sz;
 
 		/* check chunk size, assuming it can overflow */
-		if (chunk_sz > sz || off + chunk_sz > sz) {
+		if (off + sizeof(DfuPatchChunkHeader) > sz) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "chunk header 0x%04x outsize file size 0x%04x",
+				     (guint) off, (guint) sz);
+			return FALSE;
+		}
+		memcpy (&chunkhdr, data + off, sizeof(DfuPatchChunkHeader));
+		chunk_sz = GUINT32_FROM_LE (chunkhdr.sz);
+		chunk_off = GUINT32_FROM_LE (chunkhdr.off);
+		chunk_flags = GUINT32_FROM_LE (chunkhdr.flags);
+		if (chunk_sz > sz || off + sizeof(DfuPatchChunkHeader) + chunk_sz > sz) {
 			g_set_error (error,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
@@ -238,9 +273,45 @@ dfu_patch_import (DfuPatch *self, GBytes *blob, GError **error)
 				     (guint) (off + chunk_sz), (guint) sz);
 			return FALSE;
 		}
+
+		/* check the payload makes sense for the kind of chunk */
+		if (chunk_flags == DFU_PATCH_CHUNK_FLAG_COPY && chunk_sz != 8) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "copy chunk @0x%04x has invalid size 0x%x",
+				     (guint) chunk_off, (guint) chunk_sz);
+			return FALSE;
+		}
+		if (chunk_flags == DFU_PATCH_CHUNK_FLAG_SIZE && chunk_sz != 0) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "size chunk has invalid size 0x%x",
+				     (guint) chunk_sz);
+			return FALSE;
+		}
+		if (chunk_flags != DFU_PATCH_CHUNK_FLAG_NONE &&
+		    chunk_flags != DFU_PATCH_CHUNK_FLAG_COPY &&
+		    chunk_flags != DFU_PATCH_CHUNK_FLAG_SIZE) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "chunk flags 0x%x not supported",
+				     (guint) chunk_flags);
+			return FALSE;
+		}
 		chunk = g_new0 (DfuPatchChunk, 1);
 		chunk->off = chunk_off;
+		chunk->flags = chunk_flags;
 		chunk->blob = g_bytes_new_from_bytes (blob, off + sizeof(DfuPatchChunkHeader), chunk_sz);
+		if (chunk_flags == DFU_PATCH_CHUNK_FLAG_COPY) {
+			const guint8 *buf = data + off + sizeof(DfuPatchChunkHeader);
+			chunk->src = fu_common_read_uint32 (buf, G_LITTLE_ENDIAN);
+			chunk->sz = fu_common_read_uint32 (buf + 4, G_LITTLE_ENDIAN);
+		} else if (chunk_flags == DFU_PATCH_CHUNK_FLAG_NONE) {
+			chunk->sz = chunk_sz;
+		}
 		g_ptr_array_add (priv->chunks, chunk);
 		off += sizeof(DfuPatchChunkHeader) + chunk_sz;
 	}
@@ -259,44 +330,95 @@ dfu_patch_import (DfuPatch *self, GBytes *blob, GError **error)
 }
 
 
+static GBytes *
+dfu_patch_checksum_to_bytes (GChecksum *csum)
+{
+	gsize digest_len = 20;
+	guint8 *buf = g_malloc0 (digest_len);
+	g_checksum_get_digest (csum, buf, &digest_len);
+	return g_bytes_new_take (buf, digest_len);
+}
+
 static GBytes *
 dfu_patch_calculate_checksum (GBytes *blob)
 {
 	const guchar *data;
-	gsize digest_len = 20;
 	gsize sz = 0;
-	guint8 *buf = g_malloc0 (digest_len);
 	g_autoptr(GChecksum) csum = NULL;
 	csum = g_checksum_new (G_CHECKSUM_SHA1);
 	data = g_bytes_get_data (blob, &sz);
 	g_checksum_update (csum, data, (gssize) sz);
-	g_checksum_get_digest (csum, buf, &digest_len);
-	return g_bytes_new_take (buf, digest_len);
+	return dfu_patch_checksum_to_bytes (csum);
 }
 
-typedef struct {
-	guint32			 diff_start;
-	guint32			 diff_end;
-	GBytes			*blob; /* no ref */
-} DfuPatchCreateHelper;
-
 static void
-dfu_patch_flush (DfuPatch *self, DfuPatchCreateHelper *helper)
+dfu_patch_add_literal (DfuPatch *self, GBytes *blob, gsize start, gsize end)
 {
+	DfuPatchPrivate *priv = GET_PRIVATE (self);
 	DfuPatchChunk *chunk;
+
+	g_debug ("add chunk @0x%04x (len %" G_GSIZE_FORMAT ")",
+		 (guint) start, end - start);
+	chunk = g_new0 (DfuPatchChunk, 1);
+	chunk->off = (guint32) start;
+	chunk->sz = (guint32) (end - start);
+	chunk->blob = g_bytes_new_from_bytes (blob, start, end - start);
+	g_ptr_array_add (priv->chunks, chunk);
+}
+
+static void
+dfu_patch_add_copy (DfuPatch *self, gsize dst, gsize src, gsize length)
+{
 	DfuPatchPrivate *priv = GET_PRIVATE (self);
+	DfuPatchChunk *chunk;
+	guint8 buf[8];
+
+	g_debug ("add copy @0x%04x from 0x%04x (len %" G_GSIZE_FORMAT ")",
+		 (guint) dst, (guint) src, length);
+	fu_common_write_uint32 (buf, (guint32) src, G_LITTLE_ENDIAN);
+	fu_common_write_uint32 (buf + 4, (guint32) length, G_LITTLE_ENDIAN);
+	chunk = g_new0 (DfuPatchChunk, 1);
+	chunk->off = (guint32) dst;
+	chunk->flags = DFU_PATCH_CHUNK_FLAG_COPY;
+	chunk->src = (guint32) src;
+	chunk->sz = (guint32) length;
+	chunk->blob = g_bytes_new (buf, sizeof(buf));
+	g_ptr_array_add (priv->chunks, chunk);
+}
 
-	if (helper->diff_end == 0xffff)
-		return;
-	g_debug ("add chunk @0x%04x (len %" G_GUINT32_FORMAT ")",
-		 (guint) helper->diff_start, helper->diff_end - helper->diff_start + 1);
+static void
+dfu_patch_add_size (DfuPatch *self, gsize sz)
+{
+	DfuPatchPrivate *priv = GET_PRIVATE (self);
+	DfuPatchChunk *chunk;
 
+	g_debug ("add size 0x%04x", (guint) sz);
 	chunk = g_new0 (DfuPatchChunk, 1);
-	chunk->off = helper->diff_start;
-	chunk->blob = g_bytes_new_from_bytes (helper->blob, chunk->off,
-					      helper->diff_end - helper->diff_start + 1);
+	chunk->off = (guint32) sz;
+	chunk->flags = DFU_PATCH_CHUNK_FLAG_SIZE;
+	chunk->blob = g_bytes_new (NULL, 0);
 	g_ptr_array_add (priv->chunks, chunk);
-	helper->diff_end = 0xffff;
+}
+
+static guint32
+dfu_patch_hash_block (const guint8 *data)
+{
+	guint32 hash = 0;
+	for (guint i = 0; i < DFU_PATCH_BLOCK_SIZE; i++)
+		hash = (hash * DFU_PATCH_HASH_PRIME) + data[i];
+	return hash;
+}
+
+static gsize
+dfu_patch_match_len (const guint8 *data1, gsize sz1, const guint8 *data2, gsize sz2)
+{
+	gsize sz = MIN (sz1, sz2);
+	gsize i;
+	for (i = 0; i < sz; i++) {
+		if (data1[i] != data2[i])
+			break;
+	}
+	return i;
 }
 
 /**
@@ -308,12 +430,9 @@ dfu_patch_flush (DfuPatch *self, DfuPatchCreateHelper *helper)
  *
  * Creates a patch from two blobs of memory.
  *
- * The blobs should ideally be the same size. If @blob2 is has grown in size
- * the binary diff will still work but the algorithm will probably not perform
- * well unless the majority of data has just been appended.
- *
- * As an additional constrainst, @blob2 cannot be smaller than @blob1, i.e.
- * the firmware cannot be truncated by this format.
+ * Data that is unchanged at the same offset is not included in the patch, and
+ * data that has been moved is copied from the old image where possible. Only
+ * data that cannot be found in the old image is included in full.
  *
  * Return value: %TRUE on success
  **/
@@ -321,12 +440,17 @@ gboolean
 dfu_patch_create (DfuPatch *self, GBytes *blob1, GBytes *blob2, GError **error)
 {
 	DfuPatchPrivate *priv = GET_PRIVATE (self);
-	DfuPatchCreateHelper helper;
 	const guint8 *data1;
 	const guint8 *data2;
+	gboolean lit_pending = FALSE;
+	gsize hash_pos = G_MAXSIZE;
+	gsize lit_start = 0;
 	gsize sz1 = 0;
 	gsize sz2 = 0;
-	guint32 same_sz = 0;
+	gsize table_sz = 1;
+	guint32 hash = 0;
+	guint32 hash_pow = 1;
+	g_autofree guint32 *table = NULL;
 
 	g_return_val_if_fail (DFU_IS_PATCH (self), FALSE);
 	g_return_val_if_fail (blob1 != NULL, FALSE);
@@ -354,43 +478,106 @@ dfu_patch_create (DfuPatch *self, GBytes *blob1, GBytes *blob2, GError **error)
 	priv->checksum_old = dfu_patch_calculate_checksum (blob1);
 	priv->checksum_new = dfu_patch_calculate_checksum (blob2);
 
-	/* get the raw data, and ensure they are the same size */
+	/* get the raw data */
 	data1 = g_bytes_get_data (blob1, &sz1);
 	data2 = g_bytes_get_data (blob2, &sz2);
-	if (sz1 > sz2) {
-		g_set_error (error,
-			     FWUPD_ERROR,
-			     FWUPD_ERROR_NOT_SUPPORTED,
-			     "firmware binary cannot go down, got "
-			     "%" G_GSIZE_FORMAT " and %" G_GSIZE_FORMAT,
-			     sz1, sz2);
+	if (sz1 > G_MAXUINT32 || sz2 > G_MAXUINT32) {
+		g_set_error_literal (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "firmware binary too large");
 		return FALSE;
 	}
 	if (sz1 == sz2) {
 		g_debug ("binary staying same size: %" G_GSIZE_FORMAT, sz1);
 	} else {
-		g_debug ("binary growing from: %" G_GSIZE_FORMAT
+		g_debug ("binary changing from: %" G_GSIZE_FORMAT
 			 " to %" G_GSIZE_FORMAT, sz1, sz2);
 	}
 
-	/* start the dumb comparison algorithm */
-	helper.diff_start = 0;
-	helper.diff_end = 0xffff;
-	helper.blob = blob2;
-	for (gsize i = 0; i < sz1 || i < sz2; i++) {
-		if (i < sz1 && i < sz2 &&
-		    data1[i] == data2[i]) {
-			/* if we got enough the same, dump what is pending */
-			if (++same_sz > sizeof(DfuPatchChunkHeader) * 2)
-				dfu_patch_flush (self, &helper);
+	/* index each aligned block of the old image by hash, keeping the
+	 * first offset for each bucket */
+	while (table_sz < (sz1 / DFU_PATCH_BLOCK_SIZE) * 2)
+		table_sz <<= 1;
+	table = g_new0 (guint32, table_sz);
+	for (gsize i = 0; i + DFU_PATCH_BLOCK_SIZE <= sz1; i += DFU_PATCH_BLOCK_SIZE) {
+		guint32 *slot = &table[dfu_patch_hash_block (data1 + i) & (table_sz - 1)];
+		if (*slot == 0)
+			*slot = (guint32) i + 1;
+	}
+	for (guint i = 1; i < DFU_PATCH_BLOCK_SIZE; i++)
+		hash_pow *= DFU_PATCH_HASH_PRIME;
+
+	/* walk the new image, preferring data that has not moved, then data
+	 * that can be copied from the old image, then literal data */
+	for (gsize i = 0; i < sz2;) {
+		gsize same_sz = 0;
+
+		/* unchanged data does not need a chunk, but a short run is
+		 * cheaper to include in the literal than to split it */
+		if (i < sz1)
+			same_sz = dfu_patch_match_len (data1 + i, sz1 - i, data2 + i, sz2 - i);
+		if (same_sz > 0 &&
+		    (!lit_pending ||
+		     same_sz > sizeof(DfuPatchChunkHeader) * 2 ||
+		     i + same_sz == sz2)) {
+			if (lit_pending) {
+				dfu_patch_add_literal (self, blob2, lit_start, i);
+				lit_pending = FALSE;
+			}
+			i += same_sz;
 			continue;
 		}
-		if (helper.diff_end == 0xffff)
-			helper.diff_start = (guint32) i;
-		helper.diff_end = (guint32) i;
-		same_sz = 0;
+
+		/* look for this block anywhere in the old image */
+		if (i + DFU_PATCH_BLOCK_SIZE <= sz2 && sz1 >= DFU_PATCH_BLOCK_SIZE) {
+			guint32 slot;
+			if (hash_pos != G_MAXSIZE && i == hash_pos + 1) {
+				hash -= data2[hash_pos] * hash_pow;
+				hash = (hash * DFU_PATCH_HASH_PRIME) +
+				       data2[hash_pos + DFU_PATCH_BLOCK_SIZE];
+			} else {
+				hash = dfu_patch_hash_block (data2 + i);
+			}
+			hash_pos = i;
+			slot = table[hash & (table_sz - 1)];
+			if (slot != 0 &&
+			    memcmp (data1 + slot - 1, data2 + i, DFU_PATCH_BLOCK_SIZE) == 0) {
+				gsize src = slot - 1;
+				gsize dst = i;
+				gsize len;
+
+				/* extend forwards, and backwards into the literal */
+				len = dfu_patch_match_len (data1 + src, sz1 - src,
+							   data2 + dst, sz2 - dst);
+				while (lit_pending && dst > lit_start && src > 0 &&
+				       data1[src - 1] == data2[dst - 1]) {
+					src--;
+					dst--;
+					len++;
+				}
+				if (lit_pending && dst > lit_start)
+					dfu_patch_add_literal (self, blob2, lit_start, dst);
+				lit_pending = FALSE;
+				dfu_patch_add_copy (self, dst, src, len);
+				i = dst + len;
+				continue;
+			}
+		}
+
+		/* include in the literal */
+		if (!lit_pending) {
+			lit_start = i;
+			lit_pending = TRUE;
+		}
+		i += MAX (same_sz, 1);
 	}
-	dfu_patch_flush (self, &helper);
+	if (lit_pending)
+		dfu_patch_add_literal (self, blob2, lit_start, sz2);
+
+	/* chunks can only grow the image, so a smaller one needs its size set */
+	if (sz2 < sz1)
+		dfu_patch_add_size (self, sz2);
 	return TRUE;
 }
 
@@ -435,28 +622,12 @@ dfu_patch_get_checksum_new (DfuPatch *self)
 	return priv->checksum_new;
 }
 
-/**
- * dfu_patch_apply:
- * @self: a #DfuPatch
- * @blob: a #GBytes, typically the old firmware image
- * @flags: a #DfuPatchApplyFlags, e.g. %DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM
- * @error: a #GError, or %NULL
- *
- * Apply the currently loaded patch to a new firmware image.
- *
- * Return value: A #GBytes, typically saved as the new firmware file
- **/
-GBytes *
-dfu_patch_apply (DfuPatch *self, GBytes *blob, DfuPatchApplyFlags flags, GError **error)
+/* check each chunk can be applied, and get the size of the new image */
+static gboolean
+dfu_patch_check_chunks (DfuPatch *self, gsize sz_old, gsize *sz_new, GError **error)
 {
 	DfuPatchPrivate *priv = GET_PRIVATE (self);
-	const guint8 *data_old;
-	gsize sz;
-	gsize sz_max = 0;
-	g_autofree guint8 *data_new = NULL;
-	g_autoptr(GBytes) blob_checksum_new = NULL;
-	g_autoptr(GBytes) blob_checksum = NULL;
-	g_autoptr(GBytes) blob_new = NULL;
+	gsize sz_max = sz_old;
 
 	/* not loaded yet */
 	if (priv->chunks->len == 0) {
@@ -464,75 +635,137 @@ dfu_patch_apply (DfuPatch *self, GBytes *blob, DfuPatchApplyFlags flags, GError
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
 				     "no patches loaded");
-		return NULL;
-	}
-
-	/* get the hash of the old firmware file */
-	blob_checksum = dfu_patch_calculate_checksum (blob);
-	if ((flags & DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM) == 0 &&
-	    !g_bytes_equal (blob_checksum, priv->checksum_old)) {
-		g_autofree gchar *actual = _g_bytes_to_string (blob_checksum);
-		g_autofree gchar *expect = _g_bytes_to_string (priv->checksum_old);
-		g_set_error (error,
-			     FWUPD_ERROR,
-			     FWUPD_ERROR_INVALID_FILE,
-			     "checksum for source did not match, expected %s, got %s",
-			     expect, actual);
-		return NULL;
+		return FALSE;
 	}
 
-	/* get the size of the new image size */
+	/* the image grows to fit the largest chunk unless set explicitly */
 	for (guint i = 0; i < priv->chunks->len; i++) {
 		DfuPatchChunk *chunk = g_ptr_array_index (priv->chunks, i);
-		gsize chunk_sz = g_bytes_get_size (chunk->blob);
-		if (chunk->off + chunk_sz > sz_max)
-			sz_max = chunk->off + chunk_sz;
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_SIZE)
+			continue;
+		if ((guint64) chunk->off + chunk->sz > sz_max)
+			sz_max = (gsize) chunk->off + chunk->sz;
 	}
-
-	/* first, copy the data buffer */
-	data_old = g_bytes_get_data (blob, &sz);
-	if (sz_max < sz) {
-		g_set_error_literal (error,
-				     FWUPD_ERROR,
-				     FWUPD_ERROR_INVALID_FILE,
-				     "binary patch cannot truncate binary");
-		return NULL;
+	for (guint i = 0; i < priv->chunks->len; i++) {
+		DfuPatchChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_SIZE)
+			sz_max = chunk->off;
 	}
-	if (sz == sz_max) {
-		g_debug ("binary staying same size: %" G_GSIZE_FORMAT, sz);
+	if (sz_max == sz_old) {
+		g_debug ("binary staying same size: %" G_GSIZE_FORMAT, sz_old);
 	} else {
-		g_debug ("binary growing from: %" G_GSIZE_FORMAT
-			 " to %" G_GSIZE_FORMAT, sz, sz_max);
+		g_debug ("binary changing from: %" G_GSIZE_FORMAT
+			 " to %" G_GSIZE_FORMAT, sz_old, sz_max);
 	}
 
-	data_new = g_malloc0 (sz_max);
-	memcpy (data_new, data_old, MIN (sz, sz_max));
 	for (guint i = 0; i < priv->chunks->len; i++) {
 		DfuPatchChunk *chunk = g_ptr_array_index (priv->chunks, i);
-		const guint8 *chunk_data;
-		gsize chunk_sz;
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_SIZE)
+			continue;
 
 		/* bigger than the total size */
-		chunk_data = g_bytes_get_data (chunk->blob, &chunk_sz);
-		if (chunk->off + chunk_sz > sz_max) {
+		if ((guint64) chunk->off + chunk->sz > sz_max) {
 			g_set_error (error,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_INVALID_FILE,
 				     "cannot apply chunk as larger than max size");
-			return NULL;
+			return FALSE;
 		}
 
-		/* apply one chunk */
-		g_debug ("applying chunk %u/%u @0x%04x (length %" G_GSIZE_FORMAT ")",
-			 i + 1, priv->chunks->len, chunk->off, chunk_sz);
-		memcpy (data_new + chunk->off, chunk_data, chunk_sz);
+		/* copying from past the end of the old image */
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_COPY &&
+		    (guint64) chunk->src + chunk->sz > sz_old) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "cannot apply chunk as it copies 0x%x bytes from 0x%x",
+				     (guint) chunk->sz, (guint) chunk->src);
+			return FALSE;
+		}
 	}
+	*sz_new = sz_max;
+	return TRUE;
+}
 
-	/* check we got the desired hash */
-	blob_new = g_bytes_new (data_new, sz_max);
-	blob_checksum_new = dfu_patch_calculate_checksum (blob_new);
-	if ((flags & DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM) == 0 &&
-	    !g_bytes_equal (blob_checksum_new, priv->checksum_new)) {
+/* builds one block of the new image from the old image and the chunks */
+static void
+dfu_patch_apply_block (DfuPatch *self,
+		       const guint8 *data_old,
+		       gsize sz_old,
+		       gsize addr,
+		       guint8 *buf,
+		       gsize bufsz)
+{
+	DfuPatchPrivate *priv = GET_PRIVATE (self);
+
+	/* unchanged data */
+	if (addr < sz_old) {
+		gsize sz = MIN (sz_old - addr, bufsz);
+		memcpy (buf, data_old + addr, sz);
+		memset (buf + sz, 0x00, bufsz - sz);
+	} else {
+		memset (buf, 0x00, bufsz);
+	}
+
+	/* apply each chunk that overlaps this block, in order */
+	for (guint i = 0; i < priv->chunks->len; i++) {
+		DfuPatchChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		const guint8 *chunk_data;
+		gsize start;
+		gsize end;
+
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_SIZE)
+			continue;
+		if (chunk->off >= addr + bufsz || (gsize) chunk->off + chunk->sz <= addr)
+			continue;
+		start = MAX (chunk->off, addr);
+		end = MIN ((gsize) chunk->off + chunk->sz, addr + bufsz);
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_COPY)
+			chunk_data = data_old + chunk->src;
+		else
+			chunk_data = g_bytes_get_data (chunk->blob, NULL);
+		memcpy (buf + start - addr, chunk_data + start - chunk->off, end - start);
+	}
+}
+
+static gboolean
+dfu_patch_check_checksum_old (DfuPatch *self,
+			      GBytes *blob,
+			      DfuPatchApplyFlags flags,
+			      GError **error)
+{
+	DfuPatchPrivate *priv = GET_PRIVATE (self);
+	g_autoptr(GBytes) blob_checksum = NULL;
+
+	if (flags & DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM)
+		return TRUE;
+	blob_checksum = dfu_patch_calculate_checksum (blob);
+	if (!g_bytes_equal (blob_checksum, priv->checksum_old)) {
+		g_autofree gchar *actual = _g_bytes_to_string (blob_checksum);
+		g_autofree gchar *expect = _g_bytes_to_string (priv->checksum_old);
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INVALID_FILE,
+			     "checksum for source did not match, expected %s, got %s",
+			     expect, actual);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+dfu_patch_check_checksum_new (DfuPatch *self,
+			      GChecksum *csum,
+			      DfuPatchApplyFlags flags,
+			      GError **error)
+{
+	DfuPatchPrivate *priv = GET_PRIVATE (self);
+	g_autoptr(GBytes) blob_checksum_new = NULL;
+
+	if (flags & DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM)
+		return TRUE;
+	blob_checksum_new = dfu_patch_checksum_to_bytes (csum);
+	if (!g_bytes_equal (blob_checksum_new, priv->checksum_new)) {
 		g_autofree gchar *actual = _g_bytes_to_string (blob_checksum_new);
 		g_autofree gchar *expect = _g_bytes_to_string (priv->checksum_new);
 		g_set_error (error,
@@ -540,11 +773,116 @@ dfu_patch_apply (DfuPatch *self, GBytes *blob, DfuPatchApplyFlags flags, GError
 			     FWUPD_ERROR_INVALID_FILE,
 			     "checksum for result did not match, expected %s, got %s",
 			     expect, actual);
-		return NULL;
+		return FALSE;
 	}
+	return TRUE;
+}
+
+/**
+ * dfu_patch_apply:
+ * @self: a #DfuPatch
+ * @blob: a #GBytes, typically the old firmware image
+ * @flags: a #DfuPatchApplyFlags, e.g. %DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM
+ * @error: a #GError, or %NULL
+ *
+ * Apply the currently loaded patch to a new firmware image.
+ *
+ * Return value: A #GBytes, typically saved as the new firmware file
+ **/
+GBytes *
+dfu_patch_apply (DfuPatch *self, GBytes *blob, DfuPatchApplyFlags flags, GError **error)
+{
+	const guint8 *data_old;
+	gsize sz = 0;
+	gsize sz_new = 0;
+	g_autofree guint8 *data_new = NULL;
+	g_autoptr(GChecksum) csum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	g_return_val_if_fail (DFU_IS_PATCH (self), NULL);
+	g_return_val_if_fail (blob != NULL, NULL);
+
+	/* get the hash of the old firmware file */
+	if (!dfu_patch_check_checksum_old (self, blob, flags, error))
+		return NULL;
+
+	/* get the size of the new image size */
+	data_old = g_bytes_get_data (blob, &sz);
+	if (!dfu_patch_check_chunks (self, sz, &sz_new, error))
+		return NULL;
+
+	/* build the whole image in one block */
+	data_new = g_malloc0 (sz_new);
+	if (sz_new > 0)
+		dfu_patch_apply_block (self, data_old, sz, 0x0, data_new, sz_new);
+
+	/* check we got the desired hash */
+	g_checksum_update (csum, data_new, (gssize) sz_new);
+	if (!dfu_patch_check_checksum_new (self, csum, flags, error))
+		return NULL;
 
 	/* success */
-	return g_steal_pointer (&blob_new);
+	return g_bytes_new_take (g_steal_pointer (&data_new), sz_new);
+}
+
+/**
+ * dfu_patch_apply_to_stream:
+ * @self: a #DfuPatch
+ * @blob: a #GBytes, typically the old firmware image
+ * @stream: a #GOutputStream for the new firmware image
+ * @flags: a #DfuPatchApplyFlags, e.g. %DFU_PATCH_APPLY_FLAG_IGNORE_CHECKSUM
+ * @cancellable: a #GCancellable, or %NULL
+ * @error: a #GError, or %NULL
+ *
+ * Apply the currently loaded patch, writing the new firmware image to a
+ * stream in small blocks so that the new image is never held in memory.
+ * The old image can be mapped from disk using g_mapped_file_get_bytes().
+ *
+ * The checksum of the new image can only be verified once it has all been
+ * written, so the stream should be to a temporary location that is only used
+ * if this function returns %TRUE.
+ *
+ * Return value: %TRUE on success
+ **/
+gboolean
+dfu_patch_apply_to_stream (DfuPatch *self,
+			   GBytes *blob,
+			   GOutputStream *stream,
+			   DfuPatchApplyFlags flags,
+			   GCancellable *cancellable,
+			   GError **error)
+{
+	const guint8 *data_old;
+	gsize sz = 0;
+	gsize sz_new = 0;
+	g_autofree guint8 *buf = NULL;
+	g_autoptr(GChecksum) csum = g_checksum_new (G_CHECKSUM_SHA1);
+
+	g_return_val_if_fail (DFU_IS_PATCH (self), FALSE);
+	g_return_val_if_fail (blob != NULL, FALSE);
+	g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+
+	/* get the hash of the old firmware file */
+	if (!dfu_patch_check_checksum_old (self, blob, flags, error))
+		return FALSE;
+
+	/* get the size of the new image size */
+	data_old = g_bytes_get_data (blob, &sz);
+	if (!dfu_patch_check_chunks (self, sz, &sz_new, error))
+		return FALSE;
+
+	/* build and write each block */
+	buf = g_malloc (DFU_PATCH_APPLY_BLOCK_SIZE);
+	for (gsize addr = 0; addr < sz_new; addr += DFU_PATCH_APPLY_BLOCK_SIZE) {
+		gsize bufsz = MIN (sz_new - addr, DFU_PATCH_APPLY_BLOCK_SIZE);
+		dfu_patch_apply_block (self, data_old, sz, addr, buf, bufsz);
+		g_checksum_update (csum, buf, (gssize) bufsz);
+		if (!g_output_stream_write_all (stream, buf, bufsz, NULL,
+						cancellable, error))
+			return FALSE;
+	}
+
+	/* check we got the desired hash */
+	return dfu_patch_check_checksum_new (self, csum, flags, error);
 }
 
 /**
@@ -574,6 +912,16 @@ dfu_patch_to_string (DfuPatch *self)
 	/* add chunks */
 	for (guint i = 0; i < priv->chunks->len; i++) {
 		DfuPatchChunk *chunk = g_ptr_array_index (priv->chunks, i);
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_COPY) {
+			g_string_append_printf (str, "chunk #%02u     0x%04x, copy 0x%04x, length %u\n",
+						i, chunk->off, chunk->src, chunk->sz);
+			continue;
+		}
+		if (chunk->flags == DFU_PATCH_CHUNK_FLAG_SIZE) {
+			g_string_append_printf (str, "chunk #%02u     size 0x%04x\n",
+						i, chunk->off);
+			continue;
+		}
 		g_string_append_printf (str, "chunk #%02u     0x%04x, length %" G_GSIZE_FORMAT "\n",
 					i, chunk->off, g_bytes_get_size (chunk->blob));
 	}
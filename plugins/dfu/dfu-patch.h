@@ -50,6 +50,12 @@ GBytes		*dfu_patch_apply		(DfuPatch	*self,
 						 GBytes		*blob,
 						 DfuPatchApplyFlags flags,
 						 GError		**error);
+gboolean	 dfu_patch_apply_to_stream	(DfuPatch	*self,
+						 GBytes		*blob,
+						 GOutputStream	*stream,
+						 DfuPatchApplyFlags flags,
+						 GCancellable	*cancellable,
+						 GError		**error);
 GBytes		*dfu_patch_get_checksum_old	(DfuPatch	*self);
 GBytes		*dfu_patch_get_checksum_new	(DfuPatch	*self);
 
@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+/**
+ * SECTION:dfu-replay
+ * @short_description: A scripted DFU device
+ *
+ * This object replays a captured DFU session so that the download code can
+ * be tested and profiled without any hardware. Each request sent by the host
+ * is checked against the script and completed after the recorded latency.
+ *
+ * The text format has one request per line, for example:
+ *
+ * |[
+ * # DNLOAD wValue wLength latency-ms
+ * DNLOAD 2 2048 1
+ * # GETSTATUS bStatus bwPollTimeout bState latency-ms
+ * GETSTATUS 0 5 4 1
+ * ]|
+ *
+ * See also: #DfuTransfer
+ */
+
+#include "config.h"
+
+#include "dfu-replay.h"
+
+#include "fu-common.h"
+
+#include "fwupd-error.h"
+
+static void dfu_replay_finalize			 (GObject *object);
+
+typedef struct {
+	DfuRequest		 request;
+	guint16			 value;
+	gsize			 length;	/* for host-to-device requests */
+	GBytes			*data;		/* for device-to-host requests */
+	guint			 latency;	/* ms */
+} DfuReplayItem;
+
+struct _DfuReplay
+{
+	GObject			 parent_instance;
+	GQueue			*items;		/* of DfuReplayItem */
+};
+
+G_DEFINE_TYPE (DfuReplay, dfu_replay, G_TYPE_OBJECT)
+
+static void
+dfu_replay_item_free (DfuReplayItem *item)
+{
+	if (item->data != NULL)
+		g_bytes_unref (item->data);
+	g_free (item);
+}
+
+static const gchar *
+dfu_replay_request_to_string (DfuRequest request)
+{
+	if (request == DFU_REQUEST_DNLOAD)
+		return "DNLOAD";
+	if (request == DFU_REQUEST_UPLOAD)
+		return "UPLOAD";
+	if (request == DFU_REQUEST_GETSTATUS)
+		return "GETSTATUS";
+	if (request == DFU_REQUEST_ABORT)
+		return "ABORT";
+	return "unknown";
+}
+
+/**
+ * dfu_replay_add_dnload:
+ * @self: a #DfuReplay
+ * @value: the expected block number
+ * @length: the expected block size
+ * @latency: time in ms before the request completes
+ *
+ * Adds an expected DFU_DNLOAD request to the script.
+ **/
+void
+dfu_replay_add_dnload (DfuReplay *self, guint16 value, gsize length, guint latency)
+{
+	DfuReplayItem *item = g_new0 (DfuReplayItem, 1);
+	g_return_if_fail (DFU_IS_REPLAY (self));
+	item->request = DFU_REQUEST_DNLOAD;
+	item->value = value;
+	item->length = length;
+	item->latency = latency;
+	g_queue_push_tail (self->items, item);
+}
+
+/**
+ * dfu_replay_add_upload:
+ * @self: a #DfuReplay
+ * @value: the expected block number
+ * @data: the data to return
+ * @latency: time in ms before the request completes
+ *
+ * Adds an expected DFU_UPLOAD request to the script.
+ **/
+void
+dfu_replay_add_upload (DfuReplay *self, guint16 value, GBytes *data, guint latency)
+{
+	DfuReplayItem *item = g_new0 (DfuReplayItem, 1);
+	g_return_if_fail (DFU_IS_REPLAY (self));
+	g_return_if_fail (data != NULL);
+	item->request = DFU_REQUEST_UPLOAD;
+	item->value = value;
+	item->data = g_bytes_ref (data);
+	item->latency = latency;
+	g_queue_push_tail (self->items, item);
+}
+
+/**
+ * dfu_replay_add_abort:
+ * @self: a #DfuReplay
+ * @latency: time in ms before the request completes
+ *
+ * Adds an expected DFU_ABORT request to the script.
+ **/
+void
+dfu_replay_add_abort (DfuReplay *self, guint latency)
+{
+	DfuReplayItem *item = g_new0 (DfuReplayItem, 1);
+	g_return_if_fail (DFU_IS_REPLAY (self));
+	item->request = DFU_REQUEST_ABORT;
+	item->latency = latency;
+	g_queue_push_tail (self->items, item);
+}
+
+/**
+ * dfu_replay_add_getstatus:
+ * @self: a #DfuReplay
+ * @status: the #DfuStatus to report
+ * @state: the #DfuState to report
+ * @poll_timeout: the bwPollTimeout value in ms
+ * @latency: time in ms before the request completes
+ *
+ * Adds an expected DFU_GETSTATUS request to the script.
+ **/
+void
+dfu_replay_add_getstatus (DfuReplay *self,
+			  DfuStatus status,
+			  DfuState state,
+			  guint poll_timeout,
+			  guint latency)
+{
+	DfuReplayItem *item = g_new0 (DfuReplayItem, 1);
+	guint8 buf[6] = { 0x0 };
+
+	g_return_if_fail (DFU_IS_REPLAY (self));
+
+	buf[0] = status;
+	buf[1] = poll_timeout & 0xff;
+	buf[2] = (poll_timeout >> 8) & 0xff;
+	buf[3] = (poll_timeout >> 16) & 0xff;
+	buf[4] = state;
+	item->request = DFU_REQUEST_GETSTATUS;
+	item->data = g_bytes_new (buf, sizeof(buf));
+	item->latency = latency;
+	g_queue_push_tail (self->items, item);
+}
+
+/**
+ * dfu_replay_parse:
+ * @self: a #DfuReplay
+ * @data: a replay script
+ * @error: a #GError, or %NULL
+ *
+ * Adds the requests from a text replay script.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+dfu_replay_parse (DfuReplay *self, const gchar *data, GError **error)
+{
+	g_auto(GStrv) lines = NULL;
+
+	g_return_val_if_fail (DFU_IS_REPLAY (self), FALSE);
+	g_return_val_if_fail (data != NULL, FALSE);
+
+	lines = g_strsplit (data, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		g_auto(GStrv) split = NULL;
+
+		/* ignore blank lines and comments */
+		g_strstrip (lines[i]);
+		if (lines[i][0] == '\0' || lines[i][0] == '#')
+			continue;
+
+		split = g_strsplit_set (lines[i], " \t", -1);
+		if (g_strcmp0 (split[0], "DNLOAD") == 0 &&
+		    g_strv_length (split) == 4) {
+			dfu_replay_add_dnload (self,
+					       fu_common_strtoull (split[1]),
+					       fu_common_strtoull (split[2]),
+					       fu_common_strtoull (split[3]));
+			continue;
+		}
+		if (g_strcmp0 (split[0], "GETSTATUS") == 0 &&
+		    g_strv_length (split) == 5) {
+			dfu_replay_add_getstatus (self,
+						  fu_common_strtoull (split[1]),
+						  fu_common_strtoull (split[3]),
+						  fu_common_strtoull (split[2]),
+						  fu_common_strtoull (split[4]));
+			continue;
+		}
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INVALID_FILE,
+			     "invalid replay line %u: %s",
+			     i + 1, lines[i]);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * dfu_replay_get_remaining:
+ * @self: a #DfuReplay
+ *
+ * Gets the number of requests that have not yet been sent.
+ *
+ * Return value: integer
+ **/
+guint
+dfu_replay_get_remaining (DfuReplay *self)
+{
+	g_return_val_if_fail (DFU_IS_REPLAY (self), 0);
+	return g_queue_get_length (self->items);
+}
+
+static gboolean
+dfu_replay_complete_cb (gpointer user_data)
+{
+	GTask *task = G_TASK (user_data);
+	DfuReplayItem *item = g_task_get_task_data (task);
+	if (item->data != NULL) {
+		g_task_return_pointer (task,
+				       g_bytes_ref (item->data),
+				       (GDestroyNotify) g_bytes_unref);
+	} else {
+		g_task_return_pointer (task,
+				       g_bytes_new (NULL, 0),
+				       (GDestroyNotify) g_bytes_unref);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * dfu_replay_request_async:
+ * @self: a #DfuReplay
+ * @request: a #DfuRequest, e.g. %DFU_REQUEST_DNLOAD
+ * @value: the wValue of the request
+ * @data: the host-to-device data, or %NULL
+ * @cancellable: a #GCancellable, or %NULL
+ * @callback: the function to run on completion
+ * @user_data: the data to pass to @callback
+ *
+ * Sends a request to the scripted device. The request completes in the
+ * thread-default main context after the latency set in the script.
+ **/
+void
+dfu_replay_request_async (DfuReplay *self,
+			  DfuRequest request,
+			  guint16 value,
+			  GBytes *data,
+			  GCancellable *cancellable,
+			  GAsyncReadyCallback callback,
+			  gpointer user_data)
+{
+	DfuReplayItem *item;
+	gsize length = data != NULL ? g_bytes_get_size (data) : 0;
+	g_autoptr(GSource) source = NULL;
+	g_autoptr(GTask) task = NULL;
+
+	g_return_if_fail (DFU_IS_REPLAY (self));
+
+	task = g_task_new (self, cancellable, callback, user_data);
+
+	/* check this is what was captured */
+	item = g_queue_pop_head (self->items);
+	if (item == NULL) {
+		g_task_return_new_error (task,
+					 FWUPD_ERROR,
+					 FWUPD_ERROR_INTERNAL,
+					 "unexpected %s, replay finished",
+					 dfu_replay_request_to_string (request));
+		return;
+	}
+	g_task_set_task_data (task, item, (GDestroyNotify) dfu_replay_item_free);
+	if (item->request != request) {
+		g_task_return_new_error (task,
+					 FWUPD_ERROR,
+					 FWUPD_ERROR_INTERNAL,
+					 "unexpected %s, expected %s",
+					 dfu_replay_request_to_string (request),
+					 dfu_replay_request_to_string (item->request));
+		return;
+	}
+	if (item->value != value || item->length != length) {
+		g_task_return_new_error (task,
+					 FWUPD_ERROR,
+					 FWUPD_ERROR_INTERNAL,
+					 "unexpected %s 0x%04x of 0x%04x bytes, "
+					 "expected 0x%04x of 0x%04x bytes",
+					 dfu_replay_request_to_string (request),
+					 value, (guint) length,
+					 item->value, (guint) item->length);
+		return;
+	}
+
+	/* complete after the device would have done */
+	source = g_timeout_source_new (item->latency);
+	g_source_set_callback (source, dfu_replay_complete_cb,
+			       g_object_ref (task), g_object_unref);
+	g_source_attach (source, g_main_context_get_thread_default ());
+}
+
+/**
+ * dfu_replay_request_finish:
+ * @self: a #DfuReplay
+ * @res: a #GAsyncResult
+ * @error: a #GError, or %NULL
+ *
+ * Gets the result of dfu_replay_request_async().
+ *
+ * Return value: (transfer full): the device-to-host data, or %NULL for error
+ **/
+GBytes *
+dfu_replay_request_finish (DfuReplay *self, GAsyncResult *res, GError **error)
+{
+	g_return_val_if_fail (DFU_IS_REPLAY (self), NULL);
+	g_return_val_if_fail (g_task_is_valid (res, self), NULL);
+	return g_task_propagate_pointer (G_TASK (res), error);
+}
+
+static void
+dfu_replay_class_init (DfuReplayClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = dfu_replay_finalize;
+}
+
+static void
+dfu_replay_init (DfuReplay *self)
+{
+	self->items = g_queue_new ();
+}
+
+static void
+dfu_replay_finalize (GObject *object)
+{
+	DfuReplay *self = DFU_REPLAY (object);
+
+	g_queue_free_full (self->items, (GDestroyNotify) dfu_replay_item_free);
+
+	G_OBJECT_CLASS (dfu_replay_parent_class)->finalize (object);
+}
+
+/**
+ * dfu_replay_new:
+ *
+ * Creates a new scripted DFU device.
+ *
+ * Return value: a new #DfuReplay
+ **/
+DfuReplay *
+dfu_replay_new (void)
+{
+	DfuReplay *self;
+	self = g_object_new (DFU_TYPE_REPLAY, NULL);
+	return self;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __DFU_REPLAY_H
+#define __DFU_REPLAY_H
+
+#include <glib-object.h>
+#include <gio/gio.h>
+
+#include "dfu-common.h"
+
+G_BEGIN_DECLS
+
+#define DFU_TYPE_REPLAY (dfu_replay_get_type ())
+G_DECLARE_FINAL_TYPE (DfuReplay, dfu_replay, DFU, REPLAY, GObject)
+
+DfuReplay	*dfu_replay_new			(void);
+gboolean	 dfu_replay_parse		(DfuReplay	*self,
+						 const gchar	*data,
+						 GError		**error);
+void		 dfu_replay_add_dnload		(DfuReplay	*self,
+						 guint16	 value,
+						 gsize		 length,
+						 guint		 latency);
+void		 dfu_replay_add_upload		(DfuReplay	*self,
+						 guint16	 value,
+						 GBytes		*data,
+						 guint		 latency);
+void		 dfu_replay_add_abort		(DfuReplay	*self,
+						 guint		 latency);
+void		 dfu_replay_add_getstatus	(DfuReplay	*self,
+						 DfuStatus	 status,
+						 DfuState	 state,
+						 guint		 poll_timeout,
+						 guint		 latency);
+guint		 dfu_replay_get_remaining	(DfuReplay	*self);
+void		 dfu_replay_request_async	(DfuReplay	*self,
+						 DfuRequest	 request,
+						 guint16	 value,
+						 GBytes		*data,
+						 GCancellable	*cancellable,
+						 GAsyncReadyCallback callback,
+						 gpointer	 user_data);
+GBytes		*dfu_replay_request_finish	(DfuReplay	*self,
+						 GAsyncResult	*res,
+						 GError		**error);
+
+G_END_DECLS
+
+#endif /* __DFU_REPLAY_H */
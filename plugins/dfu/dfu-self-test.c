@@ -15,8 +15,11 @@
 #include "dfu-device-private.h"
 #include "dfu-firmware.h"
 #include "dfu-patch.h"
+#include "dfu-replay.h"
 #include "dfu-sector-private.h"
 #include "dfu-target-private.h"
+#include "dfu-target-stm.h"
+#include "dfu-transfer.h"
 
 #include "fu-test.h"
 
@@ -430,6 +433,113 @@ dfu_firmware_srec_func (void)
 	g_assert_cmpstr (_g_bytes_compare_verbose (data_bin, data_ref), ==, NULL);
 }
 
+static void
+dfu_firmware_parse_speed_func (void)
+{
+	const guint8 *data;
+	gboolean ret;
+	gsize sz = 0;
+	guint32 addr = 0x0;
+	const gsize fw_size = 4 * 1024 * 1024;
+	DfuElement *element;
+	GBytes *contents;
+	g_autoptr(DfuFirmware) firmware_hex = dfu_firmware_new ();
+	g_autoptr(DfuFirmware) firmware_srec = dfu_firmware_new ();
+	g_autoptr(GBytes) data_hex = NULL;
+	g_autoptr(GBytes) data_srec = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GString) str_hex = g_string_new (NULL);
+	g_autoptr(GString) str_srec = g_string_new ("S00600004844521B\n");
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* generate a large image in both formats */
+	for (addr = 0x0; addr < fw_size; addr += 0x20) {
+		guint8 csum_hex;
+		guint8 csum_srec;
+		if (addr % 0x10000 == 0) {
+			guint16 seg = addr >> 16;
+			g_string_append_printf (str_hex, ":02000004%04X%02X\n", seg,
+						(guint8) (0x100 - 0x06 - (seg >> 8) - (seg & 0xff)));
+		}
+		csum_hex = 0x20 + ((addr >> 8) & 0xff) + (addr & 0xff);
+		csum_srec = 0x25 + ((addr >> 24) & 0xff) + ((addr >> 16) & 0xff) +
+			    ((addr >> 8) & 0xff) + (addr & 0xff);
+		g_string_append_printf (str_hex, ":20%04X00", addr & 0xffff);
+		g_string_append_printf (str_srec, "S325%08X", addr);
+		for (guint i = 0; i < 0x20; i++) {
+			guint8 tmp = (addr + i) & 0xff;
+			g_string_append_printf (str_hex, "%02X", tmp);
+			g_string_append_printf (str_srec, "%02X", tmp);
+			csum_hex += tmp;
+			csum_srec += tmp;
+		}
+		g_string_append_printf (str_hex, "%02X\n", (guint8) (0x100 - csum_hex));
+		g_string_append_printf (str_srec, "%02X\n", (guint8) (csum_srec ^ 0xff));
+	}
+	g_string_append (str_hex, ":00000001FF\n");
+	g_string_append (str_srec, "S70500000000FA\n");
+	data_hex = g_bytes_new_static (str_hex->str, str_hex->len);
+	data_srec = g_bytes_new_static (str_srec->str, str_srec->len);
+
+	/* parse Intel HEX */
+	g_timer_reset (timer);
+	ret = dfu_firmware_parse_data (firmware_hex, data_hex,
+				       DFU_FIRMWARE_PARSE_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_debug ("parsed %" G_GSIZE_FORMAT " bytes of Intel HEX in %.0fms, %.1fMB/s",
+		 str_hex->len, g_timer_elapsed (timer, NULL) * 1000.f,
+		 str_hex->len / (g_timer_elapsed (timer, NULL) * 1024.f * 1024.f));
+	g_assert_cmpint (dfu_firmware_get_size (firmware_hex), ==, fw_size);
+	element = dfu_image_get_element_default (dfu_firmware_get_image_default (firmware_hex));
+	g_assert (element != NULL);
+	contents = dfu_element_get_contents (element);
+	data = g_bytes_get_data (contents, &sz);
+	g_assert_cmpint (sz, ==, fw_size);
+	for (gsize i = 0; i < sz; i++)
+		g_assert_cmpint (data[i], ==, i & 0xff);
+
+	/* parse SREC */
+	g_timer_reset (timer);
+	ret = dfu_firmware_parse_data (firmware_srec, data_srec,
+				       DFU_FIRMWARE_PARSE_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_debug ("parsed %" G_GSIZE_FORMAT " bytes of SREC in %.0fms, %.1fMB/s",
+		 str_srec->len, g_timer_elapsed (timer, NULL) * 1000.f,
+		 str_srec->len / (g_timer_elapsed (timer, NULL) * 1024.f * 1024.f));
+	g_assert_cmpint (dfu_firmware_get_size (firmware_srec), ==, fw_size);
+}
+
+static void
+dfu_firmware_fuzzing_func (void)
+{
+	const gchar *fn;
+	g_autofree gchar *path = NULL;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* the corpus only has to be parsed without crashing */
+	path = dfu_test_get_filename ("../fuzzing");
+	if (path == NULL) {
+		g_test_skip ("no fuzzing corpus");
+		return;
+	}
+	dir = g_dir_open (path, 0, &error);
+	g_assert_no_error (error);
+	g_assert (dir != NULL);
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *filename = g_build_filename (path, fn, NULL);
+		g_autoptr(DfuFirmware) firmware = dfu_firmware_new ();
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GFile) file = g_file_new_for_path (filename);
+		if (!dfu_firmware_parse_file (firmware, file,
+					      DFU_FIRMWARE_PARSE_FLAG_NONE,
+					      &error_local))
+			g_debug ("failed to parse %s: %s", fn, error_local->message);
+	}
+}
+
 static void
 dfu_firmware_intel_hex_func (void)
 {
@@ -559,6 +669,7 @@ dfu_target_sectors_to_string (DfuTarget *target)
 static void
 dfu_target_dfuse_func (void)
 {
+	DfuSector *sector;
 	gboolean ret;
 	gchar *tmp;
 	g_autoptr(DfuTarget) target = NULL;
@@ -611,6 +722,19 @@ dfu_target_dfuse_func (void)
 	g_assert (ret);
 	g_free (tmp);
 
+	/* find sectors using the index */
+	sector = dfu_target_get_sector_for_addr (target, 0x08000c10);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_address (sector), ==, 0x08000c00);
+	sector = dfu_target_get_sector_for_addr (target, 0x08000000);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_address (sector), ==, 0x08000000);
+	sector = dfu_target_get_sector_for_addr (target, 0x080017ff);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_address (sector), ==, 0x08001400);
+	g_assert (dfu_target_get_sector_for_addr (target, 0x07ffffff) == NULL);
+	g_assert (dfu_target_get_sector_for_addr (target, 0x08001800) == NULL);
+
 	/* non-contiguous */
 	ret = dfu_target_parse_sectors (target, "@Flash2 /0xF000/4*100Ba/0xE000/3*8Kg/0x80000/2*24Kg", &error);
 	g_assert_no_error (error);
@@ -631,6 +755,18 @@ dfu_target_dfuse_func (void)
 	g_assert (ret);
 	g_free (tmp);
 
+	/* overlapping sectors are found in the order they were described */
+	sector = dfu_target_get_sector_for_addr (target, 0xf010);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_zone (sector), ==, 0);
+	sector = dfu_target_get_sector_for_addr (target, 0xe010);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_zone (sector), ==, 1);
+	sector = dfu_target_get_sector_for_addr (target, 0x86010);
+	g_assert (sector != NULL);
+	g_assert_cmpint (dfu_sector_get_address (sector), ==, 0x86000);
+	g_assert (dfu_target_get_sector_for_addr (target, 0x7ffff) == NULL);
+
 	/* invalid */
 	ret = dfu_target_parse_sectors (target, "Flash", NULL);
 	g_assert (ret);
@@ -743,6 +879,95 @@ dfu_patch_apply_func (void)
 	g_assert (blob_new4 == NULL);
 }
 
+static void
+dfu_patch_delta_func (void)
+{
+	const gsize sz = 512 * 1024;
+	gboolean ret;
+	gsize sz_new;
+	guint8 *data_new;
+	guint8 *data_old;
+	g_autoptr(DfuPatch) patch = dfu_patch_new ();
+	g_autoptr(DfuPatch) patch2 = dfu_patch_new ();
+	g_autoptr(DfuPatch) patch3 = dfu_patch_new ();
+	g_autoptr(GBytes) blob_diff = NULL;
+	g_autoptr(GBytes) blob_new2 = NULL;
+	g_autoptr(GBytes) blob_new3 = NULL;
+	g_autoptr(GBytes) blob_new4 = NULL;
+	g_autoptr(GBytes) blob_new = NULL;
+	g_autoptr(GBytes) blob_old = NULL;
+	g_autoptr(GBytes) blob_short = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GOutputStream) stream = g_memory_output_stream_new_resizable ();
+	g_autoptr(GRand) rand = g_rand_new_with_seed (0);
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* something that looks like code, with a version string */
+	data_old = g_malloc (sz);
+	for (gsize i = 0; i < sz; i++)
+		data_old[i] = i % 4 == 3 ? 0xe5 : (guint8) g_rand_int_range (rand, 0, 0x100);
+	memcpy (data_old + 0x400, "version 1.2.3", 13);
+	blob_old = g_bytes_new_take (data_old, sz);
+
+	/* a function grows, which moves everything after it, the version
+	 * changes and some calls to moved functions are fixed up */
+	sz_new = sz + 0x100;
+	data_new = g_malloc (sz_new);
+	memcpy (data_new, data_old, 0x10000);
+	for (gsize i = 0x10000; i < 0x10100; i++)
+		data_new[i] = (guint8) g_rand_int_range (rand, 0, 0x100);
+	memcpy (data_new + 0x10100, data_old + 0x10000, sz - 0x10000);
+	memcpy (data_new + 0x400, "version 1.2.4", 13);
+	for (guint i = 0; i < 50; i++)
+		data_new[g_rand_int_range (rand, 0, sz_new)] ^= 0x01;
+	blob_new = g_bytes_new_take (data_new, sz_new);
+
+	/* create a patch, which should be much smaller than the image */
+	g_timer_reset (timer);
+	ret = dfu_patch_create (patch, blob_old, blob_new, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_diff = dfu_patch_export (patch, &error);
+	g_assert_no_error (error);
+	g_assert (blob_diff != NULL);
+	g_debug ("created patch of %" G_GSIZE_FORMAT " bytes for %" G_GSIZE_FORMAT
+		 " byte image in %.0fms",
+		 g_bytes_get_size (blob_diff), sz_new,
+		 g_timer_elapsed (timer, NULL) * 1000.f);
+	g_assert_cmpint (g_bytes_get_size (blob_diff), <, sz_new / 100);
+
+	/* apply the serialized patch */
+	ret = dfu_patch_import (patch2, blob_diff, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_new2 = dfu_patch_apply (patch2, blob_old, DFU_PATCH_APPLY_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (blob_new2 != NULL);
+	g_assert_cmpint (g_bytes_compare (blob_new, blob_new2), ==, 0);
+
+	/* apply to a stream */
+	ret = dfu_patch_apply_to_stream (patch2, blob_old, stream,
+					 DFU_PATCH_APPLY_FLAG_NONE,
+					 NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_output_stream_close (stream, NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_new3 = g_memory_output_stream_steal_as_bytes (G_MEMORY_OUTPUT_STREAM (stream));
+	g_assert_cmpint (g_bytes_compare (blob_new, blob_new3), ==, 0);
+
+	/* the image can also get smaller */
+	blob_short = g_bytes_new_from_bytes (blob_new, 0x100, sz - 0x1000);
+	ret = dfu_patch_create (patch3, blob_old, blob_short, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	blob_new4 = dfu_patch_apply (patch3, blob_old, DFU_PATCH_APPLY_FLAG_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (blob_new4 != NULL);
+	g_assert_cmpint (g_bytes_compare (blob_short, blob_new4), ==, 0);
+}
+
 static void
 dfu_patch_func (void)
 {
@@ -797,6 +1022,238 @@ dfu_patch_func (void)
 	g_debug ("serialized blob %s", serialized_str);
 }
 
+/* the scripted device is only built into the self tests */
+static void
+dfu_self_test_device_set_replay (DfuDevice *device, DfuReplay *replay)
+{
+	dfu_device_set_request_funcs (device, G_OBJECT (replay),
+				      (DfuDeviceRequestFunc) dfu_replay_request_async,
+				      (DfuDeviceRequestFinishFunc) dfu_replay_request_finish);
+}
+
+static gboolean
+dfu_transfer_replay_idle_cb (gpointer user_data)
+{
+	gboolean *called = (gboolean *) user_data;
+	*called = TRUE;
+	return G_SOURCE_REMOVE;
+}
+
+static void
+dfu_transfer_replay_func (void)
+{
+	gboolean idle_called = FALSE;
+	gboolean ret;
+	guint idle_id;
+	guint8 cmd[] = { 0x21, 0x00, 0x00, 0x00, 0x08 };
+	g_autoptr(DfuDevice) device = dfu_device_new (NULL);
+	g_autoptr(DfuReplay) replay = dfu_replay_new ();
+	g_autoptr(DfuReplay) replay2 = dfu_replay_new ();
+	g_autoptr(DfuTarget) target = dfu_target_new ();
+	g_autoptr(DfuTransfer) transfer = NULL;
+	g_autoptr(DfuTransfer) transfer2 = NULL;
+	g_autoptr(GBytes) blob = g_bytes_new_static ("hello world!", 12);
+	g_autoptr(GBytes) blob_cmd = g_bytes_new_static (cmd, sizeof(cmd));
+	g_autoptr(GError) error = NULL;
+
+	dfu_target_set_device (target, device);
+
+	/* set the address pointer, then two blocks with the device busy */
+	ret = dfu_replay_parse (replay,
+				"# DfuSe session\n"
+				"DNLOAD 0 5 1\n"
+				"GETSTATUS 0 2 4 1\n"	/* dfuDNBUSY */
+				"GETSTATUS 0 0 5 1\n"	/* dfuDNLOAD-IDLE */
+				"DNLOAD 2 6 1\n"
+				"GETSTATUS 0 2 4 1\n"
+				"GETSTATUS 0 0 5 1\n"
+				"DNLOAD 3 6 1\n"
+				"GETSTATUS 0 0 5 1\n",
+				&error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay), ==, 8);
+	transfer = dfu_transfer_new (target);
+	dfu_self_test_device_set_replay (device, replay);
+	dfu_transfer_add_command (transfer, blob_cmd);
+	for (guint i = 0; i < 2; i++) {
+		g_autoptr(GBytes) chunk = g_bytes_new_from_bytes (blob, i * 6, 6);
+		dfu_transfer_add_chunk (transfer, i + 2, chunk);
+	}
+
+	/* sources on the caller's context are not run during the download */
+	idle_id = g_idle_add (dfu_transfer_replay_idle_cb, &idle_called);
+	ret = dfu_transfer_run (transfer, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay), ==, 0);
+	g_assert_cmpint (dfu_device_get_state (device), ==, DFU_STATE_DFU_DNLOAD_IDLE);
+	g_assert_false (idle_called);
+	g_source_remove (idle_id);
+
+	/* device reports an error after the write */
+	dfu_replay_add_dnload (replay2, 0, 12, 1);
+	dfu_replay_add_getstatus (replay2, DFU_STATUS_ERR_WRITE,
+				  DFU_STATE_DFU_ERROR, 0, 1);
+	transfer2 = dfu_transfer_new (target);
+	dfu_self_test_device_set_replay (device, replay2);
+	dfu_transfer_add_chunk (transfer2, 0, blob);
+	dfu_transfer_add_chunk (transfer2, 1, blob);
+	ret = dfu_transfer_run (transfer2, &error);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_NOT_SUPPORTED);
+	g_assert (!ret);
+}
+
+static void
+dfu_transfer_performance_func (void)
+{
+	const guint nr_chunks = 50;
+	const guint dnload_latency = 10;	/* ms */
+	const guint poll_timeout = 10;		/* ms */
+	const guint status_latency = 1;		/* ms */
+	gboolean ret;
+	gdouble elapsed;
+	gdouble elapsed_sync;
+	g_autoptr(DfuDevice) device = dfu_device_new (NULL);
+	g_autoptr(DfuReplay) replay = dfu_replay_new ();
+	g_autoptr(DfuTarget) target = dfu_target_new ();
+	g_autoptr(DfuTransfer) transfer = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* a device that asks for bwPollTimeout after every status */
+	dfu_target_set_device (target, device);
+	blob = g_bytes_new_take (g_malloc0 (2048), 2048);
+	transfer = dfu_transfer_new (target);
+	dfu_self_test_device_set_replay (device, replay);
+	for (guint i = 0; i < nr_chunks; i++) {
+		dfu_replay_add_dnload (replay, i, g_bytes_get_size (blob), dnload_latency);
+		dfu_replay_add_getstatus (replay, DFU_STATUS_OK,
+					  DFU_STATE_DFU_DNLOAD_IDLE,
+					  poll_timeout, status_latency);
+		dfu_transfer_add_chunk (transfer, i, blob);
+	}
+	ret = dfu_transfer_run (transfer, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay), ==, 0);
+	elapsed = g_timer_elapsed (timer, NULL);
+
+	/* the old code slept for the whole bwPollTimeout after each DNLOAD */
+	elapsed_sync = (gdouble) nr_chunks *
+		       (dnload_latency + poll_timeout + status_latency) / 1000.f;
+	g_debug ("wrote %u blocks in %.0fms (%.1f KiB/s), sequential %.0fms",
+		 nr_chunks, elapsed * 1000.f,
+		 (nr_chunks * g_bytes_get_size (blob)) / (1024.f * elapsed),
+		 elapsed_sync * 1000.f);
+	g_assert_cmpfloat (elapsed, <, elapsed_sync);
+}
+
+/* set the address pointer, then read back @contents in @transfer_size blocks */
+static void
+dfu_self_test_replay_add_stm_upload (DfuReplay *replay,
+				     GBytes *contents,
+				     gsize transfer_size)
+{
+	gsize sz = g_bytes_get_size (contents);
+	guint16 idx = 2;
+	g_autoptr(GBytes) blob_empty = g_bytes_new (NULL, 0);
+
+	dfu_replay_add_dnload (replay, 0, 5, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_replay_add_abort (replay, 0);
+	for (gsize off = 0; off < sz; off += transfer_size) {
+		g_autoptr(GBytes) chunk = NULL;
+		chunk = g_bytes_new_from_bytes (contents, off, MIN (transfer_size, sz - off));
+		dfu_replay_add_upload (replay, idx++, chunk, 0);
+	}
+	dfu_replay_add_upload (replay, idx, blob_empty, 0);
+	dfu_replay_add_abort (replay, 0);
+}
+
+static void
+dfu_target_differential_func (void)
+{
+	gboolean ret;
+	guint8 *buf_new;
+	g_autoptr(DfuDevice) device = dfu_device_new (NULL);
+	g_autoptr(DfuElement) element = dfu_element_new ();
+	g_autoptr(DfuReplay) replay = dfu_replay_new ();
+	g_autoptr(DfuReplay) replay2 = dfu_replay_new ();
+	g_autoptr(DfuReplay) replay3 = dfu_replay_new ();
+	g_autoptr(DfuTarget) target = dfu_target_stm_new ();
+	g_autoptr(GBytes) blob_new = NULL;
+	g_autoptr(GBytes) blob_old = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* four 1KiB sectors where only the second has changed */
+	dfu_target_set_device (target, device);
+	ret = dfu_target_parse_sectors (target, "@Flash /0x08000000/04*001Kg", &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	dfu_device_set_transfer_size (device, 0x400);
+	dfu_device_add_attribute (device, DFU_DEVICE_ATTRIBUTE_CAN_DOWNLOAD |
+					  DFU_DEVICE_ATTRIBUTE_CAN_UPLOAD);
+	blob_old = g_bytes_new_take (g_malloc0 (0x1000), 0x1000);
+	buf_new = g_malloc0 (0x1000);
+	memset (buf_new + 0x400, 0xaa, 0x400);
+	blob_new = g_bytes_new_take (buf_new, 0x1000);
+	dfu_element_set_address (element, 0x08000000);
+	dfu_element_set_contents (element, blob_new);
+
+	/* read each sector, erase and write the changed one, then verify */
+	for (guint i = 0; i < 4; i++) {
+		g_autoptr(GBytes) sector_old = g_bytes_new_from_bytes (blob_old, i * 0x400, 0x400);
+		dfu_self_test_replay_add_stm_upload (replay, sector_old, 0x400);
+	}
+	dfu_replay_add_dnload (replay, 0, 5, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_replay_add_dnload (replay, 0, 5, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_replay_add_dnload (replay, 3, 0x400, 0);
+	dfu_replay_add_getstatus (replay, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_self_test_replay_add_stm_upload (replay, blob_new, 0x400);
+	dfu_self_test_device_set_replay (device, replay);
+	ret = dfu_target_download_element (target, element,
+					   DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL,
+					   &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay), ==, 0);
+	g_assert_cmpint (dfu_target_get_bytes_skipped (target), ==, 0xc00);
+
+	/* the skipped sectors did not actually match */
+	for (guint i = 0; i < 4; i++) {
+		g_autoptr(GBytes) sector_old = g_bytes_new_from_bytes (blob_new, i * 0x400, 0x400);
+		dfu_self_test_replay_add_stm_upload (replay2, sector_old, 0x400);
+	}
+	dfu_replay_add_dnload (replay2, 0, 5, 0);
+	dfu_replay_add_getstatus (replay2, DFU_STATUS_OK, DFU_STATE_DFU_DNLOAD_IDLE, 0, 0);
+	dfu_self_test_replay_add_stm_upload (replay2, blob_old, 0x400);
+	dfu_self_test_device_set_replay (device, replay2);
+	ret = dfu_target_download_element (target, element,
+					   DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL,
+					   &error);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_READ);
+	g_assert (!ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay2), ==, 0);
+	g_clear_error (&error);
+
+	/* skipping sectors is not allowed if the result cannot be verified */
+	dfu_replay_add_abort (replay3, 0);
+	dfu_self_test_device_set_replay (device, replay3);
+	dfu_device_remove_attribute (device, DFU_DEVICE_ATTRIBUTE_CAN_UPLOAD);
+	ret = dfu_target_download_element (target, element,
+					   DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL,
+					   &error);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_NOT_SUPPORTED);
+	g_assert (!ret);
+	g_assert_cmpint (dfu_replay_get_remaining (replay3), ==, 1);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -810,11 +1267,17 @@ main (int argc, char **argv)
 
 	/* tests go here */
 	g_test_add_func ("/dfu/firmware{srec}", dfu_firmware_srec_func);
+	g_test_add_func ("/dfu/firmware{parse-speed}", dfu_firmware_parse_speed_func);
+	g_test_add_func ("/dfu/firmware{fuzzing}", dfu_firmware_fuzzing_func);
 	g_test_add_func ("/dfu/patch", dfu_patch_func);
 	g_test_add_func ("/dfu/patch{merges}", dfu_patch_merges_func);
 	g_test_add_func ("/dfu/patch{apply}", dfu_patch_apply_func);
+	g_test_add_func ("/dfu/patch{delta}", dfu_patch_delta_func);
 	g_test_add_func ("/dfu/enums", dfu_enums_func);
+	g_test_add_func ("/dfu/transfer{replay}", dfu_transfer_replay_func);
+	g_test_add_func ("/dfu/transfer{performance}", dfu_transfer_performance_func);
 	g_test_add_func ("/dfu/target(DfuSe}", dfu_target_dfuse_func);
+	g_test_add_func ("/dfu/target{differential}", dfu_target_differential_func);
 	g_test_add_func ("/dfu/cipher{xtea}", dfu_cipher_xtea_func);
 	g_test_add_func ("/dfu/firmware{raw}", dfu_firmware_raw_func);
 	g_test_add_func ("/dfu/firmware{dfu}", dfu_firmware_dfu_func);
@@ -500,7 +500,7 @@ dfu_target_avr_download_element (DfuTarget *target,
 	guint16 page_last = G_MAXUINT16;
 	guint32 address;
 	guint32 address_offset = 0x0;
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 	const guint8 footer[] = { 0x00, 0x00, 0x00, 0x00,	/* CRC */
 				  16,				/* len */
 				  'D', 'F', 'U',		/* signature */
@@ -553,18 +553,18 @@ dfu_target_avr_download_element (DfuTarget *target,
 
 	/* chunk up the memory space into pages */
 	data = g_bytes_get_data (blob, NULL);
-	chunks = fu_chunk_array_new (data + address_offset,
-				     g_bytes_get_size (blob) - address_offset,
-				     dfu_sector_get_address (sector),
-				     ATMEL_64KB_PAGE,
-				     ATMEL_MAX_TRANSFER_SIZE);
+	chunks = fu_chunk_array_new_flat (data + address_offset,
+					  g_bytes_get_size (blob) - address_offset,
+					  dfu_sector_get_address (sector),
+					  ATMEL_64KB_PAGE,
+					  ATMEL_MAX_TRANSFER_SIZE);
 
 	/* update UI */
 	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_WRITE);
 
 	/* process each chunk */
 	for (guint i = 0; i < chunks->len; i++) {
-		const FuChunk *chk = g_ptr_array_index (chunks, i);
+		const FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		g_autofree guint8 *buf = NULL;
 		g_autoptr(GBytes) chunk_tmp = NULL;
 
@@ -47,13 +47,21 @@ void		 dfu_target_set_device			(DfuTarget	*target,
 DfuDevice	*dfu_target_get_device			(DfuTarget	*target);
 gboolean	 dfu_target_check_status		(DfuTarget	*target,
 							 GError		**error);
+gboolean	 dfu_target_check_state			(DfuTarget	*target,
+							 GError		**error);
 DfuSector	*dfu_target_get_sector_for_addr		(DfuTarget	*target,
 							 guint32	 addr);
+void		 dfu_target_add_bytes_skipped		(DfuTarget	*target,
+							 gsize		 bytes_skipped);
 
 /* export this just for the self tests */
 gboolean	 dfu_target_parse_sectors		(DfuTarget	*target,
 							 const gchar	*alt_name,
 							 GError		**error);
+gboolean	 dfu_target_download_element		(DfuTarget	*target,
+							 DfuElement	*element,
+							 DfuTargetTransferFlags flags,
+							 GError		**error);
 
 G_END_DECLS
 
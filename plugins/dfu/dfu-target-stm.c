@@ -14,6 +14,7 @@
 #include "dfu-sector.h"
 #include "dfu-target-stm.h"
 #include "dfu-target-private.h"
+#include "dfu-transfer.h"
 
 #include "fwupd-error.h"
 
@@ -51,6 +52,15 @@ dfu_target_stm_mass_erase (DfuTarget *target, GError **error)
 	return dfu_target_check_status (target, error);
 }
 
+static GBytes *
+dfu_target_stm_set_address_cmd (guint32 address)
+{
+	guint8 buf[5];
+	buf[0] = DFU_STM_CMD_SET_ADDRESS_POINTER;
+	memcpy (buf + 1, &address, 4);
+	return g_bytes_new (buf, sizeof(buf));
+}
+
 /**
  * dfu_target_stm_set_address:
  * @target: a #DfuTarget
@@ -64,13 +74,7 @@ dfu_target_stm_mass_erase (DfuTarget *target, GError **error)
 static gboolean
 dfu_target_stm_set_address (DfuTarget *target, guint32 address, GError **error)
 {
-	GBytes *data_in;
-	guint8 buf[5];
-
-	/* format buffer */
-	buf[0] = DFU_STM_CMD_SET_ADDRESS_POINTER;
-	memcpy (buf + 1, &address, 4);
-	data_in = g_bytes_new_static (buf, sizeof(buf));
+	g_autoptr(GBytes) data_in = dfu_target_stm_set_address_cmd (address);
 	if (!dfu_target_download_chunk (target, 0, data_in, error)) {
 		g_prefix_error (error, "cannot set address 0x%x: ", address);
 		return FALSE;
@@ -232,6 +236,93 @@ dfu_target_stm_erase_address (DfuTarget *target, guint32 address, GError **error
 	return dfu_target_check_status (target, error);
 }
 
+/* returns TRUE if all the sectors in the range were unchanged */
+static gboolean
+dfu_target_stm_range_is_unchanged (DfuTarget *target,
+				   GHashTable *sectors_unchanged,
+				   guint32 addr,
+				   guint32 addr_end)
+{
+	while (addr < addr_end) {
+		DfuSector *sector = dfu_target_get_sector_for_addr (target, addr);
+		if (sector == NULL || dfu_sector_get_size (sector) == 0)
+			return FALSE;
+		if (!g_hash_table_contains (sectors_unchanged, sector))
+			return FALSE;
+		addr = dfu_sector_get_address (sector) + dfu_sector_get_size (sector);
+	}
+	return TRUE;
+}
+
+/* read back each sector the element touches and find the ones that already
+ * contain the new data, so they do not need to be erased or written */
+static gboolean
+dfu_target_stm_find_unchanged_sectors (DfuTarget *target,
+				       DfuElement *element,
+				       GHashTable *sectors_unchanged,
+				       GError **error)
+{
+	DfuDevice *device = dfu_target_get_device (target);
+	GBytes *bytes = dfu_element_get_contents (element);
+	gboolean changed = TRUE;
+	guint16 transfer_size = dfu_device_get_transfer_size (device);
+	guint32 addr_start = dfu_element_get_address (element);
+	guint32 addr_end = addr_start + (guint32) g_bytes_get_size (bytes);
+
+	for (guint32 addr = addr_start; addr < addr_end;) {
+		DfuSector *sector = dfu_target_get_sector_for_addr (target, addr);
+		guint32 end;
+		g_autoptr(DfuElement) element_old = NULL;
+		g_autoptr(GBytes) bytes_new = NULL;
+
+		/* no more sectors, so just write the rest */
+		if (sector == NULL || dfu_sector_get_size (sector) == 0)
+			break;
+		end = MIN (dfu_sector_get_address (sector) +
+			   dfu_sector_get_size (sector), addr_end);
+		if (!dfu_sector_has_cap (sector, DFU_SECTOR_CAP_READABLE)) {
+			addr = end;
+			continue;
+		}
+		element_old = dfu_target_stm_upload_element (target, addr,
+							     end - addr,
+							     end - addr,
+							     error);
+		if (element_old == NULL)
+			return FALSE;
+		bytes_new = g_bytes_new_from_bytes (bytes, addr - addr_start, end - addr);
+		if (g_bytes_equal (dfu_element_get_contents (element_old), bytes_new)) {
+			g_debug ("sector 0x%04x-%04x is unchanged",
+				 dfu_sector_get_address (sector),
+				 dfu_sector_get_address (sector) + dfu_sector_get_size (sector));
+			g_hash_table_add (sectors_unchanged, sector);
+		}
+		addr = end;
+	}
+
+	/* a block that touches a changed sector is written in full, so any
+	 * other sector it touches has to be erased as well */
+	while (changed) {
+		changed = FALSE;
+		for (guint32 addr = addr_start; addr < addr_end; addr += transfer_size) {
+			guint32 end = MIN (addr + transfer_size, addr_end);
+			if (dfu_target_stm_range_is_unchanged (target,
+							       sectors_unchanged,
+							       addr, end))
+				continue;
+			for (guint32 tmp = addr; tmp < end;) {
+				DfuSector *sector = dfu_target_get_sector_for_addr (target, tmp);
+				if (sector == NULL || dfu_sector_get_size (sector) == 0)
+					break;
+				if (g_hash_table_remove (sectors_unchanged, sector))
+					changed = TRUE;
+				tmp = dfu_sector_get_address (sector) + dfu_sector_get_size (sector);
+			}
+		}
+	}
+	return TRUE;
+}
+
 static gboolean
 dfu_target_stm_download_element (DfuTarget *target,
 				 DfuElement *element,
@@ -242,10 +333,13 @@ dfu_target_stm_download_element (DfuTarget *target,
 	DfuSector *sector;
 	GBytes *bytes;
 	guint nr_chunks;
+	gsize bytes_skipped = 0;
 	guint zone_last = G_MAXUINT;
 	guint16 transfer_size = dfu_device_get_transfer_size (device);
+	guint32 addr_end;
+	g_autoptr(DfuTransfer) transfer = NULL;
 	g_autoptr(GPtrArray) sectors_array = NULL;
-	g_autoptr(GHashTable) sectors_hash = NULL;
+	g_autoptr(GHashTable) sectors_unchanged = NULL;
 
 	/* round up as we have to transfer incomplete blocks */
 	bytes = dfu_element_get_contents (element);
@@ -259,22 +353,20 @@ dfu_target_stm_download_element (DfuTarget *target,
 		return FALSE;
 	}
 
-	/* 1st pass: work out which sectors need erasing */
+	/* 1st pass: work out which sectors need erasing, visiting each
+	 * sector the element touches once */
 	sectors_array = g_ptr_array_new ();
-	sectors_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
-	for (guint i = 0; i < nr_chunks; i++) {
-		guint32 offset_dev;
-
+	addr_end = dfu_element_get_address (element) + (guint32) g_bytes_get_size (bytes);
+	for (guint32 addr = dfu_element_get_address (element); addr < addr_end;) {
 		/* for DfuSe devices we need to handle the erase and setting
 		 * the sectory address manually */
-		offset_dev = dfu_element_get_address (element) + (i * transfer_size);
-		sector = dfu_target_get_sector_for_addr (target, offset_dev);
+		sector = dfu_target_get_sector_for_addr (target, addr);
 		if (sector == NULL) {
 			g_set_error (error,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_NOT_SUPPORTED,
 				     "no memory sector at 0x%04x",
-				     (guint) offset_dev);
+				     (guint) addr);
 			return FALSE;
 		}
 		if (!dfu_sector_has_cap (sector, DFU_SECTOR_CAP_WRITEABLE)) {
@@ -282,27 +374,39 @@ dfu_target_stm_download_element (DfuTarget *target,
 				     FWUPD_ERROR,
 				     FWUPD_ERROR_NOT_SUPPORTED,
 				     "memory sector at 0x%04x is not writable",
-				     (guint) offset_dev);
+				     (guint) addr);
 			return FALSE;
 		}
 
-		/* if it's erasable and not yet blanked */
-		if (dfu_sector_has_cap (sector, DFU_SECTOR_CAP_ERASEABLE) &&
-		    g_hash_table_lookup (sectors_hash, sector) == NULL) {
-			g_hash_table_insert (sectors_hash,
-					     sector,
-					     GINT_TO_POINTER (1));
+		/* if it's erasable then blank it */
+		if (dfu_sector_has_cap (sector, DFU_SECTOR_CAP_ERASEABLE)) {
 			g_ptr_array_add (sectors_array, sector);
 			g_debug ("marking sector 0x%04x-%04x to be erased",
 				 dfu_sector_get_address (sector),
 				 dfu_sector_get_address (sector) + dfu_sector_get_size (sector));
 		}
+		addr = dfu_sector_get_address (sector) + dfu_sector_get_size (sector);
+	}
+
+	/* optionally skip the sectors that already have the new contents */
+	sectors_unchanged = g_hash_table_new (g_direct_hash, g_direct_equal);
+	if (flags & DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL) {
+		if (!dfu_target_stm_find_unchanged_sectors (target,
+							    element,
+							    sectors_unchanged,
+							    error))
+			return FALSE;
 	}
 
 	/* 2nd pass: actually erase sectors */
 	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_ERASE);
 	for (guint i = 0; i < sectors_array->len; i++) {
 		sector = g_ptr_array_index (sectors_array, i);
+		if (g_hash_table_contains (sectors_unchanged, sector)) {
+			g_debug ("not erasing unchanged sector at 0x%04x",
+				 dfu_sector_get_address (sector));
+			continue;
+		}
 		g_debug ("erasing sector at 0x%04x",
 			 dfu_sector_get_address (sector));
 		if (!dfu_target_stm_erase_address (target,
@@ -315,7 +419,7 @@ dfu_target_stm_download_element (DfuTarget *target,
 	dfu_target_set_action (target, FWUPD_STATUS_IDLE);
 
 	/* 3rd pass: write data */
-	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_WRITE);
+	transfer = dfu_transfer_new (target);
 	for (guint i = 0; i < nr_chunks; i++) {
 		gsize length;
 		guint32 offset;
@@ -332,12 +436,11 @@ dfu_target_stm_download_element (DfuTarget *target,
 
 		/* manually set the sector address */
 		if (dfu_sector_get_zone (sector) != zone_last) {
+			g_autoptr(GBytes) cmd = NULL;
 			g_debug ("setting address to 0x%04x",
 				 (guint) offset_dev);
-			if (!dfu_target_stm_set_address (target,
-							 (guint32) offset_dev,
-							 error))
-				return FALSE;
+			cmd = dfu_target_stm_set_address_cmd (offset_dev);
+			dfu_transfer_add_command (transfer, cmd);
 			zone_last = dfu_sector_get_zone (sector);
 		}
 
@@ -345,23 +448,32 @@ dfu_target_stm_download_element (DfuTarget *target,
 		length = g_bytes_get_size (bytes) - offset;
 		if (length > transfer_size)
 			length = transfer_size;
+		if (dfu_target_stm_range_is_unchanged (target,
+						       sectors_unchanged,
+						       offset_dev,
+						       offset_dev + length)) {
+			dfu_transfer_add_skipped (transfer, length);
+			bytes_skipped += length;
+			continue;
+		}
 		bytes_tmp = g_bytes_new_from_bytes (bytes, offset, length);
 		g_debug ("writing sector at 0x%04x (0x%" G_GSIZE_FORMAT ")",
 			 offset_dev,
 			 g_bytes_get_size (bytes_tmp));
 		/* ST uses wBlockNum=0 for DfuSe commands and wBlockNum=1 is reserved */
-		if (!dfu_target_download_chunk (target,
-						(guint8) (i + 2),
-						bytes_tmp,
-						error))
-			return FALSE;
-
-		/* getting the status moves the state machine to DNLOAD-IDLE */
-		if (!dfu_target_check_status (target, error))
-			return FALSE;
+		dfu_transfer_add_chunk (transfer, (guint8) (i + 2), bytes_tmp);
+	}
 
-		/* update UI */
-		dfu_target_set_percentage (target, offset, g_bytes_get_size (bytes));
+	/* getting the status after each block moves the state machine to
+	 * DNLOAD-IDLE, which the transfer does asynchronously */
+	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_WRITE);
+	if (!dfu_transfer_run (transfer, error))
+		return FALSE;
+	if (bytes_skipped > 0) {
+		g_debug ("skipped 0x%" G_GSIZE_FORMAT " of 0x%" G_GSIZE_FORMAT
+			 " bytes as unchanged",
+			 bytes_skipped, g_bytes_get_size (bytes));
+		dfu_target_add_bytes_skipped (target, bytes_skipped);
 	}
 
 	/* done */
@@ -27,6 +27,7 @@
 #include "dfu-device-private.h"
 #include "dfu-sector-private.h"
 #include "dfu-target-private.h"
+#include "dfu-transfer.h"
 
 #include "fwupd-error.h"
 
@@ -41,8 +42,11 @@ typedef struct {
 	gchar			*alt_name;
 	gchar			*alt_name_for_display;
 	GPtrArray		*sectors;		/* of DfuSector */
+	GPtrArray		*sectors_index;		/* of DfuSector, sorted */
+	gboolean		 sectors_overlap;
 	guint			 old_percentage;
 	FwupdStatus		 old_action;
+	gsize			 bytes_skipped;
 } DfuTargetPrivate;
 
 enum {
@@ -110,6 +114,8 @@ dfu_target_finalize (GObject *object)
 	g_free (priv->alt_name);
 	g_free (priv->alt_name_for_display);
 	g_ptr_array_unref (priv->sectors);
+	if (priv->sectors_index != NULL)
+		g_ptr_array_unref (priv->sectors_index);
 
 	/* we no longer care */
 	if (priv->device != NULL) {
@@ -135,21 +141,113 @@ dfu_target_sectors_to_string (DfuTarget *target)
 	return g_string_free (str, FALSE);
 }
 
-DfuSector *
-dfu_target_get_sector_for_addr (DfuTarget *target, guint32 addr)
+static void
+dfu_target_sectors_index_invalidate (DfuTarget *target)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	if (priv->sectors_index != NULL) {
+		g_ptr_array_unref (priv->sectors_index);
+		priv->sectors_index = NULL;
+	}
+}
+
+static void
+dfu_target_add_sector (DfuTarget *target, DfuSector *sector)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	g_ptr_array_add (priv->sectors, sector);
+	dfu_target_sectors_index_invalidate (target);
+}
+
+static gint
+dfu_target_sector_sort_cb (gconstpointer a, gconstpointer b)
+{
+	DfuSector *sector1 = *((DfuSector **) a);
+	DfuSector *sector2 = *((DfuSector **) b);
+	guint32 addr1 = dfu_sector_get_address (sector1);
+	guint32 addr2 = dfu_sector_get_address (sector2);
+	if (addr1 < addr2)
+		return -1;
+	if (addr1 > addr2)
+		return 1;
+	return 0;
+}
+
+/* sort the sectors by address so they can be found with a binary search */
+static void
+dfu_target_sectors_index_ensure (DfuTarget *target)
 {
 	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	guint64 addr_end = 0;
 
+	if (priv->sectors_index != NULL)
+		return;
+	priv->sectors_index = g_ptr_array_new ();
+	priv->sectors_overlap = FALSE;
 	for (guint i = 0; i < priv->sectors->len; i++) {
 		DfuSector *sector = g_ptr_array_index (priv->sectors, i);
-		if (addr < dfu_sector_get_address (sector))
-			continue;
-		if (addr > dfu_sector_get_address (sector) +
-				dfu_sector_get_size (sector))
+		/* a zero-sized sector can never contain an address */
+		if (dfu_sector_get_size (sector) == 0)
 			continue;
-		return sector;
+		g_ptr_array_add (priv->sectors_index, sector);
 	}
-	return NULL;
+	g_ptr_array_sort (priv->sectors_index, dfu_target_sector_sort_cb);
+
+	/* the first sector in the description has to win if they overlap */
+	for (guint i = 0; i < priv->sectors_index->len; i++) {
+		DfuSector *sector = g_ptr_array_index (priv->sectors_index, i);
+		if (dfu_sector_get_address (sector) < addr_end) {
+			g_debug ("sectors overlap at 0x%08x, not using index",
+				 dfu_sector_get_address (sector));
+			priv->sectors_overlap = TRUE;
+			break;
+		}
+		addr_end = (guint64) dfu_sector_get_address (sector) +
+			   dfu_sector_get_size (sector);
+	}
+}
+
+DfuSector *
+dfu_target_get_sector_for_addr (DfuTarget *target, guint32 addr)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	DfuSector *sector;
+	guint lo = 0;
+	guint hi;
+
+	dfu_target_sectors_index_ensure (target);
+
+	/* the description is not a simple list of ranges */
+	if (priv->sectors_overlap) {
+		for (guint i = 0; i < priv->sectors->len; i++) {
+			sector = g_ptr_array_index (priv->sectors, i);
+			if (addr < dfu_sector_get_address (sector))
+				continue;
+			if (addr >= dfu_sector_get_address (sector) +
+					dfu_sector_get_size (sector))
+				continue;
+			return sector;
+		}
+		return NULL;
+	}
+
+	/* find the last sector that starts at or before the address */
+	hi = priv->sectors_index->len;
+	while (lo < hi) {
+		guint mid = lo + ((hi - lo) / 2);
+		sector = g_ptr_array_index (priv->sectors_index, mid);
+		if (dfu_sector_get_address (sector) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo == 0)
+		return NULL;
+	sector = g_ptr_array_index (priv->sectors_index, lo - 1);
+	if ((guint64) addr >= (guint64) dfu_sector_get_address (sector) +
+			      dfu_sector_get_size (sector))
+		return NULL;
+	return sector;
 }
 
 static gboolean
@@ -160,7 +258,6 @@ dfu_target_parse_sector (DfuTarget *target,
 			 guint16 number,
 			 GError **error)
 {
-	DfuTargetPrivate *priv = GET_PRIVATE (target);
 	DfuSectorCap cap = DFU_SECTOR_CAP_NONE;
 	gchar *tmp;
 	guint32 addr_offset = 0;
@@ -265,7 +362,7 @@ dfu_target_parse_sector (DfuTarget *target,
 					 zone,
 					 number,
 					 cap);
-		g_ptr_array_add (priv->sectors, sector);
+		dfu_target_add_sector (target, sector);
 		addr_offset += dfu_sector_get_size (sector);
 	}
 
@@ -304,7 +401,7 @@ dfu_target_parse_sectors (DfuTarget *target, const gchar *alt_name, GError **err
 					 0x0, /* number */
 					 DFU_SECTOR_CAP_READABLE |
 					 DFU_SECTOR_CAP_WRITEABLE);
-		g_ptr_array_add (priv->sectors, sector);
+		dfu_target_add_sector (target, sector);
 	}
 
 	/* not a DfuSe alternative name */
@@ -313,6 +410,7 @@ dfu_target_parse_sectors (DfuTarget *target, const gchar *alt_name, GError **err
 
 	/* clear any existing zones */
 	g_ptr_array_set_size (priv->sectors, 0);
+	dfu_target_sectors_index_invalidate (target);
 
 	/* parse zones */
 	zones = g_strsplit (alt_name, "/", -1);
@@ -367,6 +465,7 @@ dfu_target_parse_sectors (DfuTarget *target, const gchar *alt_name, GError **err
 	}
 
 	/* success */
+	dfu_target_sectors_index_ensure (target);
 	str_debug = dfu_target_sectors_to_string (target);
 	g_debug ("%s", str_debug);
 	return TRUE;
@@ -472,7 +571,6 @@ gboolean
 dfu_target_check_status (DfuTarget *target, GError **error)
 {
 	DfuTargetPrivate *priv = GET_PRIVATE (target);
-	DfuStatus status;
 
 	/* get the status */
 	if (!dfu_device_refresh (priv->device, error))
@@ -488,6 +586,15 @@ dfu_target_check_status (DfuTarget *target, GError **error)
 		}
 	}
 
+	return dfu_target_check_state (target, error);
+}
+
+gboolean
+dfu_target_check_state (DfuTarget *target, GError **error)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	DfuStatus status;
+
 	/* not in an error state */
 	if (dfu_device_get_state (priv->device) != DFU_STATE_DFU_ERROR)
 		return TRUE;
@@ -635,7 +742,7 @@ dfu_target_setup (DfuTarget *target, GError **error)
 					 DFU_SECTOR_CAP_READABLE |
 					 DFU_SECTOR_CAP_WRITEABLE);
 		g_debug ("no UM0424 sector description in %s", priv->alt_name);
-		g_ptr_array_add (priv->sectors, sector);
+		dfu_target_add_sector (target, sector);
 	}
 
 	priv->done_setup = TRUE;
@@ -685,19 +792,33 @@ dfu_target_download_chunk (DfuTarget *target, guint16 index, GBytes *bytes, GErr
 			g_print ("Message: m[%" G_GSIZE_FORMAT "] = 0x%02x\n", i, (guint) data[i]);
 	}
 
-	if (!g_usb_device_control_transfer (usb_device,
-					    G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
-					    G_USB_DEVICE_REQUEST_TYPE_CLASS,
-					    G_USB_DEVICE_RECIPIENT_INTERFACE,
-					    DFU_REQUEST_DNLOAD,
-					    index,
-					    dfu_device_get_interface (priv->device),
-					    (guint8 *) g_bytes_get_data (bytes, NULL),
-					    g_bytes_get_size (bytes),
-					    &actual_length,
-					    dfu_device_get_timeout (priv->device),
-					    NULL,
-					    &error_local)) {
+	/* scripted device */
+	if (dfu_device_has_request_funcs (priv->device)) {
+		g_autoptr(GBytes) data = NULL;
+		data = dfu_device_request_sync (priv->device, DFU_REQUEST_DNLOAD,
+						index, bytes, &error_local);
+		if (data == NULL) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "cannot download data: %s",
+				     error_local->message);
+			return FALSE;
+		}
+		actual_length = g_bytes_get_size (bytes);
+	} else if (!g_usb_device_control_transfer (usb_device,
+						   G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
+						   G_USB_DEVICE_REQUEST_TYPE_CLASS,
+						   G_USB_DEVICE_RECIPIENT_INTERFACE,
+						   DFU_REQUEST_DNLOAD,
+						   index,
+						   dfu_device_get_interface (priv->device),
+						   (guint8 *) g_bytes_get_data (bytes, NULL),
+						   g_bytes_get_size (bytes),
+						   &actual_length,
+						   dfu_device_get_timeout (priv->device),
+						   NULL,
+						   &error_local)) {
 		/* refresh the error code */
 		dfu_device_error_fixup (priv->device, &error_local);
 		g_set_error (error,
@@ -747,6 +868,22 @@ dfu_target_upload_chunk (DfuTarget *target, guint16 index, gsize buf_sz, GError
 	if (buf_sz == 0)
 		buf_sz = (gsize) dfu_device_get_transfer_size (priv->device);
 
+	/* scripted device */
+	if (dfu_device_has_request_funcs (priv->device)) {
+		g_autoptr(GBytes) data = NULL;
+		data = dfu_device_request_sync (priv->device, DFU_REQUEST_UPLOAD,
+						index, NULL, &error_local);
+		if (data == NULL) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "cannot upload data: %s",
+				     error_local->message);
+			return NULL;
+		}
+		return g_bytes_new_from_bytes (data, 0, MIN (g_bytes_get_size (data), buf_sz));
+	}
+
 	buf = g_new0 (guint8, buf_sz);
 	if (!g_usb_device_control_transfer (usb_device,
 					    G_USB_DEVICE_DIRECTION_DEVICE_TO_HOST,
@@ -1104,6 +1241,7 @@ dfu_target_download_element_dfu (DfuTarget *target,
 	GBytes *bytes;
 	guint16 nr_chunks;
 	guint16 transfer_size = dfu_device_get_transfer_size (priv->device);
+	g_autoptr(DfuTransfer) transfer = NULL;
 
 	/* round up as we have to transfer incomplete blocks */
 	bytes = dfu_element_get_contents (element);
@@ -1116,32 +1254,25 @@ dfu_target_download_element_dfu (DfuTarget *target,
 				     "zero-length firmware");
 		return FALSE;
 	}
-	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_WRITE);
+
+	/* we have to write one final zero-sized chunk for EOF */
+	transfer = dfu_transfer_new (target);
 	for (guint16 i = 0; i < nr_chunks + 1; i++) {
-		gsize length;
-		guint32 offset;
 		g_autoptr(GBytes) bytes_tmp = NULL;
-
-		/* caclulate the offset into the element data */
-		offset = i * transfer_size;
-
-		/* we have to write one final zero-sized chunk for EOF */
 		if (i < nr_chunks) {
-			length = g_bytes_get_size (bytes) - offset;
+			guint32 offset = i * transfer_size;
+			gsize length = g_bytes_get_size (bytes) - offset;
 			if (length > transfer_size)
 				length = transfer_size;
 			bytes_tmp = g_bytes_new_from_bytes (bytes, offset, length);
 		} else {
 			bytes_tmp = g_bytes_new (NULL, 0);
 		}
-		g_debug ("writing #%04x chunk of size %" G_GSIZE_FORMAT,
-			 i, g_bytes_get_size (bytes_tmp));
-		if (!dfu_target_download_chunk (target, i, bytes_tmp, error))
-			return FALSE;
-
-		/* update UI */
-		dfu_target_set_percentage (target, offset, g_bytes_get_size (bytes));
+		dfu_transfer_add_chunk (transfer, i, bytes_tmp);
 	}
+	dfu_target_set_action (target, FWUPD_STATUS_DEVICE_WRITE);
+	if (!dfu_transfer_run (transfer, error))
+		return FALSE;
 
 	/* done */
 	dfu_target_set_percentage_raw (target, 100);
@@ -1151,7 +1282,7 @@ dfu_target_download_element_dfu (DfuTarget *target,
 	return TRUE;
 }
 
-static gboolean
+gboolean
 dfu_target_download_element (DfuTarget *target,
 			     DfuElement *element,
 			     DfuTargetTransferFlags flags,
@@ -1160,6 +1291,17 @@ dfu_target_download_element (DfuTarget *target,
 	DfuTargetPrivate *priv = GET_PRIVATE (target);
 	DfuTargetClass *klass = DFU_TARGET_GET_CLASS (target);
 
+	/* skipped sectors are only safe if the result can be verified */
+	if (flags & DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL &&
+	    !dfu_device_has_attribute (priv->device, DFU_DEVICE_ATTRIBUTE_CAN_UPLOAD)) {
+		g_set_error_literal (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_NOT_SUPPORTED,
+				     "differential write requires the target "
+				     "to support uploading");
+		return FALSE;
+	}
+
 	/* implemented as part of a superclass */
 	if (klass->download_element != NULL) {
 		if (!klass->download_element (target, element, flags, error))
@@ -1172,8 +1314,9 @@ dfu_target_download_element (DfuTarget *target,
 			return FALSE;
 	}
 
-	/* verify */
-	if (flags & DFU_TARGET_TRANSFER_FLAG_VERIFY &&
+	/* verify, which is always done when sectors have been skipped */
+	if (flags & (DFU_TARGET_TRANSFER_FLAG_VERIFY |
+		     DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL) &&
 	    dfu_device_has_attribute (priv->device, DFU_DEVICE_ATTRIBUTE_CAN_UPLOAD)) {
 		GBytes *bytes;
 		GBytes *bytes_tmp;
@@ -1244,6 +1387,7 @@ dfu_target_download (DfuTarget *target, DfuImage *image,
 	/* use correct alt */
 	if (!dfu_target_use_alt_setting (target, error))
 		return FALSE;
+	priv->bytes_skipped = 0;
 
 	/* download all elements in the image to the device */
 	elements = dfu_image_get_elements (image);
@@ -1364,6 +1508,30 @@ dfu_target_get_alt_name_for_display (DfuTarget *target, GError **error)
 	return priv->alt_name_for_display;
 }
 
+void
+dfu_target_add_bytes_skipped (DfuTarget *target, gsize bytes_skipped)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	priv->bytes_skipped += bytes_skipped;
+}
+
+/**
+ * dfu_target_get_bytes_skipped:
+ * @target: a #DfuTarget
+ *
+ * Gets the number of bytes that were not written in the last download as
+ * the device already contained the same data.
+ *
+ * Return value: size in bytes, typically 0
+ **/
+gsize
+dfu_target_get_bytes_skipped (DfuTarget *target)
+{
+	DfuTargetPrivate *priv = GET_PRIVATE (target);
+	g_return_val_if_fail (DFU_IS_TARGET (target), 0);
+	return priv->bytes_skipped;
+}
+
 /**
  * dfu_target_get_cipher_kind:
  * @target: a #DfuTarget
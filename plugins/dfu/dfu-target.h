@@ -30,6 +30,7 @@ G_DECLARE_DERIVABLE_TYPE (DfuTarget, dfu_target, DFU, TARGET, GUsbDevice)
  * @DFU_TARGET_TRANSFER_FLAG_WILDCARD_PID:	Allow downloading images with wildcard PIDs
  * @DFU_TARGET_TRANSFER_FLAG_ANY_CIPHER:	Allow any cipher kinds to be downloaded
  * @DFU_TARGET_TRANSFER_FLAG_ADDR_HEURISTIC:	Automatically detect the address to use
+ * @DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL:	Only erase and write sectors that have changed
  *
  * The optional flags used for transfering firmware.
  **/
@@ -40,6 +41,7 @@ typedef enum {
 	DFU_TARGET_TRANSFER_FLAG_WILDCARD_PID	= (1 << 5),
 	DFU_TARGET_TRANSFER_FLAG_ANY_CIPHER	= (1 << 6),
 	DFU_TARGET_TRANSFER_FLAG_ADDR_HEURISTIC	= (1 << 7),
+	DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL	= (1 << 8),
 	/*< private >*/
 	DFU_TARGET_TRANSFER_FLAG_LAST
 } DfuTargetTransferFlags;
@@ -89,6 +91,7 @@ gboolean	 dfu_target_download			(DfuTarget	*target,
 gboolean	 dfu_target_mass_erase			(DfuTarget	*target,
 							 GError		**error);
 DfuCipherKind	 dfu_target_get_cipher_kind		(DfuTarget	*target);
+gsize		 dfu_target_get_bytes_skipped		(DfuTarget	*target);
 
 G_END_DECLS
 
@@ -26,6 +26,7 @@ typedef struct {
 	GCancellable		*cancellable;
 	GPtrArray		*cmd_array;
 	gboolean		 force;
+	gboolean		 differential;
 	gchar			*device_vid_pid;
 	guint16			 transfer_size;
 	FuProgressbar		*progressbar;
@@ -1858,10 +1859,16 @@ dfu_tool_write_alt (DfuToolPrivate *priv, gchar **values, GError **error)
 	if (priv->force) {
 		flags |= DFU_TARGET_TRANSFER_FLAG_ANY_CIPHER;
 	}
+	if (priv->differential)
+		flags |= DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL;
 
 	/* transfer */
 	if (!dfu_target_download (target, image, flags, error))
 		return FALSE;
+	if (dfu_target_get_bytes_skipped (target) > 0) {
+		g_print ("%" G_GSIZE_FORMAT " bytes unchanged and skipped\n",
+			 dfu_target_get_bytes_skipped (target));
+	}
 
 	/* do host reset */
 	if (!dfu_device_attach (device, error))
@@ -1879,6 +1886,8 @@ static gboolean
 dfu_tool_write (DfuToolPrivate *priv, gchar **values, GError **error)
 {
 	DfuTargetTransferFlags flags = DFU_TARGET_TRANSFER_FLAG_VERIFY;
+	GPtrArray *targets;
+	gsize bytes_skipped = 0;
 	g_autofree gchar *str_debug = NULL;
 	g_autoptr(DfuDevice) device = NULL;
 	g_autoptr(DfuFirmware) firmware = NULL;
@@ -1933,6 +1942,8 @@ dfu_tool_write (DfuToolPrivate *priv, gchar **values, GError **error)
 		flags |= DFU_TARGET_TRANSFER_FLAG_WILDCARD_PID;
 		flags |= DFU_TARGET_TRANSFER_FLAG_ANY_CIPHER;
 	}
+	if (priv->differential)
+		flags |= DFU_TARGET_TRANSFER_FLAG_DIFFERENTIAL;
 
 	/* transfer */
 	g_signal_connect (device, "notify::status",
@@ -1941,6 +1952,13 @@ dfu_tool_write (DfuToolPrivate *priv, gchar **values, GError **error)
 			  G_CALLBACK (fu_tool_action_changed_cb), priv);
 	if (!dfu_device_download (device, firmware, flags, error))
 		return FALSE;
+	targets = dfu_device_get_targets (device);
+	for (guint i = 0; i < targets->len; i++) {
+		DfuTarget *target = g_ptr_array_index (targets, i);
+		bytes_skipped += dfu_target_get_bytes_skipped (target);
+	}
+	if (bytes_skipped > 0)
+		g_print ("%" G_GSIZE_FORMAT " bytes unchanged and skipped\n", bytes_skipped);
 
 	/* do host reset */
 	if (!dfu_device_attach (device, error))
@@ -2195,6 +2213,8 @@ main (int argc, char *argv[])
 			_("Specify the number of bytes per USB transfer"), "BYTES" },
 		{ "force", '\0', 0, G_OPTION_ARG_NONE, &priv->force,
 			_("Force the action ignoring all warnings"), NULL },
+		{ "differential", '\0', 0, G_OPTION_ARG_NONE, &priv->differential,
+			_("Only write sectors that have changed"), NULL },
 		{ NULL}
 	};
 
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+/**
+ * SECTION:dfu-transfer
+ * @short_description: Asynchronous DFU download scheduler
+ *
+ * This object writes a queue of blocks to a DFU target using asynchronous
+ * control transfers. The DFU state machine does not allow the next DNLOAD
+ * until GETSTATUS has returned dfuDNLOAD-IDLE, but the time spent on the bus
+ * sending each block counts towards the bwPollTimeout requested by the
+ * device, and the remaining wait is a timeout source rather than a sleep so
+ * that the main context keeps running while the flash is being written.
+ *
+ * See also: #DfuTarget
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include "dfu-device-private.h"
+#include "dfu-target-private.h"
+#include "dfu-transfer.h"
+
+#include "fwupd-error.h"
+
+static void dfu_transfer_finalize		 (GObject *object);
+
+typedef struct {
+	guint16			 value;
+	GBytes			*bytes;
+	gboolean		 is_command;
+} DfuTransferItem;
+
+struct _DfuTransfer
+{
+	GObject			 parent_instance;
+	DfuTarget		*target;
+	GQueue			*items;		/* of DfuTransferItem */
+	DfuTransferItem		*item;		/* in progress */
+	GMainContext		*context;
+	GMainLoop		*loop;
+	GError			*error;
+	gint64			 status_next;	/* monotonic time of next GETSTATUS */
+	gsize			 done;
+	gsize			 total;
+	guint8			 buf[6];
+};
+
+G_DEFINE_TYPE (DfuTransfer, dfu_transfer, G_TYPE_OBJECT)
+
+static void dfu_transfer_dnload		(DfuTransfer	*self);
+static void dfu_transfer_getstatus_schedule	(DfuTransfer	*self);
+
+static void
+dfu_transfer_item_free (DfuTransferItem *item)
+{
+	g_bytes_unref (item->bytes);
+	g_free (item);
+}
+
+static void
+dfu_transfer_add_item (DfuTransfer *self, guint16 value, GBytes *bytes, gboolean is_command)
+{
+	DfuTransferItem *item = g_new0 (DfuTransferItem, 1);
+	item->value = value;
+	item->bytes = g_bytes_ref (bytes);
+	item->is_command = is_command;
+	g_queue_push_tail (self->items, item);
+	if (!is_command)
+		self->total += g_bytes_get_size (bytes);
+}
+
+/**
+ * dfu_transfer_add_chunk:
+ * @self: a #DfuTransfer
+ * @value: the block number
+ * @bytes: the data to write, which may be zero-sized
+ *
+ * Adds a block of firmware to the download queue.
+ **/
+void
+dfu_transfer_add_chunk (DfuTransfer *self, guint16 value, GBytes *bytes)
+{
+	g_return_if_fail (DFU_IS_TRANSFER (self));
+	g_return_if_fail (bytes != NULL);
+	dfu_transfer_add_item (self, value, bytes, FALSE);
+}
+
+/**
+ * dfu_transfer_add_command:
+ * @self: a #DfuTransfer
+ * @bytes: the DfuSe command
+ *
+ * Adds a DfuSe command, e.g. to set the address pointer, to the download
+ * queue. Commands use wBlockNum=0 and are not counted in the progress.
+ **/
+void
+dfu_transfer_add_command (DfuTransfer *self, GBytes *bytes)
+{
+	g_return_if_fail (DFU_IS_TRANSFER (self));
+	g_return_if_fail (bytes != NULL);
+	dfu_transfer_add_item (self, 0, bytes, TRUE);
+}
+
+/**
+ * dfu_transfer_add_skipped:
+ * @self: a #DfuTransfer
+ * @length: size in bytes
+ *
+ * Counts data that does not need writing, as the device already has the same
+ * contents, towards the progress of the download.
+ **/
+void
+dfu_transfer_add_skipped (DfuTransfer *self, gsize length)
+{
+	g_return_if_fail (DFU_IS_TRANSFER (self));
+	self->done += length;
+	self->total += length;
+}
+
+static void
+dfu_transfer_fail (DfuTransfer *self, GError *error)
+{
+	g_propagate_error (&self->error, error);
+	g_main_loop_quit (self->loop);
+}
+
+static void
+dfu_transfer_request_async (DfuTransfer *self,
+			    DfuRequest request,
+			    guint16 value,
+			    GBytes *bytes,
+			    GAsyncReadyCallback callback)
+{
+	DfuDevice *device = dfu_target_get_device (self->target);
+	GUsbDevice *usb_device;
+
+	/* scripted device */
+	if (dfu_device_has_request_funcs (device)) {
+		dfu_device_request_async (device, request, value, bytes,
+					  NULL, callback, self);
+		return;
+	}
+
+	usb_device = fu_usb_device_get_dev (FU_USB_DEVICE (device));
+	if (request == DFU_REQUEST_DNLOAD) {
+		g_usb_device_control_transfer_async (usb_device,
+						     G_USB_DEVICE_DIRECTION_HOST_TO_DEVICE,
+						     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+						     G_USB_DEVICE_RECIPIENT_INTERFACE,
+						     request,
+						     value,
+						     dfu_device_get_interface (device),
+						     (guint8 *) g_bytes_get_data (bytes, NULL),
+						     g_bytes_get_size (bytes),
+						     dfu_device_get_timeout (device),
+						     NULL, /* cancellable */
+						     callback, self);
+		return;
+	}
+	g_usb_device_control_transfer_async (usb_device,
+					     G_USB_DEVICE_DIRECTION_DEVICE_TO_HOST,
+					     G_USB_DEVICE_REQUEST_TYPE_CLASS,
+					     G_USB_DEVICE_RECIPIENT_INTERFACE,
+					     request,
+					     value,
+					     dfu_device_get_interface (device),
+					     self->buf, sizeof(self->buf),
+					     dfu_device_get_timeout (device),
+					     NULL, /* cancellable */
+					     callback, self);
+}
+
+static gboolean
+dfu_transfer_request_finish (DfuTransfer *self,
+			     DfuRequest request,
+			     GObject *source,
+			     GAsyncResult *res,
+			     gsize *actual_length,
+			     GError **error)
+{
+	DfuDevice *device = dfu_target_get_device (self->target);
+	gssize rc;
+
+	/* scripted device */
+	if (dfu_device_has_request_funcs (device)) {
+		g_autoptr(GBytes) data = NULL;
+		data = dfu_device_request_finish (device, res, error);
+		if (data == NULL)
+			return FALSE;
+		if (request == DFU_REQUEST_DNLOAD) {
+			*actual_length = g_bytes_get_size (self->item->bytes);
+			return TRUE;
+		}
+		*actual_length = MIN (g_bytes_get_size (data), sizeof(self->buf));
+		memcpy (self->buf, g_bytes_get_data (data, NULL), *actual_length);
+		return TRUE;
+	}
+
+	rc = g_usb_device_control_transfer_finish (G_USB_DEVICE (source), res, error);
+	if (rc < 0)
+		return FALSE;
+	*actual_length = (gsize) rc;
+	return TRUE;
+}
+
+static void
+dfu_transfer_getstatus_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	DfuTransfer *self = DFU_TRANSFER (user_data);
+	DfuDevice *device = dfu_target_get_device (self->target);
+	gsize actual_length = 0;
+	GError *error = NULL;
+	g_autoptr(GError) error_local = NULL;
+
+	if (!dfu_transfer_request_finish (self, DFU_REQUEST_GETSTATUS,
+					  source, res, &actual_length,
+					  &error_local)) {
+		dfu_transfer_fail (self, g_error_new (FWUPD_ERROR,
+						      FWUPD_ERROR_NOT_SUPPORTED,
+						      "cannot get device state: %s",
+						      error_local->message));
+		return;
+	}
+	if (!dfu_device_parse_status (device, self->buf, actual_length, &error)) {
+		dfu_transfer_fail (self, error);
+		return;
+	}
+
+	/* the device cannot accept another GETSTATUS until this has passed */
+	self->status_next = g_get_monotonic_time () +
+			    (gint64) dfu_device_get_download_timeout (device) * 1000;
+
+	/* the device is still writing the block */
+	if (dfu_device_get_state (device) == DFU_STATE_DFU_DNBUSY) {
+		g_debug ("waiting for DFU_STATE_DFU_DNBUSY to clear");
+		dfu_transfer_getstatus_schedule (self);
+		return;
+	}
+	if (!dfu_target_check_state (self->target, &error)) {
+		dfu_transfer_fail (self, error);
+		return;
+	}
+
+	/* update UI */
+	if (!self->item->is_command && self->total > 0) {
+		self->done += g_bytes_get_size (self->item->bytes);
+		dfu_target_set_percentage (self->target, self->done, self->total);
+	}
+
+	/* next block */
+	dfu_transfer_dnload (self);
+}
+
+static void
+dfu_transfer_getstatus (DfuTransfer *self)
+{
+	dfu_transfer_request_async (self, DFU_REQUEST_GETSTATUS, 0, NULL,
+				    dfu_transfer_getstatus_cb);
+}
+
+static gboolean
+dfu_transfer_poll_timeout_cb (gpointer user_data)
+{
+	DfuTransfer *self = DFU_TRANSFER (user_data);
+	dfu_transfer_getstatus (self);
+	return G_SOURCE_REMOVE;
+}
+
+/* honour bwPollTimeout from the last GETSTATUS without blocking */
+static void
+dfu_transfer_getstatus_schedule (DfuTransfer *self)
+{
+	gint64 delay = self->status_next - g_get_monotonic_time ();
+	g_autoptr(GSource) source = NULL;
+
+	if (delay <= 0) {
+		dfu_transfer_getstatus (self);
+		return;
+	}
+	g_debug ("waiting %" G_GINT64_FORMAT "us for GETSTATUS", delay);
+	source = g_timeout_source_new ((guint) ((delay + 999) / 1000));
+	g_source_set_callback (source, dfu_transfer_poll_timeout_cb, self, NULL);
+	g_source_attach (source, self->context);
+}
+
+static void
+dfu_transfer_dnload_cb (GObject *source, GAsyncResult *res, gpointer user_data)
+{
+	DfuTransfer *self = DFU_TRANSFER (user_data);
+	DfuDevice *device = dfu_target_get_device (self->target);
+	gsize actual_length = 0;
+	gsize length = g_bytes_get_size (self->item->bytes);
+	g_autoptr(GError) error_local = NULL;
+
+	if (!dfu_transfer_request_finish (self, DFU_REQUEST_DNLOAD,
+					  source, res, &actual_length,
+					  &error_local)) {
+		/* refresh the error code */
+		if (!dfu_device_has_request_funcs (device))
+			dfu_device_error_fixup (device, &error_local);
+		dfu_transfer_fail (self, g_error_new (FWUPD_ERROR,
+						      FWUPD_ERROR_NOT_SUPPORTED,
+						      "cannot download data: %s",
+						      error_local->message));
+		return;
+	}
+	if (actual_length != length) {
+		dfu_transfer_fail (self, g_error_new (FWUPD_ERROR,
+						      FWUPD_ERROR_INTERNAL,
+						      "only wrote 0x%04x of 0x%04x bytes",
+						      (guint) actual_length,
+						      (guint) length));
+		return;
+	}
+
+	/* the device writes the contents to the EEPROM after the EOF */
+	if (length == 0 && dfu_device_get_download_timeout (device) > 0) {
+		dfu_target_set_action (self->target, FWUPD_STATUS_IDLE);
+		dfu_target_set_action (self->target, FWUPD_STATUS_DEVICE_BUSY);
+	}
+
+	/* for STM32 devices, the action only occurs when we do GetStatus */
+	dfu_transfer_getstatus_schedule (self);
+}
+
+static void
+dfu_transfer_dnload (DfuTransfer *self)
+{
+	g_clear_pointer (&self->item, dfu_transfer_item_free);
+
+	/* success */
+	self->item = g_queue_pop_head (self->items);
+	if (self->item == NULL) {
+		g_main_loop_quit (self->loop);
+		return;
+	}
+
+	/* low level packet debugging */
+	if (g_getenv ("FWUPD_DFU_VERBOSE") != NULL) {
+		gsize sz = 0;
+		const guint8 *data = g_bytes_get_data (self->item->bytes, &sz);
+		for (gsize i = 0; i < sz; i++)
+			g_print ("Message: m[%" G_GSIZE_FORMAT "] = 0x%02x\n", i, (guint) data[i]);
+	}
+	g_debug ("writing #%04x chunk of size %" G_GSIZE_FORMAT,
+		 self->item->value, g_bytes_get_size (self->item->bytes));
+	dfu_transfer_request_async (self, DFU_REQUEST_DNLOAD,
+				    self->item->value, self->item->bytes,
+				    dfu_transfer_dnload_cb);
+}
+
+static gboolean
+dfu_transfer_start_cb (gpointer user_data)
+{
+	DfuTransfer *self = DFU_TRANSFER (user_data);
+	dfu_transfer_dnload (self);
+	return G_SOURCE_REMOVE;
+}
+
+/**
+ * dfu_transfer_run:
+ * @self: a #DfuTransfer
+ * @error: a #GError, or %NULL
+ *
+ * Writes all the queued blocks to the target, returning when the device
+ * has accepted the last one or when any request fails.
+ *
+ * Return value: %TRUE for success
+ **/
+gboolean
+dfu_transfer_run (DfuTransfer *self, GError **error)
+{
+	g_autoptr(GSource) source = NULL;
+
+	g_return_val_if_fail (DFU_IS_TRANSFER (self), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+	g_return_val_if_fail (self->loop == NULL, FALSE);
+
+	/* a private context, so that unrelated sources on the caller's context
+	 * are not dispatched while the device is in the middle of a download;
+	 * the async USB transfers complete in the thread-default context */
+	self->context = g_main_context_new ();
+	g_main_context_push_thread_default (self->context);
+	self->loop = g_main_loop_new (self->context, FALSE);
+	self->status_next = 0;
+
+	source = g_idle_source_new ();
+	g_source_set_callback (source, dfu_transfer_start_cb, self, NULL);
+	g_source_attach (source, self->context);
+	g_main_loop_run (self->loop);
+
+	g_main_context_pop_thread_default (self->context);
+	g_clear_pointer (&self->loop, g_main_loop_unref);
+	g_clear_pointer (&self->context, g_main_context_unref);
+	g_clear_pointer (&self->item, dfu_transfer_item_free);
+	if (self->error != NULL) {
+		g_propagate_error (error, self->error);
+		self->error = NULL;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+dfu_transfer_class_init (DfuTransferClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = dfu_transfer_finalize;
+}
+
+static void
+dfu_transfer_init (DfuTransfer *self)
+{
+	self->items = g_queue_new ();
+}
+
+static void
+dfu_transfer_finalize (GObject *object)
+{
+	DfuTransfer *self = DFU_TRANSFER (object);
+
+	g_queue_free_full (self->items, (GDestroyNotify) dfu_transfer_item_free);
+	if (self->item != NULL)
+		dfu_transfer_item_free (self->item);
+	g_object_unref (self->target);
+
+	G_OBJECT_CLASS (dfu_transfer_parent_class)->finalize (object);
+}
+
+/**
+ * dfu_transfer_new:
+ * @target: a #DfuTarget
+ *
+ * Creates a new download scheduler for the target.
+ *
+ * Return value: a new #DfuTransfer
+ **/
+DfuTransfer *
+dfu_transfer_new (DfuTarget *target)
+{
+	DfuTransfer *self;
+	self = g_object_new (DFU_TYPE_TRANSFER, NULL);
+	self->target = g_object_ref (target);
+	return self;
+}
@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __DFU_TRANSFER_H
+#define __DFU_TRANSFER_H
+
+#include <glib-object.h>
+
+#include "dfu-target.h"
+
+G_BEGIN_DECLS
+
+#define DFU_TYPE_TRANSFER (dfu_transfer_get_type ())
+G_DECLARE_FINAL_TYPE (DfuTransfer, dfu_transfer, DFU, TRANSFER, GObject)
+
+DfuTransfer	*dfu_transfer_new		(DfuTarget	*target);
+void		 dfu_transfer_add_chunk		(DfuTransfer	*self,
+						 guint16	 value,
+						 GBytes		*bytes);
+void		 dfu_transfer_add_command	(DfuTransfer	*self,
+						 GBytes		*bytes);
+void		 dfu_transfer_add_skipped	(DfuTransfer	*self,
+						 gsize		 length);
+gboolean	 dfu_transfer_run		(DfuTransfer	*self,
+						 GError		**error);
+
+G_END_DECLS
+
+#endif /* __DFU_TRANSFER_H */
@@ -169,10 +169,7 @@ fu_plugin_verify (FuPlugin *plugin,
 	g_autoptr(DfuFirmware) dfu_firmware = NULL;
 	g_autoptr(FuDeviceLocker) locker  = NULL;
 	g_autoptr(GError) error_local = NULL;
-	GChecksumType checksum_types[] = {
-		G_CHECKSUM_SHA1,
-		G_CHECKSUM_SHA256,
-		0 };
+	g_autoptr(GPtrArray) checksums = NULL;
 
 	/* open it */
 	locker = fu_device_locker_new (device, &error_local);
@@ -193,11 +190,10 @@ fu_plugin_verify (FuPlugin *plugin,
 	blob_fw = dfu_firmware_write_data (dfu_firmware, error);
 	if (blob_fw == NULL)
 		return FALSE;
-	for (guint i = 0; checksum_types[i] != 0; i++) {
-		g_autofree gchar *hash = NULL;
-		hash = g_compute_checksum_for_bytes (checksum_types[i], blob_fw);
-		fu_device_add_checksum (dev, hash);
-	}
+	checksums = fu_common_get_checksums (blob_fw, FU_CHECKSUM_FLAG_SHA1 |
+							FU_CHECKSUM_FLAG_SHA256);
+	for (guint i = 0; i < checksums->len; i++)
+		fu_device_add_checksum (dev, g_ptr_array_index (checksums, i));
 
 	/* success */
 	return TRUE;
@@ -259,7 +259,7 @@ fu_fastboot_device_flash (FuDevice *device,
 	FuFastbootDevice *self = FU_FASTBOOT_DEVICE (device);
 	gsize sz = g_bytes_get_size (fw);
 	g_autofree gchar *tmp = g_strdup_printf ("download:%08x", (guint) sz);
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* tell the client the size of data to expect */
 	if (!fu_fastboot_device_writestr (device, tmp, error))
@@ -270,12 +270,12 @@ fu_fastboot_device_flash (FuDevice *device,
 
 	/* send the data in chunks */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
-	chunks = fu_chunk_array_new_from_bytes (fw,
-						0x00,	/* start addr */
-						0x00,	/* page_sz */
-						self->blocksz);
+	chunks = fu_chunk_array_new_flat_from_bytes (fw,
+						     0x00,	/* start addr */
+						     0x00,	/* page_sz */
+						     self->blocksz);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		if (!fu_fastboot_device_write (device, chk->data, chk->data_sz, error))
 			return FALSE;
 		fu_device_set_progress_full (device, (gsize) i, (gsize) chunks->len * 2);
@@ -416,7 +416,7 @@ fu_nvme_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 {
 	FuNvmeDevice *self = FU_NVME_DEVICE (device);
 	g_autoptr(GBytes) fw2 = NULL;
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 	guint64 block_size = self->write_block_size > 0 ?
 			     self->write_block_size : 0x1000;
 
@@ -429,15 +429,15 @@ fu_nvme_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 	}
 
 	/* build packets */
-	chunks = fu_chunk_array_new_from_bytes (fw2,
-						0x00,		/* start_addr */
-						0x00,		/* page_sz */
-						block_size);	/* block size */
+	chunks = fu_chunk_array_new_flat_from_bytes (fw2,
+						     0x00,		/* start_addr */
+						     0x00,		/* page_sz */
+						     block_size);	/* block size */
 
 	/* write each block */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		if (!fu_nvme_device_fw_download (self,
 						 chk->address,
 						 chk->data,
@@ -318,7 +318,7 @@ static gboolean
 fu_rts54hid_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 {
 	FuRts54HidDevice *self = FU_RTS54HID_DEVICE (device);
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* set MCU to high clock rate for better ISP performance */
 	if (!fu_rts54hid_device_set_clock_mode (self, TRUE, error))
@@ -330,15 +330,15 @@ fu_rts54hid_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 		return FALSE;
 
 	/* build packets */
-	chunks = fu_chunk_array_new_from_bytes (fw,
-						0x00,	/* start addr */
-						0x00,	/* page_sz */
-						FU_RTS54HID_TRANSFER_BLOCK_SIZE);
+	chunks = fu_chunk_array_new_flat_from_bytes (fw,
+						     0x00,	/* start addr */
+						     0x00,	/* page_sz */
+						     FU_RTS54HID_TRANSFER_BLOCK_SIZE);
 
 	/* write each block */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 
 		/* write chunk */
 		if (!fu_rts54hid_device_write_flash (self,
@@ -214,13 +214,13 @@ static gboolean
 fu_rts54hid_module_write_firmware (FuDevice *module, GBytes *fw, GError **error)
 {
 	FuRts54HidModule *self = FU_RTS54HID_MODULE (module);
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* build packets */
-	chunks = fu_chunk_array_new_from_bytes (fw,
-						0x00,	/* start addr */
-						0x00,	/* page_sz */
-						FU_RTS54HID_TRANSFER_BLOCK_SIZE);
+	chunks = fu_chunk_array_new_flat_from_bytes (fw,
+						     0x00,	/* start addr */
+						     0x00,	/* page_sz */
+						     FU_RTS54HID_TRANSFER_BLOCK_SIZE);
 
 	if (0) {
 		if (!fu_rts54hid_module_i2c_read (self, 0x0000, NULL, 0, error))
@@ -232,7 +232,7 @@ fu_rts54hid_module_write_firmware (FuDevice *module, GBytes *fw, GError **error)
 	/* write each block */
 	fu_device_set_status (module, FWUPD_STATUS_DEVICE_WRITE);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 
 		/* write chunk */
 		if (!fu_rts54hid_module_i2c_write (self,
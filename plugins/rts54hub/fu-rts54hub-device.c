@@ -311,7 +311,7 @@ static gboolean
 fu_rts54hub_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 {
 	FuRts54HubDevice *self = FU_RTS54HUB_DEVICE (device);
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* enable vendor commands */
 	if (!fu_rts54hub_device_vendor_cmd (self,
@@ -340,15 +340,15 @@ fu_rts54hub_device_write_firmware (FuDevice *device, GBytes *fw, GError **error)
 	}
 
 	/* build packets */
-	chunks = fu_chunk_array_new_from_bytes (fw,
-						0x00,	/* start addr */
-						0x00,	/* page_sz */
-						FU_RTS54HUB_DEVICE_BLOCK_SIZE);
+	chunks = fu_chunk_array_new_flat_from_bytes (fw,
+						     0x00,	/* start addr */
+						     0x00,	/* page_sz */
+						     FU_RTS54HUB_DEVICE_BLOCK_SIZE);
 
 	/* write each block */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 
 		/* write chunk */
 		if (!fu_rts54hub_device_write_flash (self,
@@ -20,6 +20,7 @@ fu_plugin_init (FuPlugin *plugin)
 	else
 		fu_plugin_set_build_hash (plugin, FU_BUILD_HASH);
 	fu_plugin_add_rule (plugin, FU_PLUGIN_RULE_SUPPORTS_PROTOCOL, "com.acme.test");
+	fu_plugin_add_rule (plugin, FU_PLUGIN_RULE_CONCURRENT_UPDATE, "no shared state");
 	fu_plugin_alloc_data (plugin, sizeof (FuPluginData));
 	g_debug ("init");
 }
@@ -37,6 +38,14 @@ fu_plugin_coldplug (FuPlugin *plugin, GError **error)
 	g_autoptr(FuDevice) device = NULL;
 	device = fu_device_new ();
 	fu_device_set_id (device, "FakeDevice");
+
+	/* simulate a slow probe, e.g. for the threaded coldplug test */
+	if (g_strcmp0 (g_getenv ("FWUPD_PLUGIN_TEST"), "coldplug-delay") == 0) {
+		g_usleep (50 * 1000);
+		fu_device_set_id (device, fu_plugin_get_name (plugin));
+		fu_plugin_set_coldplug_delay (plugin, 1);
+		fu_plugin_check_supported (plugin, "b585990a-003e-5270-89d5-3705a17f9a43");
+	}
 	fu_device_add_guid (device, "b585990a-003e-5270-89d5-3705a17f9a43");
 	fu_device_set_name (device, "Integrated_Webcam(TM)");
 	fu_device_add_icon (device, "preferences-desktop-keyboard");
@@ -10,6 +10,7 @@
 #include <glib/gstdio.h>
 #include <string.h>
 
+#include "fu-common.h"
 #include "fu-common-guid.h"
 #include "fu-rom.h"
 
@@ -550,8 +551,9 @@ fu_rom_load_data (FuRom *self,
 	guint32 jump = 0;
 	guint32 hdr_sz = 0;
 	g_autofree gchar *id = NULL;
-	g_autoptr(GChecksum) checksum_sha1 = g_checksum_new (G_CHECKSUM_SHA1);
-	g_autoptr(GChecksum) checksum_sha256 = g_checksum_new (G_CHECKSUM_SHA256);
+	g_autoptr(GByteArray) rom_data = g_byte_array_new ();
+	g_autoptr(GBytes) rom_blob = NULL;
+	g_autoptr(GPtrArray) checksums = NULL;
 
 	g_return_val_if_fail (FU_IS_ROM (self), FALSE);
 
@@ -678,13 +680,15 @@ fu_rom_load_data (FuRom *self,
 		fu_rom_find_and_blank_serial_numbers (self);
 	for (guint i = 0; i < self->hdrs->len; i++) {
 		hdr = g_ptr_array_index (self->hdrs, i);
-		g_checksum_update (checksum_sha1, hdr->rom_data, hdr->rom_len);
-		g_checksum_update (checksum_sha256, hdr->rom_data, hdr->rom_len);
+		g_byte_array_append (rom_data, hdr->rom_data, hdr->rom_len);
 	}
 
-	/* done updating checksums */
-	g_ptr_array_add (self->checksums, g_strdup (g_checksum_get_string (checksum_sha1)));
-	g_ptr_array_add (self->checksums, g_strdup (g_checksum_get_string (checksum_sha256)));
+	/* both digests in one pass */
+	rom_blob = g_byte_array_free_to_bytes (g_steal_pointer (&rom_data));
+	checksums = fu_common_get_checksums (rom_blob, FU_CHECKSUM_FLAG_SHA1 |
+						       FU_CHECKSUM_FLAG_SHA256);
+	for (guint i = 0; i < checksums->len; i++)
+		g_ptr_array_add (self->checksums, g_strdup (g_ptr_array_index (checksums, i)));
 
 	/* update guid */
 	id = g_strdup_printf ("PCI\\VEN_%04X&DEV_%04X",
@@ -28,7 +28,7 @@ fu_wac_module_touch_write_firmware (FuDevice *device, GBytes *blob, GError **err
 	const guint8 *data;
 	gsize blocks_total = 0;
 	gsize len = 0;
-	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GArray) chunks = NULL;
 
 	/* build each data packet */
 	data = g_bytes_get_data (blob, &len);
@@ -39,10 +39,10 @@ fu_wac_module_touch_write_firmware (FuDevice *device, GBytes *blob, GError **err
 				     "firmware has to be padded to 128b");
 		return FALSE;
 	}
-	chunks = fu_chunk_array_new (data, (guint32) len,
-				     0x0, /* addr_start */
-				     0x0, /* page_sz */
-				     128); /* packet_sz */
+	chunks = fu_chunk_array_new_flat (data, (guint32) len,
+					  0x0, /* addr_start */
+					  0x0, /* page_sz */
+					  128); /* packet_sz */
 	blocks_total = chunks->len + 2;
 
 	/* start, which will erase the module */
@@ -56,7 +56,7 @@ fu_wac_module_touch_write_firmware (FuDevice *device, GBytes *blob, GError **err
 	/* data */
 	fu_device_set_status (device, FWUPD_STATUS_DEVICE_WRITE);
 	for (guint i = 0; i < chunks->len; i++) {
-		FuChunk *chk = g_ptr_array_index (chunks, i);
+		FuChunk *chk = &g_array_index (chunks, FuChunk, i);
 		guint8 buf[128+7];
 		g_autoptr(GBytes) blob_chunk = NULL;
 
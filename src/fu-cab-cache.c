@@ -0,0 +1,243 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#define G_LOG_DOMAIN				"FuCabCache"
+
+#include "config.h"
+
+#include "fu-cab-cache.h"
+#include "fu-mutex.h"
+
+/**
+ * SECTION:fu-cab-cache
+ * @short_description: a cache of parsed cabinet archives
+ *
+ * Front-ends usually call GetDetails and then Install on the same archive,
+ * so the decompressed and validated silo is kept around keyed by the
+ * container checksum. The least recently used archives are removed when the
+ * total size goes over the limit.
+ */
+
+static void fu_cab_cache_finalize	 (GObject *obj);
+
+typedef struct {
+	gchar			*checksum;
+	XbSilo			*silo;
+	guint64			 size;
+} FuCabCacheItem;
+
+struct _FuCabCache
+{
+	GObject			 parent_instance;
+	GHashTable		*hash;		/* checksum:FuCabCacheItem */
+	GQueue			*lru;		/* of FuCabCacheItem, newest first */
+	FuMutex			*mutex;
+	guint64			 size;
+	guint64			 size_max;
+};
+
+G_DEFINE_TYPE (FuCabCache, fu_cab_cache, G_TYPE_OBJECT)
+
+static void
+fu_cab_cache_item_free (FuCabCacheItem *item)
+{
+	g_free (item->checksum);
+	g_object_unref (item->silo);
+	g_free (item);
+}
+
+static void
+fu_cab_cache_remove_item (FuCabCache *self, FuCabCacheItem *item)
+{
+	g_debug ("removing %s from cache", item->checksum);
+	g_queue_remove (self->lru, item);
+	self->size -= item->size;
+	g_hash_table_remove (self->hash, item->checksum);
+}
+
+/* remove the least recently used archives until under the limit */
+static void
+fu_cab_cache_ensure_size (FuCabCache *self)
+{
+	while (self->size > self->size_max) {
+		FuCabCacheItem *item = g_queue_peek_tail (self->lru);
+		if (item == NULL)
+			break;
+		fu_cab_cache_remove_item (self, item);
+	}
+}
+
+/**
+ * fu_cab_cache_set_size_max:
+ * @self: A #FuCabCache
+ * @size_max: Maximum size in bytes, or 0 to disable the cache
+ *
+ * Sets the approximate amount of memory that can be used by cached archives.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_cab_cache_set_size_max (FuCabCache *self, guint64 size_max)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->mutex);
+	g_return_if_fail (FU_IS_CAB_CACHE (self));
+	self->size_max = size_max;
+	fu_cab_cache_ensure_size (self);
+}
+
+/**
+ * fu_cab_cache_get_size:
+ * @self: A #FuCabCache
+ *
+ * Gets the approximate amount of memory used by cached archives.
+ *
+ * Returns: size in bytes
+ *
+ * Since: 1.2.5
+ **/
+guint64
+fu_cab_cache_get_size (FuCabCache *self)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->mutex);
+	g_return_val_if_fail (FU_IS_CAB_CACHE (self), 0);
+	return self->size;
+}
+
+/**
+ * fu_cab_cache_lookup:
+ * @self: A #FuCabCache
+ * @checksum: A SHA1 container checksum
+ *
+ * Finds a previously parsed archive, marking it as recently used.
+ *
+ * Returns: (transfer full): a #XbSilo, or %NULL if not found
+ *
+ * Since: 1.2.5
+ **/
+XbSilo *
+fu_cab_cache_lookup (FuCabCache *self, const gchar *checksum)
+{
+	FuCabCacheItem *item;
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->mutex);
+
+	g_return_val_if_fail (FU_IS_CAB_CACHE (self), NULL);
+	g_return_val_if_fail (checksum != NULL, NULL);
+
+	item = g_hash_table_lookup (self->hash, checksum);
+	if (item == NULL)
+		return NULL;
+	g_queue_remove (self->lru, item);
+	g_queue_push_head (self->lru, item);
+	return g_object_ref (item->silo);
+}
+
+/**
+ * fu_cab_cache_add:
+ * @self: A #FuCabCache
+ * @checksum: A SHA1 container checksum
+ * @silo: A #XbSilo
+ * @size: The approximate amount of memory used by @silo
+ *
+ * Adds a parsed archive to the cache, removing older archives if required.
+ * Archives larger than the maximum size are not added.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_cab_cache_add (FuCabCache *self, const gchar *checksum, XbSilo *silo, guint64 size)
+{
+	FuCabCacheItem *item;
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->mutex);
+
+	g_return_if_fail (FU_IS_CAB_CACHE (self));
+	g_return_if_fail (checksum != NULL);
+	g_return_if_fail (XB_IS_SILO (silo));
+
+	/* replace any existing entry */
+	item = g_hash_table_lookup (self->hash, checksum);
+	if (item != NULL)
+		fu_cab_cache_remove_item (self, item);
+	if (size > self->size_max) {
+		g_debug ("not caching %s as too large", checksum);
+		return;
+	}
+
+	item = g_new0 (FuCabCacheItem, 1);
+	item->checksum = g_strdup (checksum);
+	item->silo = g_object_ref (silo);
+	item->size = size;
+	g_hash_table_insert (self->hash, item->checksum, item);
+	g_queue_push_head (self->lru, item);
+	self->size += size;
+	fu_cab_cache_ensure_size (self);
+}
+
+/**
+ * fu_cab_cache_invalidate:
+ * @self: A #FuCabCache
+ *
+ * Removes all cached archives, for instance when the keyrings or the remotes
+ * have changed.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_cab_cache_invalidate (FuCabCache *self)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->mutex);
+	g_return_if_fail (FU_IS_CAB_CACHE (self));
+	if (self->size > 0)
+		g_debug ("invalidating %u cached archives", g_queue_get_length (self->lru));
+	g_queue_clear (self->lru);
+	g_hash_table_remove_all (self->hash);
+	self->size = 0;
+}
+
+static void
+fu_cab_cache_class_init (FuCabCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = fu_cab_cache_finalize;
+}
+
+static void
+fu_cab_cache_init (FuCabCache *self)
+{
+	self->size_max = 128 * 0x100000;
+	self->lru = g_queue_new ();
+	self->hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+					    (GDestroyNotify) fu_cab_cache_item_free);
+	self->mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "hash");
+}
+
+static void
+fu_cab_cache_finalize (GObject *obj)
+{
+	FuCabCache *self = FU_CAB_CACHE (obj);
+
+	g_queue_free (self->lru);
+	g_hash_table_unref (self->hash);
+	g_object_unref (self->mutex);
+
+	G_OBJECT_CLASS (fu_cab_cache_parent_class)->finalize (obj);
+}
+
+/**
+ * fu_cab_cache_new:
+ *
+ * Creates a new cache of parsed cabinet archives.
+ *
+ * Returns: a #FuCabCache
+ *
+ * Since: 1.2.5
+ **/
+FuCabCache *
+fu_cab_cache_new (void)
+{
+	FuCabCache *self;
+	self = g_object_new (FU_TYPE_CAB_CACHE, NULL);
+	return FU_CAB_CACHE (self);
+}
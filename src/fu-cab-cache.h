@@ -0,0 +1,32 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __FU_CAB_CACHE_H
+#define __FU_CAB_CACHE_H
+
+G_BEGIN_DECLS
+
+#include <glib-object.h>
+#include <xmlb.h>
+
+#define FU_TYPE_CAB_CACHE (fu_cab_cache_get_type ())
+G_DECLARE_FINAL_TYPE (FuCabCache, fu_cab_cache, FU, CAB_CACHE, GObject)
+
+FuCabCache	*fu_cab_cache_new		(void);
+void		 fu_cab_cache_set_size_max	(FuCabCache	*self,
+						 guint64	 size_max);
+guint64		 fu_cab_cache_get_size		(FuCabCache	*self);
+XbSilo		*fu_cab_cache_lookup		(FuCabCache	*self,
+						 const gchar	*checksum);
+void		 fu_cab_cache_add		(FuCabCache	*self,
+						 const gchar	*checksum,
+						 XbSilo		*silo,
+						 guint64	 size);
+void		 fu_cab_cache_invalidate	(FuCabCache	*self);
+
+G_END_DECLS
+
+#endif /* __FU_CAB_CACHE_H */
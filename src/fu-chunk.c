@@ -89,6 +89,42 @@ fu_chunk_array_to_string (GPtrArray *chunks)
 	return g_string_free (str, FALSE);
 }
 
+/* number of bytes in the packet starting at @offset, which must not cross a
+ * page boundary or be larger than the transfer size */
+static guint32
+fu_chunk_get_size_at (guint32 offset,
+		      guint32 data_sz,
+		      guint32 addr_start,
+		      guint32 page_sz,
+		      guint32 packet_sz)
+{
+	guint32 chunk_sz = data_sz - offset;
+	if (page_sz > 0)
+		chunk_sz = MIN (chunk_sz, page_sz - ((addr_start + offset) % page_sz));
+	if (packet_sz > 0)
+		chunk_sz = MIN (chunk_sz, packet_sz);
+	return chunk_sz;
+}
+
+static void
+fu_chunk_init_at (FuChunk *item,
+		  guint32 idx,
+		  guint32 offset,
+		  const guint8 *data,
+		  guint32 data_sz,
+		  guint32 addr_start,
+		  guint32 page_sz,
+		  guint32 packet_sz)
+{
+	guint32 address = addr_start + offset;
+	item->idx = idx;
+	item->page = page_sz > 0 ? address / page_sz : 0;
+	item->address = page_sz > 0 ? address % page_sz : address;
+	item->data = data != NULL ? data + offset : NULL;
+	item->data_sz = fu_chunk_get_size_at (offset, data_sz, addr_start,
+					      page_sz, packet_sz);
+}
+
 /**
  * fu_chunk_array_new:
  * @data: a linear blob of memory, or %NULL
@@ -110,63 +146,16 @@ fu_chunk_array_new (const guint8 *data,
 		 guint32 packet_sz)
 {
 	GPtrArray *segments = NULL;
-	guint32 page_old = G_MAXUINT32;
-	guint32 idx;
-	guint32 last_flush = 0;
 
 	g_return_val_if_fail (data_sz > 0, NULL);
 
 	segments = g_ptr_array_new_with_free_func (g_free);
-	for (idx = 1; idx < data_sz; idx++) {
-		guint32 page = 0;
-		if (page_sz > 0)
-			page = (addr_start + idx) / page_sz;
-		if (page_old == G_MAXUINT32) {
-			page_old = page;
-		} else if (page != page_old) {
-			const guint8 *data_offset = data != NULL ? data + last_flush : 0x0;
-			guint32 address_offset = addr_start + last_flush;
-			if (page_sz > 0)
-				address_offset %= page_sz;
-			g_ptr_array_add (segments,
-					 fu_chunk_new (segments->len,
-						       page_old,
-						       address_offset,
-						       data_offset,
-						       idx - last_flush));
-			last_flush = idx;
-			page_old = page;
-			continue;
-		}
-		if (packet_sz > 0 && idx - last_flush >= packet_sz) {
-			const guint8 *data_offset = data != NULL ? data + last_flush : 0x0;
-			guint32 address_offset = addr_start + last_flush;
-			if (page_sz > 0)
-				address_offset %= page_sz;
-			g_ptr_array_add (segments,
-					 fu_chunk_new (segments->len,
-						       page,
-						       address_offset,
-						       data_offset,
-						       idx - last_flush));
-			last_flush = idx;
-			continue;
-		}
-	}
-	if (last_flush != idx) {
-		const guint8 *data_offset = data != NULL ? data + last_flush : 0x0;
-		guint32 address_offset = addr_start + last_flush;
-		guint32 page = 0;
-		if (page_sz > 0) {
-			address_offset %= page_sz;
-			page = (addr_start + (idx - 1)) / page_sz;
-		}
-		g_ptr_array_add (segments,
-				 fu_chunk_new (segments->len,
-					       page,
-					       address_offset,
-					       data_offset,
-					       data_sz - last_flush));
+	for (guint32 offset = 0; offset < data_sz;) {
+		FuChunk *item = g_new0 (FuChunk, 1);
+		fu_chunk_init_at (item, segments->len, offset, data, data_sz,
+				  addr_start, page_sz, packet_sz);
+		g_ptr_array_add (segments, item);
+		offset += item->data_sz;
 	}
 	return segments;
 }
@@ -194,3 +183,74 @@ fu_chunk_array_new_from_bytes (GBytes *blob,
 	return fu_chunk_array_new (data, (guint32) sz,
 				   addr_start, page_sz, packet_sz);
 }
+
+/**
+ * fu_chunk_array_new_flat:
+ * @data: a linear blob of memory, or %NULL
+ * @data_sz: size of @data_sz
+ * @addr_start: the hardware address offset, or 0
+ * @page_sz: the hardware page size, or 0
+ * @packet_sz: the transfer size, or 0
+ *
+ * Chunks a linear blob of memory into packets like fu_chunk_array_new(), but
+ * stores all the packets in one allocation. The packets point into @data,
+ * which must outlive the array.
+ *
+ * Return value: (element-type FuChunk): array of packets
+ *
+ * Since: 1.2.5
+ **/
+GArray *
+fu_chunk_array_new_flat (const guint8 *data,
+			 guint32 data_sz,
+			 guint32 addr_start,
+			 guint32 page_sz,
+			 guint32 packet_sz)
+{
+	GArray *segments = NULL;
+	guint32 reserved = 2;
+
+	g_return_val_if_fail (data_sz > 0, NULL);
+
+	/* an upper bound, so the array is never resized */
+	if (packet_sz > 0)
+		reserved += data_sz / packet_sz;
+	if (page_sz > 0)
+		reserved += data_sz / page_sz;
+	segments = g_array_sized_new (FALSE, FALSE, sizeof(FuChunk), reserved);
+	for (guint32 offset = 0; offset < data_sz;) {
+		FuChunk item;
+		fu_chunk_init_at (&item, segments->len, offset, data, data_sz,
+				  addr_start, page_sz, packet_sz);
+		g_array_append_val (segments, item);
+		offset += item.data_sz;
+	}
+	return segments;
+}
+
+/**
+ * fu_chunk_array_new_flat_from_bytes:
+ * @blob: a #GBytes
+ * @addr_start: the hardware address offset, or 0
+ * @page_sz: the hardware page size, or 0
+ * @packet_sz: the transfer size, or 0
+ *
+ * Chunks a #GBytes into packets like fu_chunk_array_new_from_bytes(), but
+ * stores all the packets in one allocation. The packets point into @blob,
+ * which must outlive the array.
+ *
+ * Return value: (element-type FuChunk): array of packets
+ *
+ * Since: 1.2.5
+ **/
+GArray *
+fu_chunk_array_new_flat_from_bytes (GBytes *blob,
+				    guint32 addr_start,
+				    guint32 page_sz,
+				    guint32 packet_sz)
+{
+	gsize sz;
+	const guint8 *data = g_bytes_get_data (blob, &sz);
+	return fu_chunk_array_new_flat (data, (guint32) sz,
+					addr_start, page_sz, packet_sz);
+}
@@ -37,6 +37,15 @@ GPtrArray	*fu_chunk_array_new_from_bytes		(GBytes		*blob,
 							 guint32	 addr_start,
 							 guint32	 page_sz,
 							 guint32	 packet_sz);
+GArray		*fu_chunk_array_new_flat		(const guint8	*data,
+							 guint32	 data_sz,
+							 guint32	 addr_start,
+							 guint32	 page_sz,
+							 guint32	 packet_sz);
+GArray		*fu_chunk_array_new_flat_from_bytes	(GBytes		*blob,
+							 guint32	 addr_start,
+							 guint32	 page_sz,
+							 guint32	 packet_sz);
 
 G_END_DECLS
 
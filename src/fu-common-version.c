@@ -181,25 +181,18 @@ fu_common_vercmp_char (gchar chr1, gchar chr2)
 }
 
 static gint
-fu_common_vercmp_chunk (const gchar *str1, const gchar *str2)
+fu_common_vercmp_chunk (const gchar *str1, gsize len1, const gchar *str2, gsize len2)
 {
-	guint i;
-
-	/* trivial */
-	if (g_strcmp0 (str1, str2) == 0)
-		return 0;
-	if (str1 == NULL)
-		return 1;
-	if (str2 == NULL)
-		return -1;
+	gsize i;
 
 	/* check each char of the chunk */
-	for (i = 0; str1[i] != '\0' && str2[i] != '\0'; i++) {
+	for (i = 0; i < len1 && i < len2; i++) {
 		gint rc = fu_common_vercmp_char (str1[i], str2[i]);
 		if (rc != 0)
 			return rc;
 	}
-	return fu_common_vercmp_char (str1[i], str2[i]);
+	return fu_common_vercmp_char (i < len1 ? str1[i] : '\0',
+				      i < len2 ? str2[i] : '\0');
 }
 
 static gboolean
@@ -213,27 +206,10 @@ _g_ascii_is_digits (const gchar *str)
 	return TRUE;
 }
 
-/**
- * fu_common_version_parse:
- * @version: A version number
- *
- * Returns a dotted decimal version string from a version string. The supported
- * formats are:
- *
- * - Dotted decimal, e.g. "1.2.3"
- * - Base 16, a hex number *with* a 0x prefix, e.g. "0x10203"
- * - Base 10, a string containing just [0-9], e.g. "66051"
- * - Date in YYYYMMDD format, e.g. 20150915
- *
- * Anything with a '.' or that doesn't match [0-9] or 0x[a-f,0-9] is considered
- * a string and returned without modification.
- *
- * Returns: A version number, e.g. "1.0.3"
- *
- * Since: 1.2.0
- */
-gchar *
-fu_common_version_parse (const gchar *version)
+/* returns TRUE if the version is a plain base 10 or base 16 number that
+ * fu_common_version_parse() would convert to a triplet */
+static gboolean
+fu_common_version_parse_uint32 (const gchar *version, guint32 *val)
 {
 	const gchar *version_noprefix = version;
 	gchar *endptr = NULL;
@@ -241,13 +217,13 @@ fu_common_version_parse (const gchar *version)
 	guint base;
 
 	/* already dotted decimal */
-	if (g_strstr_len (version, -1, ".") != NULL)
-		return g_strdup (version);
+	if (strchr (version, '.') != NULL)
+		return FALSE;
 
 	/* is a date */
 	if (g_str_has_prefix (version, "20") &&
 	    strlen (version) == 8)
-		return g_strdup (version);
+		return FALSE;
 
 	/* convert 0x prefixed strings to dotted decimal */
 	if (g_str_has_prefix (version, "0x")) {
@@ -256,17 +232,46 @@ fu_common_version_parse (const gchar *version)
 	} else {
 		/* for non-numeric content, just return the string */
 		if (!_g_ascii_is_digits (version))
-			return g_strdup (version);
+			return FALSE;
 		base = 10;
 	}
 
 	/* convert */
 	tmp = g_ascii_strtoull (version_noprefix, &endptr, base);
 	if (endptr != NULL && endptr[0] != '\0')
-		return g_strdup (version);
+		return FALSE;
 	if (tmp == 0)
+		return FALSE;
+	*val = (guint32) tmp;
+	return TRUE;
+}
+
+/**
+ * fu_common_version_parse:
+ * @version: A version number
+ *
+ * Returns a dotted decimal version string from a version string. The supported
+ * formats are:
+ *
+ * - Dotted decimal, e.g. "1.2.3"
+ * - Base 16, a hex number *with* a 0x prefix, e.g. "0x10203"
+ * - Base 10, a string containing just [0-9], e.g. "66051"
+ * - Date in YYYYMMDD format, e.g. 20150915
+ *
+ * Anything with a '.' or that doesn't match [0-9] or 0x[a-f,0-9] is considered
+ * a string and returned without modification.
+ *
+ * Returns: A version number, e.g. "1.0.3"
+ *
+ * Since: 1.2.0
+ */
+gchar *
+fu_common_version_parse (const gchar *version)
+{
+	guint32 tmp = 0;
+	if (!fu_common_version_parse_uint32 (version, &tmp))
 		return g_strdup (version);
-	return fu_common_version_from_uint32 ((guint32) tmp, FU_VERSION_FORMAT_TRIPLET);
+	return fu_common_version_from_uint32 (tmp, FU_VERSION_FORMAT_TRIPLET);
 }
 
 /**
@@ -319,71 +324,180 @@ fu_common_version_guess_format (const gchar *version)
 	return FU_VERSION_FORMAT_UNKNOWN;
 }
 
+/* parses the section starting at @str, returning the start of the next */
+static const gchar *
+fu_common_version_key_parse_section (const gchar *str, FuVersionKeySection *section)
+{
+	gchar *endptr = NULL;
+	const gchar *end;
+
+	section->num = g_ascii_strtoll (str, &endptr, 10);
+	section->str = endptr;
+	end = strchr (endptr, '.');
+	if (end == NULL) {
+		section->str_len = strlen (endptr);
+		return NULL;
+	}
+	section->str_len = end - endptr;
+	return end + 1;
+}
+
 /**
- * fu_common_vercmp:
- * @version_a: the release version, e.g. 1.2.3
- * @version_b: the release version, e.g. 1.2.3.1
+ * fu_common_version_key_init:
+ * @key: A #FuVersionKey
+ * @version: (nullable): the release version, e.g. 1.2.3
  *
- * Compares version numbers for sorting.
+ * Parses a version number so that it can be compared using
+ * fu_common_version_key_cmp() without allocating memory. Numeric versions
+ * such as `0x10203` are converted in the same way as fu_common_version_parse().
+ *
+ * The key does not copy @version, so the string must not be freed or modified
+ * while the key is in use.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_common_version_key_init (FuVersionKey *key, const gchar *version)
+{
+	const gchar *tmp = version;
+	guint32 val = 0;
+
+	g_return_if_fail (key != NULL);
+
+	key->sections_len = 0;
+	key->tail = NULL;
+	key->valid = version != NULL;
+	if (version == NULL)
+		return;
+
+	/* convert to a triplet without printing it first */
+	if (fu_common_version_parse_uint32 (version, &val)) {
+		key->sections[0].num = (val >> 24) & 0xff;
+		key->sections[1].num = (val >> 16) & 0xff;
+		key->sections[2].num = val & 0xffff;
+		for (guint i = 0; i < 3; i++) {
+			key->sections[i].str = NULL;
+			key->sections[i].str_len = 0;
+		}
+		key->sections_len = 3;
+		return;
+	}
+
+	/* an empty string has no sections at all */
+	if (version[0] == '\0')
+		return;
+
+	/* any sections that do not fit are parsed when comparing */
+	while (tmp != NULL) {
+		if (key->sections_len == FU_VERSION_KEY_SECTIONS_MAX) {
+			key->tail = tmp;
+			break;
+		}
+		tmp = fu_common_version_key_parse_section (tmp, &key->sections[key->sections_len++]);
+	}
+}
+
+typedef struct {
+	const FuVersionKey	*key;
+	guint			 idx;
+	const gchar		*tail;
+} FuVersionKeyIter;
+
+static gboolean
+fu_common_version_key_iter_next (FuVersionKeyIter *iter, FuVersionKeySection *section)
+{
+	if (iter->idx < iter->key->sections_len) {
+		*section = iter->key->sections[iter->idx++];
+		return TRUE;
+	}
+	if (iter->tail == NULL)
+		return FALSE;
+	iter->tail = fu_common_version_key_parse_section (iter->tail, section);
+	return TRUE;
+}
+
+/**
+ * fu_common_version_key_cmp:
+ * @key_a: A #FuVersionKey, e.g. for 1.2.3
+ * @key_b: A #FuVersionKey, e.g. for 1.2.3.1
+ *
+ * Compares parsed version numbers for sorting.
  *
  * Returns: -1 if a < b, +1 if a > b, 0 if they are equal, and %G_MAXINT on error
  *
- * Since: 0.3.5
- */
+ * Since: 1.2.5
+ **/
 gint
-fu_common_vercmp (const gchar *version_a, const gchar *version_b)
+fu_common_version_key_cmp (const FuVersionKey *key_a, const FuVersionKey *key_b)
 {
-	guint longest_split;
-	g_autofree gchar *str_a = NULL;
-	g_autofree gchar *str_b = NULL;
-	g_auto(GStrv) split_a = NULL;
-	g_auto(GStrv) split_b = NULL;
+	FuVersionKeyIter iter_a = { key_a, 0, key_a->tail };
+	FuVersionKeyIter iter_b = { key_b, 0, key_b->tail };
 
 	/* sanity check */
-	if (version_a == NULL || version_b == NULL)
+	if (!key_a->valid || !key_b->valid)
 		return G_MAXINT;
 
-	/* optimisation */
-	if (g_strcmp0 (version_a, version_b) == 0)
-		return 0;
-
-	/* split into sections, and try to parse */
-	str_a = fu_common_version_parse (version_a);
-	str_b = fu_common_version_parse (version_b);
-	split_a = g_strsplit (str_a, ".", -1);
-	split_b = g_strsplit (str_b, ".", -1);
-	longest_split = MAX (g_strv_length (split_a), g_strv_length (split_b));
-	for (guint i = 0; i < longest_split; i++) {
-		gchar *endptr_a = NULL;
-		gchar *endptr_b = NULL;
-		gint64 ver_a;
-		gint64 ver_b;
+	for (;;) {
+		FuVersionKeySection section_a;
+		FuVersionKeySection section_b;
+		gboolean has_a = fu_common_version_key_iter_next (&iter_a, &section_a);
+		gboolean has_b = fu_common_version_key_iter_next (&iter_b, &section_b);
 
 		/* we lost or gained a dot */
-		if (split_a[i] == NULL)
+		if (!has_a && !has_b)
+			return 0;
+		if (!has_a)
 			return -1;
-		if (split_b[i] == NULL)
+		if (!has_b)
 			return 1;
 
 		/* compare integers */
-		ver_a = g_ascii_strtoll (split_a[i], &endptr_a, 10);
-		ver_b = g_ascii_strtoll (split_b[i], &endptr_b, 10);
-		if (ver_a < ver_b)
+		if (section_a.num < section_b.num)
 			return -1;
-		if (ver_a > ver_b)
+		if (section_a.num > section_b.num)
 			return 1;
 
 		/* compare strings */
-		if ((endptr_a != NULL && endptr_a[0] != '\0') ||
-		    (endptr_b != NULL && endptr_b[0] != '\0')) {
-			gint rc = fu_common_vercmp_chunk (endptr_a, endptr_b);
+		if (section_a.str_len > 0 || section_b.str_len > 0) {
+			gint rc = fu_common_vercmp_chunk (section_a.str, section_a.str_len,
+							  section_b.str, section_b.str_len);
 			if (rc < 0)
 				return -1;
 			if (rc > 0)
 				return 1;
 		}
 	}
+}
+
+/**
+ * fu_common_vercmp:
+ * @version_a: the release version, e.g. 1.2.3
+ * @version_b: the release version, e.g. 1.2.3.1
+ *
+ * Compares version numbers for sorting.
+ *
+ * When comparing the same version many times, e.g. when sorting, it is
+ * quicker to use fu_common_version_key_init() and fu_common_version_key_cmp().
+ *
+ * Returns: -1 if a < b, +1 if a > b, 0 if they are equal, and %G_MAXINT on error
+ *
+ * Since: 0.3.5
+ */
+gint
+fu_common_vercmp (const gchar *version_a, const gchar *version_b)
+{
+	FuVersionKey key_a;
+	FuVersionKey key_b;
+
+	/* sanity check */
+	if (version_a == NULL || version_b == NULL)
+		return G_MAXINT;
+
+	/* optimisation */
+	if (g_strcmp0 (version_a, version_b) == 0)
+		return 0;
 
-	/* we really shouldn't get here */
-	return 0;
+	fu_common_version_key_init (&key_a, version_a);
+	fu_common_version_key_init (&key_b, version_b);
+	return fu_common_version_key_cmp (&key_a, &key_b);
 }
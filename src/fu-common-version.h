@@ -35,11 +35,46 @@ typedef enum {
 	FU_VERSION_FORMAT_LAST
 } FuVersionFormat;
 
+#define FU_VERSION_KEY_SECTIONS_MAX	8
+
+/**
+ * FuVersionKeySection:
+ * @num:		The leading integer value of the section
+ * @str:		The text after the integer, *not* NUL terminated
+ * @str_len:		The length of @str
+ *
+ * One dot-separated section of a version number.
+ **/
+typedef struct {
+	gint64		 num;
+	const gchar	*str;
+	gsize		 str_len;
+} FuVersionKeySection;
+
+/**
+ * FuVersionKey:
+ *
+ * A version number that has been parsed so that it can be compared many times
+ * without allocating memory. The key refers to the version string, which has
+ * to remain valid for the lifetime of the key.
+ **/
+typedef struct {
+	/*< private >*/
+	FuVersionKeySection	 sections[FU_VERSION_KEY_SECTIONS_MAX];
+	guint			 sections_len;
+	const gchar		*tail;
+	gboolean		 valid;
+} FuVersionKey;
+
 FuVersionFormat  fu_common_version_format_from_string	(const gchar	*str);
 const gchar	*fu_common_version_format_to_string	(FuVersionFormat kind);
 
 gint		 fu_common_vercmp		(const gchar	*version_a,
 						 const gchar	*version_b);
+void		 fu_common_version_key_init	(FuVersionKey	*key,
+						 const gchar	*version);
+gint		 fu_common_version_key_cmp	(const FuVersionKey *key_a,
+						 const FuVersionKey *key_b);
 gchar		*fu_common_version_from_uint32	(guint32	 val,
 						 FuVersionFormat flags);
 gchar		*fu_common_version_from_uint16	(guint16	 val,
@@ -6,6 +6,9 @@
 
 #define G_LOG_DOMAIN				"FuCommon"
 
+/* for F_GET_SEALS */
+#define _GNU_SOURCE
+
 #include <config.h>
 
 #include <gio/gunixinputstream.h>
@@ -14,7 +17,9 @@
 #include <archive_entry.h>
 #include <archive.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "fwupd-error.h"
 
@@ -198,6 +203,53 @@ fu_common_get_contents_bytes (const gchar *filename, GError **error)
 	return g_bytes_new_take (data, len);
 }
 
+/* the contents of a memfd can only be mapped when the sender has sealed it,
+ * otherwise the data could change after it has been verified; the daemon
+ * never adds seals to a file descriptor it does not own -- returns %NULL
+ * without setting @error if not possible */
+static GBytes *
+fu_common_get_contents_fd_mapped (gint fd, gsize count, GError **error)
+{
+#ifdef HAVE_MEMFD_SEALS
+	const gint seals_required = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+	gint seals;
+	struct stat st;
+	g_autoptr(GMappedFile) mapped_file = NULL;
+
+	if (fstat (fd, &st) < 0 || !S_ISREG (st.st_mode) || st.st_size == 0)
+		return NULL;
+
+	/* not a memfd, or not sealed by the sender */
+	seals = fcntl (fd, F_GET_SEALS);
+	if (seals < 0)
+		return NULL;
+	if ((seals & seals_required) != seals_required) {
+		g_debug ("memfd is not sealed, seals 0x%x", (guint) seals);
+		return NULL;
+	}
+
+	/* the whole file is used, so do not truncate it like a stream */
+	if ((guint64) st.st_size > count) {
+		g_autofree gchar *sz_val = g_format_size (st.st_size);
+		g_autofree gchar *sz_max = g_format_size (count);
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INVALID_FILE,
+			     "file too large (%s, limit %s)",
+			     sz_val, sz_max);
+		return NULL;
+	}
+	mapped_file = g_mapped_file_new_from_fd (fd, FALSE, error);
+	if (mapped_file == NULL)
+		return NULL;
+	g_debug ("mapped sealed memfd with %" G_GSIZE_FORMAT " bytes",
+		 g_mapped_file_get_length (mapped_file));
+	return g_mapped_file_get_bytes (mapped_file);
+#else
+	return NULL;
+#endif
+}
+
 /**
  * fu_common_get_contents_fd:
  * @fd: A file descriptor
@@ -206,6 +258,10 @@ fu_common_get_contents_bytes (const gchar *filename, GError **error)
  *
  * Reads a blob from a specific file descriptor.
  *
+ * If the file descriptor is a memfd that has already been sealed against
+ * writing, shrinking and growing the data is mapped rather than copied into
+ * memory.
+ *
  * Note: this will close the fd when done
  *
  * Returns: (transfer full): a #GBytes, or %NULL
@@ -229,6 +285,17 @@ fu_common_get_contents_fd (gint fd, gsize count, GError **error)
 		return NULL;
 	}
 
+	/* the mapping stays valid after the fd is closed */
+	blob = fu_common_get_contents_fd_mapped (fd, count, &error_local);
+	if (blob != NULL || error_local != NULL) {
+		g_close (fd, NULL);
+		if (blob == NULL) {
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return NULL;
+		}
+		return g_steal_pointer (&blob);
+	}
+
 	/* read the entire fd to a data blob */
 	stream = g_unix_input_stream_new (fd, TRUE);
 	blob = g_input_stream_read_bytes (stream, count, NULL, &error_local);
@@ -1213,3 +1280,119 @@ fu_common_bytes_align (GBytes *bytes, gsize blksz, gchar padval)
 	/* perfectly aligned */
 	return g_bytes_ref (bytes);
 }
+
+#define FU_COMMON_CHECKSUM_BLOCK_SIZE		0x10000		/* bytes */
+#define FU_COMMON_CHECKSUM_THREAD_SIZE_MIN	0x100000	/* bytes */
+
+static guint32 fu_common_crc32_table[256];
+
+static void
+fu_common_crc32_init (void)
+{
+	static gsize initialized = 0;
+	if (!g_once_init_enter (&initialized))
+		return;
+	for (guint32 i = 0; i < 256; i++) {
+		guint32 crc = i;
+		for (guint j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ 0xedb88320 : crc >> 1;
+		fu_common_crc32_table[i] = crc;
+	}
+	g_once_init_leave (&initialized, 1);
+}
+
+static guint32
+fu_common_crc32_update (guint32 crc, const guint8 *buf, gsize bufsz)
+{
+	for (gsize i = 0; i < bufsz; i++)
+		crc = fu_common_crc32_table[(crc ^ buf[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+typedef struct {
+	GChecksum	*csum;
+	const guint8	*data;
+	gsize		 datasz;
+} FuCommonChecksumHelper;
+
+static gpointer
+fu_common_get_checksums_thread_cb (gpointer user_data)
+{
+	FuCommonChecksumHelper *helper = (FuCommonChecksumHelper *) user_data;
+	g_checksum_update (helper->csum, helper->data, helper->datasz);
+	return NULL;
+}
+
+/**
+ * fu_common_get_checksums:
+ * @blob: a #GBytes
+ * @flags: a #FuChecksumFlags, e.g. %FU_CHECKSUM_FLAG_SHA1
+ *
+ * Computes several digests of the same data, reading each block of @blob once
+ * for all the digests. For large payloads the SHA256 digest is computed on a
+ * worker thread at the same time.
+ *
+ * Returns: (transfer container) (element-type utf8): the digests as lowercase
+ * hex strings in the order SHA1, SHA256, then CRC32
+ *
+ * Since: 1.2.5
+ **/
+GPtrArray *
+fu_common_get_checksums (GBytes *blob, FuChecksumFlags flags)
+{
+	FuCommonChecksumHelper helper = { NULL };
+	GPtrArray *checksums = g_ptr_array_new_with_free_func (g_free);
+	const guint8 *data;
+	gsize datasz = 0;
+	guint32 crc = 0xffffffff;
+	g_autoptr(GChecksum) csum_sha1 = NULL;
+	g_autoptr(GChecksum) csum_sha256 = NULL;
+	g_autoptr(GThread) thread = NULL;
+
+	g_return_val_if_fail (blob != NULL, NULL);
+
+	data = g_bytes_get_data (blob, &datasz);
+	if (flags & FU_CHECKSUM_FLAG_SHA1)
+		csum_sha1 = g_checksum_new (G_CHECKSUM_SHA1);
+	if (flags & FU_CHECKSUM_FLAG_SHA256)
+		csum_sha256 = g_checksum_new (G_CHECKSUM_SHA256);
+	if (flags & FU_CHECKSUM_FLAG_CRC32)
+		fu_common_crc32_init ();
+
+	/* SHA256 is the slowest, so do it in parallel with the others */
+	if (csum_sha256 != NULL &&
+	    (flags & ~FU_CHECKSUM_FLAG_SHA256) != 0 &&
+	    datasz >= FU_COMMON_CHECKSUM_THREAD_SIZE_MIN) {
+		g_autoptr(GError) error_local = NULL;
+		helper.csum = csum_sha256;
+		helper.data = data;
+		helper.datasz = datasz;
+		thread = g_thread_try_new ("fu-checksum",
+					   fu_common_get_checksums_thread_cb,
+					   &helper, &error_local);
+		if (thread == NULL)
+			g_debug ("failed to create thread: %s", error_local->message);
+	}
+
+	/* keep each block in the cache for every digest */
+	for (gsize i = 0; i < datasz; i += FU_COMMON_CHECKSUM_BLOCK_SIZE) {
+		gsize blksz = MIN (datasz - i, FU_COMMON_CHECKSUM_BLOCK_SIZE);
+		if (csum_sha1 != NULL)
+			g_checksum_update (csum_sha1, data + i, blksz);
+		if (csum_sha256 != NULL && thread == NULL)
+			g_checksum_update (csum_sha256, data + i, blksz);
+		if (flags & FU_CHECKSUM_FLAG_CRC32)
+			crc = fu_common_crc32_update (crc, data + i, blksz);
+	}
+	if (thread != NULL)
+		g_thread_join (g_steal_pointer (&thread));
+
+	/* results */
+	if (csum_sha1 != NULL)
+		g_ptr_array_add (checksums, g_strdup (g_checksum_get_string (csum_sha1)));
+	if (csum_sha256 != NULL)
+		g_ptr_array_add (checksums, g_strdup (g_checksum_get_string (csum_sha256)));
+	if (flags & FU_CHECKSUM_FLAG_CRC32)
+		g_ptr_array_add (checksums, g_strdup_printf ("%08x", crc ^ 0xffffffff));
+	return checksums;
+}
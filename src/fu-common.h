@@ -22,6 +22,13 @@ typedef enum {
 	FU_DUMP_FLAGS_LAST
 } FuDumpFlags;
 
+typedef enum {
+	FU_CHECKSUM_FLAG_NONE		= 0,
+	FU_CHECKSUM_FLAG_SHA1		= 1 << 0,
+	FU_CHECKSUM_FLAG_SHA256		= 1 << 1,
+	FU_CHECKSUM_FLAG_CRC32		= 1 << 2,
+} FuChecksumFlags;
+
 typedef enum {
 	FU_PATH_KIND_CACHEDIR_PKG,
 	FU_PATH_KIND_DATADIR_PKG,
@@ -89,6 +96,8 @@ void		 fu_common_dump_bytes		(const gchar	*log_domain,
 GBytes		*fu_common_bytes_align		(GBytes		*bytes,
 						 gsize		 blksz,
 						 gchar		 padval);
+GPtrArray	*fu_common_get_checksums	(GBytes		*blob,
+						 FuChecksumFlags flags);
 
 typedef guint FuEndianType;
 
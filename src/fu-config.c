@@ -31,7 +31,11 @@ struct _FuConfig
 	GPtrArray		*blacklist_devices;
 	GPtrArray		*blacklist_plugins;
 	guint64			 archive_size_max;
+	guint64			 archive_cache_size_max;
 	guint			 idle_timeout;
+	guint			 coldplug_threads;
+	guint			 install_threads;
+	guint			 history_retention_days;
 	XbSilo			*silo;
 	GHashTable		*os_release;
 };
@@ -354,7 +358,11 @@ fu_config_load_from_file (FuConfig *self, const gchar *config_file,
 {
 	GFileMonitor *monitor;
 	guint64 archive_size_max;
+	guint64 archive_cache_size_max;
 	guint idle_timeout;
+	guint coldplug_threads;
+	guint install_threads;
+	guint history_retention_days;
 	g_auto(GStrv) devices = NULL;
 	g_auto(GStrv) plugins = NULL;
 	g_autoptr(GFile) file = NULL;
@@ -413,6 +421,14 @@ fu_config_load_from_file (FuConfig *self, const gchar *config_file,
 	if (archive_size_max > 0)
 		self->archive_size_max = archive_size_max *= 0x100000;
 
+	/* get memory used for parsed archives, defaulting to something sane */
+	archive_cache_size_max = g_key_file_get_uint64 (self->keyfile,
+							"fwupd",
+							"ArchiveCacheSizeMax",
+							NULL);
+	if (archive_cache_size_max > 0)
+		self->archive_cache_size_max = archive_cache_size_max * 0x100000;
+
 	/* get idle timeout */
 	idle_timeout = g_key_file_get_uint64 (self->keyfile,
 					      "fwupd",
@@ -420,6 +436,27 @@ fu_config_load_from_file (FuConfig *self, const gchar *config_file,
 					      NULL);
 	if (idle_timeout > 0)
 		self->idle_timeout = idle_timeout;
+
+	/* get number of threads to use for coldplug */
+	coldplug_threads = g_key_file_get_uint64 (self->keyfile,
+						  "fwupd",
+						  "ColdplugThreads",
+						  NULL);
+	self->coldplug_threads = coldplug_threads;
+
+	/* get number of threads to use for installing independent devices */
+	install_threads = g_key_file_get_uint64 (self->keyfile,
+						 "fwupd",
+						 "InstallThreads",
+						 NULL);
+	self->install_threads = install_threads;
+
+	/* get how long to keep successful updates */
+	history_retention_days = g_key_file_get_uint64 (self->keyfile,
+							"fwupd",
+							"HistoryRetentionDays",
+							NULL);
+	self->history_retention_days = history_retention_days;
 	return TRUE;
 }
 
@@ -523,6 +560,27 @@ fu_config_get_idle_timeout (FuConfig *self)
 	return self->idle_timeout;
 }
 
+guint
+fu_config_get_coldplug_threads (FuConfig *self)
+{
+	g_return_val_if_fail (FU_IS_CONFIG (self), 0);
+	return self->coldplug_threads;
+}
+
+guint
+fu_config_get_install_threads (FuConfig *self)
+{
+	g_return_val_if_fail (FU_IS_CONFIG (self), 0);
+	return self->install_threads;
+}
+
+guint
+fu_config_get_history_retention_days (FuConfig *self)
+{
+	g_return_val_if_fail (FU_IS_CONFIG (self), 0);
+	return self->history_retention_days;
+}
+
 FwupdRemote *
 fu_config_get_remote_by_id (FuConfig *self, const gchar *remote_id)
 {
@@ -544,6 +602,13 @@ fu_config_get_archive_size_max (FuConfig *self)
 	return self->archive_size_max;
 }
 
+guint64
+fu_config_get_archive_cache_size_max (FuConfig *self)
+{
+	g_return_val_if_fail (FU_IS_CONFIG (self), 0);
+	return self->archive_cache_size_max;
+}
+
 GPtrArray *
 fu_config_get_blacklist_plugins (FuConfig *self)
 {
@@ -562,6 +627,7 @@ static void
 fu_config_init (FuConfig *self)
 {
 	self->archive_size_max = 512 * 0x100000;
+	self->archive_cache_size_max = 128 * 0x100000;
 	self->keyfile = g_key_file_new ();
 	self->blacklist_devices = g_ptr_array_new_with_free_func (g_free);
 	self->blacklist_plugins = g_ptr_array_new_with_free_func (g_free);
@@ -21,7 +21,11 @@ gboolean	 fu_config_load				(FuConfig	*self,
 							 GError		**error);
 
 guint64		 fu_config_get_archive_size_max		(FuConfig	*self);
+guint64		 fu_config_get_archive_cache_size_max	(FuConfig	*self);
 guint		 fu_config_get_idle_timeout		(FuConfig	*self);
+guint		 fu_config_get_coldplug_threads		(FuConfig	*self);
+guint		 fu_config_get_install_threads		(FuConfig	*self);
+guint		 fu_config_get_history_retention_days	(FuConfig	*self);
 GPtrArray	*fu_config_get_blacklist_devices	(FuConfig	*self);
 GPtrArray	*fu_config_get_blacklist_plugins	(FuConfig	*self);
 GPtrArray	*fu_config_get_remotes			(FuConfig	*self);
@@ -11,6 +11,7 @@
 #include <glib-object.h>
 #include <string.h>
 
+#include "fu-common-guid.h"
 #include "fu-device-list.h"
 #include "fu-device-private.h"
 #include "fu-mutex.h"
@@ -24,6 +25,10 @@
  * This list of devices provides a way to find a device using either the
  * device-id or a GUID.
  *
+ * The GUIDs, physical IDs and device IDs of each device are indexed when the
+ * device is added to the list, or replaced by a compatible device, and so
+ * these should all be set before calling fu_device_list_add().
+ *
  * The device list will emit ::added and ::removed signals when the device list
  * has been changed. If the #FuDevice has changed during a device replug then
  * the ::changed signal will be emitted instead of ::added and then ::removed.
@@ -37,7 +42,14 @@ struct _FuDeviceList
 {
 	GObject			 parent_instance;
 	GPtrArray		*devices;	/* of FuDeviceItem */
+	GHashTable		*guids;		/* of guid:FuDeviceItem[] */
+	GHashTable		*physical_ids;	/* of physical_id:FuDeviceItem[] */
+	GPtrArray		*ids;		/* of FuDeviceListId, sorted by id */
+	guint			 next_order;
 	FuMutex			*devices_mutex;
+	GThread			*main_thread;
+	GMutex			 replug_mutex;	/* for replug_cond */
+	GCond			 replug_cond;	/* device replaced */
 };
 
 enum {
@@ -56,8 +68,18 @@ typedef struct {
 	GMainLoop		*replug_loop;	/* block waiting for replug */
 	guint			 replug_id;	/* timeout the loop */
 	guint			 remove_id;
+	guint			 order;		/* position in the list */
+	GPtrArray		*index_guids;
+	GPtrArray		*index_physical_ids;
+	GPtrArray		*index_ids;
 } FuDeviceItem;
 
+typedef struct {
+	gchar			*id;
+	FuDeviceItem		*item;		/* no ref */
+	gboolean		 is_old;
+} FuDeviceListId;
+
 G_DEFINE_TYPE (FuDeviceList, fu_device_list, G_TYPE_OBJECT)
 
 static void
@@ -81,6 +103,158 @@ fu_device_list_emit_device_changed (FuDeviceList *self, FuDevice *device)
 	g_signal_emit (self, signals[SIGNAL_CHANGED], 0, device);
 }
 
+static void
+fu_device_list_id_free (FuDeviceListId *id)
+{
+	g_free (id->id);
+	g_free (id);
+}
+
+/* returns the index of the first ID that is not less than @id */
+static guint
+fu_device_list_ids_lower_bound (FuDeviceList *self, const gchar *id)
+{
+	guint lo = 0;
+	guint hi = self->ids->len;
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+		FuDeviceListId *tmp = g_ptr_array_index (self->ids, mid);
+		if (g_strcmp0 (tmp->id, id) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+static void
+fu_device_list_index_add (GHashTable *index, const gchar *key, FuDeviceItem *item)
+{
+	GPtrArray *items = g_hash_table_lookup (index, key);
+	if (items == NULL) {
+		items = g_ptr_array_new ();
+		g_hash_table_insert (index, g_strdup (key), items);
+	}
+	for (guint i = 0; i < items->len; i++) {
+		if (g_ptr_array_index (items, i) == item)
+			return;
+	}
+	g_ptr_array_add (items, item);
+}
+
+static void
+fu_device_list_index_remove (GHashTable *index, const gchar *key, FuDeviceItem *item)
+{
+	GPtrArray *items = g_hash_table_lookup (index, key);
+	if (items == NULL)
+		return;
+	g_ptr_array_remove (items, item);
+	if (items->len == 0)
+		g_hash_table_remove (index, key);
+}
+
+/* must be called with the write lock held */
+static void
+fu_device_list_item_unindex (FuDeviceList *self, FuDeviceItem *item)
+{
+	for (guint i = 0; i < item->index_guids->len; i++) {
+		const gchar *guid = g_ptr_array_index (item->index_guids, i);
+		fu_device_list_index_remove (self->guids, guid, item);
+	}
+	g_ptr_array_set_size (item->index_guids, 0);
+	for (guint i = 0; i < item->index_physical_ids->len; i++) {
+		const gchar *physical_id = g_ptr_array_index (item->index_physical_ids, i);
+		fu_device_list_index_remove (self->physical_ids, physical_id, item);
+	}
+	g_ptr_array_set_size (item->index_physical_ids, 0);
+
+	for (guint i = 0; i < item->index_ids->len; i++) {
+		const gchar *id_str = g_ptr_array_index (item->index_ids, i);
+		for (guint k = fu_device_list_ids_lower_bound (self, id_str);
+		     k < self->ids->len; k++) {
+			FuDeviceListId *id = g_ptr_array_index (self->ids, k);
+			if (g_strcmp0 (id->id, id_str) != 0)
+				break;
+			if (id->item == item) {
+				g_ptr_array_remove_index (self->ids, k);
+				break;
+			}
+		}
+	}
+	g_ptr_array_set_size (item->index_ids, 0);
+}
+
+static void
+fu_device_list_item_index_device (FuDeviceList *self,
+				  FuDeviceItem *item,
+				  FuDevice *device,
+				  gboolean is_old)
+{
+	GPtrArray *guids = fu_device_get_guids (device);
+	const gchar *physical_id = fu_device_get_physical_id (device);
+	const gchar *ids[] = {
+		fu_device_get_id (device),
+		fu_device_get_equivalent_id (device),
+		NULL };
+
+	for (guint i = 0; i < guids->len; i++) {
+		const gchar *guid = g_ptr_array_index (guids, i);
+		fu_device_list_index_add (self->guids, guid, item);
+		g_ptr_array_add (item->index_guids, g_strdup (guid));
+	}
+	if (physical_id != NULL) {
+		fu_device_list_index_add (self->physical_ids, physical_id, item);
+		g_ptr_array_add (item->index_physical_ids, g_strdup (physical_id));
+	}
+	for (guint i = 0; ids[i] != NULL; i++) {
+		FuDeviceListId *id = g_new0 (FuDeviceListId, 1);
+		id->id = g_strdup (ids[i]);
+		id->item = item;
+		id->is_old = is_old;
+		g_ptr_array_insert (self->ids,
+				    fu_device_list_ids_lower_bound (self, ids[i]),
+				    id);
+		g_ptr_array_add (item->index_ids, g_strdup (ids[i]));
+	}
+}
+
+/* must be called with the write lock held */
+static void
+fu_device_list_item_index (FuDeviceList *self, FuDeviceItem *item)
+{
+	fu_device_list_item_unindex (self, item);
+	fu_device_list_item_index_device (self, item, item->device, FALSE);
+	if (item->device_old != NULL)
+		fu_device_list_item_index_device (self, item, item->device_old, TRUE);
+}
+
+/* the indexes are rebuilt if a plugin changes the device after it was added */
+static void
+fu_device_list_device_notify_cb (FuDevice *device, GParamSpec *pspec, gpointer user_data)
+{
+	FuDeviceItem *item = (FuDeviceItem *) user_data;
+	FuDeviceList *self = FU_DEVICE_LIST (item->self);
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->devices_mutex);
+	g_return_if_fail (locker != NULL);
+	fu_device_list_item_index (self, item);
+}
+
+static void
+fu_device_list_item_watch_device (FuDeviceItem *item, FuDevice *device)
+{
+	const gchar *signals_notify[] = {
+		"notify::id",
+		"notify::equivalent-id",
+		"notify::guids",
+		"notify::physical-id",
+		NULL };
+	for (guint i = 0; signals_notify[i] != NULL; i++) {
+		g_signal_connect (device, signals_notify[i],
+				  G_CALLBACK (fu_device_list_device_notify_cb),
+				  item);
+	}
+}
+
 /**
  * fu_device_list_get_all:
  * @self: A #FuDeviceList
@@ -160,24 +334,68 @@ fu_device_list_find_by_device (FuDeviceList *self, FuDevice *device)
 	return NULL;
 }
 
+/* the first matching item in the list wins, preferring active devices;
+ * must be called with the read lock held */
+static FuDeviceItem *
+fu_device_list_find_by_guids_unlocked (FuDeviceList *self, const gchar **guids)
+{
+	FuDeviceItem *item_old = NULL;
+	FuDeviceItem *item = NULL;
+
+	for (guint j = 0; guids[j] != NULL; j++) {
+		FuDeviceGuid guid_raw;
+		GPtrArray *items;
+		const gchar *guid = guids[j];
+		gboolean has_raw;
+		g_autofree gchar *tmp = NULL;
+
+		/* the device only stores valid GUIDs */
+		if (!fu_common_guid_is_valid (guid)) {
+			tmp = fu_common_guid_from_string (guid);
+			guid = tmp;
+		}
+		items = g_hash_table_lookup (self->guids, guid);
+		if (items == NULL)
+			continue;
+
+		/* only parse the GUID once for all the candidates */
+		has_raw = fu_device_guid_from_string (guid, &guid_raw);
+		for (guint i = 0; i < items->len; i++) {
+			FuDeviceItem *item_tmp = g_ptr_array_index (items, i);
+			if (has_raw ? fu_device_has_guid_raw (item_tmp->device, &guid_raw) :
+				      fu_device_has_guid (item_tmp->device, guid)) {
+				if (item == NULL || item_tmp->order < item->order)
+					item = item_tmp;
+				continue;
+			}
+			if (item_tmp->device_old != NULL &&
+			    (has_raw ? fu_device_has_guid_raw (item_tmp->device_old, &guid_raw) :
+				       fu_device_has_guid (item_tmp->device_old, guid))) {
+				if (item_old == NULL || item_tmp->order < item_old->order)
+					item_old = item_tmp;
+			}
+		}
+	}
+	return item != NULL ? item : item_old;
+}
+
 static FuDeviceItem *
 fu_device_list_find_by_guid (FuDeviceList *self, const gchar *guid)
 {
+	const gchar *guids[] = { guid, NULL };
 	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->devices_mutex);
 	g_return_val_if_fail (locker != NULL, NULL);
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
-		if (fu_device_has_guid (item->device, guid))
-			return item;
-	}
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
-		if (item->device_old == NULL)
-			continue;
-		if (fu_device_has_guid (item->device_old, guid))
-			return item;
-	}
-	return NULL;
+	return fu_device_list_find_by_guids_unlocked (self, guids);
+}
+
+static gboolean
+fu_device_list_device_has_connection (FuDevice *device,
+				      const gchar *physical_id,
+				      const gchar *logical_id)
+{
+	return device != NULL &&
+		g_strcmp0 (fu_device_get_physical_id (device), physical_id) == 0 &&
+		g_strcmp0 (fu_device_get_logical_id (device), logical_id) == 0;
 }
 
 static FuDeviceItem *
@@ -185,28 +403,34 @@ fu_device_list_find_by_connection (FuDeviceList *self,
 				   const gchar *physical_id,
 				   const gchar *logical_id)
 {
+	FuDeviceItem *item_old = NULL;
+	FuDeviceItem *item = NULL;
+	GPtrArray *items;
 	g_autoptr(FuMutexLocker) locker = NULL;
 	if (physical_id == NULL)
 		return NULL;
 	locker = fu_mutex_read_locker_new (self->devices_mutex);
 	g_return_val_if_fail (locker != NULL, NULL);
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item_tmp = g_ptr_array_index (self->devices, i);
-		FuDevice *device = item_tmp->device;
-		if (device != NULL &&
-		    g_strcmp0 (fu_device_get_physical_id (device), physical_id) == 0 &&
-		    g_strcmp0 (fu_device_get_logical_id (device), logical_id) == 0)
-			return item_tmp;
-	}
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item_tmp = g_ptr_array_index (self->devices, i);
-		FuDevice *device = item_tmp->device_old;
-		if (device != NULL &&
-		    g_strcmp0 (fu_device_get_physical_id (device), physical_id) == 0 &&
-		    g_strcmp0 (fu_device_get_logical_id (device), logical_id) == 0)
-			return item_tmp;
+	items = g_hash_table_lookup (self->physical_ids, physical_id);
+	if (items == NULL)
+		return NULL;
+	for (guint i = 0; i < items->len; i++) {
+		FuDeviceItem *item_tmp = g_ptr_array_index (items, i);
+		if (fu_device_list_device_has_connection (item_tmp->device,
+							  physical_id,
+							  logical_id)) {
+			if (item == NULL || item_tmp->order < item->order)
+				item = item_tmp;
+			continue;
+		}
+		if (fu_device_list_device_has_connection (item_tmp->device_old,
+							  physical_id,
+							  logical_id)) {
+			if (item_old == NULL || item_tmp->order < item_old->order)
+				item_old = item_tmp;
+		}
 	}
-	return NULL;
+	return item != NULL ? item : item_old;
 }
 
 static FuDeviceItem *
@@ -215,7 +439,11 @@ fu_device_list_find_by_id (FuDeviceList *self,
 			   gboolean *multiple_matches)
 {
 	FuDeviceItem *item = NULL;
+	FuDeviceItem *item_old = NULL;
 	gsize device_id_len;
+	guint matches = 0;
+	guint matches_old = 0;
+	g_autoptr(FuMutexLocker) locker = NULL;
 
 	/* sanity check */
 	if (device_id == NULL) {
@@ -223,45 +451,33 @@ fu_device_list_find_by_id (FuDeviceList *self,
 		return NULL;
 	}
 
-	/* support abbreviated hashes */
+	/* support abbreviated hashes, which are all sorted together */
 	device_id_len = strlen (device_id);
-	fu_mutex_read_lock (self->devices_mutex);
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item_tmp = g_ptr_array_index (self->devices, i);
-		const gchar *ids[] = {
-			fu_device_get_id (item_tmp->device),
-			fu_device_get_equivalent_id (item_tmp->device),
-			NULL };
-		for (guint j = 0; ids[j] != NULL; j++) {
-			if (strncmp (ids[j], device_id, device_id_len) == 0) {
-				if (item != NULL && multiple_matches != NULL)
-					*multiple_matches = TRUE;
-				item = item_tmp;
-			}
+	locker = fu_mutex_read_locker_new (self->devices_mutex);
+	g_return_val_if_fail (locker != NULL, NULL);
+	for (guint i = fu_device_list_ids_lower_bound (self, device_id);
+	     i < self->ids->len; i++) {
+		FuDeviceListId *id = g_ptr_array_index (self->ids, i);
+		if (strncmp (id->id, device_id, device_id_len) != 0)
+			break;
+		if (id->is_old) {
+			if (item_old == NULL || id->item->order > item_old->order)
+				item_old = id->item;
+			matches_old++;
+		} else {
+			if (item == NULL || id->item->order > item->order)
+				item = id->item;
+			matches++;
 		}
 	}
-	fu_mutex_read_unlock (self->devices_mutex);
-	if (item != NULL)
-		return item;
 
-	/* only search old devices if we didn't find the active device */
-	fu_mutex_read_lock (self->devices_mutex);
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item_tmp = g_ptr_array_index (self->devices, i);
-		const gchar *ids[3] = { NULL };
-		if (item_tmp->device_old == NULL)
-			continue;
-		ids[0] = fu_device_get_id (item_tmp->device_old);
-		ids[1] = fu_device_get_equivalent_id (item_tmp->device_old);
-		for (guint j = 0; ids[j] != NULL; j++) {
-			if (strncmp (ids[j], device_id, device_id_len) == 0) {
-				if (item != NULL && multiple_matches != NULL)
-					*multiple_matches = TRUE;
-				item = item_tmp;
-			}
-		}
+	/* only use old devices if we didn't find the active device */
+	if (item == NULL) {
+		item = item_old;
+		matches = matches_old;
 	}
-	fu_mutex_read_unlock (self->devices_mutex);
+	if (matches > 1 && multiple_matches != NULL)
+		*multiple_matches = TRUE;
 	return item;
 }
 
@@ -290,27 +506,21 @@ fu_device_list_get_old (FuDeviceList *self, FuDevice *device)
 static FuDeviceItem *
 fu_device_list_get_by_guids (FuDeviceList *self, GPtrArray *guids)
 {
+	g_autofree const gchar **guidv = g_new0 (const gchar *, guids->len + 1);
 	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->devices_mutex);
 	g_return_val_if_fail (locker != NULL, NULL);
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
-		for (guint j = 0; j < guids->len; j++) {
-			const gchar *guid = g_ptr_array_index (guids, j);
-			if (fu_device_has_guid (item->device, guid))
-				return item;
-		}
-	}
-	for (guint i = 0; i < self->devices->len; i++) {
-		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
-		if (item->device_old == NULL)
-			continue;
-		for (guint j = 0; j < guids->len; j++) {
-			const gchar *guid = g_ptr_array_index (guids, j);
-			if (fu_device_has_guid (item->device_old, guid))
-				return item;
-		}
-	}
-	return NULL;
+	for (guint i = 0; i < guids->len; i++)
+		guidv[i] = g_ptr_array_index (guids, i);
+	return fu_device_list_find_by_guids_unlocked (self, guidv);
+}
+
+static void
+fu_device_list_remove_item (FuDeviceList *self, FuDeviceItem *item)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->devices_mutex);
+	g_return_if_fail (locker != NULL);
+	fu_device_list_item_unindex (self, item);
+	g_ptr_array_remove (self->devices, item);
 }
 
 static gboolean
@@ -325,9 +535,7 @@ fu_device_list_device_delayed_remove_cb (gpointer user_data)
 	/* just remove now */
 	g_debug ("doing delayed removal");
 	fu_device_list_emit_device_removed (self, item->device);
-	fu_mutex_write_lock (self->devices_mutex);
-	g_ptr_array_remove (self->devices, item);
-	fu_mutex_write_unlock (self->devices_mutex);
+	fu_device_list_remove_item (self, item);
 	return G_SOURCE_REMOVE;
 }
 
@@ -401,9 +609,7 @@ fu_device_list_remove (FuDeviceList *self, FuDevice *device)
 			continue;
 		}
 		fu_device_list_emit_device_removed (self, child);
-		fu_mutex_write_lock (self->devices_mutex);
-		g_ptr_array_remove (self->devices, child_item);
-		fu_mutex_write_unlock (self->devices_mutex);
+		fu_device_list_remove_item (self, child_item);
 	}
 
 	/* delay the removal and check for replug */
@@ -414,9 +620,7 @@ fu_device_list_remove (FuDeviceList *self, FuDevice *device)
 
 	/* remove right now */
 	fu_device_list_emit_device_removed (self, item->device);
-	fu_mutex_write_lock (self->devices_mutex);
-	g_ptr_array_remove (self->devices, item);
-	fu_mutex_write_unlock (self->devices_mutex);
+	fu_device_list_remove_item (self, item);
 }
 
 static void
@@ -477,8 +681,14 @@ fu_device_list_replace (FuDeviceList *self, FuDeviceItem *item, FuDevice *device
 	}
 
 	/* assign the new device */
+	fu_mutex_write_lock (self->devices_mutex);
+	if (item->device_old != NULL)
+		g_signal_handlers_disconnect_by_data (item->device_old, item);
 	g_set_object (&item->device_old, item->device);
 	g_set_object (&item->device, device);
+	fu_device_list_item_index (self, item);
+	fu_mutex_write_unlock (self->devices_mutex);
+	fu_device_list_item_watch_device (item, device);
 	fu_device_list_emit_device_changed (self, device);
 
 	/* we were waiting for this... */
@@ -486,6 +696,11 @@ fu_device_list_replace (FuDeviceList *self, FuDeviceItem *item, FuDevice *device
 		g_debug ("quitting replug loop");
 		g_main_loop_quit (item->replug_loop);
 	}
+
+	/* ...possibly from a worker thread */
+	g_mutex_lock (&self->replug_mutex);
+	g_cond_broadcast (&self->replug_cond);
+	g_mutex_unlock (&self->replug_mutex);
 }
 
 /**
@@ -587,9 +802,15 @@ fu_device_list_add (FuDeviceList *self, FuDevice *device)
 	item->self = self; /* no ref */
 	item->device = g_object_ref (device);
 	item->replug_loop = g_main_loop_new (NULL, FALSE);
+	item->index_guids = g_ptr_array_new_with_free_func (g_free);
+	item->index_physical_ids = g_ptr_array_new_with_free_func (g_free);
+	item->index_ids = g_ptr_array_new_with_free_func (g_free);
 	fu_mutex_write_lock (self->devices_mutex);
+	item->order = self->next_order++;
 	g_ptr_array_add (self->devices, item);
+	fu_device_list_item_index (self, item);
 	fu_mutex_write_unlock (self->devices_mutex);
+	fu_device_list_item_watch_device (item, device);
 	fu_device_list_emit_device_added (self, device);
 }
 
@@ -637,6 +858,71 @@ fu_device_list_replug_cb (gpointer user_data)
 	return FALSE;
 }
 
+/* the item may be replaced or freed by the main thread at any time, so only
+ * the device pointers are compared, and only with the lock held */
+static gboolean
+fu_device_list_has_replaced_device (FuDeviceList *self, FuDevice *device)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->devices_mutex);
+	g_return_val_if_fail (locker != NULL, FALSE);
+	for (guint i = 0; i < self->devices->len; i++) {
+		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
+		if (item->device_old == device && item->device != device)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* gets a reference to the device that is currently in the list in place of
+ * @device, which may be @device itself */
+static FuDevice *
+fu_device_list_get_current_device (FuDeviceList *self, FuDevice *device)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->devices_mutex);
+	g_return_val_if_fail (locker != NULL, NULL);
+	for (guint i = 0; i < self->devices->len; i++) {
+		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
+		if (item->device == device)
+			return g_object_ref (item->device);
+	}
+	for (guint i = 0; i < self->devices->len; i++) {
+		FuDeviceItem *item = g_ptr_array_index (self->devices, i);
+		if (item->device_old == device)
+			return g_object_ref (item->device);
+	}
+	return NULL;
+}
+
+static gboolean
+fu_device_list_wait_for_replug_thread (FuDeviceList *self,
+				       FuDevice *device,
+				       guint remove_delay,
+				       GError **error)
+{
+	gint64 end_time = g_get_monotonic_time () + remove_delay * G_TIME_SPAN_MILLISECOND;
+
+	/* the device is replaced in the main thread */
+	g_mutex_lock (&self->replug_mutex);
+	while (!fu_device_list_has_replaced_device (self, device)) {
+		if (!g_cond_wait_until (&self->replug_cond, &self->replug_mutex, end_time))
+			break;
+	}
+	g_mutex_unlock (&self->replug_mutex);
+	if (fu_device_list_has_replaced_device (self, device)) {
+		g_debug ("waited for replug");
+		return TRUE;
+	}
+
+	/* device was not added back to the device list */
+	g_debug ("device did not replug");
+	g_set_error (error,
+		     FWUPD_ERROR,
+		     FWUPD_ERROR_NOT_FOUND,
+		     "device %s did not come back",
+		     fu_device_get_id (device));
+	return FALSE;
+}
+
 /**
  * fu_device_list_wait_for_replug:
  * @self: A #FuDeviceList
@@ -657,18 +943,19 @@ fu_device_list_wait_for_replug (FuDeviceList *self, FuDevice *device, GError **e
 {
 	FuDeviceItem *item;
 	guint remove_delay;
+	g_autoptr(FuDevice) device_current = NULL;
 
 	g_return_val_if_fail (FU_IS_DEVICE_LIST (self), FALSE);
 	g_return_val_if_fail (FU_IS_DEVICE (device), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
 	/* not found */
-	item = fu_device_list_find_by_device (self, device);
-	if (item == NULL)
+	device_current = fu_device_list_get_current_device (self, device);
+	if (device_current == NULL)
 		return TRUE;
 
 	/* not required, or possibly literally just happened */
-	if (!fu_device_has_flag (item->device, FWUPD_DEVICE_FLAG_WAIT_FOR_REPLUG)) {
+	if (!fu_device_has_flag (device_current, FWUPD_DEVICE_FLAG_WAIT_FOR_REPLUG)) {
 		g_debug ("no replug or re-enumerate required");
 		return TRUE;
 	}
@@ -686,7 +973,14 @@ fu_device_list_wait_for_replug (FuDeviceList *self, FuDevice *device, GError **e
 		g_debug ("waiting %ums for replug", remove_delay);
 	}
 
+	/* the hotplug events are being handled by the main thread */
+	if (g_thread_self () != self->main_thread)
+		return fu_device_list_wait_for_replug_thread (self, device, remove_delay, error);
+
 	/* time to unplug and then re-plug */
+	item = fu_device_list_find_by_device (self, device);
+	if (item == NULL)
+		return TRUE;
 	item->replug_id = g_timeout_add (remove_delay, fu_device_list_replug_cb, item);
 	g_main_loop_run (item->replug_loop);
 
@@ -762,9 +1056,15 @@ fu_device_list_item_free (FuDeviceItem *item)
 		g_source_remove (item->remove_id);
 	if (item->replug_id != 0)
 		g_source_remove (item->replug_id);
-	if (item->device_old != NULL)
+	if (item->device_old != NULL) {
+		g_signal_handlers_disconnect_by_data (item->device_old, item);
 		g_object_unref (item->device_old);
+	}
+	g_signal_handlers_disconnect_by_data (item->device, item);
 	g_main_loop_unref (item->replug_loop);
+	g_ptr_array_unref (item->index_guids);
+	g_ptr_array_unref (item->index_physical_ids);
+	g_ptr_array_unref (item->index_ids);
 	g_object_unref (item->device);
 	g_free (item);
 }
@@ -796,7 +1096,15 @@ static void
 fu_device_list_init (FuDeviceList *self)
 {
 	self->devices = g_ptr_array_new_with_free_func ((GDestroyNotify) fu_device_list_item_free);
+	self->guids = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     g_free, (GDestroyNotify) g_ptr_array_unref);
+	self->physical_ids = g_hash_table_new_full (g_str_hash, g_str_equal,
+						    g_free, (GDestroyNotify) g_ptr_array_unref);
+	self->ids = g_ptr_array_new_with_free_func ((GDestroyNotify) fu_device_list_id_free);
 	self->devices_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "devices");
+	self->main_thread = g_thread_self ();
+	g_mutex_init (&self->replug_mutex);
+	g_cond_init (&self->replug_cond);
 }
 
 static void
@@ -805,7 +1113,12 @@ fu_device_list_finalize (GObject *obj)
 	FuDeviceList *self = FU_DEVICE_LIST (obj);
 
 	g_ptr_array_unref (self->devices);
+	g_hash_table_unref (self->guids);
+	g_hash_table_unref (self->physical_ids);
+	g_ptr_array_unref (self->ids);
 	g_object_unref (self->devices_mutex);
+	g_mutex_clear (&self->replug_mutex);
+	g_cond_clear (&self->replug_cond);
 
 	G_OBJECT_CLASS (fu_device_list_parent_class)->finalize (obj);
 }
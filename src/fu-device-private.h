@@ -11,6 +11,8 @@
 
 G_BEGIN_DECLS
 
+typedef guint8 FuDeviceGuid[16];
+
 GPtrArray	*fu_device_get_parent_guids		(FuDevice	*self);
 gboolean	 fu_device_has_parent_guid		(FuDevice	*self,
 							 const gchar	*guid);
@@ -26,6 +28,10 @@ void		 fu_device_set_alternate		(FuDevice	*self,
 							 FuDevice	*alternate);
 gboolean	 fu_device_ensure_id			(FuDevice	*self,
 							 GError		**error);
+gboolean	 fu_device_guid_from_string		(const gchar	*guid,
+							 FuDeviceGuid	*guid_raw);
+gboolean	 fu_device_has_guid_raw			(FuDevice	*self,
+							 const FuDeviceGuid *guid_raw);
 
 G_END_DECLS
 
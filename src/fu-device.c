@@ -42,6 +42,9 @@ typedef struct {
 	GPtrArray			*parent_guids;
 	FuMutex				*parent_guids_mutex;
 	GPtrArray			*children;
+	FuDeviceGuid			*guids_set;	/* open addressed */
+	guint				 guids_set_sz;
+	guint				 guids_set_len;
 	guint				 remove_delay;	/* ms */
 	FwupdStatus			 status;
 	FuVersionFormat			 version_format;
@@ -63,6 +66,9 @@ enum {
 	PROP_PHYSICAL_ID,
 	PROP_LOGICAL_ID,
 	PROP_QUIRKS,
+	PROP_ID,
+	PROP_EQUIVALENT_ID,
+	PROP_GUIDS,
 	PROP_LAST
 };
 
@@ -91,6 +97,15 @@ fu_device_get_property (GObject *object, guint prop_id,
 	case PROP_QUIRKS:
 		g_value_set_object (value, priv->quirks);
 		break;
+	case PROP_ID:
+		g_value_set_string (value, fu_device_get_id (self));
+		break;
+	case PROP_EQUIVALENT_ID:
+		g_value_set_string (value, priv->equivalent_id);
+		break;
+	case PROP_GUIDS:
+		g_value_set_boxed (value, fu_device_get_guids (self));
+		break;
 	default:
 		G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
 		break;
@@ -281,6 +296,7 @@ fu_device_set_equivalent_id (FuDevice *self, const gchar *equivalent_id)
 	g_return_if_fail (FU_IS_DEVICE (self));
 	g_free (priv->equivalent_id);
 	priv->equivalent_id = g_strdup (equivalent_id);
+	g_object_notify (G_OBJECT (self), "equivalent-id");
 }
 
 /**
@@ -761,12 +777,139 @@ fu_device_set_firmware_size_max (FuDevice *self, guint64 size_max)
 	priv->size_max = size_max;
 }
 
+/**
+ * fu_device_guid_from_string:
+ * @guid: A GUID, e.g. `2082b5e0-7a64-478a-b1b2-e3404fab6dad`
+ * @guid_raw: (out caller-allocates): a #FuDeviceGuid
+ *
+ * Converts a GUID into the binary form used by fu_device_has_guid_raw().
+ * Only the canonical lowercase form is accepted so that matching stays case
+ * sensitive, and the null GUID is not valid.
+ *
+ * Returns: %TRUE if @guid was converted
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+fu_device_guid_from_string (const gchar *guid, FuDeviceGuid *guid_raw)
+{
+	guint8 tmp = 0x0;
+	guint j = 0;
+
+	g_return_val_if_fail (guid_raw != NULL, FALSE);
+
+	if (guid == NULL || strlen (guid) != 36)
+		return FALSE;
+	for (guint i = 0; i < 36; i++) {
+		gint val;
+		if (i == 8 || i == 13 || i == 18 || i == 23) {
+			if (guid[i] != '-')
+				return FALSE;
+			continue;
+		}
+		if (g_ascii_isupper (guid[i]))
+			return FALSE;
+		val = g_ascii_xdigit_value (guid[i]);
+		if (val < 0)
+			return FALSE;
+		(*guid_raw)[j / 2] = (j % 2 == 0) ? (guint8) (val << 4) : (*guid_raw)[j / 2] | (guint8) val;
+		tmp |= (guint8) val;
+		j++;
+	}
+	return tmp != 0x0;
+}
+
+static const FuDeviceGuid fu_device_guid_null = { 0x0 };
+
+static guint
+fu_device_guid_hash (const FuDeviceGuid *guid_raw)
+{
+	/* most GUIDs are generated from a hash, so the bytes are random */
+	return ((guint) (*guid_raw)[0] << 24) | ((guint) (*guid_raw)[1] << 16) |
+	       ((guint) (*guid_raw)[2] << 8) | (guint) (*guid_raw)[3];
+}
+
+/* returns the slot for the GUID, or the empty slot where it would go */
+static FuDeviceGuid *
+fu_device_guids_set_find (FuDeviceGuid *set, guint set_sz, const FuDeviceGuid *guid_raw)
+{
+	guint mask = set_sz - 1;
+	for (guint i = fu_device_guid_hash (guid_raw) & mask; ; i = (i + 1) & mask) {
+		if (memcmp (set[i], *guid_raw, sizeof(FuDeviceGuid)) == 0 ||
+		    memcmp (set[i], fu_device_guid_null, sizeof(FuDeviceGuid)) == 0)
+			return &set[i];
+	}
+}
+
+/* strings that are not canonical GUIDs are only in the FwupdDevice array */
+static void
+fu_device_guids_set_add (FuDevice *self, const gchar *guid)
+{
+	FuDevicePrivate *priv = GET_PRIVATE (self);
+	FuDeviceGuid guid_raw;
+	FuDeviceGuid *slot;
+
+	if (!fu_device_guid_from_string (guid, &guid_raw))
+		return;
+
+	/* keep the load factor under one half so lookups stay short */
+	if ((priv->guids_set_len + 1) * 2 > priv->guids_set_sz) {
+		guint set_sz = MAX (priv->guids_set_sz * 2, 8);
+		FuDeviceGuid *set = g_new0 (FuDeviceGuid, set_sz);
+		for (guint i = 0; i < priv->guids_set_sz; i++) {
+			if (memcmp (priv->guids_set[i], fu_device_guid_null, sizeof(FuDeviceGuid)) == 0)
+				continue;
+			slot = fu_device_guids_set_find (set, set_sz,
+							 (const FuDeviceGuid *) &priv->guids_set[i]);
+			memcpy (*slot, priv->guids_set[i], sizeof(FuDeviceGuid));
+		}
+		g_free (priv->guids_set);
+		priv->guids_set = set;
+		priv->guids_set_sz = set_sz;
+	}
+	slot = fu_device_guids_set_find (priv->guids_set, priv->guids_set_sz,
+					 (const FuDeviceGuid *) &guid_raw);
+	if (memcmp (*slot, fu_device_guid_null, sizeof(FuDeviceGuid)) != 0)
+		return;
+	memcpy (*slot, guid_raw, sizeof(FuDeviceGuid));
+	priv->guids_set_len++;
+}
+
+/**
+ * fu_device_has_guid_raw:
+ * @self: A #FuDevice
+ * @guid_raw: the binary GUID from fu_device_guid_from_string()
+ *
+ * Finds out if the device has a specific GUID. This is faster than
+ * fu_device_has_guid() when the same GUID is checked against many devices.
+ *
+ * Returns: %TRUE if the GUID is found
+ *
+ * Since: 1.2.5
+ **/
+gboolean
+fu_device_has_guid_raw (FuDevice *self, const FuDeviceGuid *guid_raw)
+{
+	FuDevicePrivate *priv = GET_PRIVATE (self);
+	FuDeviceGuid *slot;
+
+	g_return_val_if_fail (FU_IS_DEVICE (self), FALSE);
+	g_return_val_if_fail (guid_raw != NULL, FALSE);
+
+	if (priv->guids_set_len == 0)
+		return FALSE;
+	slot = fu_device_guids_set_find (priv->guids_set, priv->guids_set_sz, guid_raw);
+	return memcmp (*slot, fu_device_guid_null, sizeof(FuDeviceGuid)) != 0;
+}
+
 static void
 fu_device_add_guid_safe (FuDevice *self, const gchar *guid)
 {
 	/* add the device GUID before adding additional GUIDs from quirks
 	 * to ensure the bootloader GUID is listed after the runtime GUID */
 	fwupd_device_add_guid (FWUPD_DEVICE (self), guid);
+	fu_device_guids_set_add (self, guid);
+	g_object_notify (G_OBJECT (self), "guids");
 	fu_device_add_guid_quirks (self, guid);
 }
 
@@ -784,6 +927,12 @@ fu_device_add_guid_safe (FuDevice *self, const gchar *guid)
 gboolean
 fu_device_has_guid (FuDevice *self, const gchar *guid)
 {
+	FuDeviceGuid guid_raw;
+
+	/* already valid */
+	if (fu_device_guid_from_string (guid, &guid_raw))
+		return fu_device_has_guid_raw (self, &guid_raw);
+
 	/* make valid */
 	if (!fu_common_guid_is_valid (guid)) {
 		g_autofree gchar *tmp = fu_common_guid_from_string (guid);
@@ -841,11 +990,15 @@ fu_device_add_counterpart_guid (FuDevice *self, const gchar *guid)
 		g_autofree gchar *tmp = fu_common_guid_from_string (guid);
 		g_debug ("using %s for counterpart %s", tmp, guid);
 		fwupd_device_add_guid (FWUPD_DEVICE (self), tmp);
+		fu_device_guids_set_add (self, tmp);
+		g_object_notify (G_OBJECT (self), "guids");
 		return;
 	}
 
 	/* already valid */
 	fwupd_device_add_guid (FWUPD_DEVICE (self), guid);
+	fu_device_guids_set_add (self, guid);
+	g_object_notify (G_OBJECT (self), "guids");
 }
 
 /**
@@ -1069,6 +1222,7 @@ fu_device_set_id (FuDevice *self, const gchar *id)
 	id_hash = g_compute_checksum_for_string (G_CHECKSUM_SHA1, id, -1);
 	g_debug ("using %s for %s", id_hash, id);
 	fwupd_device_set_id (FWUPD_DEVICE (self), id_hash);
+	g_object_notify (G_OBJECT (self), "id");
 }
 
 static gboolean
@@ -1218,6 +1372,7 @@ fu_device_set_physical_id (FuDevice *self, const gchar *physical_id)
 	g_return_if_fail (FU_IS_DEVICE (self));
 	g_return_if_fail (physical_id != NULL);
 	fu_device_set_metadata (self, "physical-id", physical_id);
+	g_object_notify (G_OBJECT (self), "physical-id");
 }
 
 /**
@@ -2053,6 +2208,7 @@ fu_device_incorporate (FuDevice *self, FuDevice *donor)
 	FuDeviceClass *klass = FU_DEVICE_GET_CLASS (self);
 	FuDevicePrivate *priv = GET_PRIVATE (self);
 	FuDevicePrivate *priv_donor = GET_PRIVATE (donor);
+	GPtrArray *guids;
 	GPtrArray *parent_guids = fu_device_get_parent_guids (donor);
 	g_autoptr(GList) metadata_keys = NULL;
 
@@ -2082,11 +2238,21 @@ fu_device_incorporate (FuDevice *self, FuDevice *donor)
 	fu_mutex_read_unlock (priv_donor->metadata_mutex);
 
 	/* now the base class, where all the interesting bits are */
+	g_object_freeze_notify (G_OBJECT (self));
 	fwupd_device_incorporate (FWUPD_DEVICE (self), FWUPD_DEVICE (donor));
+	guids = fu_device_get_guids (self);
+	for (guint i = 0; i < guids->len; i++)
+		fu_device_guids_set_add (self, g_ptr_array_index (guids, i));
+
+	/* the base class does not notify, and the device may already be
+	 * indexed by its ID and GUIDs in the device list */
+	g_object_notify (G_OBJECT (self), "id");
+	g_object_notify (G_OBJECT (self), "guids");
 
 	/* optional subclass */
 	if (klass->incorporate != NULL)
 		klass->incorporate (self, donor);
+	g_object_thaw_notify (G_OBJECT (self));
 }
 
 static void
@@ -2127,6 +2293,22 @@ fu_device_class_init (FuDeviceClass *klass)
 				     G_PARAM_READWRITE |
 				     G_PARAM_STATIC_NAME);
 	g_object_class_install_property (object_class, PROP_QUIRKS, pspec);
+
+	pspec = g_param_spec_string ("id", NULL, NULL, NULL,
+				     G_PARAM_READABLE |
+				     G_PARAM_STATIC_NAME);
+	g_object_class_install_property (object_class, PROP_ID, pspec);
+
+	pspec = g_param_spec_string ("equivalent-id", NULL, NULL, NULL,
+				     G_PARAM_READABLE |
+				     G_PARAM_STATIC_NAME);
+	g_object_class_install_property (object_class, PROP_EQUIVALENT_ID, pspec);
+
+	pspec = g_param_spec_boxed ("guids", NULL, NULL,
+				    G_TYPE_PTR_ARRAY,
+				    G_PARAM_READABLE |
+				    G_PARAM_STATIC_NAME);
+	g_object_class_install_property (object_class, PROP_GUIDS, pspec);
 }
 
 static void
@@ -2161,6 +2343,7 @@ fu_device_finalize (GObject *object)
 	g_hash_table_unref (priv->metadata);
 	g_ptr_array_unref (priv->children);
 	g_ptr_array_unref (priv->parent_guids);
+	g_free (priv->guids_set);
 	g_free (priv->alternate_id);
 	g_free (priv->equivalent_id);
 
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#define G_LOG_DOMAIN				"FuEngine"
+
+#include "config.h"
+
+#include "fu-engine-silo.h"
+
+/**
+ * SECTION:fu-engine-silo
+ * @short_description: the compiled metadata of one remote
+ *
+ * Each remote is compiled into its own #XbSilo, and the engine keeps the
+ * silos in remote priority order. The flashed GUIDs and the container
+ * checksums are indexed when the object is created so that checking if a
+ * device is supported, or finding the remote an archive came from, does not
+ * need an XPath query over the whole catalog.
+ *
+ * The object is shared between the priority-ordered list and the cache of
+ * unchanged remotes, so any #XbNode returned is valid while a reference is
+ * held.
+ */
+
+static void fu_engine_silo_finalize	 (GObject *obj);
+
+struct _FuEngineSilo
+{
+	GObject			 parent_instance;
+	gchar			*key;		/* of the source file, nullable */
+	gchar			*remote_id;	/* nullable */
+	XbSilo			*silo;
+	GHashTable		*guids;		/* GUID:GPtrArray of XbNode */
+	GHashTable		*guid_positions;	/* GUID:document position */
+	GHashTable		*checksums;	/* set of container checksums */
+};
+
+G_DEFINE_TYPE (FuEngineSilo, fu_engine_silo, G_TYPE_OBJECT)
+
+/* maps each flashed GUID to the components that provide it, in document
+ * order, so that checking if a device is supported is just a lookup */
+static void
+fu_engine_silo_build_guid_index (FuEngineSilo *self)
+{
+	g_autoptr(GPtrArray) firmware = NULL;
+
+	firmware = xb_silo_query (self->silo,
+				  "components/component/provides/firmware[@type='flashed']",
+				  0, NULL);
+	if (firmware == NULL)
+		return;
+	for (guint i = 0; i < firmware->len; i++) {
+		XbNode *n = g_ptr_array_index (firmware, i);
+		GPtrArray *components;
+		const gchar *guid = xb_node_get_text (n);
+		g_autoptr(XbNode) component = NULL;
+		g_autoptr(XbNode) provides = NULL;
+
+		if (guid == NULL)
+			continue;
+		provides = xb_node_get_parent (n);
+		if (provides == NULL)
+			continue;
+		component = xb_node_get_parent (provides);
+		if (component == NULL)
+			continue;
+		components = g_hash_table_lookup (self->guids, guid);
+		if (components == NULL) {
+			components = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+			g_hash_table_insert (self->guids, g_strdup (guid), components);
+			g_hash_table_insert (self->guid_positions, g_strdup (guid),
+					     GUINT_TO_POINTER (i));
+		}
+		g_ptr_array_add (components, g_steal_pointer (&component));
+	}
+}
+
+/* every release in the silo is from the same remote, so only the container
+ * checksum is needed to find where a cabinet archive came from */
+static void
+fu_engine_silo_build_checksum_index (FuEngineSilo *self)
+{
+	g_autoptr(GPtrArray) csums = NULL;
+
+	csums = xb_silo_query (self->silo,
+			       "components/component/releases/release/"
+			       "checksum[@target='container']",
+			       0, NULL);
+	if (csums == NULL)
+		return;
+	for (guint i = 0; i < csums->len; i++) {
+		XbNode *n = g_ptr_array_index (csums, i);
+		const gchar *csum = xb_node_get_text (n);
+
+		/* owned by the silo, which we keep a reference to */
+		if (csum != NULL)
+			g_hash_table_add (self->checksums, (gpointer) csum);
+	}
+}
+
+/**
+ * fu_engine_silo_get_silo:
+ * @self: A #FuEngineSilo
+ *
+ * Gets the compiled metadata.
+ *
+ * Returns: (transfer none): a #XbSilo
+ **/
+XbSilo *
+fu_engine_silo_get_silo (FuEngineSilo *self)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), NULL);
+	return self->silo;
+}
+
+/**
+ * fu_engine_silo_get_key:
+ * @self: A #FuEngineSilo
+ *
+ * Gets the key of the source file the silo was compiled from, which is used
+ * to decide if the silo can be reused.
+ *
+ * Returns: a string, or %NULL if unset
+ **/
+const gchar *
+fu_engine_silo_get_key (FuEngineSilo *self)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), NULL);
+	return self->key;
+}
+
+/**
+ * fu_engine_silo_get_remote_id:
+ * @self: A #FuEngineSilo
+ *
+ * Gets the remote the silo was compiled for.
+ *
+ * Returns: a remote ID, e.g. `lvfs`, or %NULL if unknown
+ **/
+const gchar *
+fu_engine_silo_get_remote_id (FuEngineSilo *self)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), NULL);
+	return self->remote_id;
+}
+
+/**
+ * fu_engine_silo_get_guid_count:
+ * @self: A #FuEngineSilo
+ *
+ * Gets the number of unique flashed GUIDs in the silo.
+ *
+ * Returns: integer
+ **/
+guint
+fu_engine_silo_get_guid_count (FuEngineSilo *self)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), 0);
+	return g_hash_table_size (self->guids);
+}
+
+/**
+ * fu_engine_silo_get_components_by_guid:
+ * @self: A #FuEngineSilo
+ * @guid: A GUID
+ *
+ * Gets the components that provide a flashed GUID.
+ *
+ * Returns: (transfer none) (element-type XbNode): components in document
+ * order, or %NULL if none match
+ **/
+GPtrArray *
+fu_engine_silo_get_components_by_guid (FuEngineSilo *self, const gchar *guid)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), NULL);
+	g_return_val_if_fail (guid != NULL, NULL);
+	return g_hash_table_lookup (self->guids, guid);
+}
+
+/**
+ * fu_engine_silo_get_guid_position:
+ * @self: A #FuEngineSilo
+ * @guid: A GUID
+ * @position: (out): the document position of the first component
+ *
+ * Gets where the first component that provides a flashed GUID appears, so
+ * that matches for different GUIDs can be compared.
+ *
+ * Returns: %TRUE if the GUID was found
+ **/
+gboolean
+fu_engine_silo_get_guid_position (FuEngineSilo *self, const gchar *guid, guint *position)
+{
+	gpointer tmp = NULL;
+
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), FALSE);
+	g_return_val_if_fail (guid != NULL, FALSE);
+
+	if (!g_hash_table_lookup_extended (self->guid_positions, guid, NULL, &tmp))
+		return FALSE;
+	if (position != NULL)
+		*position = GPOINTER_TO_UINT (tmp);
+	return TRUE;
+}
+
+/**
+ * fu_engine_silo_has_checksum:
+ * @self: A #FuEngineSilo
+ * @csum: A container checksum
+ *
+ * Finds out if any release in the silo has the container checksum.
+ *
+ * Returns: %TRUE if found
+ **/
+gboolean
+fu_engine_silo_has_checksum (FuEngineSilo *self, const gchar *csum)
+{
+	g_return_val_if_fail (FU_IS_ENGINE_SILO (self), FALSE);
+	g_return_val_if_fail (csum != NULL, FALSE);
+	return g_hash_table_contains (self->checksums, csum);
+}
+
+static void
+fu_engine_silo_class_init (FuEngineSiloClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = fu_engine_silo_finalize;
+}
+
+static void
+fu_engine_silo_init (FuEngineSilo *self)
+{
+	self->guids = g_hash_table_new_full (g_str_hash, g_str_equal,
+					     g_free, (GDestroyNotify) g_ptr_array_unref);
+	self->guid_positions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->checksums = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+static void
+fu_engine_silo_finalize (GObject *obj)
+{
+	FuEngineSilo *self = FU_ENGINE_SILO (obj);
+
+	/* the indexes reference strings owned by the silo */
+	g_hash_table_unref (self->checksums);
+	g_hash_table_unref (self->guid_positions);
+	g_hash_table_unref (self->guids);
+	g_free (self->key);
+	g_free (self->remote_id);
+	g_object_unref (self->silo);
+
+	G_OBJECT_CLASS (fu_engine_silo_parent_class)->finalize (obj);
+}
+
+/**
+ * fu_engine_silo_new:
+ * @silo: A #XbSilo
+ * @key: (nullable): A key for the source file, e.g. `1549371020:1234`
+ *
+ * Creates a new object for the metadata of one remote, building the GUID and
+ * checksum indexes.
+ *
+ * Returns: a #FuEngineSilo
+ **/
+FuEngineSilo *
+fu_engine_silo_new (XbSilo *silo, const gchar *key)
+{
+	FuEngineSilo *self;
+	g_autoptr(XbNode) n = NULL;
+
+	g_return_val_if_fail (XB_IS_SILO (silo), NULL);
+
+	self = g_object_new (FU_TYPE_ENGINE_SILO, NULL);
+	self->key = g_strdup (key);
+	self->silo = g_object_ref (silo);
+	fu_engine_silo_build_guid_index (self);
+	fu_engine_silo_build_checksum_index (self);
+
+	/* the same for every component in the silo */
+	n = xb_silo_query_first (silo, "components/custom/value[@key='fwupd::RemoteId']", NULL);
+	if (n != NULL)
+		self->remote_id = g_strdup (xb_node_get_text (n));
+	return FU_ENGINE_SILO (self);
+}
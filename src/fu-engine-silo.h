@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __FU_ENGINE_SILO_H
+#define __FU_ENGINE_SILO_H
+
+G_BEGIN_DECLS
+
+#include <glib-object.h>
+#include <xmlb.h>
+
+#define FU_TYPE_ENGINE_SILO (fu_engine_silo_get_type ())
+G_DECLARE_FINAL_TYPE (FuEngineSilo, fu_engine_silo, FU, ENGINE_SILO, GObject)
+
+FuEngineSilo	*fu_engine_silo_new			(XbSilo		*silo,
+							 const gchar	*key);
+XbSilo		*fu_engine_silo_get_silo		(FuEngineSilo	*self);
+const gchar	*fu_engine_silo_get_key			(FuEngineSilo	*self);
+const gchar	*fu_engine_silo_get_remote_id		(FuEngineSilo	*self);
+guint		 fu_engine_silo_get_guid_count		(FuEngineSilo	*self);
+GPtrArray	*fu_engine_silo_get_components_by_guid	(FuEngineSilo	*self,
+							 const gchar	*guid);
+gboolean	 fu_engine_silo_get_guid_position	(FuEngineSilo	*self,
+							 const gchar	*guid,
+							 guint		*position);
+gboolean	 fu_engine_silo_has_checksum		(FuEngineSilo	*self,
+							 const gchar	*csum);
+
+G_END_DECLS
+
+#endif /* __FU_ENGINE_SILO_H */
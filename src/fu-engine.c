@@ -11,6 +11,7 @@
 #include <gio/gio.h>
 #include <gio/gunixinputstream.h>
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <gudev/gudev.h>
 #include <fnmatch.h>
 #include <string.h>
@@ -23,16 +24,20 @@
 #include "fwupd-remote-private.h"
 #include "fwupd-resources.h"
 
+#include "fu-cab-cache.h"
 #include "fu-common-cab.h"
 #include "fu-common-guid.h"
+#include "fu-common-version.h"
 #include "fu-common.h"
 #include "fu-config.h"
 #include "fu-debug.h"
 #include "fu-device-list.h"
 #include "fu-device-private.h"
 #include "fu-engine.h"
+#include "fu-engine-silo.h"
 #include "fu-hwids.h"
 #include "fu-idle.h"
+#include "fu-keyring-cache.h"
 #include "fu-keyring-utils.h"
 #include "fu-hash.h"
 #include "fu-history.h"
@@ -60,16 +65,31 @@ struct _FuEngine
 	guint			 percentage;
 	FuHistory		*history;
 	FuIdle			*idle;
-	XbSilo			*silo;
+	GPtrArray		*silos;		/* of FuEngineSilo, by remote priority */
+	GHashTable		*remote_silos;	/* remote-id:FuEngineSilo */
+	FuCabCache		*cab_cache;
+	FuKeyringCache		*keyring_cache;
+	GPtrArray		*pki_monitors;	/* of GFileMonitor */
 	gboolean		 coldplug_running;
 	guint			 coldplug_id;
 	guint			 coldplug_delay;
+	guint			 coldplug_threads;
+	guint			 install_threads;
+	GMainContext		*main_ctx;	/* only set when installing in threads */
+	GThread			*main_thread;
+	gboolean		 installing;
+	GMutex			 update_hooks_mutex;	/* for prepare and cleanup */
 	FuPluginList		*plugin_list;
 	GPtrArray		*plugin_filter;
+	GHashTable		*plugins_deferred;	/* FuPlugin:filename */
+	GPtrArray		*plugins_deferred_open;	/* of FuPlugin */
+	GPtrArray		*devices_deferred;	/* of GUsbDevice or GUdevDevice */
+	guint			 plugins_deferred_id;
 	GPtrArray		*udev_subsystems;
 	FuSmbios		*smbios;
 	FuHwids			*hwids;
 	FuQuirks		*quirks;
+	FuProfile		*profile;
 	GHashTable		*runtime_versions;
 	GHashTable		*compile_versions;
 	gboolean		 loaded;
@@ -89,9 +109,165 @@ static guint signals[SIGNAL_LAST] = { 0 };
 
 G_DEFINE_TYPE (FuEngine, fu_engine, G_TYPE_OBJECT)
 
+static void
+fu_engine_silos_clear (FuEngine *self)
+{
+	if (self->silos != NULL)
+		g_ptr_array_unref (self->silos);
+	self->silos = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+}
+
+/* gets the components from the silo with the highest priority, or %NULL */
+static GPtrArray *
+fu_engine_silos_get_components_by_guid (FuEngine *self, const gchar *guid)
+{
+	for (guint i = 0; self->silos != NULL && i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		GPtrArray *components = fu_engine_silo_get_components_by_guid (item, guid);
+		if (components != NULL)
+			return components;
+	}
+	return NULL;
+}
+
+/* queries each silo in remote priority order, returning the first match */
+static XbNode *
+fu_engine_silos_query_first (FuEngine *self, const gchar *xpath)
+{
+	if (self->silos == NULL)
+		return NULL;
+	for (guint i = 0; i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		XbNode *n = xb_silo_query_first (fu_engine_silo_get_silo (item), xpath, NULL);
+		if (n != NULL)
+			return n;
+	}
+	return NULL;
+}
+
+/* queries all the silos, merging the results in remote priority order */
+static GPtrArray *
+fu_engine_silos_query (FuEngine *self, const gchar *xpath, GError **error)
+{
+	g_autoptr(GPtrArray) results = NULL;
+
+	results = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	for (guint i = 0; self->silos != NULL && i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GPtrArray) tmp = NULL;
+		tmp = xb_silo_query (fu_engine_silo_get_silo (item), xpath, 0, &error_local);
+		if (tmp == NULL) {
+			if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+				continue;
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return NULL;
+		}
+		for (guint j = 0; j < tmp->len; j++)
+			g_ptr_array_add (results, g_object_ref (g_ptr_array_index (tmp, j)));
+	}
+	if (results->len == 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_NOT_FOUND,
+			     "no results for %s", xpath);
+		return NULL;
+	}
+	return g_steal_pointer (&results);
+}
+
+/* the container checksum used for the history and to find the remote */
+static gchar *
+fu_engine_get_container_checksum (GBytes *blob_cab)
+{
+	g_autoptr(GPtrArray) checksums = NULL;
+	checksums = fu_common_get_checksums (blob_cab, FU_CHECKSUM_FLAG_SHA1);
+	return g_strdup (g_ptr_array_index (checksums, 0));
+}
+
+typedef enum {
+	FU_ENGINE_SIGNAL_KIND_CHANGED,
+	FU_ENGINE_SIGNAL_KIND_DEVICE_CHANGED,
+	FU_ENGINE_SIGNAL_KIND_STATUS,
+	FU_ENGINE_SIGNAL_KIND_PERCENTAGE,
+} FuEngineSignalKind;
+
+typedef struct {
+	FuEngine		*self;
+	FuEngineSignalKind	 kind;
+	FuDevice		*device;	/* nullable */
+	guint			 value;
+} FuEngineSignalHelper;
+
+static void fu_engine_emit_changed	(FuEngine	*self);
+static void fu_engine_emit_device_changed (FuEngine	*self,
+					 FuDevice	*device);
+static void fu_engine_set_status	(FuEngine	*self,
+					 FwupdStatus	 status);
+static void fu_engine_set_percentage	(FuEngine	*self,
+					 guint		 percentage);
+
+static void
+fu_engine_signal_helper_free (FuEngineSignalHelper *helper)
+{
+	if (helper->device != NULL)
+		g_object_unref (helper->device);
+	g_object_unref (helper->self);
+	g_free (helper);
+}
+
+static gboolean
+fu_engine_signal_helper_cb (gpointer user_data)
+{
+	FuEngineSignalHelper *helper = (FuEngineSignalHelper *) user_data;
+	switch (helper->kind) {
+	case FU_ENGINE_SIGNAL_KIND_CHANGED:
+		fu_engine_emit_changed (helper->self);
+		break;
+	case FU_ENGINE_SIGNAL_KIND_DEVICE_CHANGED:
+		fu_engine_emit_device_changed (helper->self, helper->device);
+		break;
+	case FU_ENGINE_SIGNAL_KIND_STATUS:
+		fu_engine_set_status (helper->self, helper->value);
+		break;
+	case FU_ENGINE_SIGNAL_KIND_PERCENTAGE:
+		fu_engine_set_percentage (helper->self, helper->value);
+		break;
+	default:
+		break;
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* the signals are connected to the daemon and the idle object, neither of
+ * which is threadsafe, so anything from an install worker is handed back to
+ * the main thread in the order it was emitted */
+static gboolean
+fu_engine_signal_defer (FuEngine *self,
+			FuEngineSignalKind kind,
+			FuDevice *device,
+			guint value)
+{
+	FuEngineSignalHelper *helper;
+
+	if (self->main_thread == NULL || self->main_thread == g_thread_self ())
+		return FALSE;
+	helper = g_new0 (FuEngineSignalHelper, 1);
+	helper->self = g_object_ref (self);
+	helper->kind = kind;
+	helper->device = device != NULL ? g_object_ref (device) : NULL;
+	helper->value = value;
+	g_main_context_invoke_full (self->main_ctx, G_PRIORITY_DEFAULT,
+				    fu_engine_signal_helper_cb, helper,
+				    (GDestroyNotify) fu_engine_signal_helper_free);
+	return TRUE;
+}
+
 static void
 fu_engine_emit_changed (FuEngine *self)
 {
+	if (fu_engine_signal_defer (self, FU_ENGINE_SIGNAL_KIND_CHANGED, NULL, 0))
+		return;
 	g_signal_emit (self, signals[SIGNAL_CHANGED], 0);
 	fu_engine_idle_reset (self);
 }
@@ -99,6 +275,8 @@ fu_engine_emit_changed (FuEngine *self)
 static void
 fu_engine_emit_device_changed (FuEngine *self, FuDevice *device)
 {
+	if (fu_engine_signal_defer (self, FU_ENGINE_SIGNAL_KIND_DEVICE_CHANGED, device, 0))
+		return;
 	g_signal_emit (self, signals[SIGNAL_DEVICE_CHANGED], 0, device);
 }
 
@@ -120,6 +298,8 @@ fu_engine_get_status (FuEngine *self)
 static void
 fu_engine_set_status (FuEngine *self, FwupdStatus status)
 {
+	if (fu_engine_signal_defer (self, FU_ENGINE_SIGNAL_KIND_STATUS, NULL, status))
+		return;
 	if (self->status == status)
 		return;
 	self->status = status;
@@ -133,6 +313,8 @@ fu_engine_set_status (FuEngine *self, FwupdStatus status)
 static void
 fu_engine_set_percentage (FuEngine *self, guint percentage)
 {
+	if (fu_engine_signal_defer (self, FU_ENGINE_SIGNAL_KIND_PERCENTAGE, NULL, percentage))
+		return;
 	if (self->percentage == percentage)
 		return;
 	self->percentage = percentage;
@@ -334,15 +516,12 @@ fu_engine_set_release_from_appstream (FuEngine *self,
 static const gchar *
 fu_engine_get_remote_id_for_checksum (FuEngine *self, const gchar *csum)
 {
-	g_autofree gchar *xpath = NULL;
-	g_autoptr(XbNode) key = NULL;
-	xpath = g_strdup_printf ("components/component/releases/release/"
-				 "checksum[@target='container'][text()='%s']/../../"
-				 "../../custom/value[@key='fwupd::RemoteId']", csum);
-	key = xb_silo_query_first (self->silo, xpath, NULL);
-	if (key == NULL)
-		return NULL;
-	return xb_node_get_text (key);
+	for (guint i = 0; self->silos != NULL && i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		if (fu_engine_silo_has_checksum (item, csum))
+			return fu_engine_silo_get_remote_id (item);
+	}
+	return NULL;
 }
 
 /**
@@ -387,6 +566,20 @@ fu_engine_unlock (FuEngine *self, const gchar *device_id, GError **error)
 	return TRUE;
 }
 
+/* the main loop is iterated while installing in threads, so other D-Bus
+ * methods can be dispatched before the install has finished */
+static gboolean
+fu_engine_ensure_not_installing (FuEngine *self, GError **error)
+{
+	if (!self->installing)
+		return TRUE;
+	g_set_error_literal (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INTERNAL,
+			     "already installing");
+	return FALSE;
+}
+
 /**
  * fu_engine_modify_remote:
  * @self: A #FuEngine
@@ -411,6 +604,10 @@ fu_engine_modify_remote (FuEngine *self,
 	const gchar *keys[] = { "Enabled", "MetadataURI", "FirmwareBaseURI", NULL };
 	g_autoptr(GKeyFile) keyfile = g_key_file_new ();
 
+	/* the remote would be reloaded underneath the install */
+	if (!fu_engine_ensure_not_installing (self, error))
+		return FALSE;
+
 	/* check remote is valid */
 	remote = fu_config_get_remote_by_id (self->config, remote_id);
 	if (remote == NULL) {
@@ -622,22 +819,31 @@ fu_engine_verify_update (FuEngine *self, const gchar *device_id, GError **error)
 	return TRUE;
 }
 
+/* gets the first component in document order that provides any of the
+ * device GUIDs, using the silo with the highest priority */
 static XbNode *
-fu_engine_store_get_app_by_guids (XbSilo *silo, FuDevice *device)
+fu_engine_store_get_app_by_guids (FuEngine *self, FuDevice *device)
 {
 	GPtrArray *guids = fu_device_get_guids (device);
-	g_autoptr(GString) xpath = g_string_new (NULL);
-	g_autoptr(XbNode) component = NULL;
-	for (guint i = 0; i < guids->len; i++) {
-		const gchar *guid = g_ptr_array_index (guids, i);
-		xb_string_append_union (xpath,
-					"components/component/"
-					"provides/firmware[@type='flashed'][text()='%s']/"
-					"../..", guid);
+	for (guint i = 0; self->silos != NULL && i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		const gchar *guid_best = NULL;
+		guint position_best = G_MAXUINT;
+		for (guint j = 0; j < guids->len; j++) {
+			const gchar *guid = g_ptr_array_index (guids, j);
+			guint position = 0;
+			if (!fu_engine_silo_get_guid_position (item, guid, &position))
+				continue;
+			if (position < position_best) {
+				position_best = position;
+				guid_best = guid;
+			}
+		}
+		if (guid_best != NULL) {
+			GPtrArray *components = fu_engine_silo_get_components_by_guid (item, guid_best);
+			return g_object_ref (g_ptr_array_index (components, 0));
+		}
 	}
-	component = xb_silo_query_first (silo, xpath->str, NULL);
-	if (component != NULL)
-		return g_steal_pointer (&component);
 	return NULL;
 }
 
@@ -720,7 +926,7 @@ fu_engine_verify (FuEngine *self, const gchar *device_id, GError **error)
 						  "provides/firmware[@type='flashed'][text()='%s']/"
 						  "../../releases/release[@version='%s']",
 						  guid, version);
-			release = xb_silo_query_first (self->silo, xpath2, NULL);
+			release = fu_engine_silos_query_first (self, xpath2);
 			if (release != NULL)
 				break;
 		}
@@ -1197,28 +1403,226 @@ fu_engine_composite_cleanup (FuEngine *self, GPtrArray *devices, GError **error)
 	return TRUE;
 }
 
-/**
- * fu_engine_install_tasks:
- * @self: A #FuEngine
- * @install_tasks: (element-type FuInstallTask): A #FuDevice
- * @blob_cab: The #GBytes of the .cab file
- * @flags: The #FwupdInstallFlags, e.g. %FWUPD_DEVICE_FLAG_UPDATABLE
- * @error: A #GError, or %NULL
- *
- * Installs a specific firmware file on one or more install tasks.
- *
- * By this point all the requirements and tests should have been done in
- * fu_engine_check_requirements() so this should not fail before running
- * the plugin loader.
- *
- * Returns: %TRUE for success
- **/
-gboolean
-fu_engine_install_tasks (FuEngine *self,
-			 GPtrArray *install_tasks,
-			 GBytes *blob_cab,
-			 FwupdInstallFlags flags,
-			 GError **error)
+static gboolean
+fu_engine_device_has_ancestor (FuDevice *device, FuDevice *ancestor)
+{
+	for (FuDevice *parent = fu_device_get_parent (device);
+	     parent != NULL;
+	     parent = fu_device_get_parent (parent)) {
+		if (g_strcmp0 (fu_device_get_id (parent), fu_device_get_id (ancestor)) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/* whether the tasks have to be run one after the other */
+static gboolean
+fu_engine_install_tasks_conflict (FuEngine *self, FuInstallTask *task1, FuInstallTask *task2)
+{
+	FuDevice *device1 = fu_install_task_get_device (task1);
+	FuDevice *device2 = fu_install_task_get_device (task2);
+	FuPlugin *plugin1;
+	FuPlugin *plugin2;
+	FuPluginRule rules[] = {
+		FU_PLUGIN_RULE_CONFLICTS,
+		FU_PLUGIN_RULE_RUN_AFTER,
+		FU_PLUGIN_RULE_RUN_BEFORE,
+		FU_PLUGIN_RULE_LAST };
+
+	/* the priority is used to order composite updates */
+	if (fu_device_get_priority (device1) != fu_device_get_priority (device2))
+		return TRUE;
+
+	/* same hardware, or one is the parent of the other */
+	if (g_strcmp0 (fu_device_get_id (device1), fu_device_get_id (device2)) == 0)
+		return TRUE;
+	if (fu_device_get_physical_id (device1) != NULL &&
+	    g_strcmp0 (fu_device_get_physical_id (device1),
+		       fu_device_get_physical_id (device2)) == 0)
+		return TRUE;
+	if (fu_engine_device_has_ancestor (device1, device2) ||
+	    fu_engine_device_has_ancestor (device2, device1))
+		return TRUE;
+
+	/* plugins have to opt-in to updating more than one device at a time */
+	plugin1 = fu_plugin_list_find_by_name (self->plugin_list,
+					       fu_device_get_plugin (device1), NULL);
+	plugin2 = fu_plugin_list_find_by_name (self->plugin_list,
+					       fu_device_get_plugin (device2), NULL);
+	if (plugin1 == NULL || plugin2 == NULL)
+		return TRUE;
+	if (plugin1 == plugin2)
+		return fu_plugin_get_rules (plugin1, FU_PLUGIN_RULE_CONCURRENT_UPDATE)->len == 0;
+
+	/* the plugins have to be run in a specific order */
+	for (guint i = 0; rules[i] != FU_PLUGIN_RULE_LAST; i++) {
+		if (fu_plugin_has_rule (plugin1, rules[i], fu_plugin_get_name (plugin2)) ||
+		    fu_plugin_has_rule (plugin2, rules[i], fu_plugin_get_name (plugin1)))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+typedef struct {
+	FuEngine		*self;
+	GBytes			*blob_cab;
+	FwupdInstallFlags	 flags;
+	GThreadPool		*pool;
+	guint			 pending;
+	gboolean		 failed;
+} FuEngineInstallHelper;
+
+typedef struct {
+	FuEngineInstallHelper	*helper;
+	FuInstallTask		*task;
+	GPtrArray		*dependents;	/* of FuEngineInstallItem */
+	guint			 deps_remaining;
+	GError			*error;
+} FuEngineInstallItem;
+
+static void
+fu_engine_install_item_free (FuEngineInstallItem *item)
+{
+	if (item->error != NULL)
+		g_error_free (item->error);
+	g_ptr_array_unref (item->dependents);
+	g_free (item);
+}
+
+static void
+fu_engine_install_item_queue (FuEngineInstallItem *item)
+{
+	if (!g_thread_pool_push (item->helper->pool, item, &item->error)) {
+		item->helper->failed = TRUE;
+		return;
+	}
+	item->helper->pending++;
+}
+
+/* runs in the main thread */
+static gboolean
+fu_engine_install_item_done_cb (gpointer user_data)
+{
+	FuEngineInstallItem *item = (FuEngineInstallItem *) user_data;
+	FuEngineInstallHelper *helper = item->helper;
+
+	/* do not start any more tasks, but let the running ones finish */
+	helper->pending--;
+	if (item->error != NULL)
+		helper->failed = TRUE;
+	if (helper->failed)
+		return G_SOURCE_REMOVE;
+
+	/* unblock any tasks that conflicted with this one */
+	for (guint i = 0; i < item->dependents->len; i++) {
+		FuEngineInstallItem *item_tmp = g_ptr_array_index (item->dependents, i);
+		if (--item_tmp->deps_remaining == 0)
+			fu_engine_install_item_queue (item_tmp);
+	}
+	return G_SOURCE_REMOVE;
+}
+
+/* runs in a worker thread */
+static void
+fu_engine_install_item_thread_cb (gpointer data, gpointer user_data)
+{
+	FuEngineInstallItem *item = (FuEngineInstallItem *) data;
+	FuEngineInstallHelper *helper = (FuEngineInstallHelper *) user_data;
+	fu_engine_install (helper->self, item->task,
+			   helper->blob_cab, helper->flags,
+			   &item->error);
+	fu_plugin_unlock_usb_context ();
+
+	/* queued after any signals emitted by the install */
+	g_main_context_invoke (helper->self->main_ctx,
+			       fu_engine_install_item_done_cb, item);
+}
+
+static gboolean
+fu_engine_install_tasks_parallel (FuEngine *self,
+				  GPtrArray *install_tasks,
+				  GBytes *blob_cab,
+				  FwupdInstallFlags flags,
+				  GError **error)
+{
+	GPtrArray *plugins = fu_plugin_list_get_all (self->plugin_list);
+	GMainContext *main_ctx_old = self->main_ctx;
+	GThread *main_thread_old = self->main_thread;
+	FuEngineInstallHelper helper = {
+		.self		= self,
+		.blob_cab	= blob_cab,
+		.flags		= flags,
+	};
+	g_autoptr(GPtrArray) items = NULL;
+
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) fu_engine_install_item_free);
+	for (guint i = 0; i < install_tasks->len; i++) {
+		FuEngineInstallItem *item = g_new0 (FuEngineInstallItem, 1);
+		item->helper = &helper;
+		item->task = g_ptr_array_index (install_tasks, i);
+		item->dependents = g_ptr_array_new ();
+		g_ptr_array_add (items, item);
+	}
+
+	/* the tasks are already sorted by priority, so any conflicting task
+	 * waits for all the earlier tasks it conflicts with */
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineInstallItem *item = g_ptr_array_index (items, i);
+		for (guint j = i + 1; j < items->len; j++) {
+			FuEngineInstallItem *item_tmp = g_ptr_array_index (items, j);
+			if (!fu_engine_install_tasks_conflict (self, item->task, item_tmp->task))
+				continue;
+			g_ptr_array_add (item->dependents, item_tmp);
+			item_tmp->deps_remaining++;
+		}
+	}
+
+	/* the main thread keeps handling hotplug events and any device
+	 * signals emitted by the plugins while the workers are running */
+	helper.pool = g_thread_pool_new (fu_engine_install_item_thread_cb,
+					 &helper, self->install_threads,
+					 FALSE, error);
+	if (helper.pool == NULL)
+		return FALSE;
+	self->main_ctx = g_main_context_ref (g_main_context_default ());
+	self->main_thread = g_thread_self ();
+	for (guint i = 0; i < plugins->len; i++) {
+		FuPlugin *plugin = g_ptr_array_index (plugins, i);
+		fu_plugin_set_main_context (plugin, self->main_ctx);
+	}
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineInstallItem *item = g_ptr_array_index (items, i);
+		if (item->deps_remaining == 0)
+			fu_engine_install_item_queue (item);
+	}
+	while (helper.pending > 0)
+		g_main_context_iteration (self->main_ctx, TRUE);
+	g_thread_pool_free (helper.pool, FALSE, TRUE);
+	for (guint i = 0; i < plugins->len; i++) {
+		FuPlugin *plugin = g_ptr_array_index (plugins, i);
+		fu_plugin_set_main_context (plugin, main_ctx_old);
+	}
+	g_main_context_unref (self->main_ctx);
+	self->main_ctx = main_ctx_old;
+	self->main_thread = main_thread_old;
+
+	/* return the first error in the sorted order */
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineInstallItem *item = g_ptr_array_index (items, i);
+		if (item->error != NULL) {
+			g_propagate_error (error, g_steal_pointer (&item->error));
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+static gboolean
+fu_engine_install_tasks_internal (FuEngine *self,
+				  GPtrArray *install_tasks,
+				  GBytes *blob_cab,
+				  FwupdInstallFlags flags,
+				  GError **error)
 {
 	g_autoptr(FuIdleLocker) locker = NULL;
 	g_autoptr(GPtrArray) devices = NULL;
@@ -1240,9 +1644,10 @@ fu_engine_install_tasks (FuEngine *self,
 	}
 
 	/* all authenticated, so install all the things */
-	for (guint i = 0; i < install_tasks->len; i++) {
-		FuInstallTask *task = g_ptr_array_index (install_tasks, i);
-		if (!fu_engine_install (self, task, blob_cab, flags, error)) {
+	if (self->install_threads > 1 && install_tasks->len > 1) {
+		g_debug ("installing using %u threads", self->install_threads);
+		if (!fu_engine_install_tasks_parallel (self, install_tasks,
+						       blob_cab, flags, error)) {
 			g_autoptr(GError) error_local = NULL;
 			if (!fu_engine_composite_cleanup (self, devices, &error_local)) {
 				g_warning ("failed to cleanup failed composite action: %s",
@@ -1250,6 +1655,18 @@ fu_engine_install_tasks (FuEngine *self,
 			}
 			return FALSE;
 		}
+	} else {
+		for (guint i = 0; i < install_tasks->len; i++) {
+			FuInstallTask *task = g_ptr_array_index (install_tasks, i);
+			if (!fu_engine_install (self, task, blob_cab, flags, error)) {
+				g_autoptr(GError) error_local = NULL;
+				if (!fu_engine_composite_cleanup (self, devices, &error_local)) {
+					g_warning ("failed to cleanup failed composite action: %s",
+						   error_local->message);
+				}
+				return FALSE;
+			}
+		}
 	}
 
 	/* get a new list of devices in case they replugged */
@@ -1280,6 +1697,59 @@ fu_engine_install_tasks (FuEngine *self,
 	return TRUE;
 }
 
+/**
+ * fu_engine_install_tasks:
+ * @self: A #FuEngine
+ * @install_tasks: (element-type FuInstallTask): A #FuDevice
+ * @blob_cab: The #GBytes of the .cab file
+ * @flags: The #FwupdInstallFlags, e.g. %FWUPD_DEVICE_FLAG_UPDATABLE
+ * @error: A #GError, or %NULL
+ *
+ * Installs a specific firmware file on one or more install tasks.
+ *
+ * By this point all the requirements and tests should have been done in
+ * fu_engine_check_requirements() so this should not fail before running
+ * the plugin loader.
+ *
+ * Returns: %TRUE for success
+ **/
+gboolean
+fu_engine_install_tasks (FuEngine *self,
+			 GPtrArray *install_tasks,
+			 GBytes *blob_cab,
+			 FwupdInstallFlags flags,
+			 GError **error)
+{
+	gboolean ret;
+
+	g_return_val_if_fail (FU_IS_ENGINE (self), FALSE);
+	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+	/* the main loop is iterated when installing in threads, so refuse
+	 * an install started from a nested D-Bus method call */
+	if (!fu_engine_ensure_not_installing (self, error))
+		return FALSE;
+	self->installing = TRUE;
+	ret = fu_engine_install_tasks_internal (self, install_tasks, blob_cab,
+						flags, error);
+	self->installing = FALSE;
+	return ret;
+}
+
+static void
+fu_engine_prune_history (FuEngine *self)
+{
+	guint days = fu_config_get_history_retention_days (self->config);
+	guint64 now = (guint64) g_get_real_time () / G_USEC_PER_SEC;
+	g_autoptr(GError) error_local = NULL;
+
+	if (days == 0)
+		return;
+	if (!fu_history_prune (self->history, now - ((guint64) days * 24 * 60 * 60),
+			       &error_local))
+		g_warning ("failed to prune history: %s", error_local->message);
+}
+
 /**
  * fu_engine_install:
  * @self: A #FuEngine
@@ -1436,6 +1906,38 @@ fu_engine_get_device_by_id (FuEngine *self, const gchar *device_id, GError **err
 	return g_steal_pointer (&device2);
 }
 
+/* the plugin hooks are never run concurrently, even when the devices are */
+static gboolean
+fu_engine_update_prepare (FuEngine *self,
+			  FwupdInstallFlags flags,
+			  FuDevice *device,
+			  GError **error)
+{
+	GPtrArray *plugins = fu_plugin_list_get_all (self->plugin_list);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->update_hooks_mutex);
+	for (guint j = 0; j < plugins->len; j++) {
+		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
+		if (!fu_plugin_runner_update_prepare (plugin_tmp, flags, device, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static void
+fu_engine_update_cleanup (FuEngine *self, FwupdInstallFlags flags, FuDevice *device)
+{
+	GPtrArray *plugins = fu_plugin_list_get_all (self->plugin_list);
+	g_autoptr(GMutexLocker) locker = g_mutex_locker_new (&self->update_hooks_mutex);
+	for (guint j = 0; j < plugins->len; j++) {
+		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
+		g_autoptr(GError) error_cleanup = NULL;
+		if (!fu_plugin_runner_update_cleanup (plugin_tmp, flags, device, &error_cleanup)) {
+			g_warning ("failed to update-cleanup: %s",
+				   error_cleanup->message);
+		}
+	}
+}
+
 gboolean
 fu_engine_install_blob (FuEngine *self,
 			FuDevice *device_orig,
@@ -1446,7 +1948,6 @@ fu_engine_install_blob (FuEngine *self,
 			GError **error)
 {
 	FuPlugin *plugin;
-	GPtrArray *plugins;
 	g_autofree gchar *device_id_orig = NULL;
 	g_autofree gchar *version_orig = NULL;
 	g_autoptr(FuDevice) device = g_object_ref (device_orig);
@@ -1490,12 +1991,8 @@ fu_engine_install_blob (FuEngine *self,
 	version_orig = g_strdup (fu_device_get_version (device));
 
 	/* signal to all the plugins the update is about to happen */
-	plugins = fu_plugin_list_get_all (self->plugin_list);
-	for (guint j = 0; j < plugins->len; j++) {
-		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
-		if (!fu_plugin_runner_update_prepare (plugin_tmp, flags, device, error))
-			return FALSE;
-	}
+	if (!fu_engine_update_prepare (self, flags, device, error))
+		return FALSE;
 
 	/* save the chosen device ID in case the device goes away */
 	device_id_orig = g_strdup (fu_device_get_id (device));
@@ -1519,7 +2016,7 @@ fu_engine_install_blob (FuEngine *self,
 	if ((flags & FWUPD_INSTALL_FLAG_NO_HISTORY) == 0) {
 		const gchar *tmp;
 		g_autofree gchar *checksum = NULL;
-		checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, blob_cab);
+		checksum = fu_engine_get_container_checksum (blob_cab);
 		fwupd_release_set_version (release_history, version);
 		fwupd_release_add_checksum (release_history, checksum);
 		fu_device_set_update_state (device, FWUPD_UPDATE_STATE_FAILED);
@@ -1596,18 +2093,7 @@ fu_engine_install_blob (FuEngine *self,
 			g_warning ("failed to attach device after failed update: %s",
 				   error_attach->message);
 		}
-		for (guint j = 0; j < plugins->len; j++) {
-			FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
-			g_autoptr(GError) error_cleanup = NULL;
-			if (!fu_plugin_runner_update_cleanup (plugin_tmp,
-							      flags,
-							      device,
-							      &error_cleanup)) {
-				g_warning ("failed to update-cleanup "
-					   "after failed update: %s",
-					   error_cleanup->message);
-			}
-		}
+		fu_engine_update_cleanup (self, flags, device);
 		fu_device_set_status (device, FWUPD_STATUS_IDLE);
 		return FALSE;
 	}
@@ -1651,14 +2137,7 @@ fu_engine_install_blob (FuEngine *self,
 	}
 
 	/* signal to all the plugins the update has happened */
-	for (guint j = 0; j < plugins->len; j++) {
-		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
-		g_autoptr(GError) error_cleanup = NULL;
-		if (!fu_plugin_runner_update_cleanup (plugin_tmp, flags, device, &error_cleanup)) {
-			g_warning ("failed to update-cleanup: %s",
-				   error_cleanup->message);
-		}
-	}
+	fu_engine_update_cleanup (self, flags, device);
 
 	/* make the UI update */
 	fu_engine_set_status (self, FWUPD_STATUS_IDLE);
@@ -1704,11 +2183,15 @@ fu_engine_install_blob (FuEngine *self,
 
 	/* success */
 	fu_device_set_update_state (device, FWUPD_UPDATE_STATE_SUCCESS);
-	if ((flags & FWUPD_INSTALL_FLAG_NO_HISTORY) == 0 &&
-	    !fu_history_modify_device (self->history, device,
-				       FU_HISTORY_FLAGS_MATCH_NEW_VERSION,
-				       error))
-		return FALSE;
+	if ((flags & FWUPD_INSTALL_FLAG_NO_HISTORY) == 0) {
+		if (!fu_history_modify_device (self->history, device,
+					       FU_HISTORY_FLAGS_MATCH_NEW_VERSION,
+					       error))
+			return FALSE;
+
+		/* the daemon may not be restarted for a long time */
+		fu_engine_prune_history (self);
+	}
 	return TRUE;
 }
 
@@ -1771,7 +2254,8 @@ fu_engine_set_silo (FuEngine *self, XbSilo *silo)
 {
 	g_return_if_fail (FU_IS_ENGINE (self));
 	g_return_if_fail (XB_IS_SILO (silo));
-	g_set_object (&self->silo, silo);
+	fu_engine_silos_clear (self);
+	g_ptr_array_add (self->silos, fu_engine_silo_new (silo, NULL));
 }
 
 static gboolean
@@ -1780,7 +2264,7 @@ fu_engine_is_device_supported (FuEngine *self, FuDevice *device)
 	g_autoptr(XbNode) component = NULL;
 
 	/* sanity check */
-	if (self->silo == NULL) {
+	if (self->silos == NULL) {
 		g_critical ("FuEngine silo not set up");
 		return FALSE;
 	}
@@ -1790,7 +2274,7 @@ fu_engine_is_device_supported (FuEngine *self, FuDevice *device)
 		return FALSE;
 
 	/* match the GUIDs in the XML */
-	component = fu_engine_store_get_app_by_guids (self->silo, device);
+	component = fu_engine_store_get_app_by_guids (self, device);
 	if (component == NULL)
 		return FALSE;
 
@@ -1809,19 +2293,43 @@ fu_engine_appstream_upgrade_cb (XbBuilderFixup *self,
 	return TRUE;
 }
 
-static gboolean
-fu_engine_load_metadata_store (FuEngine *self, GError **error)
+/* uses the mtime and size of the source file so unchanged remotes are not
+ * recompiled or even re-mapped when any other remote is refreshed */
+static gchar *
+fu_engine_get_remote_silo_key (const gchar *path, GError **error)
 {
-	GPtrArray *remotes;
+	g_autoptr(GFile) file = g_file_new_for_path (path);
+	g_autoptr(GFileInfo) info = NULL;
+	info = g_file_query_info (file,
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED ","
+				  G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC ","
+				  G_FILE_ATTRIBUTE_STANDARD_SIZE,
+				  G_FILE_QUERY_INFO_NONE,
+				  NULL, error);
+	if (info == NULL)
+		return NULL;
+
+	/* a metadata refresh of the same size can land in the same second */
+	return g_strdup_printf ("%" G_GUINT64_FORMAT ".%06u:%" G_GINT64_FORMAT,
+				g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+				g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+				g_file_info_get_size (info));
+}
+
+static XbSilo *
+fu_engine_load_metadata_remote (FuEngine *self, FwupdRemote *remote, GError **error)
+{
+	const gchar *path = fwupd_remote_get_filename_cache (remote);
+	g_autofree gchar *basename = NULL;
 	g_autofree gchar *cachedirpkg = NULL;
 	g_autofree gchar *xmlbfn = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (path);
 	g_autoptr(GFile) xmlb = NULL;
-	g_autoptr(GPtrArray) devices = NULL;
-	g_autoptr(GPtrArray) components = NULL;
 	g_autoptr(XbBuilder) builder = xb_builder_new ();
-
-	/* clear existing silo */
-	g_clear_object (&self->silo);
+	g_autoptr(XbBuilderFixup) fixup = NULL;
+	g_autoptr(XbBuilderNode) custom = NULL;
+	g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
+	g_autoptr(XbSilo) silo = NULL;
 
 	/* verbose profiling */
 	if (g_getenv ("FWUPD_VERBOSE") != NULL) {
@@ -1830,17 +2338,107 @@ fu_engine_load_metadata_store (FuEngine *self, GError **error)
 					      XB_SILO_PROFILE_FLAG_DEBUG);
 	}
 
-	/* load each enabled metadata file */
+	/* load the metadata file */
+	if (!xb_builder_source_load_file (source, file,
+					  XB_BUILDER_SOURCE_FLAG_NONE,
+					  NULL, error))
+		return NULL;
+
+	/* fix up any legacy installed files */
+	fixup = xb_builder_fixup_new ("AppStreamUpgrade",
+				      fu_engine_appstream_upgrade_cb,
+				      self, NULL);
+	xb_builder_fixup_set_max_depth (fixup, 3);
+	xb_builder_source_add_fixup (source, fixup);
+
+	/* save the remote-id in the custom metadata space */
+	custom = xb_builder_node_new ("custom");
+	xb_builder_node_insert_text (custom,
+				     "value", path,
+				     "key", "fwupd::FilenameCache",
+				     NULL);
+	xb_builder_node_insert_text (custom,
+				     "value", fwupd_remote_get_id (remote),
+				     "key", "fwupd::RemoteId",
+				     NULL);
+	xb_builder_source_set_info (source, custom);
+	xb_builder_import_source (builder, source);
+
+	/* only recompiled if the source has changed */
+	cachedirpkg = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	basename = g_strdup_printf ("metadata-%s.xmlb", fwupd_remote_get_id (remote));
+	xmlbfn = g_build_filename (cachedirpkg, basename, NULL);
+	xmlb = g_file_new_for_path (xmlbfn);
+	silo = xb_builder_ensure (builder, xmlb,
+				  XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID,
+				  NULL, error);
+	if (silo == NULL)
+		return NULL;
+
+	/* build the index */
+	if (!xb_silo_query_build_index (silo,
+					"components/component/provides/firmware",
+					"type", error))
+		return NULL;
+	if (!xb_silo_query_build_index (silo,
+					"components/component/provides/firmware",
+					NULL, error))
+		return NULL;
+	return g_steal_pointer (&silo);
+}
+
+/* the compiled silos of remotes that are disabled or removed are never used */
+static void
+fu_engine_prune_metadata_silos (FuEngine *self)
+{
+	const gchar *fn;
+	g_autofree gchar *cachedirpkg = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	g_autoptr(GDir) dir = NULL;
+
+	dir = g_dir_open (cachedirpkg, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((fn = g_dir_read_name (dir)) != NULL) {
+		g_autofree gchar *filename = NULL;
+		g_autofree gchar *remote_id = NULL;
+		if (!g_str_has_prefix (fn, "metadata-") ||
+		    !g_str_has_suffix (fn, ".xmlb"))
+			continue;
+		remote_id = g_strndup (fn + strlen ("metadata-"),
+				       strlen (fn) - strlen ("metadata-") - strlen (".xmlb"));
+		if (g_hash_table_contains (self->remote_silos, remote_id))
+			continue;
+		filename = g_build_filename (cachedirpkg, fn, NULL);
+		g_debug ("removing %s as remote %s is not in use", filename, remote_id);
+		if (g_unlink (filename) != 0)
+			g_warning ("failed to delete %s", filename);
+	}
+}
+
+static gboolean
+fu_engine_load_metadata_store (FuEngine *self, GError **error)
+{
+	GPtrArray *remotes;
+	guint cnt = 0;
+	g_autoptr(GHashTable) remote_silos = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+
+	/* drop archives parsed using the previous remote configuration */
+	fu_cab_cache_invalidate (self->cab_cache);
+
+	/* load each enabled metadata file, in priority order */
+	fu_engine_silos_clear (self);
+	remote_silos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					      (GDestroyNotify) g_object_unref);
 	remotes = fu_config_get_remotes (self->config);
 	for (guint i = 0; i < remotes->len; i++) {
+		FwupdRemote *remote = g_ptr_array_index (remotes, i);
+		FuEngineSilo *item_old;
 		const gchar *path = NULL;
+		g_autofree gchar *key = NULL;
+		g_autoptr(FuEngineSilo) item = NULL;
 		g_autoptr(GError) error_local = NULL;
-		g_autoptr(GFile) file = NULL;
-		g_autoptr(XbBuilderFixup) fixup = NULL;
-		g_autoptr(XbBuilderNode) custom = NULL;
-		g_autoptr(XbBuilderSource) source = xb_builder_source_new ();
 
-		FwupdRemote *remote = g_ptr_array_index (remotes, i);
 		if (!fwupd_remote_get_enabled (remote)) {
 			g_debug ("remote %s not enabled, so skipping",
 				 fwupd_remote_get_id (remote));
@@ -1851,65 +2449,48 @@ fu_engine_load_metadata_store (FuEngine *self, GError **error)
 			g_debug ("no %s, so skipping", path);
 			continue;
 		}
-
-		/* save the remote-id in the custom metadata space */
-		file = g_file_new_for_path (path);
-		if (!xb_builder_source_load_file (source, file,
-						  XB_BUILDER_SOURCE_FLAG_NONE,
-						  NULL, &error_local)) {
+		key = fu_engine_get_remote_silo_key (path, &error_local);
+		if (key == NULL) {
 			g_warning ("failed to load remote %s: %s",
 				   fwupd_remote_get_id (remote),
 				   error_local->message);
 			continue;
 		}
 
-		/* fix up any legacy installed files */
-		fixup = xb_builder_fixup_new ("AppStreamUpgrade",
-					      fu_engine_appstream_upgrade_cb,
-					      self, NULL);
-		xb_builder_fixup_set_max_depth (fixup, 3);
-		xb_builder_source_add_fixup (source, fixup);
-
-		/* add metadata */
-		custom = xb_builder_node_new ("custom");
-		xb_builder_node_insert_text (custom,
-					     "value", path,
-					     "key", "fwupd::FilenameCache",
-					     NULL);
-		xb_builder_node_insert_text (custom,
-					     "value", fwupd_remote_get_id (remote),
-					     "key", "fwupd::RemoteId",
-					     NULL);
-		xb_builder_source_set_info (source, custom);
-
-		/* we need to watch for changes? */
-		xb_builder_import_source (builder, source);
+		/* reuse if unchanged */
+		item_old = g_hash_table_lookup (self->remote_silos,
+						fwupd_remote_get_id (remote));
+		if (item_old != NULL &&
+		    g_strcmp0 (fu_engine_silo_get_key (item_old), key) == 0) {
+			item = g_object_ref (item_old);
+		} else {
+			g_autoptr(XbSilo) silo = NULL;
+			silo = fu_engine_load_metadata_remote (self, remote, &error_local);
+			if (silo == NULL) {
+				g_warning ("failed to load remote %s: %s",
+					   fwupd_remote_get_id (remote),
+					   error_local->message);
+				continue;
+			}
+			item = fu_engine_silo_new (silo, key);
+		}
+		g_ptr_array_add (self->silos, g_object_ref (item));
+		g_hash_table_insert (remote_silos,
+				     g_strdup (fwupd_remote_get_id (remote)),
+				     g_steal_pointer (&item));
 	}
 
-	/* ensure silo is up to date */
-	cachedirpkg = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
-	xmlbfn = g_build_filename (cachedirpkg, "metadata.xmlb", NULL);
-	xmlb = g_file_new_for_path (xmlbfn);
-	self->silo = xb_builder_ensure (builder, xmlb,
-					XB_BUILDER_COMPILE_FLAG_IGNORE_INVALID,
-					NULL, error);
-	if (self->silo == NULL)
-		return FALSE;
+	/* drop any disabled or removed remotes */
+	g_hash_table_unref (self->remote_silos);
+	self->remote_silos = g_steal_pointer (&remote_silos);
+	fu_engine_prune_metadata_silos (self);
 
 	/* print what we've got */
-	components = xb_silo_query (self->silo, "components/component", 0, NULL);
-	if (components != NULL)
-		g_debug ("%u components now in silo", components->len);
-
-	/* build the index */
-	if (!xb_silo_query_build_index (self->silo,
-					"components/component/provides/firmware",
-					"type", error))
-		return FALSE;
-	if (!xb_silo_query_build_index (self->silo,
-					"components/component/provides/firmware",
-					NULL, error))
-		return FALSE;
+	for (guint i = 0; i < self->silos->len; i++) {
+		FuEngineSilo *item = g_ptr_array_index (self->silos, i);
+		cnt += fu_engine_silo_get_guid_count (item);
+	}
+	g_debug ("%u GUIDs now in %u silos", cnt, self->silos->len);
 
 	/* did any devices SUPPORTED state change? */
 	devices = fu_device_list_get_all (self->device_list);
@@ -1933,9 +2514,55 @@ fu_engine_load_metadata_store (FuEngine *self, GError **error)
 	return TRUE;
 }
 
+/* the keyring is only created and loaded if the result is not cached */
+static FuKeyringResult *
+fu_engine_verify_metadata (FuEngine *self,
+			   FwupdKeyringKind keyring_kind,
+			   FuKeyring **kr,
+			   GBytes *blob,
+			   GBytes *blob_sig,
+			   GError **error)
+{
+	g_autofree gchar *key = NULL;
+	g_autoptr(FuKeyringResult) kr_result = NULL;
+
+	/* already verified using the same public keys */
+	key = fu_keyring_cache_build_key (self->keyring_cache,
+					  fwupd_keyring_kind_to_string (keyring_kind),
+					  blob, blob_sig);
+	kr_result = fu_keyring_cache_lookup (self->keyring_cache, key);
+	if (kr_result != NULL) {
+		g_debug ("using cached keyring result");
+		return g_steal_pointer (&kr_result);
+	}
+
+	/* set up keyring */
+	if (*kr == NULL) {
+		g_autofree gchar *pki_dir = NULL;
+		g_autofree gchar *sysconfdir = NULL;
+		g_autoptr(FuKeyring) kr_tmp = NULL;
+		kr_tmp = fu_keyring_create_for_kind (keyring_kind, error);
+		if (kr_tmp == NULL)
+			return NULL;
+		if (!fu_keyring_setup (kr_tmp, error))
+			return NULL;
+		sysconfdir = fu_common_get_path (FU_PATH_KIND_SYSCONFDIR);
+		pki_dir = g_build_filename (sysconfdir, "pki", "fwupd-metadata", NULL);
+		if (!fu_keyring_add_public_keys (kr_tmp, pki_dir, error))
+			return NULL;
+		*kr = g_steal_pointer (&kr_tmp);
+	}
+	kr_result = fu_keyring_verify_data (*kr, blob, blob_sig, error);
+	if (kr_result == NULL)
+		return NULL;
+	fu_keyring_cache_add (self->keyring_cache, key, kr_result);
+	return g_steal_pointer (&kr_result);
+}
+
 static FuKeyringResult *
 fu_engine_get_existing_keyring_result (FuEngine *self,
-				       FuKeyring *kr,
+				       FwupdKeyringKind keyring_kind,
+				       FuKeyring **kr,
 				       FwupdRemote *remote,
 				       GError **error)
 {
@@ -1947,7 +2574,7 @@ fu_engine_get_existing_keyring_result (FuEngine *self,
 	blob_sig = fu_common_get_contents_bytes (fwupd_remote_get_filename_cache_sig (remote), error);
 	if (blob_sig == NULL)
 		return NULL;
-	return fu_keyring_verify_data (kr, blob, blob_sig, error);
+	return fu_engine_verify_metadata (self, keyring_kind, kr, blob, blob_sig, error);
 }
 
 /**
@@ -1974,8 +2601,6 @@ fu_engine_update_metadata (FuEngine *self, const gchar *remote_id,
 	g_autoptr(GBytes) bytes_sig = NULL;
 	g_autoptr(GInputStream) stream_fd = NULL;
 	g_autoptr(GInputStream) stream_sig = NULL;
-	g_autofree gchar *pki_dir = NULL;
-	g_autofree gchar *sysconfdir = NULL;
 
 	g_return_val_if_fail (FU_IS_ENGINE (self), FALSE);
 	g_return_val_if_fail (remote_id != NULL, FALSE);
@@ -1987,6 +2612,10 @@ fu_engine_update_metadata (FuEngine *self, const gchar *remote_id,
 	stream_fd = g_unix_input_stream_new (fd, TRUE);
 	stream_sig = g_unix_input_stream_new (fd_sig, TRUE);
 
+	/* the silo would be replaced underneath the install */
+	if (!fu_engine_ensure_not_installing (self, error))
+		return FALSE;
+
 	/* check remote is valid */
 	remote = fu_config_get_remote_by_id (self->config, remote_id);
 	if (remote == NULL) {
@@ -2021,22 +2650,16 @@ fu_engine_update_metadata (FuEngine *self, const gchar *remote_id,
 		g_autoptr(FuKeyringResult) kr_result = NULL;
 		g_autoptr(FuKeyringResult) kr_result_old = NULL;
 		g_autoptr(GError) error_local = NULL;
-		kr = fu_keyring_create_for_kind (keyring_kind, error);
-		if (kr == NULL)
-			return FALSE;
-		if (!fu_keyring_setup (kr, error))
-			return FALSE;
-		sysconfdir = fu_common_get_path (FU_PATH_KIND_SYSCONFDIR);
-		pki_dir = g_build_filename (sysconfdir, "pki", "fwupd-metadata", NULL);
-		if (!fu_keyring_add_public_keys (kr, pki_dir, error))
-			return FALSE;
-		kr_result = fu_keyring_verify_data (kr, bytes_raw, bytes_sig, error);
+		kr_result = fu_engine_verify_metadata (self, keyring_kind, &kr,
+						       bytes_raw, bytes_sig, error);
 		if (kr_result == NULL)
 			return FALSE;
 
 		/* verify the metadata was signed later than the existing
 		 * metadata for this remote to mitigate a rollback attack */
-		kr_result_old = fu_engine_get_existing_keyring_result (self, kr,
+		kr_result_old = fu_engine_get_existing_keyring_result (self,
+								       keyring_kind,
+								       &kr,
 								       remote,
 								       &error_local);
 		if (kr_result_old == NULL) {
@@ -2079,7 +2702,71 @@ fu_engine_update_metadata (FuEngine *self, const gchar *remote_id,
 						   bytes_sig, error))
 			return FALSE;
 	}
-	return fu_engine_load_metadata_store (self, error);
+	return fu_engine_load_metadata_store (self, error);
+}
+
+/* the extracted payloads may reference the archive data, so count both */
+static guint64
+fu_engine_get_silo_size (XbSilo *silo, GBytes *blob_cab)
+{
+	guint64 size = g_bytes_get_size (blob_cab);
+	g_autoptr(GPtrArray) releases = NULL;
+
+	releases = xb_silo_query (silo, "component/releases/release", 0, NULL);
+	if (releases == NULL)
+		return size;
+	for (guint i = 0; i < releases->len; i++) {
+		XbNode *release = g_ptr_array_index (releases, i);
+		guint64 tmp64;
+		tmp64 = xb_node_query_text_as_uint (release, "size[@type='installed']", NULL);
+		if (tmp64 != G_MAXUINT64) {
+			size += tmp64;
+		} else {
+			GBytes *sz = xb_node_get_data (release, "fwupd::ReleaseSize");
+			if (sz != NULL) {
+				const guint64 *sizeptr = g_bytes_get_data (sz, NULL);
+				size += *sizeptr;
+			}
+		}
+	}
+	return size;
+}
+
+static XbSilo *
+fu_engine_get_silo_from_blob_with_checksum (FuEngine *self,
+					    GBytes *blob_cab,
+					    const gchar *csum,
+					    GError **error)
+{
+	g_autoptr(XbSilo) silo = NULL;
+
+	/* parsed recently */
+	silo = fu_cab_cache_lookup (self->cab_cache, csum);
+	if (silo != NULL) {
+		g_debug ("using cached archive %s", csum);
+		return g_steal_pointer (&silo);
+	}
+
+	/* load file */
+	fu_engine_set_status (self, FWUPD_STATUS_DECOMPRESSING);
+	silo = fu_common_cab_build_silo (blob_cab,
+					 fu_engine_get_archive_size_max (self),
+					 error);
+	if (silo == NULL)
+		return NULL;
+
+	/* build the index */
+	if (!xb_silo_query_build_index (silo, "component/provides/firmware",
+					"type", error))
+		return NULL;
+	if (!xb_silo_query_build_index (silo, "component/provides/firmware",
+					NULL, error))
+		return NULL;
+
+	fu_cab_cache_add (self->cab_cache, csum, silo,
+			  fu_engine_get_silo_size (silo, blob_cab));
+	fu_engine_set_status (self, FWUPD_STATUS_IDLE);
+	return g_steal_pointer (&silo);
 }
 
 /**
@@ -2088,29 +2775,22 @@ fu_engine_update_metadata (FuEngine *self, const gchar *remote_id,
  * @blob_cab: A #GBytes
  * @error: A #GError, or %NULL
  *
- * Creates a silo from a .cab file blob.
+ * Creates a silo from a .cab file blob, reusing the silo from a previous call
+ * with the same archive if possible.
  *
- * Returns: (transfer container): a #XbSilo, or %NULL
+ * Returns: (transfer full): a #XbSilo, or %NULL
  **/
 XbSilo *
 fu_engine_get_silo_from_blob (FuEngine *self, GBytes *blob_cab, GError **error)
 {
-	g_autoptr(XbSilo) silo = NULL;
+	g_autofree gchar *csum = NULL;
 
 	g_return_val_if_fail (FU_IS_ENGINE (self), NULL);
 	g_return_val_if_fail (blob_cab != NULL, NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	/* load file */
-	fu_engine_set_status (self, FWUPD_STATUS_DECOMPRESSING);
-	silo = fu_common_cab_build_silo (blob_cab,
-					 fu_engine_get_archive_size_max (self),
-					 error);
-	if (silo == NULL)
-		return NULL;
-
-	fu_engine_set_status (self, FWUPD_STATUS_IDLE);
-	return g_steal_pointer (&silo);
+	csum = fu_engine_get_container_checksum (blob_cab);
+	return fu_engine_get_silo_from_blob_with_checksum (self, blob_cab, csum, error);
 }
 
 static FwupdDevice *
@@ -2247,7 +2927,8 @@ fu_engine_get_details (FuEngine *self, gint fd, GError **error)
 					  error);
 	if (blob == NULL)
 		return NULL;
-	silo = fu_engine_get_silo_from_blob (self, blob, error);
+	csum = fu_engine_get_container_checksum (blob);
+	silo = fu_engine_get_silo_from_blob_with_checksum (self, blob, csum, error);
 	if (silo == NULL)
 		return NULL;
 	components = xb_silo_query (silo, "component", 0, &error_local);
@@ -2260,16 +2941,7 @@ fu_engine_get_details (FuEngine *self, gint fd, GError **error)
 		return NULL;
 	}
 
-	/* build the index */
-	if (!xb_silo_query_build_index (silo, "component/provides/firmware",
-					"type", error))
-		return FALSE;
-	if (!xb_silo_query_build_index (silo, "component/provides/firmware",
-					NULL, error))
-		return FALSE;
-
 	/* does this exist in any enabled remote */
-	csum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, blob);
 	remote_id = fu_engine_get_remote_id_for_checksum (self, csum);
 
 	/* create results with all the metadata in */
@@ -2356,23 +3028,39 @@ fu_engine_get_device (FuEngine *self, const gchar *device_id, GError **error)
 }
 
 /**
- * fu_engine_get_history:
+ * fu_engine_get_history_filtered:
  * @self: A #FuEngine
+ * @device_id: A device ID, or %NULL for all devices
+ * @update_state: A #FwupdUpdateState, or %FWUPD_UPDATE_STATE_UNKNOWN for any
+ * @modified_min: The earliest modification time in seconds, or 0
+ * @modified_max: The latest modification time in seconds, or 0
+ * @offset: The number of matching entries to skip
+ * @limit: The maximum number of entries to return, or 0 for no limit
  * @error: A #GError, or %NULL
  *
- * Gets the list of history.
+ * Gets a page of the history, oldest first.
  *
  * Returns: (transfer container) (element-type FwupdDevice): results
  **/
 GPtrArray *
-fu_engine_get_history (FuEngine *self, GError **error)
+fu_engine_get_history_filtered (FuEngine *self,
+				const gchar *device_id,
+				FwupdUpdateState update_state,
+				guint64 modified_min,
+				guint64 modified_max,
+				guint offset,
+				guint limit,
+				GError **error)
 {
 	g_autoptr(GPtrArray) devices = NULL;
 
 	g_return_val_if_fail (FU_IS_ENGINE (self), NULL);
 	g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-	devices = fu_history_get_devices (self->history, error);
+	devices = fu_history_get_devices_filtered (self->history, device_id,
+						   update_state,
+						   modified_min, modified_max,
+						   offset, limit, error);
 	if (devices == NULL)
 		return NULL;
 	if (devices->len == 0) {
@@ -2410,6 +3098,23 @@ fu_engine_get_history (FuEngine *self, GError **error)
 	return g_steal_pointer (&devices);
 }
 
+/**
+ * fu_engine_get_history:
+ * @self: A #FuEngine
+ * @error: A #GError, or %NULL
+ *
+ * Gets the list of history.
+ *
+ * Returns: (transfer container) (element-type FwupdDevice): results
+ **/
+GPtrArray *
+fu_engine_get_history (FuEngine *self, GError **error)
+{
+	return fu_engine_get_history_filtered (self, NULL,
+					       FWUPD_UPDATE_STATE_UNKNOWN,
+					       0, 0, 0, 0, error);
+}
+
 /**
  * fu_engine_get_remotes:
  * @self: A #FuEngine
@@ -2470,13 +3175,39 @@ fu_engine_get_remote_by_id (FuEngine *self, const gchar *remote_id, GError **err
 }
 
 
+typedef struct {
+	FwupdRelease	*rel;	/* no ref */
+	FuVersionKey	 key;
+} FuEngineSortHelper;
+
 static gint
-fu_engine_sort_releases_cb (gconstpointer a, gconstpointer b)
+fu_engine_sort_releases_cb (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const FuEngineSortHelper *helper_a = a;
+	const FuEngineSortHelper *helper_b = b;
+	return fu_common_version_key_cmp (&helper_b->key, &helper_a->key);
+}
+
+/* sorts newest first, parsing each version only once */
+static void
+fu_engine_sort_releases (GPtrArray *releases)
 {
-	FwupdRelease *rel_a = FWUPD_RELEASE (*((FwupdRelease **) a));
-	FwupdRelease *rel_b = FWUPD_RELEASE (*((FwupdRelease **) b));
-	return fu_common_vercmp (fwupd_release_get_version (rel_b),
-				fwupd_release_get_version (rel_a));
+	g_autofree FuEngineSortHelper *helpers = NULL;
+
+	if (releases->len < 2)
+		return;
+	helpers = g_new (FuEngineSortHelper, releases->len);
+	for (guint i = 0; i < releases->len; i++) {
+		FwupdRelease *rel = g_ptr_array_index (releases, i);
+		helpers[i].rel = rel;
+		fu_common_version_key_init (&helpers[i].key,
+					    fwupd_release_get_version (rel));
+	}
+	g_qsort_with_data (helpers, (gint) releases->len,
+			   sizeof(FuEngineSortHelper),
+			   fu_engine_sort_releases_cb, NULL);
+	for (guint i = 0; i < releases->len; i++)
+		releases->pdata[i] = helpers[i].rel;
 }
 
 static gboolean
@@ -2574,7 +3305,7 @@ fu_engine_get_releases_for_device (FuEngine *self, FuDevice *device, GError **er
 					"provides/firmware[@type=$'flashed'][text()=$'%s']/"
 					"../..", guid);
 	}
-	components = xb_silo_query (self->silo, xpath->str, 0, &error_local);
+	components = fu_engine_silos_query (self, xpath->str, &error_local);
 	if (components == NULL) {
 		if (g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_NOT_FOUND) ||
 		    g_error_matches (error_local, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT)) {
@@ -2660,7 +3391,7 @@ fu_engine_get_releases (FuEngine *self, const gchar *device_id, GError **error)
 				     "No releases for device");
 		return NULL;
 	}
-	g_ptr_array_sort (releases, fu_engine_sort_releases_cb);
+	fu_engine_sort_releases (releases);
 	return g_steal_pointer (&releases);
 }
 
@@ -2753,7 +3484,7 @@ fu_engine_get_downgrades (FuEngine *self, const gchar *device_id, GError **error
 		}
 		return NULL;
 	}
-	g_ptr_array_sort (releases, fu_engine_sort_releases_cb);
+	fu_engine_sort_releases (releases);
 	return g_steal_pointer (&releases);
 }
 
@@ -2845,7 +3576,7 @@ fu_engine_get_upgrades (FuEngine *self, const gchar *device_id, GError **error)
 		}
 		return NULL;
 	}
-	g_ptr_array_sort (releases, fu_engine_sort_releases_cb);
+	fu_engine_sort_releases (releases);
 	return g_steal_pointer (&releases);
 }
 
@@ -2953,7 +3684,174 @@ fu_engine_plugins_setup (FuEngine *self)
 	}
 }
 
+typedef struct {
+	GMainContext		*main_ctx;
+	GThreadPool		*pool;
+	guint			 pending;
+} FuEngineColdplugHelper;
+
+typedef struct {
+	FuEngineColdplugHelper	*helper;
+	FuPlugin		*plugin;
+	GPtrArray		*dependents;	/* of FuEngineColdplugItem */
+	guint			 deps_remaining;
+	gboolean		 is_recoldplug;
+	GError			*error;
+} FuEngineColdplugItem;
+
+static void
+fu_engine_plugins_coldplug_result (FuPlugin *plugin, gboolean is_recoldplug, GError *error)
+{
+	if (is_recoldplug) {
+		g_message ("failed recoldplug: %s", error->message);
+		return;
+	}
+	fu_plugin_set_enabled (plugin, FALSE);
+	g_message ("disabling plugin because: %s", error->message);
+}
+
+static void
+fu_engine_plugins_coldplug_queue (FuEngineColdplugItem *item)
+{
+	g_autoptr(GError) error = NULL;
+	if (!g_thread_pool_push (item->helper->pool, item, &error))
+		g_warning ("failed to queue coldplug: %s", error->message);
+}
+
+/* runs in the main thread */
+static gboolean
+fu_engine_plugins_coldplug_done_cb (gpointer user_data)
+{
+	FuEngineColdplugItem *item = (FuEngineColdplugItem *) user_data;
+
+	/* unblock any plugins that have to be run after this one */
+	for (guint i = 0; i < item->dependents->len; i++) {
+		FuEngineColdplugItem *item_tmp = g_ptr_array_index (item->dependents, i);
+		if (--item_tmp->deps_remaining == 0)
+			fu_engine_plugins_coldplug_queue (item_tmp);
+	}
+	item->helper->pending--;
+	return G_SOURCE_REMOVE;
+}
+
+/* runs in a worker thread */
+static void
+fu_engine_plugins_coldplug_thread_cb (gpointer data, gpointer user_data)
+{
+	FuEngineColdplugItem *item = (FuEngineColdplugItem *) data;
+	FuEngineColdplugHelper *helper = (FuEngineColdplugHelper *) user_data;
+	if (item->is_recoldplug)
+		fu_plugin_runner_recoldplug (item->plugin, &item->error);
+	else
+		fu_plugin_runner_coldplug (item->plugin, &item->error);
+	fu_plugin_unlock_usb_context ();
+	g_main_context_invoke (helper->main_ctx, fu_engine_plugins_coldplug_done_cb, item);
+}
+
 static void
+fu_engine_coldplug_item_free (FuEngineColdplugItem *item)
+{
+	if (item->error != NULL)
+		g_error_free (item->error);
+	g_ptr_array_unref (item->dependents);
+	g_free (item);
+}
+
+static gboolean
+fu_engine_plugins_coldplug_parallel (FuEngine *self, GPtrArray *plugins, gboolean is_recoldplug)
+{
+	FuEngineColdplugHelper helper = { NULL };
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) items_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	g_autoptr(GPtrArray) items = NULL;
+
+	items = g_ptr_array_new_with_free_func ((GDestroyNotify) fu_engine_coldplug_item_free);
+	for (guint i = 0; i < plugins->len; i++) {
+		FuPlugin *plugin = g_ptr_array_index (plugins, i);
+		FuEngineColdplugItem *item = g_new0 (FuEngineColdplugItem, 1);
+		item->helper = &helper;
+		item->plugin = plugin;
+		item->is_recoldplug = is_recoldplug;
+		item->dependents = g_ptr_array_new ();
+		g_ptr_array_add (items, item);
+		g_hash_table_insert (items_hash,
+				     (gpointer) fu_plugin_get_name (plugin),
+				     GUINT_TO_POINTER (i + 1));
+	}
+
+	/* convert the plugin rules into a dependency graph; as the list has
+	 * already been depsolved every edge has to point forwards, and if not
+	 * we fall back to doing everything in the main thread */
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineColdplugItem *item = g_ptr_array_index (items, i);
+		for (guint k = 0; k < 2; k++) {
+			gboolean is_after = k == 0;
+			GPtrArray *deps = fu_plugin_get_rules (item->plugin,
+							       is_after ? FU_PLUGIN_RULE_RUN_AFTER :
+									  FU_PLUGIN_RULE_RUN_BEFORE);
+			for (guint j = 0; j < deps->len; j++) {
+				const gchar *plugin_name = g_ptr_array_index (deps, j);
+				FuEngineColdplugItem *dep;
+				guint idx = GPOINTER_TO_UINT (g_hash_table_lookup (items_hash, plugin_name));
+				if (idx == 0)
+					continue;
+				dep = g_ptr_array_index (items, idx - 1);
+				if (!fu_plugin_get_enabled (dep->plugin))
+					continue;
+				if (is_after ? idx - 1 >= i : idx - 1 <= i) {
+					g_warning ("plugin list not depsolved, "
+						   "not using threads for coldplug");
+					return FALSE;
+				}
+				if (is_after) {
+					g_ptr_array_add (dep->dependents, item);
+					item->deps_remaining++;
+				} else {
+					g_ptr_array_add (item->dependents, dep);
+					dep->deps_remaining++;
+				}
+			}
+		}
+	}
+
+	/* all plugin signals are proxied back to this thread */
+	helper.pool = g_thread_pool_new (fu_engine_plugins_coldplug_thread_cb,
+					 &helper, self->coldplug_threads,
+					 FALSE, &error);
+	if (helper.pool == NULL) {
+		g_warning ("failed to create thread pool: %s", error->message);
+		return FALSE;
+	}
+	helper.main_ctx = g_main_context_new ();
+	helper.pending = items->len;
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineColdplugItem *item = g_ptr_array_index (items, i);
+		fu_plugin_set_main_context (item->plugin, helper.main_ctx);
+	}
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineColdplugItem *item = g_ptr_array_index (items, i);
+		if (item->deps_remaining == 0)
+			fu_engine_plugins_coldplug_queue (item);
+	}
+	while (helper.pending > 0)
+		g_main_context_iteration (helper.main_ctx, TRUE);
+	g_thread_pool_free (helper.pool, FALSE, TRUE);
+	g_main_context_unref (helper.main_ctx);
+
+	/* process the results in the depsolved order */
+	for (guint i = 0; i < items->len; i++) {
+		FuEngineColdplugItem *item = g_ptr_array_index (items, i);
+		fu_plugin_set_main_context (item->plugin, NULL);
+		if (item->error != NULL)
+			fu_engine_plugins_coldplug_result (item->plugin,
+							   is_recoldplug,
+							   item->error);
+	}
+	return TRUE;
+}
+
+/* this is called by the self tests as well */
+void
 fu_engine_plugins_coldplug (FuEngine *self, gboolean is_recoldplug)
 {
 	GPtrArray *plugins;
@@ -2978,17 +3876,19 @@ fu_engine_plugins_coldplug (FuEngine *self, gboolean is_recoldplug)
 	}
 
 	/* exec */
-	for (guint i = 0; i < plugins->len; i++) {
-		g_autoptr(GError) error = NULL;
-		FuPlugin *plugin = g_ptr_array_index (plugins, i);
-		if (is_recoldplug) {
-			if (!fu_plugin_runner_recoldplug (plugin, &error))
-				g_message ("failed recoldplug: %s", error->message);
-		} else {
-			if (!fu_plugin_runner_coldplug (plugin, &error)) {
-				fu_plugin_set_enabled (plugin, FALSE);
-				g_message ("disabling plugin because: %s",
-					   error->message);
+	if (self->coldplug_threads > 1 && plugins->len > 1 &&
+	    fu_engine_plugins_coldplug_parallel (self, plugins, is_recoldplug)) {
+		g_debug ("coldplugged using %u threads", self->coldplug_threads);
+	} else {
+		for (guint i = 0; i < plugins->len; i++) {
+			g_autoptr(GError) error = NULL;
+			FuPlugin *plugin = g_ptr_array_index (plugins, i);
+			if (is_recoldplug) {
+				if (!fu_plugin_runner_recoldplug (plugin, &error))
+					fu_engine_plugins_coldplug_result (plugin, TRUE, error);
+			} else {
+				if (!fu_plugin_runner_coldplug (plugin, &error))
+					fu_engine_plugins_coldplug_result (plugin, FALSE, error);
 			}
 		}
 	}
@@ -3071,12 +3971,15 @@ fu_engine_adopt_children (FuEngine *self, FuDevice *device)
 	/* find the parent GUID in any existing device */
 	guids = fu_device_get_parent_guids (device);
 	for (guint j = 0; j < guids->len; j++) {
+		FuDeviceGuid guid_raw;
 		const gchar *guid = g_ptr_array_index (guids, j);
+		gboolean has_raw = fu_device_guid_from_string (guid, &guid_raw);
 		for (guint i = 0; i < devices->len; i++) {
 			FuDevice *device_tmp = g_ptr_array_index (devices, i);
 			if (fu_device_get_parent (device) != NULL)
 				continue;
-			if (fu_device_has_guid (device_tmp, guid)) {
+			if (has_raw ? fu_device_has_guid_raw (device_tmp, &guid_raw) :
+				      fu_device_has_guid (device_tmp, guid)) {
 				g_debug ("setting parent of %s [%s] to be %s [%s]",
 					 fu_device_get_name (device),
 					 fu_device_get_id (device),
@@ -3142,7 +4045,7 @@ fu_engine_add_device (FuEngine *self, FuDevice *device)
 
 	/* if this device is locked get some metadata from AppStream */
 	if (fu_device_has_flag (device, FWUPD_DEVICE_FLAG_LOCKED)) {
-		g_autoptr(XbNode) component = fu_engine_store_get_app_by_guids (self->silo, device);
+		g_autoptr(XbNode) component = fu_engine_store_get_app_by_guids (self, device);
 		if (component != NULL) {
 			g_autoptr(XbNode) release = NULL;
 			release = xb_node_query_first (component,
@@ -3243,6 +4146,142 @@ fu_engine_recoldplug_delay_cb (gpointer user_data)
 	return FALSE;
 }
 
+/* opens a plugin deferred by the manifest, and runs the parts of
+ * fu_engine_load() that were skipped */
+static gboolean
+fu_engine_plugin_open_deferred (FuEngine *self, FuPlugin *plugin, GError **error)
+{
+	const gchar *filename = g_hash_table_lookup (self->plugins_deferred, plugin);
+	gboolean ret;
+
+	/* already open */
+	if (filename == NULL)
+		return TRUE;
+	g_debug ("opening deferred plugin %s", filename);
+	ret = fu_plugin_open (plugin, filename, error);
+	g_hash_table_remove (self->plugins_deferred, plugin);
+	if (!ret) {
+		fu_plugin_set_enabled (plugin, FALSE);
+		return FALSE;
+	}
+	if (!fu_plugin_get_enabled (plugin)) {
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_NOT_SUPPORTED,
+			     "%s self disabled",
+			     fu_plugin_get_name (plugin));
+		return FALSE;
+	}
+	if (!fu_plugin_runner_startup (plugin, error) ||
+	    !fu_plugin_runner_coldplug_prepare (plugin, error) ||
+	    !fu_plugin_runner_coldplug (plugin, error) ||
+	    !fu_plugin_runner_coldplug_cleanup (plugin, error)) {
+		fu_plugin_set_enabled (plugin, FALSE);
+		return FALSE;
+	}
+
+	/* the rules are only known now the module is loaded */
+	return fu_plugin_list_depsolve (self->plugin_list, error);
+}
+
+static void	fu_engine_udev_device_add	(FuEngine	*self,
+						 GUdevDevice	*udev_device);
+static void	fu_engine_usb_device_added_cb	(GUsbContext	*ctx,
+						 GUsbDevice	*usb_device,
+						 FuEngine	*self);
+
+/* opens the deferred plugins and then adds the devices that were waiting
+ * for them again, so that every plugin gets to see them */
+static void
+fu_engine_plugins_open_deferred_flush (FuEngine *self)
+{
+	g_autoptr(GPtrArray) plugins = self->plugins_deferred_open;
+	g_autoptr(GPtrArray) devices = self->devices_deferred;
+
+	if (self->plugins_deferred_id != 0) {
+		g_source_remove (self->plugins_deferred_id);
+		self->plugins_deferred_id = 0;
+	}
+	self->plugins_deferred_open = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	self->devices_deferred = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+
+	for (guint i = 0; i < plugins->len; i++) {
+		FuPlugin *plugin = g_ptr_array_index (plugins, i);
+		g_autoptr(GError) error = NULL;
+		if (!fu_engine_plugin_open_deferred (self, plugin, &error)) {
+			g_message ("disabling plugin %s because: %s",
+				   fu_plugin_get_name (plugin),
+				   error->message);
+		}
+	}
+	for (guint i = 0; i < devices->len; i++) {
+		GObject *native = g_ptr_array_index (devices, i);
+		if (G_USB_IS_DEVICE (native))
+			fu_engine_usb_device_added_cb (self->usb_ctx, G_USB_DEVICE (native), self);
+		else if (G_UDEV_IS_DEVICE (native))
+			fu_engine_udev_device_add (self, G_UDEV_DEVICE (native));
+	}
+}
+
+static gboolean
+fu_engine_plugins_open_deferred_cb (gpointer user_data)
+{
+	FuEngine *self = FU_ENGINE (user_data);
+	self->plugins_deferred_id = 0;
+	fu_engine_plugins_open_deferred_flush (self);
+	return G_SOURCE_REMOVE;
+}
+
+static void
+fu_engine_ptr_array_add_unique (GPtrArray *array, gpointer data)
+{
+	for (guint i = 0; i < array->len; i++) {
+		if (g_ptr_array_index (array, i) == data)
+			return;
+	}
+	g_ptr_array_add (array, g_object_ref (data));
+}
+
+/* opening the module runs startup() and coldplug(), which is too slow to do
+ * from the hotplug handler, so remember the device until the plugin is open */
+static void
+fu_engine_plugin_open_deferred_queue (FuEngine *self, FuPlugin *plugin, GObject *native)
+{
+	fu_engine_ptr_array_add_unique (self->plugins_deferred_open, plugin);
+	fu_engine_ptr_array_add_unique (self->devices_deferred, native);
+
+	/* fu_engine_load() flushes this once the coldplug is complete */
+	if (!self->loaded || self->plugins_deferred_id != 0)
+		return;
+	if (self->app_flags & FU_APP_FLAGS_NO_IDLE_SOURCES) {
+		fu_engine_plugins_open_deferred_flush (self);
+		return;
+	}
+	self->plugins_deferred_id = g_idle_add (fu_engine_plugins_open_deferred_cb, self);
+}
+
+/* returns TRUE if the device has to wait for a deferred plugin to be opened */
+static gboolean
+fu_engine_plugins_open_for_device (FuEngine *self, FuDevice *device, GObject *native)
+{
+	GPtrArray *plugins = fu_plugin_list_get_all (self->plugin_list);
+	gboolean ret = FALSE;
+
+	/* nothing to do */
+	if (g_hash_table_size (self->plugins_deferred) == 0)
+		return FALSE;
+	for (guint i = 0; i < plugins->len; i++) {
+		FuPlugin *plugin = g_ptr_array_index (plugins, i);
+		if (!g_hash_table_contains (self->plugins_deferred, plugin))
+			continue;
+		if (fu_plugin_manifest_check_device (plugin, device)) {
+			fu_engine_plugin_open_deferred_queue (self, plugin, native);
+			ret = TRUE;
+		}
+	}
+	return ret;
+}
+
 static void
 fu_engine_udev_device_add (FuEngine *self, GUdevDevice *udev_device)
 {
@@ -3271,6 +4310,11 @@ fu_engine_udev_device_add (FuEngine *self, GUdevDevice *udev_device)
 				   plugin_name, error->message);
 			return;
 		}
+		if (g_hash_table_contains (self->plugins_deferred, plugin)) {
+			fu_engine_plugin_open_deferred_queue (self, plugin,
+							      G_OBJECT (udev_device));
+			return;
+		}
 		if (!fu_plugin_runner_udev_device_added (plugin, device, &error)) {
 			g_warning ("failed to add udev device %s: %s",
 				   g_udev_device_get_sysfs_path (udev_device),
@@ -3282,6 +4326,9 @@ fu_engine_udev_device_add (FuEngine *self, GUdevDevice *udev_device)
 	/* call into each plugin */
 	g_debug ("no plugin specified for udev device %s",
 		 g_udev_device_get_sysfs_path (udev_device));
+	if (fu_engine_plugins_open_for_device (self, FU_DEVICE (device),
+					       G_OBJECT (udev_device)))
+		return;
 	for (guint j = 0; j < plugins->len; j++) {
 		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
 		g_autoptr(GError) error = NULL;
@@ -3314,6 +4361,18 @@ fu_engine_udev_device_remove (FuEngine *self, GUdevDevice *udev_device)
 {
 	g_autoptr(GPtrArray) devices = NULL;
 
+	/* still waiting for a deferred plugin */
+	for (guint i = 0; i < self->devices_deferred->len; i++) {
+		GObject *native = g_ptr_array_index (self->devices_deferred, i);
+		if (!G_UDEV_IS_DEVICE (native))
+			continue;
+		if (g_strcmp0 (g_udev_device_get_sysfs_path (G_UDEV_DEVICE (native)),
+			       g_udev_device_get_sysfs_path (udev_device)) == 0) {
+			g_ptr_array_remove_index (self->devices_deferred, i);
+			break;
+		}
+	}
+
 	/* go through each device and remove any that match */
 	devices = fu_device_list_get_all (self->device_list);
 	for (guint i = 0; i < devices->len; i++) {
@@ -3392,6 +4451,20 @@ fu_engine_plugin_set_coldplug_delay_cb (FuPlugin *plugin, guint duration, FuEngi
 		 duration, self->coldplug_delay);
 }
 
+/* this is called by the self tests as well */
+void
+fu_engine_set_coldplug_threads (FuEngine *self, guint coldplug_threads)
+{
+	self->coldplug_threads = coldplug_threads;
+}
+
+/* this is called by the self tests as well */
+void
+fu_engine_set_install_threads (FuEngine *self, guint install_threads)
+{
+	self->install_threads = install_threads;
+}
+
 /* this is called by the self tests as well */
 void
 fu_engine_add_plugin (FuEngine *self, FuPlugin *plugin)
@@ -3447,13 +4520,7 @@ fu_engine_add_plugin_filter (FuEngine *self, const gchar *plugin_glob)
 static gboolean
 fu_engine_plugin_check_supported_cb (FuPlugin *plugin, const gchar *guid, FuEngine *self)
 {
-	g_autoptr(XbNode) n = NULL;
-	g_autofree gchar *xpath = NULL;
-	xpath = g_strdup_printf ("components/component/"
-				 "provides/firmware[@type='flashed'][text()='%s']",
-				 guid);
-	n = xb_silo_query_first (self->silo, xpath, NULL);
-	return n != NULL;
+	return fu_engine_silos_get_components_by_guid (self, guid) != NULL;
 }
 
 gboolean
@@ -3476,6 +4543,7 @@ fu_engine_load_plugins (FuEngine *self, GError **error)
 		return FALSE;
 	while ((fn = g_dir_read_name (dir)) != NULL) {
 		g_autofree gchar *filename = NULL;
+		g_autofree gchar *manifest_fn = NULL;
 		g_autofree gchar *name = NULL;
 		g_autoptr(FuPlugin) plugin = NULL;
 		g_autoptr(GError) error_local = NULL;
@@ -3506,13 +4574,38 @@ fu_engine_load_plugins (FuEngine *self, GError **error)
 		fu_plugin_set_smbios (plugin, self->smbios);
 		fu_plugin_set_udev_subsystems (plugin, self->udev_subsystems);
 		fu_plugin_set_quirks (plugin, self->quirks);
+		fu_plugin_set_profile (plugin, self->profile);
 		fu_plugin_set_runtime_versions (plugin, self->runtime_versions);
 		fu_plugin_set_compile_versions (plugin, self->compile_versions);
 		g_debug ("adding plugin %s", filename);
 
-		/* if loaded from fu_engine_load() open the plugin */
+		/* if loaded from fu_engine_load() open the plugin, unless the
+		 * manifest says it can wait for some matching hardware */
 		if (self->usb_ctx != NULL) {
-			if (!fu_plugin_open (plugin, filename, &error_local)) {
+			const gchar *ext = strrchr (fn, '.');
+			g_autofree gchar *basename = g_strndup (fn, ext - fn);
+			g_autofree gchar *manifest_basename = g_strdup_printf ("%s.manifest", basename);
+			manifest_fn = g_build_filename (plugin_path, manifest_basename, NULL);
+			if (g_file_test (manifest_fn, G_FILE_TEST_EXISTS) &&
+			    !fu_plugin_load_manifest (plugin, manifest_fn, &error_local)) {
+				g_warning ("failed to load manifest %s: %s",
+					   manifest_fn, error_local->message);
+				g_clear_error (&error_local);
+			}
+			if (!fu_plugin_manifest_check_hwids (plugin)) {
+				g_debug ("plugin %s has no matching HWID", name);
+				continue;
+			}
+			if (fu_plugin_manifest_is_lazy (plugin)) {
+				GPtrArray *subsystems = fu_plugin_get_manifest_udev_subsystems (plugin);
+				for (guint i = 0; i < subsystems->len; i++) {
+					const gchar *subsystem = g_ptr_array_index (subsystems, i);
+					fu_plugin_add_udev_subsystem (plugin, subsystem);
+				}
+				g_debug ("deferring opening plugin %s", filename);
+				g_hash_table_insert (self->plugins_deferred,
+						     plugin, g_strdup (filename));
+			} else if (!fu_plugin_open (plugin, filename, &error_local)) {
 				g_warning ("failed to open plugin %s: %s",
 					   filename, error_local->message);
 				continue;
@@ -3568,6 +4661,10 @@ fu_engine_cleanup_state (GError **error)
 		"/var/cache/app-info/xmls/fwupd-verify.xml",
 		"/var/cache/app-info/xmls/fwupd.xml",
 		NULL };
+	g_autofree gchar *cachedirpkg = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	g_autofree gchar *xmlbfn = NULL;
+	g_autoptr(GFile) xmlb = NULL;
+
 	for (guint i = 0; filenames[i] != NULL; i++) {
 		g_autoptr(GFile) file = g_file_new_for_path (filenames[i]);
 		if (g_file_query_exists (file, NULL)) {
@@ -3575,6 +4672,14 @@ fu_engine_cleanup_state (GError **error)
 				return FALSE;
 		}
 	}
+
+	/* each remote now has its own silo */
+	xmlbfn = g_build_filename (cachedirpkg, "metadata.xmlb", NULL);
+	xmlb = g_file_new_for_path (xmlbfn);
+	if (g_file_query_exists (xmlb, NULL)) {
+		if (!g_file_delete (xmlb, NULL, error))
+			return FALSE;
+	}
 	return TRUE;
 }
 
@@ -3591,6 +4696,9 @@ fu_engine_usb_device_removed_cb (GUsbContext *ctx,
 {
 	g_autoptr(GPtrArray) devices = NULL;
 
+	/* still waiting for a deferred plugin */
+	g_ptr_array_remove (self->devices_deferred, usb_device);
+
 	/* go through each device and remove any that match */
 	devices = fu_device_list_get_all (self->device_list);
 	for (guint i = 0; i < devices->len; i++) {
@@ -3635,6 +4743,11 @@ fu_engine_usb_device_added_cb (GUsbContext *ctx,
 				   plugin_name, error->message);
 			return;
 		}
+		if (g_hash_table_contains (self->plugins_deferred, plugin)) {
+			fu_engine_plugin_open_deferred_queue (self, plugin,
+							      G_OBJECT (usb_device));
+			return;
+		}
 		if (!fu_plugin_runner_usb_device_added (plugin, device, &error)) {
 			g_warning ("failed to add USB device %04x:%04x: %s",
 				   g_usb_device_get_vid (usb_device),
@@ -3648,6 +4761,9 @@ fu_engine_usb_device_added_cb (GUsbContext *ctx,
 	g_debug ("no plugin specified for USB device %04x:%04x",
 		 g_usb_device_get_vid (usb_device),
 		 g_usb_device_get_pid (usb_device));
+	if (fu_engine_plugins_open_for_device (self, FU_DEVICE (device),
+					       G_OBJECT (usb_device)))
+		return;
 	for (guint j = 0; j < plugins->len; j++) {
 		FuPlugin *plugin_tmp = g_ptr_array_index (plugins, j);
 		g_autoptr(GError) error = NULL;
@@ -3822,6 +4938,72 @@ fu_engine_udev_uevent_cb (GUdevClient *gudev_client,
 	}
 }
 
+static void
+fu_engine_add_profile (FuEngine *self, const gchar *id, gint64 start)
+{
+	fu_profile_add (self->profile, id, g_get_monotonic_time () - start);
+}
+
+/**
+ * fu_engine_get_profile:
+ * @self: A #FuEngine
+ *
+ * Gets the time spent in each phase of loading the engine, and in each
+ * plugin vfunc since the engine was created.
+ *
+ * Returns: (transfer none): a #FuProfile
+ **/
+FuProfile *
+fu_engine_get_profile (FuEngine *self)
+{
+	g_return_val_if_fail (FU_IS_ENGINE (self), NULL);
+	return self->profile;
+}
+
+static void
+fu_engine_pki_dir_changed_cb (GFileMonitor *monitor,
+			      GFile *file,
+			      GFile *other_file,
+			      GFileMonitorEvent event_type,
+			      gpointer user_data)
+{
+	FuEngine *self = FU_ENGINE (user_data);
+	g_autofree gchar *fn = g_file_get_path (file);
+	g_debug ("%s changed, invalidating archive and keyring caches", fn);
+	fu_cab_cache_invalidate (self->cab_cache);
+	fu_keyring_cache_invalidate (self->keyring_cache);
+}
+
+static void
+fu_engine_watch_pki_dir (FuEngine *self)
+{
+	const gchar *pki_subdirs[] = { PACKAGE_NAME, "fwupd-metadata", NULL };
+	g_autofree gchar *sysconfdir = NULL;
+
+	/* the trust flags of cached archives and the cached metadata
+	 * verification results depend on the system keys */
+	sysconfdir = fu_common_get_path (FU_PATH_KIND_SYSCONFDIR);
+	for (guint i = 0; pki_subdirs[i] != NULL; i++) {
+		GFileMonitor *monitor;
+		g_autofree gchar *pki_dir = NULL;
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GFile) file = NULL;
+
+		pki_dir = g_build_filename (sysconfdir, "pki", pki_subdirs[i], NULL);
+		fu_keyring_cache_add_pki_dir (self->keyring_cache, pki_dir);
+		file = g_file_new_for_path (pki_dir);
+		monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE,
+						    NULL, &error_local);
+		if (monitor == NULL) {
+			g_warning ("failed to watch %s: %s", pki_dir, error_local->message);
+			continue;
+		}
+		g_signal_connect (monitor, "changed",
+				  G_CALLBACK (fu_engine_pki_dir_changed_cb), self);
+		g_ptr_array_add (self->pki_monitors, monitor);
+	}
+}
+
 /**
  * fu_engine_load:
  * @self: A #FuEngine
@@ -3834,6 +5016,11 @@ fu_engine_udev_uevent_cb (GUdevClient *gudev_client,
 gboolean
 fu_engine_load (FuEngine *self, GError **error)
 {
+	gint64 start = g_get_monotonic_time ();
+	gint64 start_phase;
+	g_autofree gchar *keyring_cache_fn = NULL;
+	g_autofree gchar *localstatedir = NULL;
+
 	g_return_val_if_fail (FU_IS_ENGINE (self), FALSE);
 	g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
 
@@ -3842,25 +5029,52 @@ fu_engine_load (FuEngine *self, GError **error)
 		return TRUE;
 
 	/* read config file */
+	start_phase = g_get_monotonic_time ();
 	if (!fu_config_load (self->config, error)) {
 		g_prefix_error (error, "Failed to load config: ");
 		return FALSE;
 	}
+	fu_engine_add_profile (self, "load/config", start_phase);
 
 	/* set up idle exit */
 	if ((self->app_flags & FU_APP_FLAGS_NO_IDLE_SOURCES) == 0)
 		fu_idle_set_timeout (self->idle, fu_config_get_idle_timeout (self->config));
 
+	/* optionally coldplug plugins from a thread pool */
+	self->coldplug_threads = fu_config_get_coldplug_threads (self->config);
+
+	/* optionally install independent devices from a thread pool */
+	self->install_threads = fu_config_get_install_threads (self->config);
+
+	/* keep recently parsed archives until the keyrings change */
+	fu_cab_cache_set_size_max (self->cab_cache,
+				   fu_config_get_archive_cache_size_max (self->config));
+	fu_engine_watch_pki_dir (self);
+
+	/* verification results are saved next to the cached metadata */
+	localstatedir = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
+	keyring_cache_fn = g_build_filename (localstatedir, "remotes.d",
+					     "keyring-cache.conf", NULL);
+	fu_keyring_cache_set_filename (self->keyring_cache, keyring_cache_fn);
+
 	/* load quirks, SMBIOS and the hwids */
+	start_phase = g_get_monotonic_time ();
 	fu_engine_load_smbios (self);
+	fu_engine_add_profile (self, "load/smbios", start_phase);
+	start_phase = g_get_monotonic_time ();
 	fu_engine_load_hwids (self);
+	fu_engine_add_profile (self, "load/hwids", start_phase);
+	start_phase = g_get_monotonic_time ();
 	fu_engine_load_quirks (self);
+	fu_engine_add_profile (self, "load/quirks", start_phase);
 
 	/* load AppStream metadata */
+	start_phase = g_get_monotonic_time ();
 	if (!fu_engine_load_metadata_store (self, error)) {
 		g_prefix_error (error, "Failed to load AppStream data: ");
 		return FALSE;
 	}
+	fu_engine_add_profile (self, "load/metadata", start_phase);
 
 	/* set shared USB context */
 	self->usb_ctx = g_usb_context_new (error);
@@ -3875,11 +5089,16 @@ fu_engine_load (FuEngine *self, GError **error)
 		return FALSE;
 	}
 
+	/* compact the history on machines that update devices constantly */
+	fu_engine_prune_history (self);
+
 	/* load plugin */
+	start_phase = g_get_monotonic_time ();
 	if (!fu_engine_load_plugins (self, error)) {
 		g_prefix_error (error, "Failed to load plugins: ");
 		return FALSE;
 	}
+	fu_engine_add_profile (self, "load/plugins", start_phase);
 
 	/* watch the device list for updates and proxy */
 	g_signal_connect (self->device_list, "added",
@@ -3907,8 +5126,12 @@ fu_engine_load (FuEngine *self, GError **error)
 	fu_engine_set_status (self, FWUPD_STATUS_LOADING);
 
 	/* add devices */
+	start_phase = g_get_monotonic_time ();
 	fu_engine_plugins_setup (self);
+	fu_engine_add_profile (self, "load/startup", start_phase);
+	start_phase = g_get_monotonic_time ();
 	fu_engine_plugins_coldplug (self, FALSE);
+	fu_engine_add_profile (self, "load/coldplug", start_phase);
 
 	/* coldplug USB devices */
 	g_signal_connect (self->usb_ctx, "device-added",
@@ -3917,17 +5140,29 @@ fu_engine_load (FuEngine *self, GError **error)
 	g_signal_connect (self->usb_ctx, "device-removed",
 			  G_CALLBACK (fu_engine_usb_device_removed_cb),
 			  self);
+	start_phase = g_get_monotonic_time ();
 	g_usb_context_enumerate (self->usb_ctx);
+	fu_engine_add_profile (self, "load/usb", start_phase);
 
 	/* coldplug udev devices */
+	start_phase = g_get_monotonic_time ();
 	fu_engine_enumerate_udev (self);
+	fu_engine_add_profile (self, "load/udev", start_phase);
+
+	/* open any plugins that matched the coldplugged devices */
+	start_phase = g_get_monotonic_time ();
+	fu_engine_plugins_open_deferred_flush (self);
+	fu_engine_add_profile (self, "load/deferred", start_phase);
 
 	/* update the db for devices that were updated during the reboot */
+	start_phase = g_get_monotonic_time ();
 	if (!fu_engine_update_history_database (self, error))
 		return FALSE;
+	fu_engine_add_profile (self, "load/history", start_phase);
 
 	fu_engine_set_status (self, FWUPD_STATUS_IDLE);
 	self->loaded = TRUE;
+	fu_engine_add_profile (self, "load", start);
 
 	/* success */
 	return TRUE;
@@ -4000,9 +5235,19 @@ fu_engine_init (FuEngine *self)
 	self->hwids = fu_hwids_new ();
 	self->idle = fu_idle_new ();
 	self->quirks = fu_quirks_new ();
+	self->profile = fu_profile_new ();
+	self->cab_cache = fu_cab_cache_new ();
+	self->keyring_cache = fu_keyring_cache_new ();
+	self->pki_monitors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_mutex_init (&self->update_hooks_mutex);
 	self->history = fu_history_new ();
 	self->plugin_list = fu_plugin_list_new ();
 	self->plugin_filter = g_ptr_array_new_with_free_func (g_free);
+	self->remote_silos = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+						    (GDestroyNotify) g_object_unref);
+	self->plugins_deferred = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+	self->plugins_deferred_open = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	self->devices_deferred = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	self->udev_subsystems = g_ptr_array_new_with_free_func (g_free);
 	self->runtime_versions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	self->compile_versions = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
@@ -4040,21 +5285,32 @@ fu_engine_finalize (GObject *obj)
 
 	if (self->usb_ctx != NULL)
 		g_object_unref (self->usb_ctx);
-	if (self->silo != NULL)
-		g_object_unref (self->silo);
+	if (self->silos != NULL)
+		g_ptr_array_unref (self->silos);
 	if (self->gudev_client != NULL)
 		g_object_unref (self->gudev_client);
 	if (self->coldplug_id != 0)
 		g_source_remove (self->coldplug_id);
+	if (self->plugins_deferred_id != 0)
+		g_source_remove (self->plugins_deferred_id);
 
 	g_object_unref (self->idle);
 	g_object_unref (self->config);
 	g_object_unref (self->smbios);
 	g_object_unref (self->quirks);
+	g_object_unref (self->profile);
+	g_object_unref (self->cab_cache);
+	g_object_unref (self->keyring_cache);
+	g_ptr_array_unref (self->pki_monitors);
+	g_mutex_clear (&self->update_hooks_mutex);
 	g_object_unref (self->hwids);
 	g_object_unref (self->history);
 	g_object_unref (self->device_list);
 	g_ptr_array_unref (self->plugin_filter);
+	g_hash_table_unref (self->remote_silos);
+	g_hash_table_unref (self->plugins_deferred);
+	g_ptr_array_unref (self->plugins_deferred_open);
+	g_ptr_array_unref (self->devices_deferred);
 	g_ptr_array_unref (self->udev_subsystems);
 	g_hash_table_unref (self->runtime_versions);
 	g_hash_table_unref (self->compile_versions);
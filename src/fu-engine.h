@@ -18,6 +18,7 @@ G_BEGIN_DECLS
 #include "fu-common.h"
 #include "fu-install-task.h"
 #include "fu-plugin.h"
+#include "fu-profile.h"
 
 #define FU_TYPE_ENGINE (fu_engine_get_type ())
 G_DECLARE_FINAL_TYPE (FuEngine, fu_engine, FU, ENGINE, GObject)
@@ -31,6 +32,7 @@ gboolean	 fu_engine_load				(FuEngine	*self,
 gboolean	 fu_engine_load_plugins			(FuEngine	*self,
 							 GError		**error);
 gboolean	 fu_engine_get_tainted			(FuEngine	*self);
+FuProfile	*fu_engine_get_profile			(FuEngine	*self);
 FwupdStatus	 fu_engine_get_status			(FuEngine	*self);
 XbSilo		*fu_engine_get_silo_from_blob		(FuEngine	*self,
 							 GBytes		*blob_cab,
@@ -44,6 +46,14 @@ FuDevice	*fu_engine_get_device			(FuEngine	*self,
 							 GError		**error);
 GPtrArray	*fu_engine_get_history			(FuEngine	*self,
 							 GError		**error);
+GPtrArray	*fu_engine_get_history_filtered		(FuEngine	*self,
+							 const gchar	*device_id,
+							 FwupdUpdateState update_state,
+							 guint64	 modified_min,
+							 guint64	 modified_max,
+							 guint		 offset,
+							 guint		 limit,
+							 GError		**error);
 FwupdRemote 	*fu_engine_get_remote_by_id		(FuEngine	*self,
 							 const gchar	*remote_id,
 							 GError		**error);
@@ -120,6 +130,12 @@ void		 fu_engine_add_device			(FuEngine	*self,
 							 FuDevice	*device);
 void		 fu_engine_add_plugin			(FuEngine	*self,
 							 FuPlugin	*plugin);
+void		 fu_engine_plugins_coldplug		(FuEngine	*self,
+							 gboolean	 is_recoldplug);
+void		 fu_engine_set_coldplug_threads		(FuEngine	*self,
+							 guint		 coldplug_threads);
+void		 fu_engine_set_install_threads		(FuEngine	*self,
+							 guint		 install_threads);
 void		 fu_engine_add_runtime_version		(FuEngine	*self,
 							 const gchar	*component_id,
 							 const gchar	*version);
@@ -26,6 +26,7 @@ struct _FuHistory
 	GObject			 parent_instance;
 	sqlite3			*db;
 	FuMutex			*db_mutex;
+	GHashTable		*stmts;		/* sql:sqlite3_stmt */
 };
 
 G_DEFINE_TYPE (FuHistory, fu_history, G_TYPE_OBJECT)
@@ -126,6 +127,27 @@ fu_history_device_from_stmt (sqlite3_stmt *stmt)
 	return device;
 }
 
+/* statements are only prepared once, and are owned by the cache */
+static sqlite3_stmt *
+fu_history_prepare (FuHistory *self, const gchar *sql, GError **error)
+{
+	gint rc;
+	sqlite3_stmt *stmt;
+
+	stmt = g_hash_table_lookup (self->stmts, sql);
+	if (stmt != NULL)
+		return stmt;
+	rc = sqlite3_prepare_v2 (self->db, sql, -1, &stmt, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
+			     "Failed to prepare SQL: %s",
+			     sqlite3_errmsg (self->db));
+		return NULL;
+	}
+	g_hash_table_insert (self->stmts, g_strdup (sql), stmt);
+	return stmt;
+}
+
 static gboolean
 fu_history_stmt_exec (FuHistory *self, sqlite3_stmt *stmt,
 		      GPtrArray *array, GError **error)
@@ -143,9 +165,21 @@ fu_history_stmt_exec (FuHistory *self, sqlite3_stmt *stmt,
 		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_WRITE,
 			     "failed to execute prepared statement: %s",
 			     sqlite3_errmsg (self->db));
-		return FALSE;
 	}
-	return TRUE;
+
+	/* ready for next time, and do not keep pointers to the old values */
+	sqlite3_reset (stmt);
+	sqlite3_clear_bindings (stmt);
+	return rc == SQLITE_DONE;
+}
+
+static gboolean
+fu_history_exec (FuHistory *self, const gchar *sql, GError **error)
+{
+	sqlite3_stmt *stmt = fu_history_prepare (self, sql, error);
+	if (stmt == NULL)
+		return FALSE;
+	return fu_history_stmt_exec (self, stmt, NULL, error);
 }
 
 static gboolean
@@ -157,7 +191,7 @@ fu_history_create_database (FuHistory *self, GError **error)
 			 "CREATE TABLE schema ("
 			 "created timestamp TIMESTAMP DEFAULT CURRENT_TIMESTAMP,"
 			 "version INTEGER DEFAULT 0);"
-			 "INSERT INTO schema (version) VALUES (4);"
+			 "INSERT INTO schema (version) VALUES (6);"
 			 "CREATE TABLE history ("
 			 "device_id TEXT,"
 			 "update_state INTEGER DEFAULT 0,"
@@ -175,6 +209,10 @@ fu_history_create_database (FuHistory *self, GError **error)
 			 "version_new TEXT,"
 			 "checksum_device TEXT DEFAULT NULL,"
 			 "protocol TEXT DEFAULT NULL);"
+			 "CREATE INDEX idx_history_device_id ON history (device_id);"
+			 "CREATE INDEX idx_history_checksum ON history (checksum);"
+			 "CREATE INDEX idx_history_update_state ON history (update_state);"
+			 "CREATE INDEX idx_history_device_modified ON history (device_modified);"
 			 "COMMIT;", NULL, NULL, NULL);
 	if (rc != SQLITE_OK) {
 		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
@@ -270,6 +308,52 @@ fu_history_migrate_database_v3 (FuHistory *self, GError **error)
 	return TRUE;
 }
 
+static gboolean
+fu_history_migrate_database_v4 (FuHistory *self, GError **error)
+{
+	gint rc;
+
+	/* add indexes for the columns used in WHERE clauses */
+	rc = sqlite3_exec (self->db,
+			   "BEGIN TRANSACTION;"
+			   "CREATE INDEX IF NOT EXISTS idx_history_device_id ON history (device_id);"
+			   "CREATE INDEX IF NOT EXISTS idx_history_checksum ON history (checksum);"
+			   "CREATE INDEX IF NOT EXISTS idx_history_update_state ON history (update_state);"
+			   "UPDATE schema SET version=5;"
+			   "COMMIT;",
+			   NULL, NULL, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
+			     "Failed to migrate database: %s",
+			     sqlite3_errmsg (self->db));
+		sqlite3_exec (self->db, "ROLLBACK;", NULL, NULL, NULL);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean
+fu_history_migrate_database_v5 (FuHistory *self, GError **error)
+{
+	gint rc;
+
+	/* history is paged in this order */
+	rc = sqlite3_exec (self->db,
+			   "BEGIN TRANSACTION;"
+			   "CREATE INDEX IF NOT EXISTS idx_history_device_modified ON history (device_modified);"
+			   "UPDATE schema SET version=6;"
+			   "COMMIT;",
+			   NULL, NULL, NULL);
+	if (rc != SQLITE_OK) {
+		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
+			     "Failed to migrate database: %s",
+			     sqlite3_errmsg (self->db));
+		sqlite3_exec (self->db, "ROLLBACK;", NULL, NULL, NULL);
+		return FALSE;
+	}
+	return TRUE;
+}
+
 /* returns 0 if database is not initialised */
 static guint
 fu_history_get_schema_version (FuHistory *self)
@@ -329,9 +413,20 @@ fu_history_load (FuHistory *self, GError **error)
 			     "Can't open %s: %s",
 			     filename, sqlite3_errmsg (self->db));
 		sqlite3_close (self->db);
+		self->db = NULL;
 		return FALSE;
 	}
 
+	/* readers do not block the writer, and each commit is a single fsync;
+	 * keep FULL as the pending state has to survive a power loss during
+	 * the flash that follows it */
+	rc = sqlite3_exec (self->db,
+			   "PRAGMA journal_mode=WAL;"
+			   "PRAGMA synchronous=FULL;",
+			   NULL, NULL, NULL);
+	if (rc != SQLITE_OK)
+		g_debug ("failed to enable WAL: %s", sqlite3_errmsg (self->db));
+
 	/* check database */
 	schema_ver = fu_history_get_schema_version (self);
 	if (schema_ver == 0) {
@@ -363,6 +458,18 @@ fu_history_load (FuHistory *self, GError **error)
 			return FALSE;
 	}
 
+	/* v2 and v3 were migrated to v4 above */
+	if (schema_ver >= 2 && schema_ver <= 4) {
+		g_debug ("migrating v4 database");
+		if (!fu_history_migrate_database_v4 (self, error))
+			return FALSE;
+	}
+	if (schema_ver >= 2 && schema_ver <= 5) {
+		g_debug ("migrating v5 database");
+		if (!fu_history_migrate_database_v5 (self, error))
+			return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -396,8 +503,7 @@ fu_history_modify_device (FuHistory *self, FuDevice *device,
 			  FuHistoryFlags flags,
 			  GError **error)
 {
-	gint rc;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
+	sqlite3_stmt *stmt;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
@@ -415,49 +521,45 @@ fu_history_modify_device (FuHistory *self, FuDevice *device,
 		g_debug ("modifying device %s [%s], version not important",
 			 fu_device_get_name (device),
 			 fu_device_get_id (device));
-		rc = sqlite3_prepare_v2 (self->db,
-					 "UPDATE history SET "
-					 "update_state = ?1, "
-					 "update_error = ?2, "
-					 "checksum_device = ?6, "
-					 "flags = ?3 "
-					 "WHERE device_id = ?4;",
-					 -1, &stmt, NULL);
+		stmt = fu_history_prepare (self,
+					   "UPDATE history SET "
+					   "update_state = ?1, "
+					   "update_error = ?2, "
+					   "checksum_device = ?6, "
+					   "flags = ?3 "
+					   "WHERE device_id = ?4;",
+					   error);
 	} else if (flags & FU_HISTORY_FLAGS_MATCH_OLD_VERSION) {
 		g_debug ("modifying device %s [%s], only version old %s",
 			 fu_device_get_name (device),
 			 fu_device_get_id (device),
 			 fu_device_get_version (device));
-		rc = sqlite3_prepare_v2 (self->db,
-					 "UPDATE history SET "
-					 "update_state = ?1, "
-					 "update_error = ?2, "
-					 "checksum_device = ?6, "
-					 "flags = ?3 "
-					 "WHERE device_id = ?4 AND version_old = ?5;",
-					 -1, &stmt, NULL);
+		stmt = fu_history_prepare (self,
+					   "UPDATE history SET "
+					   "update_state = ?1, "
+					   "update_error = ?2, "
+					   "checksum_device = ?6, "
+					   "flags = ?3 "
+					   "WHERE device_id = ?4 AND version_old = ?5;",
+					   error);
 	} else if (flags & FU_HISTORY_FLAGS_MATCH_NEW_VERSION) {
 		g_debug ("modifying device %s [%s], only version new %s",
 			 fu_device_get_name (device),
 			 fu_device_get_id (device),
 			 fu_device_get_version (device));
-		rc = sqlite3_prepare_v2 (self->db,
-					 "UPDATE history SET "
-					 "update_state = ?1, "
-					 "update_error = ?2, "
-					 "checksum_device = ?6, "
-					 "flags = ?3 "
-					 "WHERE device_id = ?4 AND version_new = ?5;",
-					 -1, &stmt, NULL);
+		stmt = fu_history_prepare (self,
+					   "UPDATE history SET "
+					   "update_state = ?1, "
+					   "update_error = ?2, "
+					   "checksum_device = ?6, "
+					   "flags = ?3 "
+					   "WHERE device_id = ?4 AND version_new = ?5;",
+					   error);
 	} else {
 		g_assert_not_reached ();
 	}
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
+	if (stmt == NULL)
 		return FALSE;
-	}
 
 	sqlite3_bind_int (stmt, 1, fu_device_get_update_state (device));
 	sqlite3_bind_text (stmt, 2, fu_device_get_update_error (device), -1, SQLITE_STATIC);
@@ -469,27 +571,38 @@ fu_history_modify_device (FuHistory *self, FuDevice *device,
 	return fu_history_stmt_exec (self, stmt, NULL, error);
 }
 
-gboolean
-fu_history_add_device (FuHistory *self, FuDevice *device, FwupdRelease *release, GError **error)
+/* must be called with the mutex held */
+static gboolean
+fu_history_remove_device_internal (FuHistory *self, FuDevice *device,
+				   FwupdRelease *release, GError **error)
 {
-	const gchar *checksum_device;
-	const gchar *checksum = NULL;
-	gint rc;
-	g_autofree gchar *metadata = NULL;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
-	g_autoptr(FuMutexLocker) locker = NULL;
+	sqlite3_stmt *stmt;
 
-	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
-	g_return_val_if_fail (FU_IS_DEVICE (device), FALSE);
-	g_return_val_if_fail (FWUPD_IS_RELEASE (release), FALSE);
-
-	/* lazy load */
-	if (!fu_history_load (self, error))
+	g_debug ("remove device %s [%s]",
+		 fu_device_get_name (device),
+		 fu_device_get_id (device));
+	stmt = fu_history_prepare (self,
+				   "DELETE FROM history WHERE device_id = ?1 "
+				   "AND version_old = ?2 "
+				   "AND version_new = ?3;",
+				   error);
+	if (stmt == NULL)
 		return FALSE;
+	sqlite3_bind_text (stmt, 1, fu_device_get_id (device), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 2, fu_device_get_version (device), -1, SQLITE_STATIC);
+	sqlite3_bind_text (stmt, 3, fwupd_release_get_version (release), -1, SQLITE_STATIC);
+	return fu_history_stmt_exec (self, stmt, NULL, error);
+}
 
-	/* ensure device with this old-version -> new-version does not exist */
-	if (!fu_history_remove_device (self, device, release, error))
-		return FALSE;
+/* must be called with the mutex held */
+static gboolean
+fu_history_add_device_internal (FuHistory *self, FuDevice *device,
+				FwupdRelease *release, GError **error)
+{
+	const gchar *checksum_device;
+	const gchar *checksum = NULL;
+	sqlite3_stmt *stmt;
+	g_autofree gchar *metadata = NULL;
 
 	g_debug ("add device %s [%s]",
 		 fu_device_get_name (device),
@@ -505,33 +618,27 @@ fu_history_add_device (FuHistory *self, FuDevice *device, FwupdRelease *release,
 	metadata = _convert_hash_to_string (fwupd_release_get_metadata (release));
 
 	/* add */
-	locker = fu_mutex_write_locker_new (self->db_mutex);
-	g_return_val_if_fail (locker != NULL, FALSE);
-	rc = sqlite3_prepare_v2 (self->db,
-				 "INSERT INTO history (device_id,"
-						      "update_state,"
-						      "update_error,"
-						      "flags,"
-						      "filename,"
-						      "checksum,"
-						      "display_name,"
-						      "plugin,"
-						      "guid_default,"
-						      "metadata,"
-						      "device_created,"
-						      "device_modified,"
-						      "version_old,"
-						      "version_new,"
-						      "checksum_device,"
-						      "protocol) "
-				 "VALUES (?1,?2,?3,?4,?5,?6,?7,?8,?9,?10,"
-					 "?11,?12,?13,?14,?15,?16)", -1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
+	stmt = fu_history_prepare (self,
+				   "INSERT INTO history (device_id,"
+							"update_state,"
+							"update_error,"
+							"flags,"
+							"filename,"
+							"checksum,"
+							"display_name,"
+							"plugin,"
+							"guid_default,"
+							"metadata,"
+							"device_created,"
+							"device_modified,"
+							"version_old,"
+							"version_new,"
+							"checksum_device,"
+							"protocol) "
+				   "VALUES (?1,?2,?3,?4,?5,?6,?7,?8,?9,?10,"
+					   "?11,?12,?13,?14,?15,?16)", error);
+	if (stmt == NULL)
 		return FALSE;
-	}
 	sqlite3_bind_text (stmt, 1, fu_device_get_id (device), -1, SQLITE_STATIC);
 	sqlite3_bind_int (stmt, 2, fu_device_get_update_state (device));
 	sqlite3_bind_text (stmt, 3, fu_device_get_update_error (device), -1, SQLITE_STATIC);
@@ -551,13 +658,39 @@ fu_history_add_device (FuHistory *self, FuDevice *device, FwupdRelease *release,
 	return fu_history_stmt_exec (self, stmt, NULL, error);
 }
 
+gboolean
+fu_history_add_device (FuHistory *self, FuDevice *device, FwupdRelease *release, GError **error)
+{
+	g_autoptr(FuMutexLocker) locker = NULL;
+
+	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
+	g_return_val_if_fail (FU_IS_DEVICE (device), FALSE);
+	g_return_val_if_fail (FWUPD_IS_RELEASE (release), FALSE);
+
+	/* lazy load */
+	if (!fu_history_load (self, error))
+		return FALSE;
+
+	/* ensure device with this old-version -> new-version does not exist,
+	 * replacing it in one transaction */
+	locker = fu_mutex_write_locker_new (self->db_mutex);
+	g_return_val_if_fail (locker != NULL, FALSE);
+	if (!fu_history_exec (self, "BEGIN IMMEDIATE TRANSACTION;", error))
+		return FALSE;
+	if (!fu_history_remove_device_internal (self, device, release, error) ||
+	    !fu_history_add_device_internal (self, device, release, error)) {
+		fu_history_exec (self, "ROLLBACK;", NULL);
+		return FALSE;
+	}
+	return fu_history_exec (self, "COMMIT;", error);
+}
+
 gboolean
 fu_history_remove_all_with_state (FuHistory *self,
 				  FwupdUpdateState update_state,
 				  GError **error)
 {
-	gint rc;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
+	sqlite3_stmt *stmt;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
@@ -571,15 +704,11 @@ fu_history_remove_all_with_state (FuHistory *self,
 	g_return_val_if_fail (locker != NULL, FALSE);
 	g_debug ("removing all devices with update_state %s",
 		 fwupd_update_state_to_string (update_state));
-	rc = sqlite3_prepare_v2 (self->db,
-				 "DELETE FROM history WHERE update_state = ?1",
-				 -1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
+	stmt = fu_history_prepare (self,
+				   "DELETE FROM history WHERE update_state = ?1",
+				   error);
+	if (stmt == NULL)
 		return FALSE;
-	}
 	sqlite3_bind_int (stmt, 1, update_state);
 	return fu_history_stmt_exec (self, stmt, NULL, error);
 }
@@ -587,8 +716,6 @@ fu_history_remove_all_with_state (FuHistory *self,
 gboolean
 fu_history_remove_all (FuHistory *self, GError **error)
 {
-	gint rc;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
@@ -601,22 +728,13 @@ fu_history_remove_all (FuHistory *self, GError **error)
 	locker = fu_mutex_write_locker_new (self->db_mutex);
 	g_return_val_if_fail (locker != NULL, FALSE);
 	g_debug ("removing all devices");
-	rc = sqlite3_prepare_v2 (self->db, "DELETE FROM history;", -1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
-		return FALSE;
-	}
-	return fu_history_stmt_exec (self, stmt, NULL, error);
+	return fu_history_exec (self, "DELETE FROM history;", error);
 }
 
 gboolean
 fu_history_remove_device (FuHistory *self,  FuDevice *device,
 			  FwupdRelease *release, GError **error)
 {
-	gint rc;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
@@ -629,32 +747,14 @@ fu_history_remove_device (FuHistory *self,  FuDevice *device,
 
 	locker = fu_mutex_write_locker_new (self->db_mutex);
 	g_return_val_if_fail (locker != NULL, FALSE);
-	g_debug ("remove device %s [%s]",
-		 fu_device_get_name (device),
-		 fu_device_get_id (device));
-	rc = sqlite3_prepare_v2 (self->db,
-				 "DELETE FROM history WHERE device_id = ?1 "
-				 "AND version_old = ?2 "
-				 "AND version_new = ?3;",
-				 -1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
-		return FALSE;
-	}
-	sqlite3_bind_text (stmt, 1, fu_device_get_id (device), -1, SQLITE_STATIC);
-	sqlite3_bind_text (stmt, 2, fu_device_get_version (device), -1, SQLITE_STATIC);
-	sqlite3_bind_text (stmt, 3, fwupd_release_get_version (release), -1, SQLITE_STATIC);
-	return fu_history_stmt_exec (self, stmt, NULL, error);
+	return fu_history_remove_device_internal (self, device, release, error);
 }
 
 FuDevice *
 fu_history_get_device_by_id (FuHistory *self, const gchar *device_id, GError **error)
 {
-	gint rc;
+	sqlite3_stmt *stmt;
 	g_autoptr(GPtrArray) array_tmp = NULL;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), NULL);
@@ -664,34 +764,31 @@ fu_history_get_device_by_id (FuHistory *self, const gchar *device_id, GError **e
 	if (!fu_history_load (self, error))
 		return NULL;
 
-	/* get all the devices */
-	locker = fu_mutex_read_locker_new (self->db_mutex);
+	/* get all the devices; the prepared statement is shared so this
+	 * cannot use a read lock */
+	locker = fu_mutex_write_locker_new (self->db_mutex);
 	g_return_val_if_fail (locker != NULL, NULL);
 	g_debug ("get device");
-	rc = sqlite3_prepare_v2 (self->db,
-				 "SELECT device_id, "
-					"checksum, "
-					"plugin, "
-					"device_created, "
-					"device_modified, "
-					"display_name, "
-					"filename, "
-					"flags, "
-					"metadata, "
-					"guid_default, "
-					"update_state, "
-					"update_error, "
-					"version_new, "
-					"version_old, "
-					"checksum_device, "
-					"protocol FROM history WHERE "
-				 "device_id = ?1 LIMIT 1", -1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
+	stmt = fu_history_prepare (self,
+				   "SELECT device_id, "
+					  "checksum, "
+					  "plugin, "
+					  "device_created, "
+					  "device_modified, "
+					  "display_name, "
+					  "filename, "
+					  "flags, "
+					  "metadata, "
+					  "guid_default, "
+					  "update_state, "
+					  "update_error, "
+					  "version_new, "
+					  "version_old, "
+					  "checksum_device, "
+					  "protocol FROM history WHERE "
+				   "device_id = ?1 LIMIT 1", error);
+	if (stmt == NULL)
 		return NULL;
-	}
 	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_STATIC);
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	if (!fu_history_stmt_exec (self, stmt, array_tmp, error))
@@ -707,12 +804,19 @@ fu_history_get_device_by_id (FuHistory *self, const gchar *device_id, GError **e
 }
 
 GPtrArray *
-fu_history_get_devices (FuHistory *self, GError **error)
+fu_history_get_devices_filtered (FuHistory *self,
+				 const gchar *device_id,
+				 FwupdUpdateState update_state,
+				 guint64 modified_min,
+				 guint64 modified_max,
+				 guint offset,
+				 guint limit,
+				 GError **error)
 {
 	GPtrArray *array = NULL;
-	g_autoptr(sqlite3_stmt) stmt = NULL;
-	gint rc;
+	sqlite3_stmt *stmt;
 	g_autoptr(GPtrArray) array_tmp = NULL;
+	g_autoptr(GString) sql = NULL;
 	g_autoptr(FuMutexLocker) locker = NULL;
 
 	g_return_val_if_fail (FU_IS_HISTORY (self), NULL);
@@ -723,34 +827,47 @@ fu_history_get_devices (FuHistory *self, GError **error)
 			return NULL;
 	}
 
-	/* get all the devices */
-	locker = fu_mutex_read_locker_new (self->db_mutex);
+	/* only the filters that are set are used, so each combination gets
+	 * its own prepared statement that can use the right index */
+	sql = g_string_new ("SELECT device_id, "
+				   "checksum, "
+				   "plugin, "
+				   "device_created, "
+				   "device_modified, "
+				   "display_name, "
+				   "filename, "
+				   "flags, "
+				   "metadata, "
+				   "guid_default, "
+				   "update_state, "
+				   "update_error, "
+				   "version_new, "
+				   "version_old, "
+				   "checksum_device, "
+				   "protocol FROM history WHERE 1");
+	if (device_id != NULL)
+		g_string_append (sql, " AND device_id = ?1");
+	if (update_state != FWUPD_UPDATE_STATE_UNKNOWN)
+		g_string_append (sql, " AND update_state = ?2");
+	if (modified_min > 0)
+		g_string_append (sql, " AND device_modified >= ?3");
+	if (modified_max > 0)
+		g_string_append (sql, " AND device_modified <= ?4");
+	g_string_append (sql, " ORDER BY device_modified ASC, rowid ASC "
+			      "LIMIT ?5 OFFSET ?6;");
+
+	/* get the devices */
+	locker = fu_mutex_write_locker_new (self->db_mutex);
 	g_return_val_if_fail (locker != NULL, NULL);
-	rc = sqlite3_prepare_v2 (self->db,
-				 "SELECT device_id, "
-					"checksum, "
-					"plugin, "
-					"device_created, "
-					"device_modified, "
-					"display_name, "
-					"filename, "
-					"flags, "
-					"metadata, "
-					"guid_default, "
-					"update_state, "
-					"update_error, "
-					"version_new, "
-					"version_old, "
-					"checksum_device, "
-					"protocol FROM history "
-					"ORDER BY device_modified ASC;",
-					-1, &stmt, NULL);
-	if (rc != SQLITE_OK) {
-		g_set_error (error, FWUPD_ERROR, FWUPD_ERROR_INTERNAL,
-			     "Failed to prepare SQL: %s",
-			     sqlite3_errmsg (self->db));
+	stmt = fu_history_prepare (self, sql->str, error);
+	if (stmt == NULL)
 		return NULL;
-	}
+	sqlite3_bind_text (stmt, 1, device_id, -1, SQLITE_STATIC);
+	sqlite3_bind_int (stmt, 2, update_state);
+	sqlite3_bind_int64 (stmt, 3, modified_min);
+	sqlite3_bind_int64 (stmt, 4, modified_max);
+	sqlite3_bind_int64 (stmt, 5, limit > 0 ? (gint64) limit : -1);
+	sqlite3_bind_int64 (stmt, 6, offset);
 	array_tmp = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	if (!fu_history_stmt_exec (self, stmt, array_tmp, error))
 		return NULL;
@@ -758,6 +875,46 @@ fu_history_get_devices (FuHistory *self, GError **error)
 	return array;
 }
 
+GPtrArray *
+fu_history_get_devices (FuHistory *self, GError **error)
+{
+	return fu_history_get_devices_filtered (self, NULL,
+						FWUPD_UPDATE_STATE_UNKNOWN,
+						0, 0, 0, 0, error);
+}
+
+/* removes successful updates older than @modified_max, although the most
+ * recent entry for each device is always kept */
+gboolean
+fu_history_prune (FuHistory *self, guint64 modified_max, GError **error)
+{
+	sqlite3_stmt *stmt;
+	g_autoptr(FuMutexLocker) locker = NULL;
+
+	g_return_val_if_fail (FU_IS_HISTORY (self), FALSE);
+
+	/* lazy load */
+	if (!fu_history_load (self, error))
+		return FALSE;
+
+	locker = fu_mutex_write_locker_new (self->db_mutex);
+	g_return_val_if_fail (locker != NULL, FALSE);
+	stmt = fu_history_prepare (self,
+				   "DELETE FROM history WHERE update_state = ?1 "
+				   "AND device_modified < ?2 "
+				   "AND rowid NOT IN (SELECT MAX(rowid) FROM history "
+						     "GROUP BY device_id);",
+				   error);
+	if (stmt == NULL)
+		return FALSE;
+	sqlite3_bind_int (stmt, 1, FWUPD_UPDATE_STATE_SUCCESS);
+	sqlite3_bind_int64 (stmt, 2, modified_max);
+	if (!fu_history_stmt_exec (self, stmt, NULL, error))
+		return FALSE;
+	g_debug ("pruned %i old history entries", sqlite3_changes (self->db));
+	return TRUE;
+}
+
 static void
 fu_history_class_init (FuHistoryClass *klass)
 {
@@ -769,6 +926,8 @@ static void
 fu_history_init (FuHistory *self)
 {
 	self->db_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "db");
+	self->stmts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					     (GDestroyNotify) sqlite3_finalize);
 }
 
 static void
@@ -776,6 +935,7 @@ fu_history_finalize (GObject *object)
 {
 	FuHistory *self = FU_HISTORY (object);
 
+	g_hash_table_unref (self->stmts);
 	if (self->db != NULL)
 		sqlite3_close (self->db);
 	g_object_unref (self->db_mutex);
@@ -56,6 +56,17 @@ FuDevice	*fu_history_get_device_by_id		(FuHistory	*self,
 							 GError		**error);
 GPtrArray	*fu_history_get_devices			(FuHistory	*self,
 							 GError		**error);
+GPtrArray	*fu_history_get_devices_filtered	(FuHistory	*self,
+							 const gchar	*device_id,
+							 FwupdUpdateState update_state,
+							 guint64	 modified_min,
+							 guint64	 modified_max,
+							 guint		 offset,
+							 guint		 limit,
+							 GError		**error);
+gboolean	 fu_history_prune			(FuHistory	*self,
+							 guint64	 modified_max,
+							 GError		**error);
 
 G_END_DECLS
 
@@ -0,0 +1,344 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#define G_LOG_DOMAIN				"FuKeyring"
+
+#include "config.h"
+
+#include <string.h>
+
+#include "fu-common.h"
+#include "fu-keyring-cache.h"
+
+/**
+ * SECTION:fu-keyring-cache
+ * @short_description: a cache of signature verification results
+ *
+ * Verifying a detached signature with GnuPG or GnuTLS is slow, and the same
+ * remote metadata is often verified again even though neither the data nor
+ * the signature have changed. Results are keyed by the digest of the data,
+ * the digest of the signature and a generation computed from the contents of
+ * the trusted public keys, so that changing any of them causes a miss.
+ *
+ * The results are optionally saved to disk so they survive a daemon restart,
+ * but each one is only trusted for a limited time after it was verified so
+ * that a key revocation or a change to the verification code is eventually
+ * picked up without a generation change.
+ */
+
+#define FU_KEYRING_CACHE_ENTRIES_MAX		32
+#define FU_KEYRING_CACHE_AGE_MAX		(60 * 60 * 24)	/* s */
+
+static void fu_keyring_cache_finalize	 (GObject *obj);
+
+struct _FuKeyringCache
+{
+	GObject			 parent_instance;
+	GKeyFile		*kf;
+	gchar			*filename;
+	GPtrArray		*pki_dirs;	/* of gchar* */
+	gchar			*generation;	/* lazily computed */
+};
+
+G_DEFINE_TYPE (FuKeyringCache, fu_keyring_cache, G_TYPE_OBJECT)
+
+static gint
+fu_keyring_cache_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+static void
+fu_keyring_cache_checksum_dir (GChecksum *csum, const gchar *path)
+{
+	const gchar *fn;
+	g_autoptr(GDir) dir = NULL;
+	g_autoptr(GPtrArray) fns = g_ptr_array_new_with_free_func (g_free);
+
+	/* a missing directory is a different generation to an empty one */
+	g_checksum_update (csum, (const guchar *) path, strlen (path) + 1);
+	dir = g_dir_open (path, 0, NULL);
+	if (dir == NULL)
+		return;
+	while ((fn = g_dir_read_name (dir)) != NULL)
+		g_ptr_array_add (fns, g_strdup (fn));
+	g_ptr_array_sort (fns, fu_keyring_cache_sort_cb);
+
+	/* the keys are small, so use the contents rather than the mtime */
+	for (guint i = 0; i < fns->len; i++) {
+		const gchar *fn_tmp = g_ptr_array_index (fns, i);
+		gsize len = 0;
+		g_autofree gchar *data = NULL;
+		g_autofree gchar *fn_full = g_build_filename (path, fn_tmp, NULL);
+		if (!g_file_get_contents (fn_full, &data, &len, NULL))
+			continue;
+		g_checksum_update (csum, (const guchar *) fn_tmp, strlen (fn_tmp) + 1);
+		g_checksum_update (csum, (const guchar *) data, len);
+	}
+}
+
+static const gchar *
+fu_keyring_cache_get_generation (FuKeyringCache *self)
+{
+	g_autoptr(GChecksum) csum = NULL;
+
+	if (self->generation != NULL)
+		return self->generation;
+	csum = g_checksum_new (G_CHECKSUM_SHA256);
+	for (guint i = 0; i < self->pki_dirs->len; i++)
+		fu_keyring_cache_checksum_dir (csum, g_ptr_array_index (self->pki_dirs, i));
+	self->generation = g_strdup (g_checksum_get_string (csum));
+	g_debug ("keyring generation is %s", self->generation);
+	return self->generation;
+}
+
+static void
+fu_keyring_cache_save (FuKeyringCache *self)
+{
+	g_autoptr(GError) error_local = NULL;
+
+	if (self->filename == NULL)
+		return;
+	if (!fu_common_mkdir_parent (self->filename, &error_local) ||
+	    !g_key_file_save_to_file (self->kf, self->filename, &error_local)) {
+		g_warning ("failed to save keyring cache: %s", error_local->message);
+	}
+}
+
+/**
+ * fu_keyring_cache_set_filename:
+ * @self: A #FuKeyringCache
+ * @filename: A filename, e.g. `/var/lib/fwupd/remotes.d/keyring-cache.conf`
+ *
+ * Sets the file used to persist verification results, loading any results
+ * that were previously saved.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_keyring_cache_set_filename (FuKeyringCache *self, const gchar *filename)
+{
+	g_autoptr(GError) error_local = NULL;
+
+	g_return_if_fail (FU_IS_KEYRING_CACHE (self));
+	g_return_if_fail (filename != NULL);
+
+	g_free (self->filename);
+	self->filename = g_strdup (filename);
+	if (!g_key_file_load_from_file (self->kf, filename,
+					G_KEY_FILE_NONE, &error_local)) {
+		if (!g_error_matches (error_local, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+			g_debug ("ignoring keyring cache: %s", error_local->message);
+		g_key_file_free (self->kf);
+		self->kf = g_key_file_new ();
+	}
+}
+
+/**
+ * fu_keyring_cache_add_pki_dir:
+ * @self: A #FuKeyringCache
+ * @path: A directory of public keys, e.g. `/etc/pki/fwupd-metadata`
+ *
+ * Adds a directory of public keys that any cached result depends on.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_keyring_cache_add_pki_dir (FuKeyringCache *self, const gchar *path)
+{
+	g_return_if_fail (FU_IS_KEYRING_CACHE (self));
+	g_return_if_fail (path != NULL);
+	g_ptr_array_add (self->pki_dirs, g_strdup (path));
+	g_clear_pointer (&self->generation, g_free);
+}
+
+/**
+ * fu_keyring_cache_build_key:
+ * @self: A #FuKeyringCache
+ * @kind: A keyring kind, e.g. `gpg`
+ * @blob: The signed data
+ * @blob_signature: The detached signature
+ *
+ * Builds the key used for fu_keyring_cache_lookup() and fu_keyring_cache_add()
+ * from the digests of the data and signature and the current keyring
+ * generation.
+ *
+ * Returns: (transfer full): a string
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+fu_keyring_cache_build_key (FuKeyringCache *self,
+			    const gchar *kind,
+			    GBytes *blob,
+			    GBytes *blob_signature)
+{
+	g_autofree gchar *csum_blob = NULL;
+	g_autofree gchar *csum_sig = NULL;
+	g_autoptr(GChecksum) csum = g_checksum_new (G_CHECKSUM_SHA256);
+
+	g_return_val_if_fail (FU_IS_KEYRING_CACHE (self), NULL);
+	g_return_val_if_fail (kind != NULL, NULL);
+	g_return_val_if_fail (blob != NULL, NULL);
+	g_return_val_if_fail (blob_signature != NULL, NULL);
+
+	csum_blob = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, blob);
+	csum_sig = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, blob_signature);
+	g_checksum_update (csum, (const guchar *) kind, strlen (kind) + 1);
+	g_checksum_update (csum, (const guchar *) csum_blob, -1);
+	g_checksum_update (csum, (const guchar *) csum_sig, -1);
+	g_checksum_update (csum, (const guchar *) fu_keyring_cache_get_generation (self), -1);
+	return g_strdup (g_checksum_get_string (csum));
+}
+
+/**
+ * fu_keyring_cache_lookup:
+ * @self: A #FuKeyringCache
+ * @key: A key from fu_keyring_cache_build_key()
+ *
+ * Finds a previous successful verification result that is recent enough to
+ * be trusted.
+ *
+ * Returns: (transfer full): a #FuKeyringResult, or %NULL if not found
+ *
+ * Since: 1.2.5
+ **/
+FuKeyringResult *
+fu_keyring_cache_lookup (FuKeyringCache *self, const gchar *key)
+{
+	gint64 now = g_get_real_time () / G_USEC_PER_SEC;
+	gint64 timestamp;
+	gint64 verified;
+	g_autofree gchar *authority = NULL;
+
+	g_return_val_if_fail (FU_IS_KEYRING_CACHE (self), NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	if (!g_key_file_has_group (self->kf, key))
+		return NULL;
+
+	/* too old, or from the future if the clock has been changed */
+	verified = g_key_file_get_int64 (self->kf, key, "Verified", NULL);
+	if (verified > now || now - verified > FU_KEYRING_CACHE_AGE_MAX) {
+		g_debug ("ignoring keyring result verified at %" G_GINT64_FORMAT,
+			 verified);
+		return NULL;
+	}
+	timestamp = g_key_file_get_int64 (self->kf, key, "Timestamp", NULL);
+	authority = g_key_file_get_string (self->kf, key, "Authority", NULL);
+	return g_object_new (FU_TYPE_KEYRING_RESULT,
+			     "timestamp", timestamp,
+			     "authority", authority,
+			     NULL);
+}
+
+/**
+ * fu_keyring_cache_add:
+ * @self: A #FuKeyringCache
+ * @key: A key from fu_keyring_cache_build_key()
+ * @result: A #FuKeyringResult
+ *
+ * Adds a successful verification result to the cache, removing the oldest
+ * results if required. If a filename has been set then the cache is saved.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_keyring_cache_add (FuKeyringCache *self, const gchar *key, FuKeyringResult *result)
+{
+	const gchar *authority;
+	gsize groups_len = 0;
+	g_auto(GStrv) groups = NULL;
+
+	g_return_if_fail (FU_IS_KEYRING_CACHE (self));
+	g_return_if_fail (key != NULL);
+	g_return_if_fail (FU_IS_KEYRING_RESULT (result));
+
+	/* remove the oldest results, and any existing entry so it is newest */
+	g_key_file_remove_group (self->kf, key, NULL);
+	groups = g_key_file_get_groups (self->kf, &groups_len);
+	for (gsize i = 0; i + FU_KEYRING_CACHE_ENTRIES_MAX <= groups_len; i++)
+		g_key_file_remove_group (self->kf, groups[i], NULL);
+
+	g_key_file_set_int64 (self->kf, key, "Verified",
+			      g_get_real_time () / G_USEC_PER_SEC);
+	g_key_file_set_int64 (self->kf, key, "Timestamp",
+			      fu_keyring_result_get_timestamp (result));
+	authority = fu_keyring_result_get_authority (result);
+	if (authority != NULL)
+		g_key_file_set_string (self->kf, key, "Authority", authority);
+	fu_keyring_cache_save (self);
+}
+
+/**
+ * fu_keyring_cache_invalidate:
+ * @self: A #FuKeyringCache
+ *
+ * Removes all cached results, for instance when the public keys have changed.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_keyring_cache_invalidate (FuKeyringCache *self)
+{
+	gsize groups_len = 0;
+	g_auto(GStrv) groups = NULL;
+
+	g_return_if_fail (FU_IS_KEYRING_CACHE (self));
+
+	g_clear_pointer (&self->generation, g_free);
+	groups = g_key_file_get_groups (self->kf, &groups_len);
+	if (groups_len == 0)
+		return;
+	g_debug ("invalidating %" G_GSIZE_FORMAT " cached keyring results", groups_len);
+	g_key_file_free (self->kf);
+	self->kf = g_key_file_new ();
+	fu_keyring_cache_save (self);
+}
+
+static void
+fu_keyring_cache_class_init (FuKeyringCacheClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = fu_keyring_cache_finalize;
+}
+
+static void
+fu_keyring_cache_init (FuKeyringCache *self)
+{
+	self->kf = g_key_file_new ();
+	self->pki_dirs = g_ptr_array_new_with_free_func (g_free);
+}
+
+static void
+fu_keyring_cache_finalize (GObject *obj)
+{
+	FuKeyringCache *self = FU_KEYRING_CACHE (obj);
+
+	g_key_file_free (self->kf);
+	g_free (self->filename);
+	g_free (self->generation);
+	g_ptr_array_unref (self->pki_dirs);
+
+	G_OBJECT_CLASS (fu_keyring_cache_parent_class)->finalize (obj);
+}
+
+/**
+ * fu_keyring_cache_new:
+ *
+ * Creates a new cache of signature verification results.
+ *
+ * Returns: a #FuKeyringCache
+ *
+ * Since: 1.2.5
+ **/
+FuKeyringCache *
+fu_keyring_cache_new (void)
+{
+	FuKeyringCache *self;
+	self = g_object_new (FU_TYPE_KEYRING_CACHE, NULL);
+	return FU_KEYRING_CACHE (self);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2018 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __FU_KEYRING_CACHE_H
+#define __FU_KEYRING_CACHE_H
+
+G_BEGIN_DECLS
+
+#include <glib-object.h>
+
+#include "fu-keyring-result.h"
+
+#define FU_TYPE_KEYRING_CACHE (fu_keyring_cache_get_type ())
+G_DECLARE_FINAL_TYPE (FuKeyringCache, fu_keyring_cache, FU, KEYRING_CACHE, GObject)
+
+FuKeyringCache	*fu_keyring_cache_new		(void);
+void		 fu_keyring_cache_set_filename	(FuKeyringCache	*self,
+						 const gchar	*filename);
+void		 fu_keyring_cache_add_pki_dir	(FuKeyringCache	*self,
+						 const gchar	*path);
+gchar		*fu_keyring_cache_build_key	(FuKeyringCache	*self,
+						 const gchar	*kind,
+						 GBytes		*blob,
+						 GBytes		*blob_signature);
+FuKeyringResult	*fu_keyring_cache_lookup	(FuKeyringCache	*self,
+						 const gchar	*key);
+void		 fu_keyring_cache_add		(FuKeyringCache	*self,
+						 const gchar	*key,
+						 FuKeyringResult *result);
+void		 fu_keyring_cache_invalidate	(FuKeyringCache	*self);
+
+G_END_DECLS
+
+#endif /* __FU_KEYRING_CACHE_H */
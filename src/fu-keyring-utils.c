@@ -65,6 +65,16 @@ fu_keyring_create_for_kind (FwupdKeyringKind kind, GError **error)
 	return NULL;
 }
 
+/* save the result on the release so that reusing a parsed archive does not
+ * verify the signature again */
+static void
+fu_keyring_set_release_trust_flags_cached (XbNode *release, FwupdTrustFlags trust_flags)
+{
+	g_object_set_data_full (G_OBJECT (release), "fwupd::ReleaseTrustFlags",
+				g_memdup (&trust_flags, sizeof(trust_flags)),
+				g_free);
+}
+
 /**
  * fu_keyring_get_release_trust_flags:
  * @release: A #XbNode, e.g. %FWUPD_KEYRING_KIND_GPG
@@ -81,6 +91,7 @@ fu_keyring_get_release_trust_flags (XbNode *release,
 				    GError **error)
 {
 	FwupdKeyringKind keyring_kind = FWUPD_KEYRING_KIND_UNKNOWN;
+	FwupdTrustFlags *trust_flags_cached;
 	GBytes *blob_payload;
 	GBytes *blob_signature;
 	const gchar *fn;
@@ -100,6 +111,13 @@ fu_keyring_get_release_trust_flags (XbNode *release,
 		{ FWUPD_KEYRING_KIND_NONE,	NULL }
 	};
 
+	/* already verified */
+	trust_flags_cached = g_object_get_data (G_OBJECT (release), "fwupd::ReleaseTrustFlags");
+	if (trust_flags_cached != NULL) {
+		*trust_flags |= *trust_flags_cached;
+		return TRUE;
+	}
+
 	/* custom filename specified */
 	fn = xb_node_query_attr (release, "checksum[@target='content']", "filename", NULL);
 	if (fn == NULL)
@@ -118,6 +136,7 @@ fu_keyring_get_release_trust_flags (XbNode *release,
 	}
 	if (keyring_kind == FWUPD_KEYRING_KIND_UNKNOWN) {
 		g_debug ("firmware archive contained no signature");
+		fu_keyring_set_release_trust_flags_cached (release, FWUPD_TRUST_FLAG_NONE);
 		return TRUE;
 	}
 
@@ -162,11 +181,13 @@ fu_keyring_get_release_trust_flags (XbNode *release,
 		g_warning ("untrusted as failed to verify from %s keyring: %s",
 			   fu_keyring_get_name (kr),
 			   error_local->message);
+		fu_keyring_set_release_trust_flags_cached (release, FWUPD_TRUST_FLAG_NONE);
 		return TRUE;
 	}
 
 	/* awesome! */
 	g_debug ("marking payload as trusted");
 	*trust_flags |= FWUPD_TRUST_FLAG_PAYLOAD;
+	fu_keyring_set_release_trust_flags_cached (release, FWUPD_TRUST_FLAG_PAYLOAD);
 	return TRUE;
 }
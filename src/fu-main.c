@@ -779,6 +779,57 @@ fu_main_daemon_method_call (GDBusConnection *connection, const gchar *sender,
 		g_dbus_method_invocation_return_value (invocation, val);
 		return;
 	}
+	if (g_strcmp0 (method_name, "GetHistoryFiltered") == 0) {
+		const gchar *device_id = NULL;
+		guint32 update_state = FWUPD_UPDATE_STATE_UNKNOWN;
+		guint64 modified_min = 0;
+		guint64 modified_max = 0;
+		guint32 offset = 0;
+		guint32 limit = 0;
+		g_autoptr(GPtrArray) devices = NULL;
+		g_autoptr(GVariant) filters = NULL;
+
+		/* all filters are optional */
+		g_variant_get (parameters, "(@a{sv})", &filters);
+		g_variant_lookup (filters, "device-id", "&s", &device_id);
+		g_variant_lookup (filters, "update-state", "u", &update_state);
+		g_variant_lookup (filters, "modified-min", "t", &modified_min);
+		g_variant_lookup (filters, "modified-max", "t", &modified_max);
+		g_variant_lookup (filters, "offset", "u", &offset);
+		g_variant_lookup (filters, "limit", "u", &limit);
+		g_debug ("Called %s(%s,%u,%u)", method_name,
+			 device_id, offset, limit);
+		if (g_strcmp0 (device_id, FWUPD_DEVICE_ID_ANY) == 0)
+			device_id = NULL;
+		if (device_id != NULL &&
+		    !fu_main_device_id_valid (device_id, &error)) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		devices = fu_engine_get_history_filtered (priv->engine, device_id,
+							  update_state,
+							  modified_min, modified_max,
+							  offset, limit, &error);
+		if (devices == NULL) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		val = fu_main_device_array_to_variant (priv, sender, devices, &error);
+		if (val == NULL) {
+			g_dbus_method_invocation_return_gerror (invocation, error);
+			return;
+		}
+		g_dbus_method_invocation_return_value (invocation, val);
+		return;
+	}
+	if (g_strcmp0 (method_name, "GetProfile") == 0) {
+		g_autofree gchar *json = NULL;
+		g_debug ("Called %s()", method_name);
+		json = fu_profile_to_json (fu_engine_get_profile (priv->engine));
+		val = g_variant_new ("(s)", json);
+		g_dbus_method_invocation_return_value (invocation, val);
+		return;
+	}
 	if (g_strcmp0 (method_name, "ClearResults") == 0) {
 		const gchar *device_id;
 		g_variant_get (parameters, "(&s)", &device_id);
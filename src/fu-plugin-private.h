@@ -9,6 +9,7 @@
 
 #include "fu-quirks.h"
 #include "fu-plugin.h"
+#include "fu-profile.h"
 #include "fu-smbios.h"
 
 G_BEGIN_DECLS
@@ -18,12 +19,17 @@ G_BEGIN_DECLS
 FuPlugin	*fu_plugin_new				(void);
 void		 fu_plugin_set_usb_context		(FuPlugin	*self,
 							 GUsbContext	*usb_ctx);
+void		 fu_plugin_set_main_context		(FuPlugin	*self,
+							 GMainContext	*main_ctx);
+void		 fu_plugin_unlock_usb_context		(void);
 void		 fu_plugin_set_hwids			(FuPlugin	*self,
 							 FuHwids	*hwids);
 void		 fu_plugin_set_udev_subsystems		(FuPlugin	*self,
 							 GPtrArray	*udev_subsystems);
 void		 fu_plugin_set_quirks			(FuPlugin	*self,
 							 FuQuirks	*quirks);
+void		 fu_plugin_set_profile			(FuPlugin	*self,
+							 FuProfile	*profile);
 void		 fu_plugin_set_runtime_versions		(FuPlugin	*self,
 							 GHashTable	*runtime_versions);
 void		 fu_plugin_set_compile_versions		(FuPlugin	*self,
@@ -48,6 +54,16 @@ GHashTable	*fu_plugin_get_report_metadata		(FuPlugin	*self);
 gboolean	 fu_plugin_open				(FuPlugin	*self,
 							 const gchar	*filename,
 							 GError		**error);
+gboolean	 fu_plugin_is_open			(FuPlugin	*self);
+gboolean	 fu_plugin_load_manifest		(FuPlugin	*self,
+							 const gchar	*filename,
+							 GError		**error);
+gboolean	 fu_plugin_has_manifest			(FuPlugin	*self);
+gboolean	 fu_plugin_manifest_is_lazy		(FuPlugin	*self);
+GPtrArray	*fu_plugin_get_manifest_udev_subsystems	(FuPlugin	*self);
+gboolean	 fu_plugin_manifest_check_hwids		(FuPlugin	*self);
+gboolean	 fu_plugin_manifest_check_device	(FuPlugin	*self,
+							 FuDevice	*device);
 gboolean	 fu_plugin_runner_startup		(FuPlugin	*self,
 							 GError		**error);
 gboolean	 fu_plugin_runner_coldplug		(FuPlugin	*self,
@@ -33,6 +33,7 @@
  */
 
 #define	FU_PLUGIN_COLDPLUG_DELAY_MAXIMUM	3000u	/* ms */
+#define	FU_PLUGIN_MANIFEST_GROUP		"fwupd Plugin"
 
 static void fu_plugin_finalize			 (GObject *object);
 
@@ -47,14 +48,23 @@ typedef struct {
 	gchar			*build_hash;
 	FuHwids			*hwids;
 	FuQuirks		*quirks;
+	GHashTable		*quirk_group_keys;	/* group:group_key */
+	FuMutex			*quirk_group_keys_mutex;
+	FuProfile		*profile;	/* nullable */
 	GHashTable		*runtime_versions;
 	GHashTable		*compile_versions;
 	GPtrArray		*udev_subsystems;
+	gboolean		 has_manifest;
+	GPtrArray		*manifest_guids;
+	GPtrArray		*manifest_hwids;
+	GPtrArray		*manifest_udev_subsystems;
 	FuSmbios		*smbios;
 	GHashTable		*devices;	/* platform_id:GObject */
 	FuMutex			*devices_mutex;
 	GHashTable		*report_metadata;	/* key:value */
 	FuPluginData		*data;
+	GMainContext		*main_ctx;	/* nullable */
+	GThread			*main_thread;
 } FuPluginPrivate;
 
 enum {
@@ -70,6 +80,12 @@ enum {
 
 static guint signals[SIGNAL_LAST] = { 0 };
 
+#define FU_PLUGIN_QUIRK_GROUP_KEYS_MAX	256
+
+/* held by the worker thread using the shared GUsbContext */
+static GMutex fu_plugin_usb_mutex;
+static GPrivate fu_plugin_usb_locked;
+
 G_DEFINE_TYPE_WITH_PRIVATE (FuPlugin, fu_plugin, G_TYPE_OBJECT)
 #define GET_PRIVATE(o) (fu_plugin_get_instance_private (o))
 
@@ -282,9 +298,28 @@ fu_plugin_get_usb_context (FuPlugin *self)
 {
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	g_return_val_if_fail (FU_IS_PLUGIN (self), NULL);
+
+	/* the shared context is not thread safe, so only one worker thread
+	 * can use it at a time until the vfunc has returned */
+	if (priv->main_ctx != NULL &&
+	    priv->main_thread != g_thread_self () &&
+	    g_private_get (&fu_plugin_usb_locked) == NULL) {
+		g_mutex_lock (&fu_plugin_usb_mutex);
+		g_private_set (&fu_plugin_usb_locked, GINT_TO_POINTER (TRUE));
+	}
 	return priv->usb_ctx;
 }
 
+/* called from a worker thread when the plugin vfunc has returned */
+void
+fu_plugin_unlock_usb_context (void)
+{
+	if (g_private_get (&fu_plugin_usb_locked) == NULL)
+		return;
+	g_private_set (&fu_plugin_usb_locked, NULL);
+	g_mutex_unlock (&fu_plugin_usb_mutex);
+}
+
 void
 fu_plugin_set_usb_context (FuPlugin *self, GUsbContext *usb_ctx)
 {
@@ -292,6 +327,101 @@ fu_plugin_set_usb_context (FuPlugin *self, GUsbContext *usb_ctx)
 	g_set_object (&priv->usb_ctx, usb_ctx);
 }
 
+/* the plugin signals are emitted in the thread that called this function when
+ * the plugin vfuncs are being run from a worker thread */
+void
+fu_plugin_set_main_context (FuPlugin *self, GMainContext *main_ctx)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	if (priv->main_ctx != NULL)
+		g_main_context_unref (priv->main_ctx);
+	priv->main_ctx = main_ctx != NULL ? g_main_context_ref (main_ctx) : NULL;
+	priv->main_thread = main_ctx != NULL ? g_thread_self () : NULL;
+}
+
+typedef struct {
+	FuPlugin		*self;
+	guint			 signal_idx;
+	FuDevice		*device;	/* nullable */
+	const gchar		*guid;		/* nullable */
+	guint			 duration;
+	gboolean		 retval;
+	GMutex			 mutex;
+	GCond			 cond;
+	gboolean		 done;
+} FuPluginSignalHelper;
+
+static void
+fu_plugin_signal_helper_emit (FuPluginSignalHelper *helper)
+{
+	guint signal_id = signals[helper->signal_idx];
+	switch (helper->signal_idx) {
+	case SIGNAL_DEVICE_ADDED:
+	case SIGNAL_DEVICE_REMOVED:
+	case SIGNAL_DEVICE_REGISTER:
+		g_signal_emit (helper->self, signal_id, 0, helper->device);
+		break;
+	case SIGNAL_SET_COLDPLUG_DELAY:
+		g_signal_emit (helper->self, signal_id, 0, helper->duration);
+		break;
+	case SIGNAL_CHECK_SUPPORTED:
+		g_signal_emit (helper->self, signal_id, 0, helper->guid, &helper->retval);
+		break;
+	default:
+		g_signal_emit (helper->self, signal_id, 0);
+		break;
+	}
+}
+
+static gboolean
+fu_plugin_emit_signal_cb (gpointer user_data)
+{
+	FuPluginSignalHelper *helper = (FuPluginSignalHelper *) user_data;
+	fu_plugin_signal_helper_emit (helper);
+	g_mutex_lock (&helper->mutex);
+	helper->done = TRUE;
+	g_cond_signal (&helper->cond);
+	g_mutex_unlock (&helper->mutex);
+	return G_SOURCE_REMOVE;
+}
+
+/* the engine is not thread safe, so when a vfunc is being run from a worker
+ * thread every signal is handled in the thread that owns the engine */
+static void
+fu_plugin_emit_signal (FuPluginSignalHelper *helper)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (helper->self);
+
+	/* emit directly */
+	if (priv->main_ctx == NULL || priv->main_thread == g_thread_self ()) {
+		fu_plugin_signal_helper_emit (helper);
+		return;
+	}
+
+	/* block until the main thread has handled the signal so that the
+	 * plugin sees exactly the same ordering as when run synchronously */
+	g_mutex_init (&helper->mutex);
+	g_cond_init (&helper->cond);
+	g_main_context_invoke (priv->main_ctx, fu_plugin_emit_signal_cb, helper);
+	g_mutex_lock (&helper->mutex);
+	while (!helper->done)
+		g_cond_wait (&helper->cond, &helper->mutex);
+	g_mutex_unlock (&helper->mutex);
+	g_cond_clear (&helper->cond);
+	g_mutex_clear (&helper->mutex);
+}
+
+static void
+fu_plugin_emit_device_signal (FuPlugin *self, guint signal_idx, FuDevice *device)
+{
+	FuPluginSignalHelper helper = {
+		.self		= self,
+		.signal_idx	= signal_idx,
+		.device		= device,
+	};
+	fu_plugin_emit_signal (&helper);
+}
+
 /**
  * fu_plugin_get_enabled:
  * @self: A #FuPlugin
@@ -371,6 +501,244 @@ fu_plugin_open (FuPlugin *self, const gchar *filename, GError **error)
 	return TRUE;
 }
 
+gboolean
+fu_plugin_is_open (FuPlugin *self)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	return priv->module != NULL;
+}
+
+static gboolean
+fu_plugin_parse_usb_id (const gchar *str, guint16 *vid, guint16 *pid)
+{
+	gchar *endptr = NULL;
+	guint64 tmp;
+	g_auto(GStrv) split = g_strsplit (str, ":", -1);
+
+	if (g_strv_length (split) != 2)
+		return FALSE;
+	tmp = g_ascii_strtoull (split[0], &endptr, 16);
+	if (endptr == split[0] || *endptr != '\0' || tmp > G_MAXUINT16)
+		return FALSE;
+	*vid = (guint16) tmp;
+	tmp = g_ascii_strtoull (split[1], &endptr, 16);
+	if (endptr == split[1] || *endptr != '\0' || tmp > G_MAXUINT16)
+		return FALSE;
+	*pid = (guint16) tmp;
+	return TRUE;
+}
+
+static void
+fu_plugin_add_manifest_guid (GPtrArray *array, const gchar *str)
+{
+	if (fu_common_guid_is_valid (str)) {
+		g_ptr_array_add (array, g_strdup (str));
+		return;
+	}
+	g_ptr_array_add (array, fu_common_guid_from_string (str));
+}
+
+/**
+ * fu_plugin_load_manifest:
+ * @self: A #FuPlugin
+ * @filename: A manifest filename, e.g. `libfu_plugin_ebitdo.manifest`
+ * @error: A #GError, or %NULL
+ *
+ * Loads the manifest shipped alongside the plugin module. The manifest lists
+ * the hardware the plugin handles, which allows the engine to defer opening
+ * the module until a matching device appears.
+ *
+ * The `[fwupd Plugin]` group can contain the following string lists:
+ *
+ *  - `UsbIds`, USB VID:PID pairs, e.g. `2DC8:AB11`
+ *  - `Guids`, device GUIDs or instance IDs
+ *  - `UdevSubsystems`, e.g. `hidraw`
+ *  - `Hwids`, HWID GUIDs where at least one has to match the system
+ *
+ * Devices that set the plugin name using the `Plugin` quirk always match.
+ *
+ * As fu_plugin_init() is not run until the module is opened, the manifest
+ * also has to list any rules the engine needs before then:
+ *
+ *  - `RequiresQuirk`, e.g. `Plugin`
+ *  - `SupportsProtocol`, e.g. `com.8bitdo`
+ *  - `ConcurrentUpdate`, the reason the plugin can update devices in parallel
+ *
+ * Returns: %TRUE for success
+ **/
+gboolean
+fu_plugin_load_manifest (FuPlugin *self, const gchar *filename, GError **error)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+	g_auto(GStrv) guids = NULL;
+	g_auto(GStrv) hwids = NULL;
+	g_auto(GStrv) subsystems = NULL;
+	g_auto(GStrv) usb_ids = NULL;
+	struct {
+		const gchar	*key;
+		FuPluginRule	 rule;
+	} rules[] = {
+		{ "RequiresQuirk",	FU_PLUGIN_RULE_REQUIRES_QUIRK },
+		{ "SupportsProtocol",	FU_PLUGIN_RULE_SUPPORTS_PROTOCOL },
+		{ "ConcurrentUpdate",	FU_PLUGIN_RULE_CONCURRENT_UPDATE },
+		{ NULL, 0 }
+	};
+
+	if (!g_key_file_load_from_file (kf, filename, G_KEY_FILE_NONE, error))
+		return FALSE;
+	if (!g_key_file_has_group (kf, FU_PLUGIN_MANIFEST_GROUP)) {
+		g_set_error (error,
+			     FWUPD_ERROR,
+			     FWUPD_ERROR_INVALID_FILE,
+			     "%s has no [%s] group",
+			     filename, FU_PLUGIN_MANIFEST_GROUP);
+		return FALSE;
+	}
+
+	/* USB devices, using the same instance ID as FuUsbDevice */
+	usb_ids = g_key_file_get_string_list (kf, FU_PLUGIN_MANIFEST_GROUP,
+					      "UsbIds", NULL, NULL);
+	for (guint i = 0; usb_ids != NULL && usb_ids[i] != NULL; i++) {
+		guint16 vid = 0;
+		guint16 pid = 0;
+		g_autofree gchar *devid = NULL;
+		if (!fu_plugin_parse_usb_id (usb_ids[i], &vid, &pid)) {
+			g_set_error (error,
+				     FWUPD_ERROR,
+				     FWUPD_ERROR_INVALID_FILE,
+				     "invalid UsbIds entry '%s' in %s",
+				     usb_ids[i], filename);
+			return FALSE;
+		}
+		devid = g_strdup_printf ("USB\\VID_%04X&PID_%04X", vid, pid);
+		g_ptr_array_add (priv->manifest_guids, fu_common_guid_from_string (devid));
+	}
+
+	/* GUIDs or instance IDs */
+	guids = g_key_file_get_string_list (kf, FU_PLUGIN_MANIFEST_GROUP,
+					    "Guids", NULL, NULL);
+	for (guint i = 0; guids != NULL && guids[i] != NULL; i++)
+		fu_plugin_add_manifest_guid (priv->manifest_guids, guids[i]);
+
+	/* HWIDs */
+	hwids = g_key_file_get_string_list (kf, FU_PLUGIN_MANIFEST_GROUP,
+					    "Hwids", NULL, NULL);
+	for (guint i = 0; hwids != NULL && hwids[i] != NULL; i++)
+		fu_plugin_add_manifest_guid (priv->manifest_hwids, hwids[i]);
+
+	/* udev */
+	subsystems = g_key_file_get_string_list (kf, FU_PLUGIN_MANIFEST_GROUP,
+						 "UdevSubsystems", NULL, NULL);
+	for (guint i = 0; subsystems != NULL && subsystems[i] != NULL; i++)
+		g_ptr_array_add (priv->manifest_udev_subsystems, g_strdup (subsystems[i]));
+
+	/* rules normally added in fu_plugin_init() */
+	for (guint j = 0; rules[j].key != NULL; j++) {
+		g_auto(GStrv) names = NULL;
+		names = g_key_file_get_string_list (kf, FU_PLUGIN_MANIFEST_GROUP,
+						    rules[j].key, NULL, NULL);
+		for (guint i = 0; names != NULL && names[i] != NULL; i++)
+			fu_plugin_add_rule (self, rules[j].rule, names[i]);
+	}
+
+	priv->has_manifest = TRUE;
+	return TRUE;
+}
+
+gboolean
+fu_plugin_has_manifest (FuPlugin *self)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	return priv->has_manifest;
+}
+
+/**
+ * fu_plugin_manifest_is_lazy:
+ * @self: A #FuPlugin
+ *
+ * Gets if the manifest lists any devices or subsystems that can be used to
+ * open the plugin on demand. Manifests that only list HWIDs are opened as
+ * soon as the HWID matches.
+ *
+ * Returns: %TRUE if opening the plugin can be deferred
+ **/
+gboolean
+fu_plugin_manifest_is_lazy (FuPlugin *self)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	if (!priv->has_manifest)
+		return FALSE;
+
+	/* only quirked devices */
+	if (priv->manifest_hwids->len == 0)
+		return TRUE;
+	return priv->manifest_guids->len > 0 ||
+	       priv->manifest_udev_subsystems->len > 0;
+}
+
+GPtrArray *
+fu_plugin_get_manifest_udev_subsystems (FuPlugin *self)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	return priv->manifest_udev_subsystems;
+}
+
+/**
+ * fu_plugin_manifest_check_hwids:
+ * @self: A #FuPlugin
+ *
+ * Checks the manifest HWID requirements against the system.
+ *
+ * Returns: %TRUE if there are no requirements or at least one HWID matches
+ **/
+gboolean
+fu_plugin_manifest_check_hwids (FuPlugin *self)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	if (priv->manifest_hwids->len == 0)
+		return TRUE;
+	for (guint i = 0; i < priv->manifest_hwids->len; i++) {
+		const gchar *hwid = g_ptr_array_index (priv->manifest_hwids, i);
+		if (fu_plugin_check_hwid (self, hwid))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/**
+ * fu_plugin_manifest_check_device:
+ * @self: A #FuPlugin
+ * @device: A #FuDevice
+ *
+ * Checks if a newly added device is handled by the plugin according to the
+ * manifest, either by GUID or by udev subsystem.
+ *
+ * Returns: %TRUE if the plugin has to be opened to handle the device
+ **/
+gboolean
+fu_plugin_manifest_check_device (FuPlugin *self, FuDevice *device)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+
+	if (!priv->has_manifest)
+		return FALSE;
+	for (guint i = 0; i < priv->manifest_guids->len; i++) {
+		const gchar *guid = g_ptr_array_index (priv->manifest_guids, i);
+		if (fu_device_has_guid (device, guid))
+			return TRUE;
+	}
+	if (FU_IS_UDEV_DEVICE (device)) {
+		const gchar *subsystem = fu_udev_device_get_subsystem (FU_UDEV_DEVICE (device));
+		for (guint i = 0; i < priv->manifest_udev_subsystems->len; i++) {
+			const gchar *tmp = g_ptr_array_index (priv->manifest_udev_subsystems, i);
+			if (g_strcmp0 (subsystem, tmp) == 0)
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 /**
  * fu_plugin_device_add:
  * @self: A #FuPlugin
@@ -406,7 +774,7 @@ fu_plugin_device_add (FuPlugin *self, FuDevice *device)
 		 fu_device_get_id (device));
 	fu_device_set_created (device, (guint64) g_get_real_time () / G_USEC_PER_SEC);
 	fu_device_set_plugin (device, fu_plugin_get_name (self));
-	g_signal_emit (self, signals[SIGNAL_DEVICE_ADDED], 0, device);
+	fu_plugin_emit_device_signal (self, SIGNAL_DEVICE_ADDED, device);
 
 	/* add children if they have not already been added */
 	children = fu_device_get_children (device);
@@ -448,7 +816,7 @@ fu_plugin_device_register (FuPlugin *self, FuDevice *device)
 	g_debug ("emit device-register from %s: %s",
 		 fu_plugin_get_name (self),
 		 fu_device_get_id (device));
-	g_signal_emit (self, signals[SIGNAL_DEVICE_REGISTER], 0, device);
+	fu_plugin_emit_device_signal (self, SIGNAL_DEVICE_REGISTER, device);
 }
 
 /**
@@ -469,7 +837,7 @@ fu_plugin_device_remove (FuPlugin *self, FuDevice *device)
 	g_debug ("emit removed from %s: %s",
 		 fu_plugin_get_name (self),
 		 fu_device_get_id (device));
-	g_signal_emit (self, signals[SIGNAL_DEVICE_REMOVED], 0, device);
+	fu_plugin_emit_device_signal (self, SIGNAL_DEVICE_REMOVED, device);
 }
 
 /**
@@ -484,8 +852,12 @@ fu_plugin_device_remove (FuPlugin *self, FuDevice *device)
 void
 fu_plugin_request_recoldplug (FuPlugin *self)
 {
+	FuPluginSignalHelper helper = {
+		.self		= self,
+		.signal_idx	= SIGNAL_RECOLDPLUG,
+	};
 	g_return_if_fail (FU_IS_PLUGIN (self));
-	g_signal_emit (self, signals[SIGNAL_RECOLDPLUG], 0);
+	fu_plugin_emit_signal (&helper);
 }
 
 /**
@@ -544,9 +916,14 @@ fu_plugin_get_hwids (FuPlugin *self)
 gboolean
 fu_plugin_check_supported (FuPlugin *self, const gchar *guid)
 {
-	gboolean retval = FALSE;
-	g_signal_emit (self, signals[SIGNAL_CHECK_SUPPORTED], 0, guid, &retval);
-	return retval;
+	FuPluginSignalHelper helper = {
+		.self		= self,
+		.signal_idx	= SIGNAL_CHECK_SUPPORTED,
+		.guid		= guid,
+		.retval		= FALSE,
+	};
+	fu_plugin_emit_signal (&helper);
+	return helper.retval;
 }
 
 /**
@@ -633,9 +1010,54 @@ void
 fu_plugin_set_quirks (FuPlugin *self, FuQuirks *quirks)
 {
 	FuPluginPrivate *priv = GET_PRIVATE (self);
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (priv->quirk_group_keys_mutex);
+	g_return_if_fail (locker != NULL);
 	g_set_object (&priv->quirks, quirks);
+	g_hash_table_remove_all (priv->quirk_group_keys);
+}
+
+void
+fu_plugin_set_profile (FuPlugin *self, FuProfile *profile)
+{
+	FuPluginPrivate *priv = GET_PRIVATE (self);
+	g_set_object (&priv->profile, profile);
 }
 
+/* records how long the vfunc took to run when the scope is cleared, which
+ * is when the runner returns */
+typedef struct {
+	FuPlugin		*plugin;	/* no ref */
+	const gchar		*vfunc;
+	gint64			 start;
+} FuPluginProfileScope;
+
+static void
+fu_plugin_profile_scope_start (FuPluginProfileScope *scope,
+			       FuPlugin *self,
+			       const gchar *vfunc)
+{
+	scope->plugin = self;
+	scope->vfunc = vfunc;
+	scope->start = g_get_monotonic_time ();
+}
+
+static void
+fu_plugin_profile_scope_clear (FuPluginProfileScope *scope)
+{
+	FuPluginPrivate *priv;
+	g_autofree gchar *id = NULL;
+
+	if (scope->plugin == NULL)
+		return;
+	priv = GET_PRIVATE (scope->plugin);
+	if (priv->profile == NULL)
+		return;
+	id = g_strdup_printf ("plugins/%s/%s", priv->name, scope->vfunc);
+	fu_profile_add (priv->profile, id, g_get_monotonic_time () - scope->start);
+}
+
+G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC(FuPluginProfileScope, fu_plugin_profile_scope_clear)
+
 /**
  * fu_plugin_get_quirks:
  * @self: A #FuPlugin
@@ -730,10 +1152,36 @@ const gchar *
 fu_plugin_lookup_quirk_by_id (FuPlugin *self, const gchar *group, const gchar *key)
 {
 	FuPluginPrivate *priv = GET_PRIVATE (self);
+	const gchar *group_key;
+	g_autofree gchar *group_key_new = NULL;
+
 	g_return_val_if_fail (FU_IS_PLUGIN (self), NULL);
+	g_return_val_if_fail (group != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	/* plugins look up the same few groups for each device, so remember
+	 * the group key rather than converting the group each time */
+	fu_mutex_read_lock (priv->quirk_group_keys_mutex);
+	group_key = g_hash_table_lookup (priv->quirk_group_keys, group);
+	if (group_key != NULL) {
+		const gchar *value = fu_quirks_lookup_by_key (priv->quirks, group_key, key);
+		fu_mutex_read_unlock (priv->quirk_group_keys_mutex);
+		return value;
+	}
+	fu_mutex_read_unlock (priv->quirk_group_keys_mutex);
 
-	/* exact ID */
-	return fu_quirks_lookup_by_id (priv->quirks, group, key);
+	/* not yet seen */
+	if (priv->quirks == NULL)
+		return NULL;
+	group_key_new = fu_quirks_get_group_key (priv->quirks, group);
+	fu_mutex_write_lock (priv->quirk_group_keys_mutex);
+	if (g_hash_table_size (priv->quirk_group_keys) >= FU_PLUGIN_QUIRK_GROUP_KEYS_MAX)
+		g_hash_table_remove_all (priv->quirk_group_keys);
+	g_hash_table_insert (priv->quirk_group_keys,
+			     g_strdup (group),
+			     g_strdup (group_key_new));
+	fu_mutex_write_unlock (priv->quirk_group_keys_mutex);
+	return fu_quirks_lookup_by_key (priv->quirks, group_key_new, key);
 }
 
 /**
@@ -785,6 +1233,11 @@ fu_plugin_set_smbios (FuPlugin *self, FuSmbios *smbios)
 void
 fu_plugin_set_coldplug_delay (FuPlugin *self, guint duration)
 {
+	FuPluginSignalHelper helper = {
+		.self		= self,
+		.signal_idx	= SIGNAL_SET_COLDPLUG_DELAY,
+	};
+
 	g_return_if_fail (FU_IS_PLUGIN (self));
 	g_return_if_fail (duration > 0);
 
@@ -797,7 +1250,8 @@ fu_plugin_set_coldplug_delay (FuPlugin *self, guint duration)
 	}
 
 	/* emit */
-	g_signal_emit (self, signals[SIGNAL_SET_COLDPLUG_DELAY], 0, duration);
+	helper.duration = duration;
+	fu_plugin_emit_signal (&helper);
 }
 
 gboolean
@@ -806,6 +1260,7 @@ fu_plugin_runner_startup (FuPlugin *self, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginStartupFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -820,6 +1275,7 @@ fu_plugin_runner_startup (FuPlugin *self, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing startup() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "startup");
 	if (!func (self, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for startup()",
@@ -888,6 +1344,7 @@ fu_plugin_runner_device_generic (FuPlugin *self, FuDevice *device,
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginDeviceFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -902,6 +1359,7 @@ fu_plugin_runner_device_generic (FuPlugin *self, FuDevice *device,
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing %s() on %s", symbol_name + 10, priv->name);
+	fu_plugin_profile_scope_start (&scope, self, symbol_name + 10);
 	if (!func (self, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for %s()",
@@ -927,6 +1385,7 @@ fu_plugin_runner_flagged_device_generic (FuPlugin *self, FwupdInstallFlags flags
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginFlaggedDeviceFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -941,6 +1400,7 @@ fu_plugin_runner_flagged_device_generic (FuPlugin *self, FwupdInstallFlags flags
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing %s() on %s", symbol_name + 10, priv->name);
+	fu_plugin_profile_scope_start (&scope, self, symbol_name + 10);
 	if (!func (self, flags, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for %s()",
@@ -966,6 +1426,7 @@ fu_plugin_runner_device_array_generic (FuPlugin *self, GPtrArray *devices,
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginDeviceArrayFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -980,6 +1441,7 @@ fu_plugin_runner_device_array_generic (FuPlugin *self, GPtrArray *devices,
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing %s() on %s", symbol_name + 10, priv->name);
+	fu_plugin_profile_scope_start (&scope, self, symbol_name + 10);
 	if (!func (self, devices, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for %s()",
@@ -1003,6 +1465,7 @@ fu_plugin_runner_coldplug (FuPlugin *self, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginStartupFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1017,6 +1480,7 @@ fu_plugin_runner_coldplug (FuPlugin *self, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing coldplug() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "coldplug");
 	if (!func (self, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for coldplug()",
@@ -1039,6 +1503,7 @@ fu_plugin_runner_recoldplug (FuPlugin *self, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginStartupFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1053,6 +1518,7 @@ fu_plugin_runner_recoldplug (FuPlugin *self, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing recoldplug() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "recoldplug");
 	if (!func (self, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for recoldplug()",
@@ -1076,6 +1542,7 @@ fu_plugin_runner_coldplug_prepare (FuPlugin *self, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginStartupFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1090,6 +1557,7 @@ fu_plugin_runner_coldplug_prepare (FuPlugin *self, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing coldplug_prepare() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "coldplug_prepare");
 	if (!func (self, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for coldplug_prepare()",
@@ -1113,6 +1581,7 @@ fu_plugin_runner_coldplug_cleanup (FuPlugin *self, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginStartupFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1127,6 +1596,7 @@ fu_plugin_runner_coldplug_cleanup (FuPlugin *self, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing coldplug_cleanup() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "coldplug_cleanup");
 	if (!func (self, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for coldplug_cleanup()",
@@ -1227,6 +1697,7 @@ fu_plugin_runner_usb_device_added (FuPlugin *self, FuUsbDevice *device, GError *
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginUsbDeviceAddedFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1241,6 +1712,7 @@ fu_plugin_runner_usb_device_added (FuPlugin *self, FuUsbDevice *device, GError *
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing usb_device_added() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "usb_device_added");
 	if (!func (self, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for usb_device_added()",
@@ -1264,6 +1736,7 @@ fu_plugin_runner_udev_device_added (FuPlugin *self, FuUdevDevice *device, GError
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginUdevDeviceAddedFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1278,6 +1751,7 @@ fu_plugin_runner_udev_device_added (FuPlugin *self, FuUdevDevice *device, GError
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing udev_device_added() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "udev_device_added");
 	if (!func (self, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for udev_device_added()",
@@ -1311,6 +1785,7 @@ fu_plugin_runner_device_register (FuPlugin *self, FuDevice *device)
 {
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginDeviceRegisterFunc func = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1326,6 +1801,7 @@ fu_plugin_runner_device_register (FuPlugin *self, FuDevice *device)
 	g_module_symbol (priv->module, "fu_plugin_device_registered", (gpointer *) &func);
 	if (func != NULL) {
 		g_debug ("performing fu_plugin_device_registered() on %s", priv->name);
+		fu_plugin_profile_scope_start (&scope, self, "device_registered");
 		func (self, device);
 	}
 }
@@ -1404,6 +1880,7 @@ fu_plugin_runner_verify (FuPlugin *self,
 	FuPluginVerifyFunc func = NULL;
 	GPtrArray *checksums;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1424,6 +1901,7 @@ fu_plugin_runner_verify (FuPlugin *self,
 
 	/* run vfunc */
 	g_debug ("performing verify() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "verify");
 	if (!func (self, device, flags, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for verify()",
@@ -1482,6 +1960,7 @@ fu_plugin_runner_update (FuPlugin *self,
 	g_autoptr(FuHistory) history = NULL;
 	g_autoptr(FuDevice) device_pending = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled) {
@@ -1527,6 +2006,7 @@ fu_plugin_runner_update (FuPlugin *self,
 	/* online */
 	history = fu_history_new ();
 	device_pending = fu_history_get_device_by_id (history, fu_device_get_id (device), NULL);
+	fu_plugin_profile_scope_start (&scope, self, "update");
 	if (!update_func (self, device, blob_fw, flags, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for update()",
@@ -1587,6 +2067,7 @@ fu_plugin_runner_clear_results (FuPlugin *self, FuDevice *device, GError **error
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginDeviceFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1601,6 +2082,7 @@ fu_plugin_runner_clear_results (FuPlugin *self, FuDevice *device, GError **error
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing clear_result() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "clear_results");
 	if (!func (self, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for clear_result()",
@@ -1624,6 +2106,7 @@ fu_plugin_runner_get_results (FuPlugin *self, FuDevice *device, GError **error)
 	FuPluginPrivate *priv = GET_PRIVATE (self);
 	FuPluginDeviceFunc func = NULL;
 	g_autoptr(GError) error_local = NULL;
+	g_auto(FuPluginProfileScope) scope = { NULL };
 
 	/* not enabled */
 	if (!priv->enabled)
@@ -1638,6 +2121,7 @@ fu_plugin_runner_get_results (FuPlugin *self, FuDevice *device, GError **error)
 	if (func == NULL)
 		return TRUE;
 	g_debug ("performing get_results() on %s", priv->name);
+	fu_plugin_profile_scope_start (&scope, self, "get_results");
 	if (!func (self, device, &error_local)) {
 		if (error_local == NULL) {
 			g_critical ("unset error in plugin %s for get_results()",
@@ -1732,8 +2216,16 @@ void
 fu_plugin_add_rule (FuPlugin *self, FuPluginRule rule, const gchar *name)
 {
 	FuPluginPrivate *priv = fu_plugin_get_instance_private (self);
+	FuPluginSignalHelper helper = {
+		.self		= self,
+		.signal_idx	= SIGNAL_RULES_CHANGED,
+	};
+
+	/* the manifest may have already added the rule */
+	if (fu_plugin_has_rule (self, rule, name))
+		return;
 	g_ptr_array_add (priv->rules[rule], g_strdup (name));
-	g_signal_emit (self, signals[SIGNAL_RULES_CHANGED], 0);
+	fu_plugin_emit_signal (&helper);
 }
 
 /**
@@ -1934,9 +2426,14 @@ fu_plugin_init (FuPlugin *self)
 	priv->devices = g_hash_table_new_full (g_str_hash, g_str_equal,
 					       g_free, (GDestroyNotify) g_object_unref);
 	priv->devices_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "devices");
+	priv->quirk_group_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+	priv->quirk_group_keys_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "quirk_group_keys");
 	priv->report_metadata = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	for (guint i = 0; i < FU_PLUGIN_RULE_LAST; i++)
 		priv->rules[i] = g_ptr_array_new_with_free_func (g_free);
+	priv->manifest_guids = g_ptr_array_new_with_free_func (g_free);
+	priv->manifest_hwids = g_ptr_array_new_with_free_func (g_free);
+	priv->manifest_udev_subsystems = g_ptr_array_new_with_free_func (g_free);
 }
 
 static void
@@ -1957,13 +2454,20 @@ fu_plugin_finalize (GObject *object)
 
 	for (guint i = 0; i < FU_PLUGIN_RULE_LAST; i++)
 		g_ptr_array_unref (priv->rules[i]);
+	g_ptr_array_unref (priv->manifest_guids);
+	g_ptr_array_unref (priv->manifest_hwids);
+	g_ptr_array_unref (priv->manifest_udev_subsystems);
 
 	if (priv->usb_ctx != NULL)
 		g_object_unref (priv->usb_ctx);
+	if (priv->main_ctx != NULL)
+		g_main_context_unref (priv->main_ctx);
 	if (priv->hwids != NULL)
 		g_object_unref (priv->hwids);
 	if (priv->quirks != NULL)
 		g_object_unref (priv->quirks);
+	if (priv->profile != NULL)
+		g_object_unref (priv->profile);
 	if (priv->udev_subsystems != NULL)
 		g_ptr_array_unref (priv->udev_subsystems);
 	if (priv->smbios != NULL)
@@ -1975,6 +2479,8 @@ fu_plugin_finalize (GObject *object)
 	g_hash_table_unref (priv->devices);
 	g_hash_table_unref (priv->report_metadata);
 	g_object_unref (priv->devices_mutex);
+	g_hash_table_unref (priv->quirk_group_keys);
+	g_object_unref (priv->quirk_group_keys_mutex);
 	g_free (priv->name);
 	g_free (priv->data);
 	/* Must happen as the last step to avoid prematurely
@@ -71,6 +71,7 @@ typedef enum {
  * @FU_PLUGIN_RULE_BETTER_THAN:		Is better than another plugin
  * @FU_PLUGIN_RULE_INHIBITS_IDLE:	The plugin inhibits the idle shutdown
  * @FU_PLUGIN_RULE_SUPPORTS_PROTOCOL:	The plugin supports a well known protocol
+ * @FU_PLUGIN_RULE_CONCURRENT_UPDATE:	The plugin can update more than one device at a time
  *
  * The rules used for ordering plugins.
  * Plugins are expected to add rules in fu_plugin_initialize().
@@ -83,6 +84,7 @@ typedef enum {
 	FU_PLUGIN_RULE_BETTER_THAN,
 	FU_PLUGIN_RULE_INHIBITS_IDLE,
 	FU_PLUGIN_RULE_SUPPORTS_PROTOCOL,
+	FU_PLUGIN_RULE_CONCURRENT_UPDATE,
 	/*< private >*/
 	FU_PLUGIN_RULE_LAST
 } FuPluginRule;
@@ -0,0 +1,309 @@
+/*
+ * Copyright (C) 2019 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#define G_LOG_DOMAIN				"FuProfile"
+
+#include "config.h"
+
+#include <glib-object.h>
+#include <json-glib/json-glib.h>
+#include <string.h>
+
+#include "fu-mutex.h"
+#include "fu-profile.h"
+
+/**
+ * SECTION:fu-profile
+ * @short_description: a record of where time is spent
+ *
+ * Each item is identified using a path such as `load/coldplug` or
+ * `plugins/dfu/coldplug`, and calling fu_profile_add() more than once with
+ * the same ID adds to the total duration. All durations are measured using
+ * the monotonic clock in microseconds.
+ *
+ * This object is thread safe, as plugins may be run from a thread pool.
+ */
+
+static void fu_profile_finalize	 (GObject *obj);
+
+struct _FuProfile
+{
+	GObject			 parent_instance;
+	GPtrArray		*items;		/* of FuProfileItem, in order added */
+	GHashTable		*hash;		/* of id:FuProfileItem */
+	FuMutex			*items_mutex;
+};
+
+typedef struct {
+	gchar			*id;
+	gint64			 duration;
+	guint			 count;
+} FuProfileItem;
+
+typedef struct {
+	gchar			*name;
+	FuProfileItem		*item;		/* no ref, or %NULL */
+} FuProfileNode;
+
+G_DEFINE_TYPE (FuProfile, fu_profile, G_TYPE_OBJECT)
+
+static void
+fu_profile_item_free (FuProfileItem *item)
+{
+	g_free (item->id);
+	g_free (item);
+}
+
+/**
+ * fu_profile_add:
+ * @self: A #FuProfile
+ * @id: An ID, e.g. `plugins/dfu/coldplug`
+ * @duration: duration in microseconds
+ *
+ * Adds a duration to the profile.
+ *
+ * Since: 1.2.5
+ **/
+void
+fu_profile_add (FuProfile *self, const gchar *id, gint64 duration)
+{
+	FuProfileItem *item;
+	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->items_mutex);
+
+	g_return_if_fail (FU_IS_PROFILE (self));
+	g_return_if_fail (id != NULL);
+	g_return_if_fail (locker != NULL);
+
+	item = g_hash_table_lookup (self->hash, id);
+	if (item == NULL) {
+		item = g_new0 (FuProfileItem, 1);
+		item->id = g_strdup (id);
+		g_ptr_array_add (self->items, item);
+		g_hash_table_insert (self->hash, item->id, item);
+	}
+	item->duration += duration;
+	item->count++;
+}
+
+/**
+ * fu_profile_get_duration:
+ * @self: A #FuProfile
+ * @id: An ID, e.g. `plugins/dfu/coldplug`
+ *
+ * Gets the total duration recorded for an ID.
+ *
+ * Returns: duration in microseconds, or 0 if not found
+ *
+ * Since: 1.2.5
+ **/
+gint64
+fu_profile_get_duration (FuProfile *self, const gchar *id)
+{
+	FuProfileItem *item;
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->items_mutex);
+	g_return_val_if_fail (FU_IS_PROFILE (self), 0);
+	g_return_val_if_fail (locker != NULL, 0);
+	item = g_hash_table_lookup (self->hash, id);
+	if (item == NULL)
+		return 0;
+	return item->duration;
+}
+
+/**
+ * fu_profile_get_count:
+ * @self: A #FuProfile
+ * @id: An ID, e.g. `plugins/dfu/coldplug`
+ *
+ * Gets the number of times a duration was added for an ID.
+ *
+ * Returns: integer, or 0 if not found
+ *
+ * Since: 1.2.5
+ **/
+guint
+fu_profile_get_count (FuProfile *self, const gchar *id)
+{
+	FuProfileItem *item;
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->items_mutex);
+	g_return_val_if_fail (FU_IS_PROFILE (self), 0);
+	g_return_val_if_fail (locker != NULL, 0);
+	item = g_hash_table_lookup (self->hash, id);
+	if (item == NULL)
+		return 0;
+	return item->count;
+}
+
+static gboolean
+fu_profile_node_free_cb (GNode *n, gpointer user_data)
+{
+	FuProfileNode *node = n->data;
+	if (node != NULL) {
+		g_free (node->name);
+		g_free (node);
+	}
+	return FALSE;
+}
+
+static GNode *
+fu_profile_node_ensure (GNode *parent, const gchar *name)
+{
+	FuProfileNode *node;
+	for (GNode *n = parent->children; n != NULL; n = n->next) {
+		node = n->data;
+		if (g_strcmp0 (node->name, name) == 0)
+			return n;
+	}
+	node = g_new0 (FuProfileNode, 1);
+	node->name = g_strdup (name);
+	return g_node_append_data (parent, node);
+}
+
+static gboolean
+fu_profile_node_to_string_cb (GNode *n, gpointer user_data)
+{
+	FuProfileNode *node = n->data;
+	GString *str = (GString *) user_data;
+
+	/* root */
+	if (node == NULL)
+		return FALSE;
+	for (guint i = 2; i < g_node_depth (n); i++)
+		g_string_append (str, "  ");
+	g_string_append (str, node->name);
+	if (node->item != NULL) {
+		g_string_append_printf (str, ": %.1fms",
+					(gdouble) node->item->duration / 1000.f);
+		if (node->item->count > 1)
+			g_string_append_printf (str, " (%u calls)", node->item->count);
+	}
+	g_string_append (str, "\n");
+	return FALSE;
+}
+
+/**
+ * fu_profile_to_string:
+ * @self: A #FuProfile
+ *
+ * Gets the profile as a tree suitable for showing to the user.
+ *
+ * Returns: a string
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+fu_profile_to_string (FuProfile *self)
+{
+	GString *str = g_string_new (NULL);
+	GNode *root = g_node_new (NULL);
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->items_mutex);
+
+	g_return_val_if_fail (FU_IS_PROFILE (self), NULL);
+	g_return_val_if_fail (locker != NULL, NULL);
+
+	/* build a tree from the IDs */
+	for (guint i = 0; i < self->items->len; i++) {
+		FuProfileItem *item = g_ptr_array_index (self->items, i);
+		GNode *n = root;
+		g_auto(GStrv) split = g_strsplit (item->id, "/", -1);
+		for (guint j = 0; split[j] != NULL; j++)
+			n = fu_profile_node_ensure (n, split[j]);
+		((FuProfileNode *) n->data)->item = item;
+	}
+	g_node_traverse (root, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+			 fu_profile_node_to_string_cb, str);
+	g_node_traverse (root, G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+			 fu_profile_node_free_cb, NULL);
+	g_node_destroy (root);
+	return g_string_free (str, FALSE);
+}
+
+/**
+ * fu_profile_to_json:
+ * @self: A #FuProfile
+ *
+ * Gets the profile as JSON, with each duration in microseconds.
+ *
+ * Returns: a string
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+fu_profile_to_json (FuProfile *self)
+{
+	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->items_mutex);
+	g_autoptr(JsonBuilder) builder = json_builder_new ();
+	g_autoptr(JsonGenerator) json_generator = NULL;
+	g_autoptr(JsonNode) json_root = NULL;
+
+	g_return_val_if_fail (FU_IS_PROFILE (self), NULL);
+	g_return_val_if_fail (locker != NULL, NULL);
+
+	json_builder_begin_object (builder);
+	json_builder_set_member_name (builder, "Profile");
+	json_builder_begin_array (builder);
+	for (guint i = 0; i < self->items->len; i++) {
+		FuProfileItem *item = g_ptr_array_index (self->items, i);
+		json_builder_begin_object (builder);
+		json_builder_set_member_name (builder, "Id");
+		json_builder_add_string_value (builder, item->id);
+		json_builder_set_member_name (builder, "Duration");
+		json_builder_add_int_value (builder, item->duration);
+		json_builder_set_member_name (builder, "Count");
+		json_builder_add_int_value (builder, item->count);
+		json_builder_end_object (builder);
+	}
+	json_builder_end_array (builder);
+	json_builder_end_object (builder);
+
+	/* export as a string */
+	json_root = json_builder_get_root (builder);
+	json_generator = json_generator_new ();
+	json_generator_set_pretty (json_generator, TRUE);
+	json_generator_set_root (json_generator, json_root);
+	return json_generator_to_data (json_generator, NULL);
+}
+
+static void
+fu_profile_class_init (FuProfileClass *klass)
+{
+	GObjectClass *object_class = G_OBJECT_CLASS (klass);
+	object_class->finalize = fu_profile_finalize;
+}
+
+static void
+fu_profile_init (FuProfile *self)
+{
+	self->items = g_ptr_array_new_with_free_func ((GDestroyNotify) fu_profile_item_free);
+	self->hash = g_hash_table_new (g_str_hash, g_str_equal);
+	self->items_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "items");
+}
+
+static void
+fu_profile_finalize (GObject *obj)
+{
+	FuProfile *self = FU_PROFILE (obj);
+	g_hash_table_unref (self->hash);
+	g_ptr_array_unref (self->items);
+	g_object_unref (self->items_mutex);
+	G_OBJECT_CLASS (fu_profile_parent_class)->finalize (obj);
+}
+
+/**
+ * fu_profile_new:
+ *
+ * Creates a new profile.
+ *
+ * Returns: (transfer full): a #FuProfile
+ *
+ * Since: 1.2.5
+ **/
+FuProfile *
+fu_profile_new (void)
+{
+	FuProfile *self;
+	self = g_object_new (FU_TYPE_PROFILE, NULL);
+	return FU_PROFILE (self);
+}
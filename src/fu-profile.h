@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2019 Richard Hughes <richard@hughsie.com>
+ *
+ * SPDX-License-Identifier: LGPL-2.1+
+ */
+
+#ifndef __FU_PROFILE_H
+#define __FU_PROFILE_H
+
+G_BEGIN_DECLS
+
+#include <glib-object.h>
+
+#define FU_TYPE_PROFILE (fu_profile_get_type ())
+G_DECLARE_FINAL_TYPE (FuProfile, fu_profile, FU, PROFILE, GObject)
+
+FuProfile	*fu_profile_new			(void);
+void		 fu_profile_add			(FuProfile	*self,
+						 const gchar	*id,
+						 gint64		 duration);
+gint64		 fu_profile_get_duration	(FuProfile	*self,
+						 const gchar	*id);
+guint		 fu_profile_get_count		(FuProfile	*self,
+						 const gchar	*id);
+gchar		*fu_profile_to_string		(FuProfile	*self);
+gchar		*fu_profile_to_json		(FuProfile	*self);
+
+G_END_DECLS
+
+#endif /* __FU_PROFILE_H */
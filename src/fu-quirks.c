@@ -9,8 +9,10 @@
 #include "config.h"
 
 #include <glib-object.h>
+#include <glib/gstdio.h>
 #include <gio/gio.h>
 #include <string.h>
+#include <xmlb.h>
 
 #include "fu-common.h"
 #include "fu-common-guid.h"
@@ -42,21 +44,60 @@
  * obviously need code changes, but allows us to get most existing devices working
  * in an easy way without the user compiling anything.
  *
+ * The quirk files are compiled into a binary silo in the cache directory which
+ * is then mapped read-only by each process using the quirks. The silo is only
+ * rebuilt when any of the quirk files have been added, removed or modified.
+ * The groups from each file are also stored separately so that only the files
+ * that have changed have to be parsed again, which roughly doubles the size of
+ * the silo compared to storing just the merged groups.
+ *
+ * Values added using fu_quirks_add_value() are kept when the silo is reloaded
+ * and are merged with the values from the silo when the group is looked up.
+ * Any strings returned from the lookup functions remain valid until the silo
+ * has been reloaded twice, which only happens when the quirk files change.
+ *
  * See also: #FuDevice, #FuPlugin
  */
 
 static void fu_quirks_finalize	 (GObject *obj);
 
+#define FU_QUIRKS_RELOAD_DELAY		500	/* ms */
+#define FU_QUIRKS_GROUP_KEYS_MAX	1024
+#define FU_QUIRKS_MISSING_MAX		1024
+
 struct _FuQuirks
 {
 	GObject			 parent_instance;
 	GPtrArray		*monitors;
-	GHashTable		*hash;	/* of group:{key:value} */
+	guint			 reload_id;
+	XbSilo			*silo;
+	XbSilo			*silo_old;	/* nullable */
+	GHashTable		*hash;	/* of group_key:{key:value} from the silo */
+	GHashTable		*hash_old;	/* nullable */
+	GPtrArray		*strings;	/* merged values in @hash */
+	GPtrArray		*strings_old;	/* nullable */
+	GHashTable		*hash_runtime;	/* of group_key:{key:value} */
+	GHashTable		*missing;	/* of group_key */
+	GHashTable		*group_keys;	/* of group:group_key */
 	FuMutex			*hash_mutex;
 };
 
 G_DEFINE_TYPE (FuQuirks, fu_quirks, G_TYPE_OBJECT)
 
+static gboolean	 fu_quirks_reload	(FuQuirks	*self,
+						 GError		**error);
+
+static gboolean
+fu_quirks_reload_cb (gpointer user_data)
+{
+	FuQuirks *self = FU_QUIRKS (user_data);
+	g_autoptr(GError) error = NULL;
+	self->reload_id = 0;
+	if (!fu_quirks_reload (self, &error))
+		g_warning ("failed to rescan quirks: %s", error->message);
+	return G_SOURCE_REMOVE;
+}
+
 static void
 fu_quirks_monitor_changed_cb (GFileMonitor *monitor,
 			      GFile *file,
@@ -65,21 +106,28 @@ fu_quirks_monitor_changed_cb (GFileMonitor *monitor,
 			      gpointer user_data)
 {
 	FuQuirks *self = FU_QUIRKS (user_data);
-	g_autoptr(GError) error = NULL;
 	g_autofree gchar *filename = g_file_get_path (file);
-	g_debug ("%s changed, reloading all configs", filename);
-	if (!fu_quirks_load (self, &error))
-		g_warning ("failed to rescan quirks: %s", error->message);
+
+	/* ignore editor backup files and the like */
+	if (!g_str_has_suffix (filename, ".quirk"))
+		return;
+
+	/* several files are often changed at the same time */
+	g_debug ("%s changed, scheduling reload", filename);
+	if (self->reload_id != 0)
+		g_source_remove (self->reload_id);
+	self->reload_id = g_timeout_add (FU_QUIRKS_RELOAD_DELAY,
+					 fu_quirks_reload_cb, self);
 }
 
 static gboolean
-fu_quirks_add_inotify (FuQuirks *self, const gchar *filename, GError **error)
+fu_quirks_add_inotify (FuQuirks *self, const gchar *path, GError **error)
 {
 	GFileMonitor *monitor;
-	g_autoptr(GFile) file = g_file_new_for_path (filename);
+	g_autoptr(GFile) file = g_file_new_for_path (path);
 
-	/* set up a notify watch */
-	monitor = g_file_monitor (file, G_FILE_MONITOR_NONE, NULL, error);
+	/* set up a notify watch on the directory */
+	monitor = g_file_monitor_directory (file, G_FILE_MONITOR_NONE, NULL, error);
 	if (monitor == NULL)
 		return FALSE;
 	g_signal_connect (monitor, "changed",
@@ -107,6 +155,223 @@ fu_quirks_build_group_key (const gchar *group)
 	return g_strdup (group);
 }
 
+/* groups are always stored in the silo using a GUID so that they can be
+ * safely used in an XPath predicate */
+static gchar *
+fu_quirks_build_silo_group_key (const gchar *group_key)
+{
+	g_autofree gchar *tmp = NULL;
+	if (fu_common_guid_is_valid (group_key))
+		return g_strdup (group_key);
+	tmp = g_strdup_printf ("FuQuirks:%s", group_key);
+	return fu_common_guid_from_string (tmp);
+}
+
+static GHashTable *
+fu_quirks_kvs_new (void)
+{
+	return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+/* must be called with the read or write lock held, and returns FALSE if the
+ * group has not yet been looked up in the silo */
+static gboolean
+fu_quirks_lookup_kvs_unlocked (FuQuirks *self, const gchar *group_key, GHashTable **kvs)
+{
+	*kvs = g_hash_table_lookup (self->hash, group_key);
+	if (*kvs != NULL)
+		return TRUE;
+	return g_hash_table_contains (self->missing, group_key);
+}
+
+static gchar *
+fu_quirks_merge_values (const gchar *old, const gchar *new)
+{
+	guint cnt = 0;
+	g_autofree gchar **resv = NULL;
+	g_auto(GStrv) newv = g_strsplit (new, ",", -1);
+	g_auto(GStrv) oldv = g_strsplit (old, ",", -1);
+
+	/* segment flags, and append if they do not already exists */
+	resv = g_new0 (gchar *, g_strv_length (oldv) + g_strv_length (newv) + 1);
+	for (guint i = 0; oldv[i] != NULL; i++) {
+		if (!g_strv_contains ((const gchar * const *) resv, oldv[i]))
+			resv[cnt++] = oldv[i];
+	}
+	for (guint i = 0; newv[i] != NULL; i++) {
+		if (!g_strv_contains ((const gchar * const *) resv, newv[i]))
+			resv[cnt++] = newv[i];
+	}
+	return g_strjoinv (",", resv);
+}
+
+/* merges a runtime value over the indexed group; the merged string is kept
+ * with the index as callers may still be using the previous value, and @key
+ * has to be owned by the runtime hash */
+static void
+fu_quirks_kvs_add_runtime_unlocked (FuQuirks *self,
+				    GHashTable *kvs,
+				    const gchar *key,
+				    const gchar *value)
+{
+	const gchar *value_old = g_hash_table_lookup (kvs, key);
+	gchar *value_new;
+
+	if (value_old != NULL)
+		value_new = fu_quirks_merge_values (value_old, value);
+	else
+		value_new = g_strdup (value);
+	g_ptr_array_add (self->strings, value_new);
+	g_hash_table_insert (kvs, (gpointer) key, value_new);
+}
+
+/* index the group from the silo so it can be iterated, merging any values
+ * added at runtime, which also remembers a limited number of groups that do
+ * not exist; the strings are owned by the silo and so this must be called
+ * with the write lock held */
+static GHashTable *
+fu_quirks_get_kvs_for_group_key (FuQuirks *self, const gchar *group_key)
+{
+	GHashTable *kvs;
+	GHashTable *kvs_runtime;
+	g_autoptr(GPtrArray) values = NULL;
+
+	/* already indexed */
+	if (fu_quirks_lookup_kvs_unlocked (self, group_key, &kvs))
+		return kvs;
+
+	/* query the mapped silo, where the key is used in the XPath predicate
+	 * and so it has to be a GUID */
+	if (self->silo != NULL && fu_common_guid_is_valid (group_key)) {
+		g_autofree gchar *xpath = NULL;
+		xpath = g_strdup_printf ("quirks/group[@id='%s']/value", group_key);
+		values = xb_silo_query (self->silo, xpath, 0, NULL);
+	}
+	kvs_runtime = g_hash_table_lookup (self->hash_runtime, group_key);
+	if (values == NULL && kvs_runtime == NULL) {
+		if (g_hash_table_size (self->missing) >= FU_QUIRKS_MISSING_MAX)
+			g_hash_table_remove_all (self->missing);
+		g_hash_table_add (self->missing, g_strdup (group_key));
+		return NULL;
+	}
+	kvs = g_hash_table_new (g_str_hash, g_str_equal);
+	for (guint i = 0; values != NULL && i < values->len; i++) {
+		XbNode *n = g_ptr_array_index (values, i);
+		g_hash_table_insert (kvs,
+				     (gpointer) xb_node_get_attr (n, "key"),
+				     (gpointer) xb_node_get_text (n));
+	}
+	if (kvs_runtime != NULL) {
+		GHashTableIter iter;
+		gpointer k, v;
+		g_hash_table_iter_init (&iter, kvs_runtime);
+		while (g_hash_table_iter_next (&iter, &k, &v))
+			fu_quirks_kvs_add_runtime_unlocked (self, kvs, k, v);
+	}
+	g_hash_table_insert (self->hash, g_strdup (group_key), kvs);
+	return kvs;
+}
+
+/* must be called with the write lock held, and the returned key is only valid
+ * until the lock is released */
+static const gchar *
+fu_quirks_get_group_key_unlocked (FuQuirks *self, const gchar *group)
+{
+	gchar *group_key;
+	g_autofree gchar *tmp = NULL;
+
+	/* the same instance IDs are looked up many times */
+	group_key = g_hash_table_lookup (self->group_keys, group);
+	if (group_key != NULL)
+		return group_key;
+	if (g_hash_table_size (self->group_keys) >= FU_QUIRKS_GROUP_KEYS_MAX)
+		g_hash_table_remove_all (self->group_keys);
+	tmp = fu_quirks_build_group_key (group);
+	group_key = fu_quirks_build_silo_group_key (tmp);
+	g_hash_table_insert (self->group_keys, g_strdup (group), group_key);
+	return group_key;
+}
+
+/* only takes the write lock if the group has to be looked up in the silo */
+static const gchar *
+fu_quirks_lookup_value (FuQuirks *self, const gchar *group, const gchar *group_key, const gchar *key)
+{
+	GHashTable *kvs;
+	const gchar *value = NULL;
+
+	fu_mutex_read_lock (self->hash_mutex);
+	if (group_key == NULL)
+		group_key = g_hash_table_lookup (self->group_keys, group);
+	if (group_key != NULL && fu_quirks_lookup_kvs_unlocked (self, group_key, &kvs)) {
+		if (kvs != NULL)
+			value = g_hash_table_lookup (kvs, key);
+		fu_mutex_read_unlock (self->hash_mutex);
+		return value;
+	}
+	fu_mutex_read_unlock (self->hash_mutex);
+
+	/* another thread may have done this before we got the lock */
+	fu_mutex_write_lock (self->hash_mutex);
+	if (group_key == NULL)
+		group_key = fu_quirks_get_group_key_unlocked (self, group);
+	kvs = fu_quirks_get_kvs_for_group_key (self, group_key);
+	if (kvs != NULL)
+		value = g_hash_table_lookup (kvs, key);
+	fu_mutex_write_unlock (self->hash_mutex);
+	return value;
+}
+
+/**
+ * fu_quirks_get_group_key:
+ * @self: A #FuQuirks
+ * @group: A string group, e.g. "DeviceInstanceId=USB\VID_1235&PID_AB11"
+ *
+ * Gets the key used to store a group in the hardware database. The key can be
+ * saved by the caller and used with fu_quirks_lookup_by_key() so that the
+ * group string does not have to be converted for each lookup.
+ *
+ * Returns: (transfer full): a group key, which is always a GUID
+ *
+ * Since: 1.2.5
+ **/
+gchar *
+fu_quirks_get_group_key (FuQuirks *self, const gchar *group)
+{
+	g_autoptr(FuMutexLocker) locker = NULL;
+
+	g_return_val_if_fail (FU_IS_QUIRKS (self), NULL);
+	g_return_val_if_fail (group != NULL, NULL);
+
+	locker = fu_mutex_write_locker_new (self->hash_mutex);
+	g_return_val_if_fail (locker != NULL, NULL);
+	return g_strdup (fu_quirks_get_group_key_unlocked (self, group));
+}
+
+/**
+ * fu_quirks_lookup_by_key:
+ * @self: A #FuQuirks
+ * @group_key: A group key from fu_quirks_get_group_key(), or a GUID
+ * @key: An ID to match the entry, e.g. "Name"
+ *
+ * Looks up an entry in the hardware database using a precomputed group key.
+ *
+ * Returns: (transfer none): values from the database, or %NULL if not found
+ *
+ * Since: 1.2.5
+ **/
+const gchar *
+fu_quirks_lookup_by_key (FuQuirks *self, const gchar *group_key, const gchar *key)
+{
+	g_return_val_if_fail (FU_IS_QUIRKS (self), NULL);
+	g_return_val_if_fail (group_key != NULL, NULL);
+	g_return_val_if_fail (key != NULL, NULL);
+
+	/* the key is used in the XPath predicate */
+	if (!fu_common_guid_is_valid (group_key))
+		return NULL;
+	return fu_quirks_lookup_value (self, NULL, group_key, key);
+}
+
 /**
  * fu_quirks_lookup_by_id:
  * @self: A #FuPlugin
@@ -122,20 +387,10 @@ fu_quirks_build_group_key (const gchar *group)
 const gchar *
 fu_quirks_lookup_by_id (FuQuirks *self, const gchar *group, const gchar *key)
 {
-	GHashTable *kvs;
-	g_autofree gchar *group_key = NULL;
-	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->hash_mutex);
-
 	g_return_val_if_fail (FU_IS_QUIRKS (self), NULL);
 	g_return_val_if_fail (group != NULL, NULL);
 	g_return_val_if_fail (key != NULL, NULL);
-	g_return_val_if_fail (locker != NULL, NULL);
-
-	group_key = fu_quirks_build_group_key (group);
-	kvs = g_hash_table_lookup (self->hash, group_key);
-	if (kvs == NULL)
-		return NULL;
-	return g_hash_table_lookup (kvs, key);
+	return fu_quirks_lookup_value (self, group, NULL, key);
 }
 
 /**
@@ -154,34 +409,57 @@ gboolean
 fu_quirks_get_kvs_for_guid (FuQuirks *self, const gchar *guid, GHashTableIter *iter)
 {
 	GHashTable *kvs;
-	g_autoptr(FuMutexLocker) locker = fu_mutex_read_locker_new (self->hash_mutex);
-	g_return_val_if_fail (locker != NULL, FALSE);
-	kvs = g_hash_table_lookup (self->hash, guid);
-	if (kvs == NULL)
+	gboolean found;
+
+	/* the GUID is used in the XPath predicate */
+	if (!fu_common_guid_is_valid (guid))
+		return FALSE;
+
+	/* only take the write lock if the group has to be copied */
+	fu_mutex_read_lock (self->hash_mutex);
+	found = fu_quirks_lookup_kvs_unlocked (self, guid, &kvs);
+	fu_mutex_read_unlock (self->hash_mutex);
+	if (!found) {
+		fu_mutex_write_lock (self->hash_mutex);
+		kvs = fu_quirks_get_kvs_for_group_key (self, guid);
+		fu_mutex_write_unlock (self->hash_mutex);
+	}
+	if (kvs == NULL || g_hash_table_size (kvs) == 0)
 		return FALSE;
 	g_hash_table_iter_init (iter, kvs);
 	return TRUE;
 }
 
-static gchar *
-fu_quirks_merge_values (const gchar *old, const gchar *new)
+static void
+fu_quirks_hash_add_value (GHashTable *hash,
+			  const gchar *group_key,
+			  const gchar *key,
+			  const gchar *value)
 {
-	guint cnt = 0;
-	g_autofree gchar **resv = NULL;
-	g_auto(GStrv) newv = g_strsplit (new, ",", -1);
-	g_auto(GStrv) oldv = g_strsplit (old, ",", -1);
+	GHashTable *kvs;
+	const gchar *value_old;
+	g_autofree gchar *value_new = NULL;
 
-	/* segment flags, and append if they do not already exists */
-	resv = g_new0 (gchar *, g_strv_length (oldv) + g_strv_length (newv) + 1);
-	for (guint i = 0; oldv[i] != NULL; i++) {
-		if (!g_strv_contains ((const gchar * const *) resv, oldv[i]))
-			resv[cnt++] = oldv[i];
-	}
-	for (guint i = 0; newv[i] != NULL; i++) {
-		if (!g_strv_contains ((const gchar * const *) resv, newv[i]))
-			resv[cnt++] = newv[i];
+	/* does the key already exists in our hash */
+	kvs = g_hash_table_lookup (hash, group_key);
+	if (kvs == NULL) {
+		kvs = fu_quirks_kvs_new ();
+		g_hash_table_insert (hash, g_strdup (group_key), kvs);
+		value_new = g_strdup (value);
+	} else {
+		/* look up in the 2nd level hash */
+		value_old = g_hash_table_lookup (kvs, key);
+		if (value_old != NULL) {
+			g_debug ("already found %s=%s, merging with %s",
+				 group_key, value_old, value);
+			value_new = fu_quirks_merge_values (value_old, value);
+		} else {
+			value_new = g_strdup (value);
+		}
 	}
-	return g_strjoinv (",", resv);
+
+	/* insert the new value */
+	g_hash_table_insert (kvs, g_strdup (key), g_steal_pointer (&value_new));
 }
 
 /**
@@ -200,40 +478,32 @@ void
 fu_quirks_add_value (FuQuirks *self, const gchar *group, const gchar *key, const gchar *value)
 {
 	GHashTable *kvs;
-	const gchar *value_old;
-	g_autofree gchar *group_key = NULL;
-	g_autofree gchar *value_new = NULL;
+	GHashTable *kvs_runtime;
+	const gchar *group_key;
+	gpointer key_runtime = NULL;
 	g_autoptr(FuMutexLocker) locker = fu_mutex_write_locker_new (self->hash_mutex);
 
 	g_return_if_fail (locker != NULL);
 
-	/* does the key already exists in our hash */
-	group_key = fu_quirks_build_group_key (group);
-	kvs = g_hash_table_lookup (self->hash, group_key);
-	if (kvs == NULL) {
-		kvs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
-		g_hash_table_insert (self->hash,
-				     g_steal_pointer (&group_key),
-				     kvs);
-		value_new = g_strdup (value);
-	} else {
-		/* look up in the 2nd level hash */
-		value_old = g_hash_table_lookup (kvs, key);
-		if (value_old != NULL) {
-			g_debug ("already found %s=%s, merging with %s",
-				 group_key, value_old, value);
-			value_new = fu_quirks_merge_values (value_old, value);
-		} else {
-			value_new = g_strdup (value);
-		}
-	}
+	/* only the runtime values are stored so that they are merged over the
+	 * current silo values, even after the silo is reloaded */
+	group_key = fu_quirks_get_group_key_unlocked (self, group);
+	fu_quirks_hash_add_value (self->hash_runtime, group_key, key, value);
+	g_hash_table_remove (self->missing, group_key);
 
-	/* insert the new value */
-	g_hash_table_insert (kvs, g_strdup (key), g_steal_pointer (&value_new));
+	/* update the group if it has already been indexed */
+	kvs = g_hash_table_lookup (self->hash, group_key);
+	if (kvs == NULL)
+		return;
+	kvs_runtime = g_hash_table_lookup (self->hash_runtime, group_key);
+	if (!g_hash_table_lookup_extended (kvs_runtime, key, &key_runtime, NULL))
+		return;
+	fu_quirks_kvs_add_runtime_unlocked (self, kvs, key_runtime, value);
 }
 
+/* the hash is keyed by the silo group key */
 static gboolean
-fu_quirks_add_quirks_from_filename (FuQuirks *self, const gchar *filename, GError **error)
+fu_quirks_add_quirks_from_filename (GHashTable *hash, const gchar *filename, GError **error)
 {
 	g_autoptr(GKeyFile) kf = g_key_file_new ();
 	g_auto(GStrv) groups = NULL;
@@ -245,7 +515,11 @@ fu_quirks_add_quirks_from_filename (FuQuirks *self, const gchar *filename, GErro
 	/* add each set of groups and keys */
 	groups = g_key_file_get_groups (kf, NULL);
 	for (guint i = 0; groups[i] != NULL; i++) {
+		g_autofree gchar *group_key = NULL;
+		g_autofree gchar *silo_key = NULL;
 		g_auto(GStrv) keys = NULL;
+		group_key = fu_quirks_build_group_key (groups[i]);
+		silo_key = fu_quirks_build_silo_group_key (group_key);
 		keys = g_key_file_get_keys (kf, groups[i], NULL, error);
 		if (keys == NULL)
 			return FALSE;
@@ -255,7 +529,41 @@ fu_quirks_add_quirks_from_filename (FuQuirks *self, const gchar *filename, GErro
 			value = g_key_file_get_value (kf, groups[i], keys[j], error);
 			if (value == NULL)
 				return FALSE;
-			fu_quirks_add_value (self, groups[i], keys[j], value);
+			fu_quirks_hash_add_value (hash, silo_key, keys[j], value);
+		}
+	}
+	return TRUE;
+}
+
+/* reuse the groups from a previous silo if the file has not changed */
+static gboolean
+fu_quirks_add_quirks_from_silo (GHashTable *hash,
+				XbSilo *silo,
+				const gchar *file_id,
+				const gchar *file_key)
+{
+	g_autofree gchar *xpath = NULL;
+	g_autoptr(GPtrArray) groups = NULL;
+	g_autoptr(XbNode) n = NULL;
+
+	xpath = g_strdup_printf ("quirks/file[@id='%s']", file_id);
+	n = xb_silo_query_first (silo, xpath, NULL);
+	if (n == NULL)
+		return FALSE;
+	if (g_strcmp0 (xb_node_get_attr (n, "key"), file_key) != 0)
+		return FALSE;
+	groups = xb_node_query (n, "group", 0, NULL);
+	if (groups == NULL)
+		return TRUE;
+	for (guint i = 0; i < groups->len; i++) {
+		XbNode *group = g_ptr_array_index (groups, i);
+		g_autoptr(GPtrArray) values = xb_node_get_children (group);
+		for (guint j = 0; j < values->len; j++) {
+			XbNode *value = g_ptr_array_index (values, j);
+			fu_quirks_hash_add_value (hash,
+						  xb_node_get_attr (group, "id"),
+						  xb_node_get_attr (value, "key"),
+						  xb_node_get_text (value));
 		}
 	}
 	return TRUE;
@@ -270,15 +578,13 @@ fu_quirks_filename_sort_cb (gconstpointer a, gconstpointer b)
 }
 
 static gboolean
-fu_quirks_add_quirks_for_path (FuQuirks *self, const gchar *path, GError **error)
+fu_quirks_add_filenames_for_path (const gchar *path_hw, GPtrArray *filenames, GError **error)
 {
 	const gchar *tmp;
-	g_autofree gchar *path_hw = NULL;
 	g_autoptr(GDir) dir = NULL;
-	g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) filenames_tmp = g_ptr_array_new_with_free_func (g_free);
 
 	/* add valid files to the array */
-	path_hw = g_build_filename (path, "quirks.d", NULL);
 	if (!g_file_test (path_hw, G_FILE_TEST_EXISTS)) {
 		g_debug ("no %s, skipping", path_hw);
 		return TRUE;
@@ -291,30 +597,260 @@ fu_quirks_add_quirks_for_path (FuQuirks *self, const gchar *path, GError **error
 			g_debug ("skipping invalid file %s", tmp);
 			continue;
 		}
-		g_ptr_array_add (filenames, g_build_filename (path_hw, tmp, NULL));
+		g_ptr_array_add (filenames_tmp, g_build_filename (path_hw, tmp, NULL));
 	}
 
 	/* sort */
-	g_ptr_array_sort (filenames, fu_quirks_filename_sort_cb);
+	g_ptr_array_sort (filenames_tmp, fu_quirks_filename_sort_cb);
+	for (guint i = 0; i < filenames_tmp->len; i++) {
+		const gchar *filename = g_ptr_array_index (filenames_tmp, i);
+		g_ptr_array_add (filenames, g_strdup (filename));
+	}
+
+	/* success */
+	return TRUE;
+}
+
+/* returns a string that changes when the file is modified */
+static gchar *
+fu_quirks_build_file_key (const gchar *filename, GError **error)
+{
+	GStatBuf statbuf;
+	if (g_stat (filename, &statbuf) != 0) {
+		g_set_error (error,
+			     G_IO_ERROR,
+			     G_IO_ERROR_NOT_FOUND,
+			     "failed to stat %s", filename);
+		return NULL;
+	}
+	/* the nanoseconds catch a same-sized edit within the same second */
+	return g_strdup_printf ("%" G_GINT64_FORMAT ".%09ld:%" G_GINT64_FORMAT,
+				(gint64) statbuf.st_mtim.tv_sec,
+				(glong) statbuf.st_mtim.tv_nsec,
+				(gint64) statbuf.st_size);
+}
+
+/* any change in the files or the daemon version invalidates the silo */
+static gchar *
+fu_quirks_build_cache_key (GPtrArray *filenames, GError **error)
+{
+	g_autoptr(GString) str = g_string_new (VERSION);
+	for (guint i = 0; i < filenames->len; i++) {
+		const gchar *filename = g_ptr_array_index (filenames, i);
+		g_autofree gchar *file_key = fu_quirks_build_file_key (filename, error);
+		if (file_key == NULL)
+			return NULL;
+		g_string_append_printf (str, ";%s:%s", filename, file_key);
+	}
+	return g_string_free (g_steal_pointer (&str), FALSE);
+}
 
-	/* process files */
+static void
+fu_quirks_hash_to_nodes (GHashTable *hash, XbBuilderNode *parent)
+{
+	GHashTableIter iter;
+	const gchar *silo_key;
+	GHashTable *kvs;
+
+	g_hash_table_iter_init (&iter, hash);
+	while (g_hash_table_iter_next (&iter, (gpointer *) &silo_key, (gpointer *) &kvs)) {
+		GHashTableIter iter_kvs;
+		const gchar *key;
+		const gchar *value;
+		g_autoptr(XbBuilderNode) group = NULL;
+		group = xb_builder_node_insert (parent, "group", "id", silo_key, NULL);
+		g_hash_table_iter_init (&iter_kvs, kvs);
+		while (g_hash_table_iter_next (&iter_kvs, (gpointer *) &key, (gpointer *) &value))
+			xb_builder_node_insert_text (group, "value", value, "key", key, NULL);
+	}
+}
+
+static XbSilo *
+fu_quirks_build_silo (GPtrArray *filenames,
+		      const gchar *cache_key,
+		      XbSilo *silo_old,
+		      GError **error)
+{
+	GHashTableIter iter;
+	const gchar *silo_key;
+	GHashTable *kvs;
+	guint parsed = 0;
+	g_autoptr(GHashTable) hash = NULL;
+	g_autoptr(XbBuilder) builder = xb_builder_new ();
+	g_autoptr(XbBuilderNode) root = NULL;
+
+	/* merge all the files in order */
+	root = xb_builder_node_insert (NULL, "quirks", NULL);
+	xb_builder_node_insert_text (root, "cache", cache_key, NULL);
+	hash = g_hash_table_new_full (g_str_hash, g_str_equal,
+				      g_free, (GDestroyNotify) g_hash_table_unref);
 	for (guint i = 0; i < filenames->len; i++) {
 		const gchar *filename = g_ptr_array_index (filenames, i);
+		g_autofree gchar *file_id = fu_common_guid_from_string (filename);
+		g_autofree gchar *file_key = NULL;
+		g_autoptr(GHashTable) hash_file = NULL;
+		g_autoptr(XbBuilderNode) file = NULL;
+
+		file_key = fu_quirks_build_file_key (filename, error);
+		if (file_key == NULL)
+			return NULL;
+		hash_file = g_hash_table_new_full (g_str_hash, g_str_equal,
+						   g_free, (GDestroyNotify) g_hash_table_unref);
+		if (silo_old == NULL ||
+		    !fu_quirks_add_quirks_from_silo (hash_file, silo_old, file_id, file_key)) {
+			g_debug ("loading quirks from %s", filename);
+			if (!fu_quirks_add_quirks_from_filename (hash_file, filename, error)) {
+				g_prefix_error (error, "failed to load %s: ", filename);
+				return NULL;
+			}
+			parsed++;
+		}
 
-		/* load from keyfile */
-		g_debug ("loading quirks from %s", filename);
-		if (!fu_quirks_add_quirks_from_filename (self, filename, error)) {
-			g_prefix_error (error, "failed to load %s: ", filename);
-			return FALSE;
+		/* save where each group came from so that only the changed
+		 * files have to be parsed when the silo is next rebuilt */
+		file = xb_builder_node_insert (root, "file",
+					       "id", file_id,
+					       "key", file_key,
+					       NULL);
+		fu_quirks_hash_to_nodes (hash_file, file);
+
+		/* merge into the global set */
+		g_hash_table_iter_init (&iter, hash_file);
+		while (g_hash_table_iter_next (&iter, (gpointer *) &silo_key, (gpointer *) &kvs)) {
+			GHashTableIter iter_kvs;
+			const gchar *key;
+			const gchar *value;
+			g_hash_table_iter_init (&iter_kvs, kvs);
+			while (g_hash_table_iter_next (&iter_kvs, (gpointer *) &key, (gpointer *) &value))
+				fu_quirks_hash_add_value (hash, silo_key, key, value);
+		}
+	}
+	g_debug ("parsed %u of %u quirk files, now %u quirk entries",
+		 parsed, filenames->len, g_hash_table_size (hash));
+
+	/* convert to nodes */
+	fu_quirks_hash_to_nodes (hash, root);
+	xb_builder_import_node (builder, root);
+	return xb_builder_compile (builder, XB_BUILDER_COMPILE_FLAG_NONE, NULL, error);
+}
+
+static XbSilo *
+fu_quirks_load_silo (GPtrArray *filenames, XbSilo *silo_old, GError **error)
+{
+	g_autofree gchar *cachedirpkg = NULL;
+	g_autofree gchar *cache_key = NULL;
+	g_autofree gchar *xmlbfn = NULL;
+	g_autoptr(GError) error_local = NULL;
+	g_autoptr(GFile) xmlb = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+	g_autoptr(XbSilo) silo_mapped = xb_silo_new ();
+	g_autoptr(XbSilo) silo_stale = NULL;
+
+	cache_key = fu_quirks_build_cache_key (filenames, error);
+	if (cache_key == NULL)
+		return NULL;
+
+	/* use the existing silo if it is not stale */
+	cachedirpkg = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	xmlbfn = g_build_filename (cachedirpkg, "quirks.xmlb", NULL);
+	xmlb = g_file_new_for_path (xmlbfn);
+	if (xb_silo_load_from_file (silo_mapped, xmlb,
+				    XB_SILO_LOAD_FLAG_NONE,
+				    NULL, &error_local)) {
+		g_autoptr(XbNode) n = xb_silo_query_first (silo_mapped, "quirks/cache", NULL);
+		if (n != NULL && g_strcmp0 (xb_node_get_text (n), cache_key) == 0) {
+			g_debug ("using quirks from %s", xmlbfn);
+			return g_steal_pointer (&silo_mapped);
 		}
+		g_debug ("%s is stale, rebuilding", xmlbfn);
+		silo_stale = g_steal_pointer (&silo_mapped);
+	} else {
+		g_debug ("failed to load %s: %s", xmlbfn, error_local->message);
+		if (silo_old != NULL)
+			silo_stale = g_object_ref (silo_old);
+	}
+
+	/* parse the quirk files that have changed */
+	silo = fu_quirks_build_silo (filenames, cache_key, silo_stale, error);
+	if (silo == NULL)
+		return NULL;
 
-		/* watch the file for changes */
-		if (!fu_quirks_add_inotify (self, filename, error))
+	/* save it so all the other processes can map the same pages,
+	 * although the cache directory may not be writable */
+	g_clear_error (&error_local);
+	g_clear_object (&silo_mapped);
+	silo_mapped = xb_silo_new ();
+	if (!fu_common_mkdir_parent (xmlbfn, &error_local) ||
+	    !xb_silo_save_to_file (silo, xmlb, NULL, &error_local) ||
+	    !xb_silo_load_from_file (silo_mapped, xmlb,
+				     XB_SILO_LOAD_FLAG_NONE,
+				     NULL, &error_local)) {
+		g_debug ("failed to save %s: %s", xmlbfn, error_local->message);
+		return g_steal_pointer (&silo);
+	}
+	return g_steal_pointer (&silo_mapped);
+}
+
+static GPtrArray *
+fu_quirks_get_paths (void)
+{
+	GPtrArray *paths = g_ptr_array_new_with_free_func (g_free);
+	g_autofree gchar *datadir = NULL;
+	g_autofree gchar *localstatedir = NULL;
+
+	/* system datadir */
+	datadir = fu_common_get_path (FU_PATH_KIND_DATADIR_PKG);
+	g_ptr_array_add (paths, g_build_filename (datadir, "quirks.d", NULL));
+
+	/* something we can write when using Ostree */
+	localstatedir = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
+	g_ptr_array_add (paths, g_build_filename (localstatedir, "quirks.d", NULL));
+	return paths;
+}
+
+static gboolean
+fu_quirks_reload (FuQuirks *self, GError **error)
+{
+	g_autoptr(GPtrArray) filenames = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) paths = fu_quirks_get_paths ();
+	g_autoptr(XbSilo) silo = NULL;
+	g_autoptr(XbSilo) silo_old = NULL;
+
+	/* find all the files in order */
+	for (guint i = 0; i < paths->len; i++) {
+		const gchar *path = g_ptr_array_index (paths, i);
+		if (!fu_quirks_add_filenames_for_path (path, filenames, error))
 			return FALSE;
 	}
 
+	/* build the new silo without holding the lock */
+	fu_mutex_read_lock (self->hash_mutex);
+	if (self->silo != NULL)
+		silo_old = g_object_ref (self->silo);
+	fu_mutex_read_unlock (self->hash_mutex);
+	silo = fu_quirks_load_silo (filenames, silo_old, error);
+	if (silo == NULL)
+		return FALSE;
+	if (!xb_silo_query_build_index (silo, "quirks/group", "id", error))
+		return FALSE;
+
+	/* swap it in, keeping the previous silo and the groups indexed from it
+	 * as the strings returned to callers point into the mapped data */
+	fu_mutex_write_lock (self->hash_mutex);
+	g_clear_object (&self->silo_old);
+	g_clear_pointer (&self->hash_old, g_hash_table_unref);
+	g_clear_pointer (&self->strings_old, g_ptr_array_unref);
+	self->silo_old = g_steal_pointer (&self->silo);
+	self->hash_old = self->hash;
+	self->strings_old = self->strings;
+	self->hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					    (GDestroyNotify) g_hash_table_unref);
+	self->strings = g_ptr_array_new_with_free_func (g_free);
+	self->silo = g_object_ref (silo);
+	g_hash_table_remove_all (self->missing);
+	fu_mutex_write_unlock (self->hash_mutex);
+
 	/* success */
-	g_debug ("now %u quirk entries", g_hash_table_size (self->hash));
 	return TRUE;
 }
 
@@ -332,29 +868,26 @@ fu_quirks_add_quirks_for_path (FuQuirks *self, const gchar *path, GError **error
 gboolean
 fu_quirks_load (FuQuirks *self, GError **error)
 {
-	g_autofree gchar *datadir = NULL;
-	g_autofree gchar *localstatedir = NULL;
+	g_autoptr(GPtrArray) paths = fu_quirks_get_paths ();
 
 	g_return_val_if_fail (FU_IS_QUIRKS (self), FALSE);
 
-	/* ensure empty in case we're called from a monitor change */
+	/* watch the directories for changes */
 	g_ptr_array_set_size (self->monitors, 0);
-	fu_mutex_write_lock (self->hash_mutex);
-	g_hash_table_remove_all (self->hash);
-	fu_mutex_write_unlock (self->hash_mutex);
-
-	/* system datadir */
-	datadir = fu_common_get_path (FU_PATH_KIND_DATADIR_PKG);
-	if (!fu_quirks_add_quirks_for_path (self, datadir, error))
-		return FALSE;
-
-	/* something we can write when using Ostree */
-	localstatedir = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
-	if (!fu_quirks_add_quirks_for_path (self, localstatedir, error))
-		return FALSE;
+	if (self->reload_id != 0) {
+		g_source_remove (self->reload_id);
+		self->reload_id = 0;
+	}
+	for (guint i = 0; i < paths->len; i++) {
+		const gchar *path = g_ptr_array_index (paths, i);
+		if (!g_file_test (path, G_FILE_TEST_EXISTS))
+			continue;
+		if (!fu_quirks_add_inotify (self, path, error))
+			return FALSE;
+	}
 
-	/* success */
-	return TRUE;
+	/* load the compiled silo, rebuilding if required */
+	return fu_quirks_reload (self, error);
 }
 
 static void
@@ -369,6 +902,10 @@ fu_quirks_init (FuQuirks *self)
 {
 	self->monitors = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
 	self->hash = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_unref);
+	self->strings = g_ptr_array_new_with_free_func (g_free);
+	self->hash_runtime = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_hash_table_unref);
+	self->missing = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	self->group_keys = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 	self->hash_mutex = fu_mutex_new (G_OBJECT_TYPE_NAME(self), "hash");
 }
 
@@ -376,9 +913,23 @@ static void
 fu_quirks_finalize (GObject *obj)
 {
 	FuQuirks *self = FU_QUIRKS (obj);
+	if (self->reload_id != 0)
+		g_source_remove (self->reload_id);
 	g_ptr_array_unref (self->monitors);
+	if (self->silo != NULL)
+		g_object_unref (self->silo);
 	g_object_unref (self->hash_mutex);
 	g_hash_table_unref (self->hash);
+	g_ptr_array_unref (self->strings);
+	if (self->hash_old != NULL)
+		g_hash_table_unref (self->hash_old);
+	if (self->strings_old != NULL)
+		g_ptr_array_unref (self->strings_old);
+	if (self->silo_old != NULL)
+		g_object_unref (self->silo_old);
+	g_hash_table_unref (self->hash_runtime);
+	g_hash_table_unref (self->missing);
+	g_hash_table_unref (self->group_keys);
 	G_OBJECT_CLASS (fu_quirks_parent_class)->finalize (obj);
 }
 
@@ -21,6 +21,11 @@ gboolean	 fu_quirks_load				(FuQuirks	*self,
 const gchar	*fu_quirks_lookup_by_id			(FuQuirks	*self,
 							 const gchar	*group,
 							 const gchar	*key);
+gchar		*fu_quirks_get_group_key		(FuQuirks	*self,
+							 const gchar	*group);
+const gchar	*fu_quirks_lookup_by_key		(FuQuirks	*self,
+							 const gchar	*group_key,
+							 const gchar	*key);
 void		 fu_quirks_add_value			(FuQuirks	*self,
 							 const gchar	*group,
 							 const gchar	*key,
@@ -4,6 +4,9 @@
  * SPDX-License-Identifier: LGPL-2.1+
  */
 
+/* for memfd_create() and F_GET_SEALS */
+#define _GNU_SOURCE
+
 #include "config.h"
 
 #include <xmlb.h>
@@ -12,10 +15,17 @@
 #include <glib/gstdio.h>
 #include <gio/gfiledescriptorbased.h>
 #include <libgcab.h>
+#include <sqlite3.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef HAVE_MEMFD_SEALS
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 #include "fu-archive.h"
+#include "fu-cab-cache.h"
 #include "fu-common-cab.h"
 #include "fu-common-guid.h"
 #include "fu-common-version.h"
@@ -24,8 +34,10 @@
 #include "fu-device-list.h"
 #include "fu-device-private.h"
 #include "fu-engine.h"
+#include "fu-engine-silo.h"
 #include "fu-quirks.h"
 #include "fu-keyring.h"
+#include "fu-keyring-cache.h"
 #include "fu-history.h"
 #include "fu-install-task.h"
 #include "fu-plugin-private.h"
@@ -73,6 +85,155 @@ fu_archive_invalid_func (void)
 	g_assert_null (archive);
 }
 
+static void
+fu_cab_cache_func (void)
+{
+	g_autoptr(FuCabCache) cache = fu_cab_cache_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(XbSilo) silo1 = NULL;
+	g_autoptr(XbSilo) silo2 = NULL;
+	g_autoptr(XbSilo) silo3 = NULL;
+	g_autoptr(XbSilo) silo_tmp = NULL;
+
+	silo1 = xb_silo_new_from_xml ("<components><component/></components>", &error);
+	g_assert_no_error (error);
+	silo2 = xb_silo_new_from_xml ("<components><component/></components>", &error);
+	g_assert_no_error (error);
+	silo3 = xb_silo_new_from_xml ("<components><component/></components>", &error);
+	g_assert_no_error (error);
+
+	/* add two archives that fit */
+	fu_cab_cache_set_size_max (cache, 100);
+	fu_cab_cache_add (cache, "aaa", silo1, 40);
+	fu_cab_cache_add (cache, "bbb", silo2, 40);
+	g_assert_cmpint (fu_cab_cache_get_size (cache), ==, 80);
+	silo_tmp = fu_cab_cache_lookup (cache, "ccc");
+	g_assert_null (silo_tmp);
+
+	/* using the oldest makes the other one the least recently used */
+	silo_tmp = fu_cab_cache_lookup (cache, "aaa");
+	g_assert (silo_tmp == silo1);
+	g_clear_object (&silo_tmp);
+	fu_cab_cache_add (cache, "ccc", silo3, 40);
+	g_assert_cmpint (fu_cab_cache_get_size (cache), ==, 80);
+	silo_tmp = fu_cab_cache_lookup (cache, "bbb");
+	g_assert_null (silo_tmp);
+	silo_tmp = fu_cab_cache_lookup (cache, "ccc");
+	g_assert (silo_tmp == silo3);
+	g_clear_object (&silo_tmp);
+
+	/* too large to ever be cached */
+	fu_cab_cache_add (cache, "ddd", silo2, 101);
+	silo_tmp = fu_cab_cache_lookup (cache, "ddd");
+	g_assert_null (silo_tmp);
+	g_assert_cmpint (fu_cab_cache_get_size (cache), ==, 80);
+
+	/* keyrings changed */
+	fu_cab_cache_invalidate (cache);
+	g_assert_cmpint (fu_cab_cache_get_size (cache), ==, 0);
+	silo_tmp = fu_cab_cache_lookup (cache, "aaa");
+	g_assert_null (silo_tmp);
+}
+
+static void
+fu_keyring_cache_func (void)
+{
+	gboolean ret;
+	g_autofree gchar *fn = NULL;
+	g_autofree gchar *fn_key = NULL;
+	g_autofree gchar *key1 = NULL;
+	g_autofree gchar *key2 = NULL;
+	g_autofree gchar *key3 = NULL;
+	g_autofree gchar *pki_dir = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(FuKeyringCache) cache = fu_keyring_cache_new ();
+	g_autoptr(FuKeyringCache) cache2 = fu_keyring_cache_new ();
+	g_autoptr(FuKeyringCache) cache3 = fu_keyring_cache_new ();
+	g_autoptr(FuKeyringResult) result = NULL;
+	g_autoptr(FuKeyringResult) result_tmp = NULL;
+	g_autoptr(GBytes) blob = g_bytes_new_static ("hello", 5);
+	g_autoptr(GBytes) blob_sig = g_bytes_new_static ("signature", 9);
+	g_autoptr(GBytes) blob_sig2 = g_bytes_new_static ("forgery", 7);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GKeyFile) kf = g_key_file_new ();
+
+	tmpdir = g_dir_make_tmp ("fwupd-self-test-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (tmpdir);
+	fn = g_build_filename (tmpdir, "keyring-cache.conf", NULL);
+	pki_dir = g_build_filename (tmpdir, "pki", NULL);
+	fn_key = g_build_filename (pki_dir, "test.asc", NULL);
+	g_assert_cmpint (g_mkdir_with_parents (pki_dir, 0755), ==, 0);
+	ret = g_file_set_contents (fn_key, "key1", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	fu_keyring_cache_set_filename (cache, fn);
+	fu_keyring_cache_add_pki_dir (cache, pki_dir);
+
+	/* not yet verified */
+	key1 = fu_keyring_cache_build_key (cache, "gpg", blob, blob_sig);
+	result_tmp = fu_keyring_cache_lookup (cache, key1);
+	g_assert_null (result_tmp);
+
+	/* verified */
+	result = g_object_new (FU_TYPE_KEYRING_RESULT,
+			       "timestamp", (gint64) 1438072952,
+			       "authority", "3FC6B804410ED0840D8F2F9748A6D80E4538BAC2",
+			       NULL);
+	fu_keyring_cache_add (cache, key1, result);
+	result_tmp = fu_keyring_cache_lookup (cache, key1);
+	g_assert_nonnull (result_tmp);
+	g_assert_cmpint (fu_keyring_result_get_timestamp (result_tmp), ==, 1438072952);
+	g_assert_cmpstr (fu_keyring_result_get_authority (result_tmp), ==,
+			 "3FC6B804410ED0840D8F2F9748A6D80E4538BAC2");
+	g_clear_object (&result_tmp);
+
+	/* different signature */
+	key2 = fu_keyring_cache_build_key (cache, "gpg", blob, blob_sig2);
+	g_assert_cmpstr (key1, !=, key2);
+	result_tmp = fu_keyring_cache_lookup (cache, key2);
+	g_assert_null (result_tmp);
+
+	/* loaded from disk */
+	fu_keyring_cache_set_filename (cache2, fn);
+	fu_keyring_cache_add_pki_dir (cache2, pki_dir);
+	result_tmp = fu_keyring_cache_lookup (cache2, key1);
+	g_assert_nonnull (result_tmp);
+	g_assert_cmpint (fu_keyring_result_get_timestamp (result_tmp), ==, 1438072952);
+	g_clear_object (&result_tmp);
+
+	/* verified too long ago, or by a version that did not record when */
+	ret = g_key_file_load_from_file (kf, fn, G_KEY_FILE_NONE, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_key_file_set_int64 (kf, key1, "Verified", 1438072952);
+	g_key_file_set_int64 (kf, key2, "Timestamp", 1438072952);
+	ret = g_key_file_save_to_file (kf, fn, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	fu_keyring_cache_set_filename (cache3, fn);
+	fu_keyring_cache_add_pki_dir (cache3, pki_dir);
+	result_tmp = fu_keyring_cache_lookup (cache3, key1);
+	g_assert_null (result_tmp);
+	result_tmp = fu_keyring_cache_lookup (cache3, key2);
+	g_assert_null (result_tmp);
+
+	/* keys changed */
+	ret = g_file_set_contents (fn_key, "key2", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	fu_keyring_cache_invalidate (cache);
+	key3 = fu_keyring_cache_build_key (cache, "gpg", blob, blob_sig);
+	g_assert_cmpstr (key1, !=, key3);
+	result_tmp = fu_keyring_cache_lookup (cache, key1);
+	g_assert_null (result_tmp);
+
+	/* clean up */
+	ret = fu_common_rmtree (tmpdir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
 static void
 fu_archive_cab_func (void)
 {
@@ -438,6 +599,93 @@ fu_engine_device_parent_func (void)
 	g_assert_cmpint (fu_device_get_order (device3), ==, 0);
 }
 
+static void
+fu_profile_func (void)
+{
+	g_autofree gchar *json = NULL;
+	g_autofree gchar *str = NULL;
+	g_autoptr(FuProfile) profile = fu_profile_new ();
+
+	fu_profile_add (profile, "load/plugins", 2000);
+	fu_profile_add (profile, "plugins/test/coldplug", 1000);
+	fu_profile_add (profile, "plugins/test/coldplug", 500);
+	g_assert_cmpint (fu_profile_get_duration (profile, "plugins/test/coldplug"), ==, 1500);
+	g_assert_cmpint (fu_profile_get_count (profile, "plugins/test/coldplug"), ==, 2);
+	g_assert_cmpint (fu_profile_get_count (profile, "plugins/test/startup"), ==, 0);
+
+	/* tree */
+	str = fu_profile_to_string (profile);
+	g_print ("\n%s", str);
+	g_assert (g_strstr_len (str, -1, "load\n  plugins: 2.0ms\n") != NULL);
+	g_assert (g_strstr_len (str, -1, "    coldplug: 1.5ms (2 calls)\n") != NULL);
+
+	/* machine readable */
+	json = fu_profile_to_json (profile);
+	g_assert (g_strstr_len (json, -1, "\"plugins/test/coldplug\"") != NULL);
+}
+
+static void
+fu_engine_supported_performance_func (void)
+{
+	guint cnt = 0;
+	g_autoptr(FuEngine) engine = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	g_autoptr(GString) xml = g_string_new ("<components>");
+	g_autoptr(GTimer) timer = g_timer_new ();
+	g_autoptr(XbSilo) silo = NULL;
+
+	/* about the size of the LVFS catalog */
+	for (guint i = 0; i < 5000; i++) {
+		g_autofree gchar *guid1 = NULL;
+		g_autofree gchar *guid2 = NULL;
+		g_autofree gchar *str1 = g_strdup_printf ("component%u-a", i);
+		g_autofree gchar *str2 = g_strdup_printf ("component%u-b", i);
+		guid1 = fu_common_guid_from_string (str1);
+		guid2 = fu_common_guid_from_string (str2);
+		g_string_append_printf (xml,
+					"<component type=\"firmware\">"
+					"<id>com.hughski.Component%u.firmware</id>"
+					"<provides>"
+					"<firmware type=\"flashed\">%s</firmware>"
+					"<firmware type=\"flashed\">%s</firmware>"
+					"</provides>"
+					"<releases><release version=\"1.2.%u\"/></releases>"
+					"</component>",
+					i, guid1, guid2, i);
+	}
+	g_string_append (xml, "</components>");
+	silo = xb_silo_new_from_xml (xml->str, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+	g_timer_reset (timer);
+	fu_engine_set_silo (engine, silo);
+	g_print ("index=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* every other device matches the second GUID of a component */
+	for (guint i = 0; i < 500; i++) {
+		g_autofree gchar *id = g_strdup_printf ("device%u", i);
+		g_autofree gchar *str = g_strdup_printf ("component%u-b", i * 10);
+		FuDevice *device = fu_device_new ();
+		fu_device_set_id (device, id);
+		fu_device_set_version (device, "1.2.3");
+		fu_device_add_guid (device, id);
+		if (i % 2 == 0)
+			fu_device_add_guid (device, str);
+		g_ptr_array_add (devices, device);
+	}
+	g_timer_reset (timer);
+	for (guint i = 0; i < devices->len; i++)
+		fu_engine_add_device (engine, g_ptr_array_index (devices, i));
+	g_print ("add=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+	for (guint i = 0; i < devices->len; i++) {
+		FuDevice *device = g_ptr_array_index (devices, i);
+		if (fu_device_has_flag (device, FWUPD_DEVICE_FLAG_SUPPORTED))
+			cnt++;
+	}
+	g_assert_cmpint (cnt, ==, 250);
+}
+
 static void
 fu_engine_partial_hash_func (void)
 {
@@ -545,6 +793,141 @@ fu_engine_device_unlock_func (void)
 	g_assert_nonnull (fwupd_device_get_release_default (FWUPD_DEVICE (device)));
 }
 
+static const gchar *fu_engine_silo_xml =
+	"<components>"
+	"  <custom>"
+	"    <value key=\"fwupd::RemoteId\">stable</value>"
+	"  </custom>"
+	"  <component type=\"firmware\">"
+	"    <id>com.acme.test</id>"
+	"    <provides>"
+	"      <firmware type=\"flashed\">aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee</firmware>"
+	"    </provides>"
+	"    <releases>"
+	"      <release version=\"1.2.3\">"
+	"        <checksum target=\"container\" type=\"sha1\">7c211433f02071597741e6ff5a8ea34789abbf43</checksum>"
+	"        <checksum target=\"content\" type=\"sha1\">0123456789012345678901234567890123456789</checksum>"
+	"      </release>"
+	"    </releases>"
+	"  </component>"
+	"</components>";
+
+static void
+fu_engine_silo_lifetime_func (void)
+{
+	GPtrArray *components;
+	g_autoptr(FuEngineSilo) item = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GHashTable) remote_silos = NULL;
+	g_autoptr(GPtrArray) silos = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+
+	silo = xb_silo_new_from_xml (fu_engine_silo_xml, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+	item = fu_engine_silo_new (silo, "123:456");
+	g_clear_object (&silo);
+	g_assert_cmpstr (fu_engine_silo_get_key (item), ==, "123:456");
+	g_assert_cmpstr (fu_engine_silo_get_remote_id (item), ==, "stable");
+
+	/* shared between the priority list and the remote cache like the engine */
+	silos = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+	remote_silos = g_hash_table_new_full (g_str_hash, g_str_equal,
+					      g_free, (GDestroyNotify) g_object_unref);
+	g_ptr_array_add (silos, g_object_ref (item));
+	g_hash_table_insert (remote_silos, g_strdup ("stable"), g_object_ref (item));
+	g_object_add_weak_pointer (G_OBJECT (item), (gpointer *) &item);
+	g_object_unref (item);
+	g_assert_nonnull (item);
+
+	/* the priority list is rebuilt, but the cached copy keeps the nodes valid */
+	g_ptr_array_set_size (silos, 0);
+	g_assert_nonnull (item);
+	components = fu_engine_silo_get_components_by_guid (item, "aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee");
+	g_assert_nonnull (components);
+	g_assert_cmpint (components->len, ==, 1);
+	g_assert_cmpstr (xb_node_query_text (g_ptr_array_index (components, 0), "id", NULL),
+			 ==, "com.acme.test");
+
+	/* the remote was removed */
+	g_hash_table_remove (remote_silos, "stable");
+	g_assert_null (item);
+}
+
+static void
+fu_engine_silo_checksum_func (void)
+{
+	guint position = G_MAXUINT;
+	g_autoptr(FuEngineSilo) item = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+
+	silo = xb_silo_new_from_xml (fu_engine_silo_xml, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+	item = fu_engine_silo_new (silo, NULL);
+	g_assert_cmpint (fu_engine_silo_get_guid_count (item), ==, 1);
+	g_assert_true (fu_engine_silo_get_guid_position (item, "aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee", &position));
+	g_assert_cmpint (position, ==, 0);
+	g_assert_false (fu_engine_silo_get_guid_position (item, "ffffffff-ffff-ffff-ffff-ffffffffffff", NULL));
+
+	/* only the container checksum is indexed */
+	g_assert_true (fu_engine_silo_has_checksum (item, "7c211433f02071597741e6ff5a8ea34789abbf43"));
+	g_assert_false (fu_engine_silo_has_checksum (item, "0123456789012345678901234567890123456789"));
+	g_assert_false (fu_engine_silo_has_checksum (item, "deadbeef"));
+}
+
+static void
+fu_engine_device_unlock_order_func (void)
+{
+	gboolean ret;
+	FwupdRelease *rel;
+	const gchar *xml =
+		"<components>"
+		"  <component type=\"firmware\">"
+		"    <id>com.acme.first</id>"
+		"    <provides>"
+		"      <firmware type=\"flashed\">bbbbbbbb-bbbb-bbbb-bbbb-bbbbbbbbbbbb</firmware>"
+		"    </provides>"
+		"    <releases>"
+		"      <release version=\"1.0.0\"/>"
+		"    </releases>"
+		"  </component>"
+		"  <component type=\"firmware\">"
+		"    <id>com.acme.second</id>"
+		"    <provides>"
+		"      <firmware type=\"flashed\">aaaaaaaa-aaaa-aaaa-aaaa-aaaaaaaaaaaa</firmware>"
+		"    </provides>"
+		"    <releases>"
+		"      <release version=\"2.0.0\"/>"
+		"    </releases>"
+		"  </component>"
+		"</components>";
+	g_autoptr(FuDevice) device = fu_device_new ();
+	g_autoptr(FuEngine) engine = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(XbSilo) silo = NULL;
+
+	/* load engine to get FuConfig set up */
+	ret = fu_engine_load (engine, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	silo = xb_silo_new_from_xml (xml, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+	fu_engine_set_silo (engine, silo);
+
+	/* the component that appears first wins, not the first device GUID */
+	fu_device_set_id (device, "UEFI-dummy-dev0");
+	fu_device_add_guid (device, "aaaaaaaa-aaaa-aaaa-aaaa-aaaaaaaaaaaa");
+	fu_device_add_guid (device, "bbbbbbbb-bbbb-bbbb-bbbb-bbbbbbbbbbbb");
+	fu_device_add_flag (device, FWUPD_DEVICE_FLAG_LOCKED);
+	fu_engine_add_device (engine, device);
+	rel = fwupd_device_get_release_default (FWUPD_DEVICE (device));
+	g_assert_nonnull (rel);
+	g_assert_cmpstr (fwupd_release_get_version (rel), ==, "1.0.0");
+}
+
 static void
 fu_engine_require_hwid_func (void)
 {
@@ -826,6 +1209,142 @@ fu_engine_install_duration_func (void)
 	g_assert_cmpint (fwupd_release_get_install_duration (rel), ==, 120);
 }
 
+static void
+fu_engine_metadata_write (const gchar *filename, const gchar *version)
+{
+	gboolean ret;
+	g_autofree gchar *xml = NULL;
+	g_autoptr(GError) error = NULL;
+
+	xml = g_strdup_printf ("<components>"
+			       "  <component type=\"firmware\">"
+			       "    <id>test</id>"
+			       "    <provides>"
+			       "      <firmware type=\"flashed\">aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee</firmware>"
+			       "    </provides>"
+			       "    <releases>"
+			       "      <release version=\"%s\" date=\"2017-09-15\">"
+			       "        <location>https://test.org/foo.cab</location>"
+			       "        <checksum filename=\"foo.cab\" target=\"container\" type=\"md5\">deadbeefdeadbeefdeadbeefdeadbeef</checksum>"
+			       "      </release>"
+			       "    </releases>"
+			       "  </component>"
+			       "</components>", version);
+	ret = g_file_set_contents (filename, xml, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static guint64
+fu_engine_metadata_get_inode (const gchar *filename)
+{
+	g_autoptr(GFile) file = g_file_new_for_path (filename);
+	g_autoptr(GFileInfo) info = NULL;
+	g_autoptr(GError) error = NULL;
+
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_UNIX_INODE,
+				  G_FILE_QUERY_INFO_NONE, NULL, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (info);
+	return g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE);
+}
+
+static void
+fu_engine_metadata_set_mtime (const gchar *fn, guint64 mtime, guint32 mtime_usec)
+{
+	gboolean ret;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GFile) file = g_file_new_for_path (fn);
+	g_autoptr(GFileInfo) info = g_file_info_new ();
+
+	g_file_info_set_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED, mtime);
+	g_file_info_set_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC, mtime_usec);
+	ret = g_file_set_attributes_from_info (file, info, G_FILE_QUERY_INFO_NONE,
+					       NULL, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
+static void
+fu_engine_metadata_silo_func (void)
+{
+	gboolean ret;
+	guint64 inode_stable;
+	guint64 mtime = (guint64) (g_get_real_time () / G_USEC_PER_SEC);
+	guint64 inode_testing;
+	g_autofree gchar *cachedir = NULL;
+	g_autofree gchar *fn_removed = NULL;
+	g_autofree gchar *fn_stable = NULL;
+	g_autofree gchar *fn_testing = NULL;
+	g_autofree gchar *testdatadir = NULL;
+	g_autoptr(FuDevice) device = fu_device_new ();
+	g_autoptr(FuEngine) engine1 = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(FuEngine) engine2 = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(FuEngine) engine3 = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) releases = NULL;
+
+	/* ensure empty tree */
+	fu_self_test_mkroot ();
+	fu_engine_metadata_write ("/tmp/fwupd-self-test/stable.xml", "1.2.3");
+	fu_engine_metadata_write ("/tmp/fwupd-self-test/testing.xml", "1.2.4");
+	fu_engine_metadata_set_mtime ("/tmp/fwupd-self-test/testing.xml", mtime, 0);
+
+	/* a silo left behind by a remote that no longer exists */
+	cachedir = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	fn_removed = g_build_filename (cachedir, "metadata-removed.xmlb", NULL);
+	fn_stable = g_build_filename (cachedir, "metadata-stable.xmlb", NULL);
+	fn_testing = g_build_filename (cachedir, "metadata-testing.xmlb", NULL);
+	ret = fu_common_mkdir_parent (fn_removed, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = g_file_set_contents (fn_removed, "stale", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+
+	/* each remote gets its own silo, and the stale one is pruned */
+	testdatadir = fu_test_get_filename (TESTDATADIR, ".");
+	g_assert (testdatadir != NULL);
+	g_setenv ("FU_SELF_TEST_REMOTES_DIR", testdatadir, TRUE);
+	ret = fu_engine_load (engine1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_true (g_file_test (fn_stable, G_FILE_TEST_EXISTS));
+	g_assert_true (g_file_test (fn_testing, G_FILE_TEST_EXISTS));
+	g_assert_false (g_file_test (fn_removed, G_FILE_TEST_EXISTS));
+	inode_stable = fu_engine_metadata_get_inode (fn_stable);
+	inode_testing = fu_engine_metadata_get_inode (fn_testing);
+
+	/* nothing changed, so both silos are reused */
+	ret = fu_engine_load (engine2, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (fu_engine_metadata_get_inode (fn_stable), ==, inode_stable);
+	g_assert_cmpint (fu_engine_metadata_get_inode (fn_testing), ==, inode_testing);
+
+	/* only the remote that changed is rebuilt, even when the rewrite is
+	 * the same size and lands in the same second */
+	fu_engine_metadata_write ("/tmp/fwupd-self-test/testing.xml", "1.2.5");
+	fu_engine_metadata_set_mtime ("/tmp/fwupd-self-test/testing.xml", mtime, 1);
+	ret = fu_engine_load (engine3, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert_cmpint (fu_engine_metadata_get_inode (fn_stable), ==, inode_stable);
+	g_assert_cmpint (fu_engine_metadata_get_inode (fn_testing), !=, inode_testing);
+
+	/* and the new release is used */
+	fu_device_set_version (device, "1.2.3");
+	fu_device_set_id (device, "test_device");
+	fu_device_add_guid (device, "aaaaaaaa-bbbb-cccc-dddd-eeeeeeeeeeee");
+	fu_device_add_flag (device, FWUPD_DEVICE_FLAG_UPDATABLE);
+	fu_engine_add_device (engine3, device);
+	releases = fu_engine_get_upgrades (engine3, fu_device_get_id (device), &error);
+	g_assert_no_error (error);
+	g_assert (releases != NULL);
+	g_assert_cmpint (releases->len, ==, 1);
+	g_assert_cmpstr (fwupd_release_get_version (g_ptr_array_index (releases, 0)), ==, "1.2.5");
+}
+
 static void
 fu_engine_history_func (void)
 {
@@ -849,6 +1368,7 @@ fu_engine_history_func (void)
 	g_autoptr(XbNode) component = NULL;
 	g_autoptr(XbSilo) silo_empty = xb_silo_new ();
 	g_autoptr(XbSilo) silo = NULL;
+	g_autoptr(XbSilo) silo_cached = NULL;
 
 	/* ensure empty tree */
 	fu_self_test_mkroot ();
@@ -895,6 +1415,11 @@ fu_engine_history_func (void)
 	g_assert_no_error (error);
 	g_assert_nonnull (silo);
 
+	/* the same archive is only parsed once */
+	silo_cached = fu_engine_get_silo_from_blob (engine, blob_cab, &error);
+	g_assert_no_error (error);
+	g_assert (silo_cached == silo);
+
 	/* get component */
 	component = xb_silo_query_first (silo, "component/id[text()='com.hughski.test.firmware']/..", &error);
 	g_assert_no_error (error);
@@ -1461,6 +1986,116 @@ fu_device_list_func (void)
 			 "1a8d0d9a96ad3e67ba76cf3033623625dc6d6882");
 }
 
+static void
+fu_device_list_performance_func (void)
+{
+	g_autofree gchar *device_id = NULL;
+	g_autoptr(FuDeviceList) device_list = fu_device_list_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* add lots of unrelated devices */
+	for (guint i = 0; i < 10000; i++) {
+		g_autofree gchar *id = g_strdup_printf ("device%u", i);
+		g_autofree gchar *physical_id = g_strdup_printf ("usb:%02x:%02x", i / 256, i % 256);
+		g_autoptr(FuDevice) device = fu_device_new ();
+		fu_device_set_id (device, id);
+		fu_device_add_guid (device, id);
+		fu_device_set_physical_id (device, physical_id);
+		fu_device_list_add (device_list, device);
+	}
+	devices = fu_device_list_get_active (device_list);
+	g_assert_cmpint (devices->len, ==, 10000);
+	g_print ("add=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* find by GUID */
+	g_timer_reset (timer);
+	for (guint i = 0; i < 10000; i++) {
+		g_autofree gchar *id = g_strdup_printf ("device%u", i);
+		g_autoptr(FuDevice) device = NULL;
+		device = fu_device_list_get_by_guid (device_list, id, &error);
+		g_assert_no_error (error);
+		g_assert_true (device == g_ptr_array_index (devices, i));
+	}
+	g_print ("guid=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* find by full and abbreviated ID */
+	g_timer_reset (timer);
+	for (guint i = 0; i < 10000; i++) {
+		FuDevice *device_tmp = g_ptr_array_index (devices, i);
+		g_autofree gchar *device_id_short = NULL;
+		g_autoptr(FuDevice) device = NULL;
+		g_autoptr(FuDevice) device2 = NULL;
+		device = fu_device_list_get_by_id (device_list,
+						   fu_device_get_id (device_tmp),
+						   &error);
+		g_assert_no_error (error);
+		g_assert_true (device == device_tmp);
+		device_id_short = g_strndup (fu_device_get_id (device_tmp), 12);
+		device2 = fu_device_list_get_by_id (device_list, device_id_short, &error);
+		g_assert_no_error (error);
+		g_assert_true (device2 == device_tmp);
+	}
+	g_print ("id=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* a short prefix matches more than one device */
+	device_id = g_strndup (fu_device_get_id (g_ptr_array_index (devices, 0)), 1);
+	g_assert_null (fu_device_list_get_by_id (device_list, device_id, &error));
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_NOT_SUPPORTED);
+	g_clear_error (&error);
+
+	/* remove them all again */
+	g_timer_reset (timer);
+	for (guint i = 0; i < devices->len; i++)
+		fu_device_list_remove (device_list, g_ptr_array_index (devices, i));
+	g_print ("remove=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+	g_assert_null (fu_device_list_get_by_guid (device_list, "device0", &error));
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_NOT_FOUND);
+}
+
+static void
+fu_device_list_reindex_func (void)
+{
+	g_autofree gchar *device_id_old = NULL;
+	g_autoptr(FuDevice) device = fu_device_new ();
+	g_autoptr(FuDevice) device1 = NULL;
+	g_autoptr(FuDevice) device2 = NULL;
+	g_autoptr(FuDevice) device3 = NULL;
+	g_autoptr(FuDevice) device4 = NULL;
+	g_autoptr(FuDevice) donor = fu_device_new ();
+	g_autoptr(FuDeviceList) device_list = fu_device_list_new ();
+	g_autoptr(GError) error = NULL;
+
+	fu_device_set_id (device, "device");
+	fu_device_add_guid (device, "foobar");
+	fu_device_list_add (device_list, device);
+	device_id_old = g_strdup (fu_device_get_id (device));
+
+	/* change the device after it was added */
+	fu_device_set_id (device, "device-new");
+	fu_device_add_guid (device, "baz");
+	fu_device_set_physical_id (device, "usb:01:02");
+
+	device1 = fu_device_list_get_by_guid (device_list, "baz", &error);
+	g_assert_no_error (error);
+	g_assert_true (device1 == device);
+	device2 = fu_device_list_get_by_id (device_list, fu_device_get_id (device), &error);
+	g_assert_no_error (error);
+	g_assert_true (device2 == device);
+	device3 = fu_device_list_get_by_id (device_list, device_id_old, &error);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_NOT_FOUND);
+	g_assert_null (device3);
+	g_clear_error (&error);
+
+	/* GUIDs copied from another device */
+	fu_device_add_guid (donor, "donor");
+	fu_device_incorporate (device, donor);
+	device4 = fu_device_list_get_by_guid (device_list, "donor", &error);
+	g_assert_no_error (error);
+	g_assert_true (device4 == device);
+}
+
 static void
 fu_device_version_format_func (void)
 {
@@ -1709,6 +2344,73 @@ _plugin_device_register_cb (FuPlugin *plugin, FuDevice *device, gpointer user_da
 	fu_plugin_runner_device_register (plugin, device);
 }
 
+static void
+fu_plugin_manifest_func (void)
+{
+	gboolean ret;
+	const gchar *data =
+		"[fwupd Plugin]\n"
+		"UsbIds=273F:1004\n"
+		"UdevSubsystems=hidraw;usb\n"
+		"RequiresQuirk=Plugin\n"
+		"SupportsProtocol=com.acme.test\n";
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *tmpdir = NULL;
+	g_autoptr(FuDevice) device1 = fu_device_new ();
+	g_autoptr(FuDevice) device2 = fu_device_new ();
+	g_autoptr(FuPlugin) plugin = fu_plugin_new ();
+	g_autoptr(FuPlugin) plugin_invalid = fu_plugin_new ();
+	g_autoptr(GError) error = NULL;
+
+	/* no manifest */
+	g_assert (!fu_plugin_has_manifest (plugin));
+	g_assert (!fu_plugin_manifest_is_lazy (plugin));
+	g_assert (fu_plugin_manifest_check_hwids (plugin));
+
+	/* load */
+	tmpdir = g_dir_make_tmp ("fwupd-self-test-XXXXXX", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (tmpdir);
+	filename = g_build_filename (tmpdir, "libfu_plugin_test.manifest", NULL);
+	ret = g_file_set_contents (filename, data, -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = fu_plugin_load_manifest (plugin, filename, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	g_assert (fu_plugin_has_manifest (plugin));
+	g_assert (fu_plugin_manifest_is_lazy (plugin));
+	g_assert (fu_plugin_manifest_check_hwids (plugin));
+	g_assert_cmpint (fu_plugin_get_manifest_udev_subsystems (plugin)->len, ==, 2);
+
+	/* rules are known before the module is opened, and not duplicated */
+	g_assert (fu_plugin_has_rule (plugin, FU_PLUGIN_RULE_REQUIRES_QUIRK, "Plugin"));
+	g_assert (fu_plugin_has_rule (plugin, FU_PLUGIN_RULE_SUPPORTS_PROTOCOL, "com.acme.test"));
+	fu_plugin_add_rule (plugin, FU_PLUGIN_RULE_SUPPORTS_PROTOCOL, "com.acme.test");
+	g_assert_cmpint (fu_plugin_get_rules (plugin, FU_PLUGIN_RULE_SUPPORTS_PROTOCOL)->len, ==, 1);
+
+	/* matches the instance ID created by FuUsbDevice */
+	fu_device_add_guid (device1, "USB\\VID_273F&PID_1004");
+	g_assert (fu_plugin_manifest_check_device (plugin, device1));
+	fu_device_add_guid (device2, "USB\\VID_273F&PID_1005");
+	g_assert (!fu_plugin_manifest_check_device (plugin, device2));
+
+	/* invalid VID:PID */
+	ret = g_file_set_contents (filename, "[fwupd Plugin]\nUsbIds=273F\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+	ret = fu_plugin_load_manifest (plugin_invalid, filename, &error);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_INVALID_FILE);
+	g_assert (!ret);
+	g_assert (!fu_plugin_has_manifest (plugin_invalid));
+	g_clear_error (&error);
+
+	/* clean up */
+	ret = fu_common_rmtree (tmpdir, &error);
+	g_assert_no_error (error);
+	g_assert (ret);
+}
+
 static void
 fu_plugin_quirks_func (void)
 {
@@ -1740,18 +2442,127 @@ fu_plugin_quirks_func (void)
 	g_assert_cmpstr (tmp, ==, NULL);
 	tmp = fu_plugin_lookup_quirk_by_id (plugin, "bb9ec3e2-77b3-53bc-a1f1-b05916715627", "Flags");
 	g_assert_cmpstr (tmp, ==, "clever");
+
+	/* again, using the group keys remembered by the plugin */
+	tmp = fu_plugin_lookup_quirk_by_id (plugin, "USB\\VID_0A5C&PID_6412", "Flags");
+	g_assert_cmpstr (tmp, ==, "MERGE_ME,ignore-runtime");
+	tmp = fu_plugin_lookup_quirk_by_id (plugin, "CORP*", "Test");
+	g_assert_cmpstr (tmp, ==, "town");
+	tmp = fu_plugin_lookup_quirk_by_id (plugin, "unfound", "tests");
+	g_assert_cmpstr (tmp, ==, NULL);
 }
 
 static void
-fu_plugin_quirks_performance_func (void)
+fu_plugin_quirks_cache_func (void)
 {
-	g_autoptr(FuQuirks) quirks = fu_quirks_new ();
-	g_autoptr(GTimer) timer = g_timer_new ();
-	const gchar *keys[] = {
-		"Name", "Icon", "Children", "Plugin", "Flags",
-		"FirmwareSizeMin", "FirmwareSizeMax", NULL };
+	const gchar *tmp;
+	gboolean ret;
+	g_autofree gchar *cachedir = NULL;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(FuQuirks) quirks1 = fu_quirks_new ();
+	g_autoptr(FuQuirks) quirks2 = fu_quirks_new ();
+	g_autoptr(GError) error = NULL;
 
-	/* insert */
+	/* compile the silo */
+	cachedir = fu_common_get_path (FU_PATH_KIND_CACHEDIR_PKG);
+	fn = g_build_filename (cachedir, "quirks.xmlb", NULL);
+	g_unlink (fn);
+	ret = fu_quirks_load (quirks1, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_true (g_file_test (fn, G_FILE_TEST_EXISTS));
+
+	/* use the existing silo */
+	ret = fu_quirks_load (quirks2, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	tmp = fu_quirks_lookup_by_id (quirks2, "USB\\VID_0A5C&PID_6412", "Flags");
+	g_assert_cmpstr (tmp, ==, "MERGE_ME,ignore-runtime");
+	tmp = fu_quirks_lookup_by_id (quirks2, "CORP*", "Test");
+	g_assert_cmpstr (tmp, ==, "town");
+
+	/* values added at runtime are merged */
+	fu_quirks_add_value (quirks2, "USB\\VID_0A5C&PID_6412", "Flags", "runtime");
+	tmp = fu_quirks_lookup_by_id (quirks2, "USB\\VID_0A5C&PID_6412", "Flags");
+	g_assert_cmpstr (tmp, ==, "MERGE_ME,ignore-runtime,runtime");
+	tmp = fu_quirks_lookup_by_id (quirks1, "USB\\VID_0A5C&PID_6412", "Flags");
+	g_assert_cmpstr (tmp, ==, "MERGE_ME,ignore-runtime");
+}
+
+static void
+fu_plugin_quirks_reload_func (void)
+{
+	const gchar *tmp;
+	const gchar *tmp_old;
+	gboolean ret;
+	g_autofree gchar *localstatedir = NULL;
+	g_autofree gchar *fn = NULL;
+	g_autoptr(FuQuirks) quirks = fu_quirks_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* add a file that can be changed */
+	localstatedir = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
+	fn = g_build_filename (localstatedir, "quirks.d", "reload.quirk", NULL);
+	ret = fu_common_mkdir_parent (fn, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	ret = g_file_set_contents (fn, "[Test]\nReload=one\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	ret = fu_quirks_load (quirks, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	tmp_old = fu_quirks_lookup_by_id (quirks, "Test", "Reload");
+	g_assert_cmpstr (tmp_old, ==, "one");
+	fu_quirks_add_value (quirks, "Runtime", "Reload", "kept");
+	fu_quirks_add_value (quirks, "Test", "Extra", "runtime");
+
+	/* change the file and wait for the debounced reload */
+	ret = g_file_set_contents (fn, "[Test]\nReload=second\n", -1, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	while (g_timer_elapsed (timer, NULL) < 5.f) {
+		tmp = fu_quirks_lookup_by_id (quirks, "Test", "Reload");
+		if (g_strcmp0 (tmp, "second") == 0)
+			break;
+		g_main_context_iteration (NULL, FALSE);
+		g_usleep (10000);
+	}
+	g_assert_cmpstr (tmp, ==, "second");
+
+	/* strings from the old silo are still valid, and runtime values are kept */
+	g_assert_cmpstr (tmp_old, ==, "one");
+	tmp = fu_quirks_lookup_by_id (quirks, "Runtime", "Reload");
+	g_assert_cmpstr (tmp, ==, "kept");
+	tmp = fu_quirks_lookup_by_id (quirks, "Test", "Extra");
+	g_assert_cmpstr (tmp, ==, "runtime");
+
+	/* groups from the unchanged files are copied from the old silo */
+	tmp = fu_quirks_lookup_by_id (quirks, "USB\\VID_0A5C&PID_6412", "Flags");
+	g_assert_cmpstr (tmp, ==, "MERGE_ME,ignore-runtime");
+	tmp = fu_quirks_lookup_by_id (quirks, "CORP*", "Test");
+	g_assert_cmpstr (tmp, ==, "town");
+
+	/* remove the file again so other tests are not affected */
+	g_unlink (fn);
+	ret = fu_quirks_load (quirks, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	g_assert_null (fu_quirks_lookup_by_id (quirks, "Test", "Reload"));
+}
+
+static void
+fu_plugin_quirks_performance_func (void)
+{
+	g_autoptr(FuQuirks) quirks = fu_quirks_new ();
+	g_autoptr(GTimer) timer = g_timer_new ();
+	g_autoptr(GPtrArray) group_keys = g_ptr_array_new_with_free_func (g_free);
+	const gchar *keys[] = {
+		"Name", "Icon", "Children", "Plugin", "Flags",
+		"FirmwareSizeMin", "FirmwareSizeMax", NULL };
+
+	/* insert */
 	for (guint j = 0; j < 1000; j++) {
 		g_autofree gchar *group = NULL;
 		group = g_strdup_printf ("DeviceInstanceId=USB\\VID_0BDA&PID_%04X", j);
@@ -1771,6 +2582,28 @@ fu_plugin_quirks_performance_func (void)
 		}
 	}
 	g_print ("lookup=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* lookup using the precomputed group keys */
+	for (guint j = 0; j < 1000; j++) {
+		g_autofree gchar *group = NULL;
+		group = g_strdup_printf ("DeviceInstanceId=USB\\VID_0BDA&PID_%04X", j);
+		g_ptr_array_add (group_keys, fu_quirks_get_group_key (quirks, group));
+	}
+	g_timer_reset (timer);
+	for (guint k = 0; k < 100; k++) {
+		for (guint j = 0; j < 1000; j++) {
+			for (guint i = 0; keys[i] != NULL; i++) {
+				const gchar *group_key = g_ptr_array_index (group_keys, j);
+				const gchar *tmp = fu_quirks_lookup_by_key (quirks, group_key, keys[i]);
+				g_assert_cmpstr (tmp, ==, "Value");
+			}
+		}
+	}
+	g_print ("lookups/sec=%.0f ",
+		 (100 * 1000 * 7) / g_timer_elapsed (timer, NULL));
+
+	/* keys that are not GUIDs are never used in the XPath predicate */
+	g_assert_null (fu_quirks_lookup_by_key (quirks, "x']/../group[@id!='", "Name"));
 }
 
 static void
@@ -2159,6 +2992,145 @@ fu_history_func (void)
 	g_clear_error (&error);
 }
 
+static void
+fu_history_filtered_func (void)
+{
+	gboolean ret;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autoptr(FuHistory) history = NULL;
+	g_autoptr(FwupdRelease) release = fwupd_release_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GPtrArray) ids = g_ptr_array_new_with_free_func (g_free);
+
+	/* delete the database */
+	dirname = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
+	if (!g_file_test (dirname, G_FILE_TEST_IS_DIR))
+		return;
+	filename = g_build_filename (dirname, "pending.db", NULL);
+	g_unlink (filename);
+
+	/* two devices each updated five times, with every third one failing */
+	history = fu_history_new ();
+	for (guint i = 0; i < 10; i++) {
+		g_autofree gchar *id = g_strdup_printf ("self-test-%u", i % 2);
+		g_autofree gchar *version = g_strdup_printf ("1.2.%u", i);
+		g_autoptr(FuDevice) device = fu_device_new ();
+		fu_device_set_id (device, id);
+		fu_device_set_version (device, version);
+		fu_device_set_modified (device, 1000 + i);
+		fu_device_set_update_state (device, i % 3 == 0 ?
+					    FWUPD_UPDATE_STATE_FAILED :
+					    FWUPD_UPDATE_STATE_SUCCESS);
+		fwupd_release_set_version (release, version);
+		ret = fu_history_add_device (history, device, release, &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+		if (i < 2)
+			g_ptr_array_add (ids, g_strdup (fu_device_get_id (device)));
+	}
+
+	/* a page, oldest first */
+	devices = fu_history_get_devices_filtered (history, NULL,
+						   FWUPD_UPDATE_STATE_UNKNOWN,
+						   0, 0, 3, 4, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (devices->len, ==, 4);
+	g_assert_cmpint (fu_device_get_modified (g_ptr_array_index (devices, 0)), ==, 1003);
+	g_assert_cmpint (fu_device_get_modified (g_ptr_array_index (devices, 3)), ==, 1006);
+	g_ptr_array_unref (devices);
+
+	/* one device in a time range */
+	devices = fu_history_get_devices_filtered (history, g_ptr_array_index (ids, 1),
+						   FWUPD_UPDATE_STATE_UNKNOWN,
+						   1002, 1007, 0, 0, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (devices->len, ==, 3);
+	g_ptr_array_unref (devices);
+
+	/* only failures */
+	devices = fu_history_get_devices_filtered (history, NULL,
+						   FWUPD_UPDATE_STATE_FAILED,
+						   0, 0, 0, 0, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (devices->len, ==, 4);
+	g_ptr_array_unref (devices);
+
+	/* remove old successful updates, keeping the last of each device */
+	ret = fu_history_prune (history, 1008, &error);
+	g_assert_no_error (error);
+	g_assert_true (ret);
+	devices = fu_history_get_devices (history, &error);
+	g_assert_no_error (error);
+	g_assert_cmpint (devices->len, ==, 5);
+}
+
+static void
+fu_history_performance_func (void)
+{
+	gboolean ret;
+	gint rc;
+	g_autofree gchar *dirname = NULL;
+	g_autofree gchar *filename = NULL;
+	g_autofree gchar *plan = NULL;
+	g_autoptr(FuHistory) history = NULL;
+	g_autoptr(FwupdRelease) release = fwupd_release_new ();
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) ids = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GTimer) timer = g_timer_new ();
+	sqlite3 *db = NULL;
+	sqlite3_stmt *stmt = NULL;
+
+	/* delete the database */
+	dirname = fu_common_get_path (FU_PATH_KIND_LOCALSTATEDIR_PKG);
+	if (!g_file_test (dirname, G_FILE_TEST_IS_DIR))
+		return;
+	filename = g_build_filename (dirname, "pending.db", NULL);
+	g_unlink (filename);
+
+	/* add lots of devices */
+	history = fu_history_new ();
+	fwupd_release_set_version (release, "1.2.3");
+	for (guint i = 0; i < 2000; i++) {
+		g_autofree gchar *id = g_strdup_printf ("self-test-%04u", i);
+		g_autoptr(FuDevice) device = fu_device_new ();
+		fu_device_set_id (device, id);
+		fu_device_set_version (device, "1.2.2");
+		ret = fu_history_add_device (history, device, release, &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+		g_ptr_array_add (ids, g_strdup (fu_device_get_id (device)));
+	}
+	g_print ("add=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* look them all up again */
+	g_timer_reset (timer);
+	for (guint i = 0; i < ids->len; i++) {
+		const gchar *id = g_ptr_array_index (ids, i);
+		g_autoptr(FuDevice) device = NULL;
+		device = fu_history_get_device_by_id (history, id, &error);
+		g_assert_no_error (error);
+		g_assert_cmpstr (fu_device_get_id (device), ==, id);
+	}
+	g_print ("lookup=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* the lookup does not scan the whole table */
+	rc = sqlite3_open (filename, &db);
+	g_assert_cmpint (rc, ==, SQLITE_OK);
+	rc = sqlite3_prepare_v2 (db, "EXPLAIN QUERY PLAN SELECT * FROM history "
+				 "WHERE device_id = ?1 LIMIT 1", -1, &stmt, NULL);
+	g_assert_cmpint (rc, ==, SQLITE_OK);
+	while (sqlite3_step (stmt) == SQLITE_ROW) {
+		const gchar *tmp = (const gchar *) sqlite3_column_text (stmt, 3);
+		if (tmp != NULL && g_strstr_len (tmp, -1, "idx_history_device_id") != NULL)
+			plan = g_strdup (tmp);
+	}
+	sqlite3_finalize (stmt);
+	sqlite3_close (db);
+	g_assert_nonnull (plan);
+}
+
 static void
 fu_keyring_gpg_func (void)
 {
@@ -2401,6 +3373,92 @@ fu_device_locker_fail_func (void)
 	g_assert_null (locker);
 }
 
+#ifdef HAVE_MEMFD_SEALS
+static guint64
+fu_common_get_rss_anon (void)
+{
+	g_autofree gchar *buf = NULL;
+	g_auto(GStrv) lines = NULL;
+	if (!g_file_get_contents ("/proc/self/status", &buf, NULL, NULL))
+		return 0;
+	lines = g_strsplit (buf, "\n", -1);
+	for (guint i = 0; lines[i] != NULL; i++) {
+		if (g_str_has_prefix (lines[i], "RssAnon:"))
+			return g_ascii_strtoull (lines[i] + 8, NULL, 10) * 1024;
+	}
+	return 0;
+}
+
+static void
+fu_common_get_contents_fd_memfd_func (void)
+{
+	const gsize sz = 32 * 1024 * 1024;
+	gint fd;
+	gint fd_dup;
+	guint64 rss_before;
+	guint64 rss_after;
+	g_autofree guint8 *chunk = g_malloc (1024 * 1024);
+	g_autofree gchar *csum = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GError) error = NULL;
+
+	/* write a large archive-sized payload into a memfd */
+	fd = memfd_create ("fu-self-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	g_assert_cmpint (fd, >=, 0);
+	for (gsize i = 0; i < 1024 * 1024; i++)
+		chunk[i] = i & 0xff;
+	for (gsize i = 0; i < sz / (1024 * 1024); i++)
+		g_assert_cmpint (write (fd, chunk, 1024 * 1024), ==, 1024 * 1024);
+	g_assert_cmpint (lseek (fd, 0, SEEK_SET), ==, 0);
+
+	/* not sealed by the sender, so read normally and not sealed by us */
+	fd_dup = dup (fd);
+	blob = fu_common_get_contents_fd (fd, sz, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (blob);
+	g_assert_cmpint (g_bytes_get_size (blob), ==, sz);
+	g_assert_cmpint (fcntl (fd_dup, F_GET_SEALS) & F_SEAL_WRITE, ==, 0);
+	g_bytes_unref (g_steal_pointer (&blob));
+
+	/* sealed by the sender */
+	g_assert_cmpint (fcntl (fd_dup, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+						     F_SEAL_WRITE | F_SEAL_SEAL), ==, 0);
+	g_assert_cmpint (lseek (fd_dup, 0, SEEK_SET), ==, 0);
+
+	/* the page cache of the memfd is shared, so the anonymous RSS should
+	 * not grow by the size of the payload if it was mapped */
+	rss_before = fu_common_get_rss_anon ();
+	if (rss_before == 0) {
+		close (fd_dup);
+		g_test_skip ("no RssAnon in /proc/self/status");
+		return;
+	}
+	blob = fu_common_get_contents_fd (fd_dup, sz, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (blob);
+	g_assert_cmpint (g_bytes_get_size (blob), ==, sz);
+	csum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, blob);
+	g_assert_nonnull (csum);
+	rss_after = fu_common_get_rss_anon ();
+	g_debug ("RssAnon grew by %" G_GUINT64_FORMAT " bytes",
+		 rss_after > rss_before ? rss_after - rss_before : 0);
+	g_assert_cmpint (rss_after, <, rss_before + 8 * 1024 * 1024);
+
+	/* too large for the limit; the dup is closed by the callee on every
+	 * path, and we always close our own copy */
+	fd = memfd_create ("fu-self-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	g_assert_cmpint (fd, >=, 0);
+	g_assert_cmpint (write (fd, chunk, 1024), ==, 1024);
+	g_assert_cmpint (fcntl (fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW |
+						 F_SEAL_WRITE), ==, 0);
+	g_bytes_unref (g_steal_pointer (&blob));
+	blob = fu_common_get_contents_fd (dup (fd), 512, &error);
+	close (fd);
+	g_assert_error (error, FWUPD_ERROR, FWUPD_ERROR_INVALID_FILE);
+	g_assert_null (blob);
+}
+#endif
+
 static void
 fu_common_spawn_func (void)
 {
@@ -2698,6 +3756,281 @@ fu_plugin_composite_func (void)
 	}
 }
 
+static void
+_plugin_coldplug_device_added_cb (FuPlugin *plugin, FuDevice *device, gpointer user_data)
+{
+	FuEngine *engine = FU_ENGINE (user_data);
+	GThread *thread = g_object_get_data (G_OBJECT (engine), "thread");
+
+	/* the engine must only ever be used from the main thread */
+	g_assert (g_thread_self () == thread);
+	fu_engine_add_device (engine, device);
+}
+
+static void
+_plugin_coldplug_delay_cb (FuPlugin *plugin, guint duration, gpointer user_data)
+{
+	FuEngine *engine = FU_ENGINE (user_data);
+	GThread *thread = g_object_get_data (G_OBJECT (engine), "thread");
+	guint *cnt = g_object_get_data (G_OBJECT (engine), "cnt");
+
+	/* signals without a device are also handled in the main thread */
+	g_assert (g_thread_self () == thread);
+	(*cnt)++;
+}
+
+/* coldplugs plugins that each take 50ms, returning the time taken in ms */
+static gdouble
+fu_engine_coldplug_threads_run (guint coldplug_threads)
+{
+	const guint plugins_cnt = 8;
+	gdouble elapsed;
+	FuPlugin *plugin_last = NULL;
+	guint cnt = 0;
+	g_autoptr(FuEngine) engine = fu_engine_new (FU_APP_FLAGS_NONE);
+	g_autoptr(GError) error = NULL;
+	g_autoptr(GPtrArray) devices = NULL;
+	g_autoptr(GTimer) timer = NULL;
+	g_autoptr(XbSilo) silo_empty = xb_silo_new ();
+
+	g_setenv ("FWUPD_PLUGIN_TEST", "coldplug-delay", TRUE);
+	fu_engine_set_silo (engine, silo_empty);
+	g_object_set_data (G_OBJECT (engine), "thread", g_thread_self ());
+	g_object_set_data (G_OBJECT (engine), "cnt", &cnt);
+	for (guint i = 0; i < plugins_cnt; i++) {
+		gboolean ret;
+		g_autofree gchar *name = g_strdup_printf ("test%u", i);
+		g_autoptr(FuPlugin) plugin = fu_plugin_new ();
+		fu_plugin_set_name (plugin, name);
+		ret = fu_plugin_open (plugin, PLUGINBUILDDIR "/libfu_plugin_test.so", &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+		g_signal_connect (plugin, "device-added",
+				  G_CALLBACK (_plugin_coldplug_device_added_cb),
+				  engine);
+		g_signal_connect (plugin, "set-coldplug-delay",
+				  G_CALLBACK (_plugin_coldplug_delay_cb),
+				  engine);
+		fu_engine_add_plugin (engine, plugin);
+		plugin_last = plugin;
+	}
+
+	/* the last plugin cannot be run in parallel with the first */
+	fu_plugin_add_rule (plugin_last, FU_PLUGIN_RULE_RUN_AFTER, "test0");
+
+	fu_engine_set_coldplug_threads (engine, coldplug_threads);
+	timer = g_timer_new ();
+	fu_engine_plugins_coldplug (engine, FALSE);
+	elapsed = g_timer_elapsed (timer, NULL) * 1000.f;
+	g_unsetenv ("FWUPD_PLUGIN_TEST");
+
+	/* all devices were added from the main thread */
+	devices = fu_engine_get_devices (engine, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (devices);
+	g_assert_cmpint (devices->len, ==, plugins_cnt);
+	g_assert_cmpint (cnt, ==, plugins_cnt);
+	return elapsed;
+}
+
+static void
+fu_engine_coldplug_threads_func (void)
+{
+	/* serial, then using a thread per plugin */
+	fu_engine_coldplug_threads_run (0);
+	fu_engine_coldplug_threads_run (8);
+}
+
+static void
+fu_engine_coldplug_threads_performance_func (void)
+{
+	gdouble elapsed[2];
+
+	elapsed[0] = fu_engine_coldplug_threads_run (0);
+	elapsed[1] = fu_engine_coldplug_threads_run (8);
+	g_test_message ("serial=%.0fms", elapsed[0]);
+	g_test_minimized_result (elapsed[1], "threaded=%.0fms", elapsed[1]);
+}
+
+typedef struct {
+	GThread		*main_thread;
+	guint		 device_changed_cnt;
+	guint		 status_changed_cnt;
+	guint		 wrong_thread_cnt;
+} FuEngineInstallThreadsHelper;
+
+static void
+_engine_install_device_changed_cb (FuEngine *engine, FuDevice *device, gpointer user_data)
+{
+	FuEngineInstallThreadsHelper *helper = (FuEngineInstallThreadsHelper *) user_data;
+	if (g_thread_self () != helper->main_thread)
+		helper->wrong_thread_cnt++;
+	helper->device_changed_cnt++;
+}
+
+static void
+_engine_install_status_changed_cb (FuEngine *engine, FwupdStatus status, gpointer user_data)
+{
+	FuEngineInstallThreadsHelper *helper = (FuEngineInstallThreadsHelper *) user_data;
+	if (g_thread_self () != helper->main_thread)
+		helper->wrong_thread_cnt++;
+	helper->status_changed_cnt++;
+}
+
+static void
+fu_engine_install_threads_func (void)
+{
+	const guint devices_cnt = 4;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GError) error = NULL;
+	g_autoptr(XbNode) component = NULL;
+	g_autoptr(XbSilo) silo_empty = xb_silo_new ();
+	g_autoptr(XbSilo) silo = NULL;
+
+	blob = _build_cab (GCAB_COMPRESSION_NONE,
+			   "acme.metainfo.xml",
+	"<component type=\"firmware\">\n"
+	"  <id>com.acme.example.firmware</id>\n"
+	"  <provides>\n"
+	"    <firmware type=\"flashed\">b585990a-003e-5270-89d5-3705a17f9a43</firmware>\n"
+	"  </provides>\n"
+	"  <releases>\n"
+	"    <release version=\"1.2.3\"/>\n"
+	"  </releases>\n"
+	"</component>",
+			   "firmware.bin", "world",
+			   NULL);
+	if (blob == NULL) {
+		g_test_skip ("libgcab too old");
+		return;
+	}
+	silo = fu_common_cab_build_silo (blob, 10240, &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (silo);
+	component = xb_silo_query_first (silo, "component", &error);
+	g_assert_no_error (error);
+	g_assert_nonnull (component);
+
+	/* serial, then using a thread per device */
+	for (guint k = 0; k < 2; k++) {
+		gboolean ret;
+		FuEngineInstallThreadsHelper helper = {
+			.main_thread	= g_thread_self (),
+		};
+		g_autoptr(FuEngine) engine = fu_engine_new (FU_APP_FLAGS_NONE);
+		g_autoptr(FuPlugin) plugin = fu_plugin_new ();
+		g_autoptr(GPtrArray) devices = NULL;
+		g_autoptr(GPtrArray) install_tasks = NULL;
+
+		fu_engine_set_silo (engine, silo_empty);
+		ret = fu_plugin_open (plugin, PLUGINBUILDDIR "/libfu_plugin_test.so", &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+		fu_engine_add_plugin (engine, plugin);
+
+		/* identical devices on different ports */
+		devices = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		install_tasks = g_ptr_array_new_with_free_func ((GDestroyNotify) g_object_unref);
+		for (guint i = 0; i < devices_cnt; i++) {
+			g_autofree gchar *id = g_strdup_printf ("device%u", i);
+			g_autoptr(FuDevice) device = fu_device_new ();
+			fu_device_set_id (device, id);
+			fu_device_set_physical_id (device, id);
+			fu_device_set_plugin (device, "test");
+			fu_device_set_version (device, "1.2.2");
+			fu_device_add_guid (device, "b585990a-003e-5270-89d5-3705a17f9a43");
+			fu_device_add_flag (device, FWUPD_DEVICE_FLAG_UPDATABLE);
+			fu_engine_add_device (engine, device);
+			g_ptr_array_add (install_tasks, fu_install_task_new (device, component));
+			g_ptr_array_add (devices, g_steal_pointer (&device));
+		}
+		g_signal_connect (engine, "device-changed",
+				  G_CALLBACK (_engine_install_device_changed_cb),
+				  &helper);
+		g_signal_connect (engine, "status-changed",
+				  G_CALLBACK (_engine_install_status_changed_cb),
+				  &helper);
+
+		fu_engine_set_install_threads (engine, k == 0 ? 0 : devices_cnt);
+		ret = fu_engine_install_tasks (engine, install_tasks, blob,
+					       FWUPD_INSTALL_FLAG_NO_HISTORY,
+					       &error);
+		g_assert_no_error (error);
+		g_assert_true (ret);
+
+		/* everything was updated, with progress for every device, and
+		 * every signal was delivered before returning */
+		for (guint i = 0; i < devices->len; i++) {
+			FuDevice *device = g_ptr_array_index (devices, i);
+			g_assert_cmpstr (fu_device_get_version (device), ==, "1.2.3");
+		}
+		g_assert_cmpint (helper.device_changed_cnt, >=, devices_cnt * 300);
+		g_assert_cmpint (helper.status_changed_cnt, >, 0);
+		g_assert_cmpint (fu_engine_get_status (engine), ==, FWUPD_STATUS_IDLE);
+
+		/* the daemon is not threadsafe */
+		g_assert_cmpint (helper.wrong_thread_cnt, ==, 0);
+	}
+}
+
+static void
+fu_common_checksums_func (void)
+{
+	g_autoptr(GBytes) blob = g_bytes_new_static ("123456789", 9);
+	g_autoptr(GPtrArray) checksums = NULL;
+	g_autoptr(GPtrArray) checksums_crc = NULL;
+
+	/* all of them, in a fixed order */
+	checksums = fu_common_get_checksums (blob, FU_CHECKSUM_FLAG_SHA1 |
+						   FU_CHECKSUM_FLAG_SHA256 |
+						   FU_CHECKSUM_FLAG_CRC32);
+	g_assert_cmpint (checksums->len, ==, 3);
+	g_assert_cmpstr (g_ptr_array_index (checksums, 0), ==,
+			 "f7c3bc1d808e04732adf679965ccc34ca7ae3441");
+	g_assert_cmpstr (g_ptr_array_index (checksums, 1), ==,
+			 "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225");
+	g_assert_cmpstr (g_ptr_array_index (checksums, 2), ==, "cbf43926");
+
+	/* just one */
+	checksums_crc = fu_common_get_checksums (blob, FU_CHECKSUM_FLAG_CRC32);
+	g_assert_cmpint (checksums_crc->len, ==, 1);
+	g_assert_cmpstr (g_ptr_array_index (checksums_crc, 0), ==, "cbf43926");
+}
+
+static void
+fu_common_checksums_performance_func (void)
+{
+	gdouble elapsed[2];
+	gsize bufsz = 64 * 0x100000;
+	guint8 *buf = g_malloc (bufsz);
+	g_autofree gchar *sha1 = NULL;
+	g_autofree gchar *sha256 = NULL;
+	g_autoptr(GBytes) blob = NULL;
+	g_autoptr(GPtrArray) checksums = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	for (gsize i = 0; i < bufsz; i++)
+		buf[i] = (guint8) (i * 7);
+	blob = g_bytes_new_take (buf, bufsz);
+
+	/* one pass per digest */
+	g_timer_reset (timer);
+	sha1 = g_compute_checksum_for_bytes (G_CHECKSUM_SHA1, blob);
+	sha256 = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, blob);
+	elapsed[0] = g_timer_elapsed (timer, NULL) * 1000.f;
+
+	/* all at once */
+	g_timer_reset (timer);
+	checksums = fu_common_get_checksums (blob, FU_CHECKSUM_FLAG_SHA1 |
+						   FU_CHECKSUM_FLAG_SHA256);
+	elapsed[1] = g_timer_elapsed (timer, NULL) * 1000.f;
+	g_assert_cmpint (checksums->len, ==, 2);
+	g_assert_cmpstr (g_ptr_array_index (checksums, 0), ==, sha1);
+	g_assert_cmpstr (g_ptr_array_index (checksums, 1), ==, sha256);
+	g_test_message ("separate=%.0fms", elapsed[0]);
+	g_test_minimized_result (elapsed[1], "combined=%.0fms", elapsed[1]);
+}
+
 static void
 fu_common_store_cab_func (void)
 {
@@ -3046,6 +4379,39 @@ fu_device_incorporate_func (void)
 	g_assert_cmpint (fu_device_get_icons(device)->len, ==, 1);
 }
 
+static void
+fu_device_guid_raw_func (void)
+{
+	FuDeviceGuid guid_raw;
+	g_autoptr(FuDevice) device = fu_device_new ();
+	g_autoptr(FuDevice) donor = fu_device_new ();
+
+	/* only canonical lowercase GUIDs are converted */
+	g_assert_true (fu_device_guid_from_string ("2082b5e0-7a64-478a-b1b2-e3404fab6dad", &guid_raw));
+	g_assert_cmpint (guid_raw[0], ==, 0x20);
+	g_assert_cmpint (guid_raw[15], ==, 0xad);
+	g_assert_false (fu_device_guid_from_string ("2082B5E0-7A64-478A-B1B2-E3404FAB6DAD", &guid_raw));
+	g_assert_false (fu_device_guid_from_string ("2082b5e0x7a64-478a-b1b2-e3404fab6dad", &guid_raw));
+	g_assert_false (fu_device_guid_from_string ("00000000-0000-0000-0000-000000000000", &guid_raw));
+	g_assert_false (fu_device_guid_from_string ("WacomAES", &guid_raw));
+
+	/* added directly and as a counterpart */
+	fu_device_add_guid (device, "2082b5e0-7a64-478a-b1b2-e3404fab6dad");
+	fu_device_add_counterpart_guid (device, "1082b5e0-7a64-478a-b1b2-e3404fab6dad");
+	g_assert_true (fu_device_guid_from_string ("2082b5e0-7a64-478a-b1b2-e3404fab6dad", &guid_raw));
+	g_assert_true (fu_device_has_guid_raw (device, &guid_raw));
+	g_assert_true (fu_device_guid_from_string ("1082b5e0-7a64-478a-b1b2-e3404fab6dad", &guid_raw));
+	g_assert_true (fu_device_has_guid_raw (device, &guid_raw));
+	g_assert_true (fu_device_guid_from_string ("3082b5e0-7a64-478a-b1b2-e3404fab6dad", &guid_raw));
+	g_assert_false (fu_device_has_guid_raw (device, &guid_raw));
+
+	/* copied from another device */
+	fu_device_add_guid (donor, "3082b5e0-7a64-478a-b1b2-e3404fab6dad");
+	fu_device_incorporate (device, donor);
+	g_assert_true (fu_device_has_guid_raw (device, &guid_raw));
+	g_assert_true (fu_device_has_guid (device, "3082b5e0-7a64-478a-b1b2-e3404fab6dad"));
+}
+
 static void
 fu_chunk_func (void)
 {
@@ -3053,10 +4419,13 @@ fu_chunk_func (void)
 	g_autofree gchar *chunked2_str = NULL;
 	g_autofree gchar *chunked3_str = NULL;
 	g_autofree gchar *chunked4_str = NULL;
+	g_autofree gchar *chunked5_str = NULL;
+	g_autoptr(GArray) chunked_flat = NULL;
 	g_autoptr(GPtrArray) chunked1 = NULL;
 	g_autoptr(GPtrArray) chunked2 = NULL;
 	g_autoptr(GPtrArray) chunked3 = NULL;
 	g_autoptr(GPtrArray) chunked4 = NULL;
+	g_autoptr(GPtrArray) chunked5 = NULL;
 
 	chunked3 = fu_chunk_array_new ((const guint8 *) "123456", 6, 0x0, 3, 3);
 	chunked3_str = fu_chunk_array_to_string (chunked3);
@@ -3088,6 +4457,75 @@ fu_chunk_func (void)
 					   "#03: page:01 addr:0004 len:02 YY\n"
 					   "#04: page:02 addr:0000 len:04 ZZZZ\n"
 					   "#05: page:02 addr:0004 len:02 ZZ\n");
+
+	/* first byte is the last of its page */
+	chunked5 = fu_chunk_array_new ((const guint8 *) "123456", 6, 0x3, 4, 4);
+	chunked5_str = fu_chunk_array_to_string (chunked5);
+	g_print ("\n%s", chunked5_str);
+	g_assert_cmpstr (chunked5_str, ==, "#00: page:00 addr:0003 len:01 1\n"
+					   "#01: page:01 addr:0000 len:04 2345\n"
+					   "#02: page:02 addr:0000 len:01 6\n");
+
+	/* same packets, but in one allocation */
+	chunked_flat = fu_chunk_array_new_flat ((const guint8 *) "0123456789abcdef", 16, 0x0, 10, 4);
+	g_assert_cmpint (chunked_flat->len, ==, chunked1->len);
+	for (guint i = 0; i < chunked_flat->len; i++) {
+		FuChunk *chk1 = g_ptr_array_index (chunked1, i);
+		FuChunk *chk2 = &g_array_index (chunked_flat, FuChunk, i);
+		g_autofree gchar *tmp1 = fu_chunk_to_string (chk1);
+		g_autofree gchar *tmp2 = fu_chunk_to_string (chk2);
+		g_assert_cmpstr (tmp1, ==, tmp2);
+	}
+}
+
+static void
+fu_chunk_flat_func (void)
+{
+	guint32 bufsz = 0x1234;
+	g_autofree guint8 *buf = g_malloc0 (bufsz);
+
+	/* the flat array has exactly the same packets, with and without pages */
+	for (guint32 page_sz = 0; page_sz <= 0x400; page_sz += 0x400) {
+		g_autoptr(GArray) chunks_flat = NULL;
+		g_autoptr(GPtrArray) chunks = NULL;
+
+		chunks = fu_chunk_array_new (buf, bufsz, 0x100, page_sz, 32);
+		chunks_flat = fu_chunk_array_new_flat (buf, bufsz, 0x100, page_sz, 32);
+		g_assert_cmpint (chunks_flat->len, ==, chunks->len);
+		for (guint i = 0; i < chunks->len; i++) {
+			FuChunk *chk = g_ptr_array_index (chunks, i);
+			FuChunk *chk_flat = &g_array_index (chunks_flat, FuChunk, i);
+			g_assert_cmpint (chk_flat->idx, ==, chk->idx);
+			g_assert_cmpint (chk_flat->page, ==, chk->page);
+			g_assert_cmpint (chk_flat->address, ==, chk->address);
+			g_assert_true (chk_flat->data == chk->data);
+			g_assert_cmpint (chk_flat->data_sz, ==, chk->data_sz);
+		}
+	}
+}
+
+static void
+fu_chunk_performance_func (void)
+{
+	gdouble elapsed[2];
+	guint32 bufsz = 8 * 0x100000;
+	g_autofree guint8 *buf = g_malloc0 (bufsz);
+	g_autoptr(GArray) chunks_flat = NULL;
+	g_autoptr(GPtrArray) chunks = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* an allocation for each packet */
+	chunks = fu_chunk_array_new (buf, bufsz, 0x0, 0x400, 32);
+	elapsed[0] = g_timer_elapsed (timer, NULL) * 1000.f;
+
+	/* all packets in one allocation */
+	g_timer_reset (timer);
+	chunks_flat = fu_chunk_array_new_flat (buf, bufsz, 0x0, 0x400, 32);
+	elapsed[1] = g_timer_elapsed (timer, NULL) * 1000.f;
+	g_assert_cmpint (chunks_flat->len, ==, bufsz / 32);
+	g_assert_cmpint (chunks_flat->len, ==, chunks->len);
+	g_test_message ("ptrarray=%.3fms", elapsed[0]);
+	g_test_minimized_result (elapsed[1], "flat=%.3fms", elapsed[1]);
 }
 
 static void
@@ -3261,12 +4699,88 @@ fu_common_vercmp_func (void)
 	g_assert_cmpint (fu_common_vercmp ("1.2.3", "1.2.3~rc1"), >, 0);
 	g_assert_cmpint (fu_common_vercmp ("1.2.3~rc2", "1.2.3~rc1"), >, 0);
 
+	/* more sections than fit in the key */
+	g_assert_cmpint (fu_common_vercmp ("1.2.3.4.5.6.7.8.9.10", "1.2.3.4.5.6.7.8.9.11"), <, 0);
+	g_assert_cmpint (fu_common_vercmp ("1.2.3.4.5.6.7.8.9a", "1.2.3.4.5.6.7.8.9"), >, 0);
+	g_assert_cmpint (fu_common_vercmp ("1.2.3.4.5.6.7.8", "1.2.3.4.5.6.7.8.0"), <, 0);
+
 	/* invalid */
 	g_assert_cmpint (fu_common_vercmp ("1", NULL), ==, G_MAXINT);
 	g_assert_cmpint (fu_common_vercmp (NULL, "1"), ==, G_MAXINT);
 	g_assert_cmpint (fu_common_vercmp (NULL, NULL), ==, G_MAXINT);
 }
 
+static gint
+fu_common_vercmp_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return fu_common_vercmp (*((const gchar **) a), *((const gchar **) b));
+}
+
+static gint
+fu_common_version_key_sort_cb (gconstpointer a, gconstpointer b)
+{
+	return fu_common_version_key_cmp (a, b);
+}
+
+static void
+fu_common_version_key_func (void)
+{
+	const guint nr_versions = 5000;
+	FuVersionKey key_a;
+	FuVersionKey key_b;
+	g_autofree FuVersionKey *keys = NULL;
+	g_autoptr(GPtrArray) versions = g_ptr_array_new_with_free_func (g_free);
+	g_autoptr(GPtrArray) versions_sorted = NULL;
+	g_autoptr(GTimer) timer = g_timer_new ();
+
+	/* keys compare the same as strings */
+	fu_common_version_key_init (&key_a, "1.2.3");
+	fu_common_version_key_init (&key_b, "0x1020003");
+	g_assert_cmpint (fu_common_version_key_cmp (&key_a, &key_b), ==, 0);
+	fu_common_version_key_init (&key_b, "1.2.3~rc1");
+	g_assert_cmpint (fu_common_version_key_cmp (&key_a, &key_b), >, 0);
+	fu_common_version_key_init (&key_b, NULL);
+	g_assert_cmpint (fu_common_version_key_cmp (&key_a, &key_b), ==, G_MAXINT);
+
+	/* lots of releases in different formats */
+	for (guint i = 0; i < nr_versions; i++) {
+		guint j = (i * 7919) % nr_versions;
+		if (i % 3 == 0) {
+			g_ptr_array_add (versions, g_strdup_printf ("1.%u.%u", j / 100, j % 100));
+		} else if (i % 3 == 1) {
+			g_ptr_array_add (versions, g_strdup_printf ("0x%08x", 0x01000000 + j));
+		} else {
+			g_ptr_array_add (versions, g_strdup_printf ("1.%u.%u~rc%u",
+								    j / 100, j % 100, j % 3));
+		}
+	}
+
+	/* sort using the string API */
+	versions_sorted = g_ptr_array_new ();
+	for (guint i = 0; i < versions->len; i++)
+		g_ptr_array_add (versions_sorted, g_ptr_array_index (versions, i));
+	g_timer_reset (timer);
+	g_ptr_array_sort (versions_sorted, fu_common_vercmp_sort_cb);
+	g_print ("vercmp=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* sort using keys parsed once */
+	g_timer_reset (timer);
+	keys = g_new (FuVersionKey, versions->len);
+	for (guint i = 0; i < versions->len; i++)
+		fu_common_version_key_init (&keys[i], g_ptr_array_index (versions, i));
+	qsort (keys, versions->len, sizeof(FuVersionKey), fu_common_version_key_sort_cb);
+	g_print ("key=%.3fms ", g_timer_elapsed (timer, NULL) * 1000.f);
+
+	/* both agree on the order */
+	for (guint i = 0; i < versions->len; i++) {
+		FuVersionKey key_tmp;
+		fu_common_version_key_init (&key_tmp, g_ptr_array_index (versions_sorted, i));
+		g_assert_cmpint (fu_common_version_key_cmp (&keys[i], &key_tmp), ==, 0);
+		if (i > 0)
+			g_assert_cmpint (fu_common_version_key_cmp (&keys[i - 1], &keys[i]), <=, 0);
+	}
+}
+
 int
 main (int argc, char **argv)
 {
@@ -3287,10 +4801,14 @@ main (int argc, char **argv)
 	/* tests go here */
 	if (g_test_slow ())
 		g_test_add_func ("/fwupd/progressbar", fu_progressbar_func);
+	g_test_add_func ("/fwupd/profile", fu_profile_func);
 	g_test_add_func ("/fwupd/archive{invalid}", fu_archive_invalid_func);
 	g_test_add_func ("/fwupd/archive{cab}", fu_archive_cab_func);
+	g_test_add_func ("/fwupd/cab-cache", fu_cab_cache_func);
+	g_test_add_func ("/fwupd/keyring-cache", fu_keyring_cache_func);
 	g_test_add_func ("/fwupd/engine{requirements-other-device}", fu_engine_requirements_other_device_func);
 	g_test_add_func ("/fwupd/device{incorporate}", fu_device_incorporate_func);
+	g_test_add_func ("/fwupd/device{guid-raw}", fu_device_guid_raw_func);
 	g_test_add_func ("/fwupd/device{poll}", fu_device_poll_func);
 	g_test_add_func ("/fwupd/device-locker{success}", fu_device_locker_func);
 	g_test_add_func ("/fwupd/device-locker{fail}", fu_device_locker_fail_func);
@@ -3301,7 +4819,13 @@ main (int argc, char **argv)
 	g_test_add_func ("/fwupd/device-list{delay}", fu_device_list_delay_func);
 	g_test_add_func ("/fwupd/device-list{compatible}", fu_device_list_compatible_func);
 	g_test_add_func ("/fwupd/device-list{remove-chain}", fu_device_list_remove_chain_func);
+	g_test_add_func ("/fwupd/device-list{performance}", fu_device_list_performance_func);
+	g_test_add_func ("/fwupd/device-list{reindex}", fu_device_list_reindex_func);
+	g_test_add_func ("/fwupd/engine{supported-performance}", fu_engine_supported_performance_func);
 	g_test_add_func ("/fwupd/engine{device-unlock}", fu_engine_device_unlock_func);
+	g_test_add_func ("/fwupd/engine{device-unlock-order}", fu_engine_device_unlock_order_func);
+	g_test_add_func ("/fwupd/engine-silo{lifetime}", fu_engine_silo_lifetime_func);
+	g_test_add_func ("/fwupd/engine-silo{checksum}", fu_engine_silo_checksum_func);
 	g_test_add_func ("/fwupd/engine{history-success}", fu_engine_history_func);
 	g_test_add_func ("/fwupd/engine{history-error}", fu_engine_history_error_func);
 	g_test_add_func ("/fwupd/device-list{replug-auto}", fu_device_list_replug_auto_func);
@@ -3316,29 +4840,46 @@ main (int argc, char **argv)
 	g_test_add_func ("/fwupd/engine{device-auto-parent}", fu_engine_device_parent_func);
 	g_test_add_func ("/fwupd/engine{device-priority}", fu_engine_device_priority_func);
 	g_test_add_func ("/fwupd/engine{install-duration}", fu_engine_install_duration_func);
+	g_test_add_func ("/fwupd/engine{metadata-silo}", fu_engine_metadata_silo_func);
 	g_test_add_func ("/fwupd/hwids", fu_hwids_func);
 	g_test_add_func ("/fwupd/smbios", fu_smbios_func);
 	g_test_add_func ("/fwupd/smbios3", fu_smbios3_func);
 	g_test_add_func ("/fwupd/history", fu_history_func);
 	g_test_add_func ("/fwupd/history{migrate}", fu_history_migrate_func);
+	g_test_add_func ("/fwupd/history{filtered}", fu_history_filtered_func);
+	g_test_add_func ("/fwupd/history{performance}", fu_history_performance_func);
 	g_test_add_func ("/fwupd/plugin-list", fu_plugin_list_func);
 	g_test_add_func ("/fwupd/plugin-list{depsolve}", fu_plugin_list_depsolve_func);
 	g_test_add_func ("/fwupd/plugin{delay}", fu_plugin_delay_func);
 	g_test_add_func ("/fwupd/plugin{module}", fu_plugin_module_func);
 	g_test_add_func ("/fwupd/plugin{quirks}", fu_plugin_quirks_func);
+	g_test_add_func ("/fwupd/plugin{manifest}", fu_plugin_manifest_func);
+	g_test_add_func ("/fwupd/plugin{quirks-cache}", fu_plugin_quirks_cache_func);
+	g_test_add_func ("/fwupd/plugin{quirks-reload}", fu_plugin_quirks_reload_func);
 	g_test_add_func ("/fwupd/plugin{quirks-performance}", fu_plugin_quirks_performance_func);
 	g_test_add_func ("/fwupd/plugin{quirks-device}", fu_plugin_quirks_device_func);
 	g_test_add_func ("/fwupd/plugin{composite}", fu_plugin_composite_func);
+	g_test_add_func ("/fwupd/engine{coldplug-threads}", fu_engine_coldplug_threads_func);
+	if (g_test_perf ())
+		g_test_add_func ("/fwupd/engine{coldplug-threads-performance}", fu_engine_coldplug_threads_performance_func);
+	g_test_add_func ("/fwupd/engine{install-threads}", fu_engine_install_threads_func);
 	g_test_add_func ("/fwupd/keyring{gpg}", fu_keyring_gpg_func);
 	g_test_add_func ("/fwupd/keyring{pkcs7}", fu_keyring_pkcs7_func);
 	g_test_add_func ("/fwupd/plugin{build-hash}", fu_plugin_hash_func);
 	g_test_add_func ("/fwupd/chunk", fu_chunk_func);
+	g_test_add_func ("/fwupd/chunk{flat}", fu_chunk_flat_func);
+	if (g_test_perf ())
+		g_test_add_func ("/fwupd/chunk{performance}", fu_chunk_performance_func);
 	g_test_add_func ("/fwupd/common{version-guess-format}", fu_common_version_guess_format_func);
 	g_test_add_func ("/fwupd/common{guid}", fu_common_guid_func);
 	g_test_add_func ("/fwupd/common{version}", fu_common_version_func);
 	g_test_add_func ("/fwupd/common{vercmp}", fu_common_vercmp_func);
+	g_test_add_func ("/fwupd/common{version-key}", fu_common_version_key_func);
 	g_test_add_func ("/fwupd/common{strstrip}", fu_common_strstrip_func);
 	g_test_add_func ("/fwupd/common{endian}", fu_common_endian_func);
+	g_test_add_func ("/fwupd/common{checksums}", fu_common_checksums_func);
+	if (g_test_perf ())
+		g_test_add_func ("/fwupd/common{checksums-performance}", fu_common_checksums_performance_func);
 	g_test_add_func ("/fwupd/common{cab-success}", fu_common_store_cab_func);
 	g_test_add_func ("/fwupd/common{cab-success-unsigned}", fu_common_store_cab_unsigned_func);
 	g_test_add_func ("/fwupd/common{cab-success-folder}", fu_common_store_cab_folder_func);
@@ -3347,6 +4888,9 @@ main (int argc, char **argv)
 	g_test_add_func ("/fwupd/common{cab-error-wrong-checksum}", fu_common_store_cab_error_wrong_checksum_func);
 	g_test_add_func ("/fwupd/common{cab-error-missing-file}", fu_common_store_cab_error_missing_file_func);
 	g_test_add_func ("/fwupd/common{cab-error-size}", fu_common_store_cab_error_size_func);
+#ifdef HAVE_MEMFD_SEALS
+	g_test_add_func ("/fwupd/common{get-contents-fd-memfd}", fu_common_get_contents_fd_memfd_func);
+#endif
 	g_test_add_func ("/fwupd/common{spawn)", fu_common_spawn_func);
 	g_test_add_func ("/fwupd/common{firmware-builder}", fu_common_firmware_builder_func);
 	return g_test_run ();
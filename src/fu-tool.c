@@ -49,6 +49,7 @@ typedef struct {
 	gboolean		 no_reboot_check;
 	FwupdInstallFlags	 flags;
 	gboolean		 show_all_devices;
+	gboolean		 as_json;
 	/* only valid in update and downgrade */
 	FuUtilOperation		 current_operation;
 	FwupdDevice		*current_device;
@@ -386,6 +387,26 @@ fu_util_get_plugins (FuUtilPrivate *priv, gchar **values, GError **error)
 	return TRUE;
 }
 
+static gboolean
+fu_util_get_profile (FuUtilPrivate *priv, gchar **values, GError **error)
+{
+	g_autofree gchar *str = NULL;
+
+	/* load engine */
+	if (!fu_util_start_engine (priv, error))
+		return FALSE;
+
+	/* print */
+	if (priv->as_json) {
+		str = fu_profile_to_json (fu_engine_get_profile (priv->engine));
+		g_print ("%s\n", str);
+		return TRUE;
+	}
+	str = fu_profile_to_string (fu_engine_get_profile (priv->engine));
+	g_print ("%s", str);
+	return TRUE;
+}
+
 static gboolean
 fu_util_get_details (FuUtilPrivate *priv, gchar **values, GError **error)
 {
@@ -1147,6 +1168,9 @@ main (int argc, char *argv[])
 		{ "plugin-whitelist", '\0', 0, G_OPTION_ARG_STRING_ARRAY, &plugin_glob,
 			/* TRANSLATORS: command line option */
 			_("Manually whitelist specific plugins"), NULL },
+		{ "json", '\0', 0, G_OPTION_ARG_NONE, &priv->as_json,
+			/* TRANSLATORS: command line option */
+			_("Output in JSON format"), NULL },
 		{ NULL}
 	};
 
@@ -1185,6 +1209,12 @@ main (int argc, char *argv[])
 		     /* TRANSLATORS: command description */
 		     _("Get all enabled plugins registered with the system"),
 		     fu_util_get_plugins);
+	fu_util_add (priv->cmd_array,
+		     "get-profile",
+		     NULL,
+		     /* TRANSLATORS: command description */
+		     _("Gets the time spent loading the engine and plugins"),
+		     fu_util_get_profile);
 	fu_util_add (priv->cmd_array,
 		     "get-details",
 		     NULL,
@@ -1074,22 +1074,60 @@ fu_util_report_history (FuUtilPrivate *priv, gchar **values, GError **error)
 	return TRUE;
 }
 
-static gboolean
-fu_util_get_history (FuUtilPrivate *priv, gchar **values, GError **error)
+static void
+fu_util_print_history (GPtrArray *devices)
 {
-	g_autoptr(GPtrArray) devices = NULL;
-
-	/* get all devices from the history database */
-	devices = fwupd_client_get_history (priv->client, NULL, error);
-	if (devices == NULL)
-		return FALSE;
-
-	/* show each device */
 	for (guint i = 0; i < devices->len; i++) {
 		FwupdDevice *dev = g_ptr_array_index (devices, i);
 		g_autofree gchar *str = fwupd_device_to_string (dev);
 		g_print ("%s\n", str);
 	}
+}
+
+static gboolean
+fu_util_get_history (FuUtilPrivate *priv, gchar **values, GError **error)
+{
+	const guint limit = 100;
+
+	/* get the devices from the history database a page at a time */
+	for (guint offset = 0; ; offset += limit) {
+		g_autoptr(GError) error_local = NULL;
+		g_autoptr(GPtrArray) devices = NULL;
+
+		devices = fwupd_client_get_history_filtered (priv->client, NULL,
+							     FWUPD_UPDATE_STATE_UNKNOWN,
+							     0, 0, offset, limit,
+							     NULL, &error_local);
+		if (devices == NULL) {
+			/* the previous page was exactly full */
+			if (offset > 0 &&
+			    g_error_matches (error_local,
+					     FWUPD_ERROR,
+					     FWUPD_ERROR_NOTHING_TO_DO))
+				break;
+
+			/* the daemon does not support paging, so get everything */
+			if (offset == 0 &&
+			    g_error_matches (error_local,
+					     FWUPD_ERROR,
+					     FWUPD_ERROR_NOT_SUPPORTED)) {
+				g_debug ("falling back to all history: %s",
+					 error_local->message);
+				devices = fwupd_client_get_history (priv->client, NULL, error);
+				if (devices == NULL)
+					return FALSE;
+				fu_util_print_history (devices);
+				break;
+			}
+			g_propagate_error (error, g_steal_pointer (&error_local));
+			return FALSE;
+		}
+
+		/* show each device */
+		fu_util_print_history (devices);
+		if (devices->len < limit)
+			break;
+	}
 
 	return TRUE;
 }